@@ -0,0 +1,265 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bench.c
+ *
+ * Benchmarks of the objective function and the GA operators.
+ *
+ * Writes a TSV table to stdout with one row per measurement: the kernel, the
+ * number of OpenMP threads, the population size, the number of training data
+ * rows (0 for the GA operators, which don't depend on the data), the number
+ * of repetitions, the total time in seconds, and the number of designs
+ * processed per second. The thread counts are the powers of 2 up to
+ * `omp_get_max_threads()` (set with `OMP_NUM_THREADS`), and that maximum.
+ *
+ * The training data is the given data file repeated (with the times shifted)
+ * to each length, so the designs behave like they do on real data.
+ *
+ * Usage: bench [BOUNDS_PATH DATA_PATH TRIALS_PATH]
+ */
+
+#include "bt_bounds.h"
+#include "bt_data.h"
+#include "bt_model.h"
+#include "bt_plan.h"
+#include "bt_trials.h"
+#include "ga.h"
+#include "rng_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Minimum total time of each measurement, in seconds. The number of
+ * repetitions is doubled until the kernel runs for at least this long.
+ */
+#ifndef BENCH_MIN_SECONDS
+#define BENCH_MIN_SECONDS 0.5
+#endif
+
+static const size_t population_sizes[] = {100, 1000, 10000};
+static const size_t data_lengths[] = {500, 5000, 50000};
+
+/**
+ * Buffers shared by the kernels.
+ */
+typedef struct bench_t {
+    size_t nmemb;
+    const bt_design_bounds_t *bounds;
+    const bt_plan_t *plan;
+    design_var_t (*designs)[DESIGN_VAR_COUNT];
+    fitness_t *fitnesses;
+    size_t *winners;
+    design_var_t (*children)[DESIGN_VAR_COUNT];
+    fitness_t *child_fitnesses;
+    uint64_t key;
+} bench_t;
+
+
+static double wall_time()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+
+static void run_calculate_error(bench_t *bench)
+{
+    bt_model_update_fitnesses(bench->nmemb, bench->designs, bench->child_fitnesses,
+                              NULL, bench->plan, NULL);
+}
+
+
+static void run_tournament_select(bench_t *bench)
+{
+    ga_tournament_select(bench->nmemb, bench->fitnesses, bench->nmemb, bench->winners,
+                         bench->key++);
+}
+
+
+static void run_blx_alpha(bench_t *bench)
+{
+    ga_blx_alpha(bench->nmemb, DESIGN_VAR_COUNT, bench->designs, bench->winners,
+                 bench->children, 0.5, bench->key++);
+}
+
+
+static void run_mutate(bench_t *bench)
+{
+    ga_mutate(bench->nmemb, DESIGN_VAR_COUNT, bench->children, bench->bounds->stdevs,
+              0.1, bench->key++);
+}
+
+
+static void run_cull(bench_t *bench)
+{
+    ga_cull(bench->nmemb, DESIGN_VAR_COUNT, bench->designs, bench->fitnesses,
+            bench->nmemb / 10, bench->children, bench->child_fitnesses);
+}
+
+
+/*
+ * Runs the kernel, doubling the number of repetitions until they take long
+ * enough, and writes a row of results. The first run is also the warm-up.
+ */
+static void measure(const char *name, void (*kernel)(bench_t *), bench_t *bench,
+                    const int threads, const size_t data_length)
+{
+    double start = wall_time();
+    kernel(bench);
+    double seconds = wall_time() - start;
+    size_t repetitions = 1;
+    while (seconds < BENCH_MIN_SECONDS) {
+        repetitions *= 2;
+        start = wall_time();
+        for (size_t i = 0; i < repetitions; i++)
+            kernel(bench);
+        seconds = wall_time() - start;
+    }
+    printf("%s\t%d\t%zd\t%zd\t%zd\t%lf\t%lf\n", name, threads, bench->nmemb, data_length,
+           repetitions, seconds, repetitions * bench->nmemb / seconds);
+    fflush(stdout);
+}
+
+
+/*
+ * Repeats the training data and trials to the given number of rows.
+ */
+static void tile_data(const bt_data_t *data, const bt_trials_t *trials, const size_t length,
+                      bt_data_t *tiled_data, bt_trials_t *tiled_trials)
+{
+    const size_t period = data->size;
+    const double span = data->time[period-1] - data->time[0] + 1;
+    tiled_data->size = length;
+    tiled_data->time = malloc(length * sizeof(double));
+    tiled_data->performance = malloc(length * sizeof(double));
+    tiled_data->training_stress = malloc(length * sizeof(double));
+    tiled_data->input = NULL;
+    for (size_t i = 0; i < length; i++) {
+        tiled_data->time[i] = data->time[i % period] + (i / period) * span;
+        tiled_data->performance[i] = data->performance[i % period];
+        tiled_data->training_stress[i] = data->training_stress[i % period];
+    }
+    tiled_trials->size = 0;
+    tiled_trials->trial_indices = malloc(((length / period + 1) * trials->size) * sizeof(size_t));
+    for (size_t offset = 0; offset < length; offset += period) {
+        for (size_t j = 0; j < trials->size; j++) {
+            if (offset + trials->trial_indices[j] < length)
+                tiled_trials->trial_indices[tiled_trials->size++] = offset + trials->trial_indices[j];
+        }
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *bounds_path = "data/dv_bounds.tsv";
+    const char *data_path = "data/training_data.tsv";
+    const char *trials_path = "data/trial_indices.tsv";
+    if (argc == 4) {
+        bounds_path = argv[1];
+        data_path = argv[2];
+        trials_path = argv[3];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [BOUNDS_PATH DATA_PATH TRIALS_PATH]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    bt_design_bounds_t *bounds = bt_bounds_load(bounds_path);
+    bt_data_t *data = bt_data_load(data_path);
+    bt_trials_t *trials = bt_trials_load(trials_path);
+    if (bounds == NULL || data == NULL || trials == NULL) {
+        fprintf(stderr, "Unable to load the input files.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Thread counts to measure.
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    int thread_counts[8 * sizeof(int)];
+    size_t num_thread_counts = 0;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+        thread_counts[num_thread_counts++] = threads;
+    thread_counts[num_thread_counts++] = max_threads;
+
+    const size_t max_nmemb = population_sizes[sizeof(population_sizes) / sizeof(size_t) - 1];
+    bench_t bench = {
+        .bounds = bounds,
+        .designs = malloc(max_nmemb * DESIGN_VAR_COUNT * sizeof(design_var_t)),
+        .fitnesses = malloc(max_nmemb * sizeof(fitness_t)),
+        .winners = malloc(max_nmemb * sizeof(size_t)),
+        .children = malloc(max_nmemb * DESIGN_VAR_COUNT * sizeof(design_var_t)),
+        .child_fitnesses = malloc(max_nmemb * sizeof(fitness_t)),
+        .key = rng_stream_key(0, 1)
+    };
+
+    printf("kernel\tthreads\tpopulation_size\tdata_length\trepetitions\tseconds\tdesigns_per_second\n");
+    for (size_t t = 0; t < num_thread_counts; t++) {
+#ifdef _OPENMP
+        omp_set_num_threads(thread_counts[t]);
+#endif
+        for (size_t p = 0; p < sizeof(population_sizes) / sizeof(size_t); p++) {
+            bench.nmemb = population_sizes[p];
+            init_random_population(bench.nmemb, DESIGN_VAR_COUNT, bench.designs,
+                                   bounds->lower_bounds, bounds->upper_bounds, bench.key++);
+
+            // Objective function.
+            for (size_t d = 0; d < sizeof(data_lengths) / sizeof(size_t); d++) {
+                bt_data_t tiled_data;
+                bt_trials_t tiled_trials;
+                tile_data(data, trials, data_lengths[d], &tiled_data, &tiled_trials);
+                bt_plan_t *plan = bt_plan_compile(&tiled_data, &tiled_trials, BT_ODE_EULER, BT_PLAN_DOUBLE);
+                bench.plan = plan;
+                measure("calculate_error", run_calculate_error, &bench, thread_counts[t],
+                        data_lengths[d]);
+                bt_plan_free(plan);
+                free(tiled_trials.trial_indices);
+                free(tiled_data.time);
+                free(tiled_data.performance);
+                free(tiled_data.training_stress);
+            }
+
+            // GA operators, with the fitnesses of the last evaluation.
+            memcpy(bench.fitnesses, bench.child_fitnesses, bench.nmemb * sizeof(fitness_t));
+            measure("tournament_select", run_tournament_select, &bench, thread_counts[t], 0);
+            measure("blx_alpha", run_blx_alpha, &bench, thread_counts[t], 0);
+            measure("mutate", run_mutate, &bench, thread_counts[t], 0);
+            measure("cull", run_cull, &bench, thread_counts[t], 0);
+        }
+    }
+
+    free(bench.child_fitnesses);
+    free(bench.children);
+    free(bench.winners);
+    free(bench.fitnesses);
+    free(bench.designs);
+    bt_trials_free(trials);
+    bt_data_free(data);
+    bt_bounds_free(bounds);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_checkpoint.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+
+/*
+ * number of values converted to little-endian at a time
+ */
+#define BLOCK_SIZE 512
+
+
+static void store_u64(unsigned char *bytes, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+
+static uint64_t load_u64(const unsigned char *bytes)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+
+bt_checkpoint_t *bt_checkpoint_create(const char *path)
+{
+    bt_checkpoint_t *checkpoint = calloc(1, sizeof(bt_checkpoint_t));
+    checkpoint->path = strdup(path);
+    checkpoint->temp_path = malloc(strlen(path) + 5);
+    sprintf(checkpoint->temp_path, "%s.tmp", path);
+    if ((checkpoint->stream = fopen(checkpoint->temp_path, "wb")) == NULL) {
+        free(checkpoint->temp_path);
+        free(checkpoint->path);
+        free(checkpoint);
+        return NULL;
+    }
+    if (fwrite(BT_CHECKPOINT_MAGIC, 1, 8, checkpoint->stream) != 8)
+        checkpoint->failed = true;
+    return checkpoint;
+}
+
+
+int bt_checkpoint_commit(bt_checkpoint_t *checkpoint)
+{
+    bool failed = checkpoint->failed || fflush(checkpoint->stream) != 0;
+#ifndef _WIN32
+    // The data must be on disk before the rename, or a crash could leave an
+    // empty checkpoint in place of the previous one.
+    failed = failed || fsync(fileno(checkpoint->stream)) != 0;
+#endif
+    failed = fclose(checkpoint->stream) != 0 || failed;
+#ifdef _WIN32
+    // rename() doesn't replace existing files here.
+    if (!failed)
+        remove(checkpoint->path);
+#endif
+    failed = failed || rename(checkpoint->temp_path, checkpoint->path) != 0;
+    if (failed)
+        remove(checkpoint->temp_path);
+    free(checkpoint->temp_path);
+    free(checkpoint->path);
+    free(checkpoint);
+    return failed ? -1 : 0;
+}
+
+
+bt_checkpoint_t *bt_checkpoint_open(const char *path)
+{
+    FILE *stream;
+    if ((stream = fopen(path, "rb")) == NULL)
+        return NULL;
+    char magic[8];
+    if (fread(magic, 1, 8, stream) != 8 || memcmp(magic, BT_CHECKPOINT_MAGIC, 8) != 0) {
+        fclose(stream);
+        return NULL;
+    }
+    bt_checkpoint_t *checkpoint = calloc(1, sizeof(bt_checkpoint_t));
+    checkpoint->stream = stream;
+    checkpoint->path = strdup(path);
+    return checkpoint;
+}
+
+
+int bt_checkpoint_close(bt_checkpoint_t *checkpoint)
+{
+    const bool failed = checkpoint->failed || fgetc(checkpoint->stream) != EOF;
+    fclose(checkpoint->stream);
+    free(checkpoint->path);
+    free(checkpoint);
+    return failed ? -1 : 0;
+}
+
+
+void bt_checkpoint_put_size(bt_checkpoint_t *checkpoint, const size_t value)
+{
+    unsigned char bytes[8];
+    store_u64(bytes, value);
+    if (!checkpoint->failed && fwrite(bytes, 1, 8, checkpoint->stream) != 8)
+        checkpoint->failed = true;
+}
+
+
+void bt_checkpoint_put_doubles(bt_checkpoint_t *checkpoint, const size_t n,
+                               const double values[])
+{
+    unsigned char block[BLOCK_SIZE * 8];
+    for (size_t start = 0; start < n && !checkpoint->failed; start += BLOCK_SIZE) {
+        const size_t count = n - start < BLOCK_SIZE ? n - start : BLOCK_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            uint64_t bits;
+            memcpy(&bits, &values[start + i], sizeof(bits));
+            store_u64(block + 8 * i, bits);
+        }
+        if (fwrite(block, 8, count, checkpoint->stream) != count)
+            checkpoint->failed = true;
+    }
+}
+
+
+size_t bt_checkpoint_get_size(bt_checkpoint_t *checkpoint)
+{
+    unsigned char bytes[8];
+    if (checkpoint->failed || fread(bytes, 1, 8, checkpoint->stream) != 8) {
+        checkpoint->failed = true;
+        return 0;
+    }
+    const uint64_t value = load_u64(bytes);
+    if (value > SIZE_MAX) {
+        checkpoint->failed = true;
+        return 0;
+    }
+    return value;
+}
+
+
+void bt_checkpoint_get_doubles(bt_checkpoint_t *checkpoint, const size_t n,
+                               double values[])
+{
+    unsigned char block[BLOCK_SIZE * 8];
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+        const size_t count = n - start < BLOCK_SIZE ? n - start : BLOCK_SIZE;
+        if (checkpoint->failed || fread(block, 8, count, checkpoint->stream) != count) {
+            checkpoint->failed = true;
+            memset(values + start, 0, count * sizeof(double));
+            continue;
+        }
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t bits = load_u64(block + 8 * i);
+            memcpy(&values[start + i], &bits, sizeof(bits));
+        }
+    }
+}
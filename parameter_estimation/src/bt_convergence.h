@@ -0,0 +1,119 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_convergence.h
+ *
+ * Log of the distribution of the objective function values in each
+ * generation.
+ */
+
+#pragma once
+
+#include "bt_table.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Size of the output buffer of a convergence log, in bytes.
+ */
+#ifndef BT_CONVERGENCE_BUFFER_SIZE
+#define BT_CONVERGENCE_BUFFER_SIZE (1 << 16)
+#endif
+
+/**
+ * Number of values in each row of a convergence log.
+ */
+#define BT_CONVERGENCE_NUM_COLUMNS 6
+
+/**
+ * A convergence log file.
+ *
+ * Each row has the generation number and the min/q1/median/q3/max of the
+ * objective function values. The rows are also kept in memory, so that they
+ * can be saved in checkpoints. In TSV format, the rows are buffered and
+ * written in large blocks; in binary format, the table is written when the
+ * log is closed.
+ */
+typedef struct bt_convergence_t {
+    /**
+     * The file being written.
+     */
+    FILE *stream;
+    /**
+     * Buffer of @p stream.
+     */
+    char *buffer;
+    /**
+     * Format of the log.
+     */
+    enum bt_table_format format;
+    /**
+     * Number of rows held in @p rows.
+     */
+    size_t num_rows;
+    /**
+     * Number of rows that fit in @p rows.
+     */
+    size_t capacity;
+    /**
+     * Rows of #BT_CONVERGENCE_NUM_COLUMNS values each.
+     */
+    double *rows;
+} bt_convergence_t;
+
+/**
+ * Creates a convergence log and writes its header.
+ *
+ * The returned pointer must be freed with bt_convergence_close().
+ *
+ * @param[in] path Path of the file to create.
+ * @param[in] format Format of the file.
+ * @returns A pointer to the log, or `NULL` if the file couldn't be opened.
+ */
+bt_convergence_t *bt_convergence_open(const char *path, const enum bt_table_format format);
+
+/**
+ * Appends the statistics of one generation to the log.
+ *
+ * The quartiles are found by selection (see stats_quantiles()), so this
+ * takes linear time in @p nmemb.
+ *
+ * @param[in,out] log The log.
+ * @param[in] generation The generation number.
+ * @param[in] nmemb Number of objective function values.
+ * @param[in] fitnesses Array of objective function values.
+ */
+void bt_convergence_write(bt_convergence_t *log, const size_t generation,
+                          const size_t nmemb, const double fitnesses[]);
+
+/**
+ * Appends rows saved from another log, such as in a checkpoint.
+ *
+ * @param[in,out] log The log.
+ * @param[in] num_rows Number of rows.
+ * @param[in] rows Rows of #BT_CONVERGENCE_NUM_COLUMNS values each.
+ */
+void bt_convergence_restore(bt_convergence_t *log, const size_t num_rows,
+                            const double rows[]);
+
+/**
+ * Flushes and closes a log opened with bt_convergence_open().
+ *
+ * @param[in] log The log to close.
+ */
+void bt_convergence_close(bt_convergence_t *log);
@@ -20,67 +20,97 @@
 #include <string.h>
 
 
-static int bt_data_parse_line(const char *line, bt_data_t *data) {
-    return sscanf(line, "%lf %lf %lf",
-                  data->time + data->size,
-                  data->performance + data->size,
-                  data->training_stress + data->size) == 3 ? 0 : 1;
+static int bt_data_parse_line(const char *line, const char *end, bt_data_t *data) {
+    return bt_input_parse_double(&line, end, data->time + data->size) == 0
+        && bt_input_parse_double(&line, end, data->performance + data->size) == 0
+        && bt_input_parse_double(&line, end, data->training_stress + data->size) == 0 ? 0 : 1;
 }
 
 
-bt_data_t *bt_data_load(const char *path)
+/*
+ * parses the training data from a TSV file into newly allocated arrays
+ */
+static bt_data_t *bt_data_parse_text(bt_input_t *input)
 {
-    // Open file
-    FILE *file;
-    if ((file = fopen(path, "r")) == NULL)
-        return NULL;
-    char *line = NULL;
-    size_t length = 0;
+    const char *end = input->data + input->size;
 
     // Skip header line
-    if (getline(&line, &length, file) == -1) {
-        free(line);
-        fclose(file);
+    if (input->size == 0)
         return NULL;
-    }
+    const char *line = bt_input_next_line(input->data, end);
 
-    // Allocate memory
-    size_t capacity = 1000;
+    // Allocate memory. Counting the lines first means that the arrays are
+    // allocated once at their final size.
+    const size_t capacity = bt_input_count_lines(line, end);
     bt_data_t *data = calloc(1, sizeof(bt_data_t));
-    data->time = malloc(capacity * sizeof(double));
-    data->performance = malloc(capacity * sizeof(double));
-    data->training_stress = malloc(capacity * sizeof(double));
+    data->time = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+    data->performance = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
+    data->training_stress = malloc((capacity > 0 ? capacity : 1) * sizeof(double));
 
     // Read data
-    while (getline(&line, &length, file) != -1) {
-        // Enlarge arrays if necessary
-        if (data->size >= capacity) {
-            capacity <<= 1;
-            data->time = realloc(data->time, capacity * sizeof(double));
-            data->performance = realloc(data->performance, capacity * sizeof(double));
-            data->training_stress = realloc(data->training_stress, capacity * sizeof(double));
-        }
-
-        // Parse line
-        if (bt_data_parse_line(line, data) != 0) {
-            fprintf(stderr, "Unable to parse line '%s'.\n", line);
-            free(line);
-            fclose(file);
+    while (line < end) {
+        const char *next_line = bt_input_next_line(line, end);
+        if (bt_data_parse_line(line, next_line, data) != 0) {
+            fprintf(stderr, "Unable to parse line '%.*s'.\n", (int)(next_line - line), line);
             bt_data_free(data);
             return NULL;
         }
         data->size++;
+        line = next_line;
+        bt_input_release(input, line);
+    }
+    return data;
+}
+
+
+/*
+ * uses the first three columns of a binary table as the training data; the
+ * arrays point into the mapped file if possible
+ */
+static bt_data_t *bt_data_from_table(bt_input_t *input)
+{
+    size_t header_size, num_columns, num_rows;
+    if (bt_table_parse_header(input->data, input->size, &header_size, &num_columns, &num_rows) != 0
+        || num_columns < 3)
+        return NULL;
+    char *columns = input->data + header_size;
+    const size_t column_size = num_rows * sizeof(double);
+    bt_data_t *data = calloc(1, sizeof(bt_data_t));
+    data->size = num_rows;
+    if (bt_table_native()) {
+        data->time = (double *)columns;
+        data->performance = (double *)(columns + column_size);
+        data->training_stress = (double *)(columns + 2 * column_size);
+        data->input = input;
+    } else {
+        data->time = malloc((num_rows > 0 ? num_rows : 1) * sizeof(double));
+        data->performance = malloc((num_rows > 0 ? num_rows : 1) * sizeof(double));
+        data->training_stress = malloc((num_rows > 0 ? num_rows : 1) * sizeof(double));
+        for (size_t i = 0; i < num_rows; i++) {
+            data->time[i] = bt_table_value(columns, i);
+            data->performance[i] = bt_table_value(columns + column_size, i);
+            data->training_stress[i] = bt_table_value(columns + 2 * column_size, i);
+        }
     }
+    return data;
+}
+
 
-    // Free resources.
-    free(line);
-    fclose(file);
+bt_data_t *bt_data_load(const char *path)
+{
+    bt_input_t *input;
+    if ((input = bt_input_open(path)) == NULL)
+        return NULL;
 
-    // Resize arrays to the number of values they contain
-    data->time = realloc(data->time, data->size * sizeof(double));
-    data->performance = realloc(data->performance, data->size * sizeof(double));
-    data->training_stress = realloc(data->training_stress, data->size * sizeof(double));
+    bt_data_t *data;
+    if (input->size >= 8 && memcmp(input->data, BT_TABLE_MAGIC, 8) == 0)
+        data = bt_data_from_table(input);
+    else
+        data = bt_data_parse_text(input);
 
+    // Keep the file mapped if the data points into it.
+    if (data == NULL || data->input != input)
+        bt_input_close(input);
     return data;
 }
 
@@ -99,8 +129,19 @@ bt_data_t *bt_data_copy(const bt_data_t *data)
 }
 
 
-void bt_data_write(FILE *stream, const bt_data_t *data)
+void bt_data_write(FILE *stream, const enum bt_table_format format, const bt_data_t *data)
 {
+    if (format == BT_TABLE_BINARY) {
+        static const char *const names[] = {"day", "performance", "training_stress"};
+        double *values = malloc(3 * data->size * sizeof(double));
+        memcpy(values, data->time, data->size * sizeof(double));
+        memcpy(values + data->size, data->performance, data->size * sizeof(double));
+        memcpy(values + 2 * data->size, data->training_stress, data->size * sizeof(double));
+        bt_table_write(stream, 3, data->size, names, NULL, values);
+        free(values);
+        return;
+    }
+
     fprintf(stream, "day\tperformance\ttraining_stress\n");
     for (int j = 0; j < data->size; j++) {
         fprintf(stream, "%lf\t%lf\t%lf\n",
@@ -114,8 +155,12 @@ void bt_data_free(bt_data_t *data)
     if (data == NULL)
         return;
 
-    free(data->time);
-    free(data->performance);
-    free(data->training_stress);
+    if (data->input != NULL) {
+        bt_input_close(data->input);
+    } else {
+        free(data->time);
+        free(data->performance);
+        free(data->training_stress);
+    }
     free(data);
 }
@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include "bt_input.h"
+#include "bt_table.h"
 #include <stdio.h>
 
 /**
@@ -48,11 +50,21 @@ typedef struct bt_data_t {
      * Array of the training stresses.
      */
     double *training_stress;
+    /**
+     * The mapped file that the arrays point into, or `NULL` if they're
+     * allocated.
+     */
+    bt_input_t *input;
 } bt_data_t;
 
 /**
  * Reads the training data file at the specified path.
  *
+ * The file is either a TSV file with a header line and rows of day,
+ * performance, and training stress, or a binary table (see bt_table.h)
+ * whose first three columns are those values. A binary table is mapped into
+ * memory and used in place, without parsing or copying.
+ *
  * The resulting pointer must be freed with bt_data_free().
  *
  * @param[in] path Path where the file is located.
@@ -71,12 +83,13 @@ bt_data_t *bt_data_load(const char *path);
 bt_data_t *bt_data_copy(const bt_data_t *data);
 
 /**
- * Writes the training data to the given stream.
+ * Writes the training data to the given stream as a table.
  *
  * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
  * @param[in] data The data to write.
  */
-void bt_data_write(FILE *stream, const bt_data_t *data);
+void bt_data_write(FILE *stream, const enum bt_table_format format, const bt_data_t *data);
 
 /**
  * Frees a pointer allocated by bt_data_load() or bt_data_copy().
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_input.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+/*
+ * the largest mantissa and powers of ten that are exactly representable as
+ * doubles, so that a single multiplication or division is correctly rounded
+ */
+#define MAX_EXACT_MANTISSA (UINT64_C(1) << 53)
+#define MAX_EXACT_POW10 22
+#define MAX_FAST_DIGITS 19
+
+/* longest number passed to strtod() */
+#define MAX_TOKEN_LENGTH 128
+
+
+static const double exact_pow10[MAX_EXACT_POW10 + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+#ifdef _WIN32
+static bt_input_t *bt_input_read(const char *path)
+{
+    FILE *file;
+    if ((file = fopen(path, "rb")) == NULL)
+        return NULL;
+    bt_input_t *input = calloc(1, sizeof(bt_input_t));
+    size_t capacity = 0;
+    size_t length;
+    do {
+        capacity = capacity > 0 ? 2 * capacity : 1 << 16;
+        input->data = realloc(input->data, capacity);
+        length = fread(input->data + input->size, 1, capacity - input->size, file);
+        input->size += length;
+    } while (input->size == capacity);
+    fclose(file);
+    return input;
+}
+#endif
+
+
+bt_input_t *bt_input_open(const char *path)
+{
+#ifdef _WIN32
+    return bt_input_read(path);
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    bt_input_t *input = calloc(1, sizeof(bt_input_t));
+    input->size = st.st_size;
+    if (input->size > 0) {
+        void *address = mmap(NULL, input->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            free(input);
+            return NULL;
+        }
+        madvise(address, input->size, MADV_SEQUENTIAL);
+        input->data = address;
+        input->mapped = true;
+    }
+    close(fd);
+    return input;
+#endif
+}
+
+
+void bt_input_close(bt_input_t *input)
+{
+    if (input == NULL)
+        return;
+
+#ifndef _WIN32
+    if (input->mapped)
+        munmap(input->data, input->size);
+    else
+#endif
+        free(input->data);
+    free(input);
+}
+
+
+void bt_input_release(bt_input_t *input, const char *cursor)
+{
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+    const size_t offset = cursor - input->data;
+    if (!input->mapped || offset - input->released < BT_INPUT_RELEASE_SIZE)
+        return;
+    const size_t page_size = sysconf(_SC_PAGESIZE);
+    const size_t end = offset / page_size * page_size;
+    // The mapping hasn't been written, so dropping its pages just means that
+    // they'd be read from the file again.
+    madvise(input->data + input->released, end - input->released, MADV_DONTNEED);
+    input->released = end;
+#endif
+}
+
+
+size_t bt_input_count_lines(const char *cursor, const char *end)
+{
+    size_t num_lines = 0;
+    while (cursor < end) {
+        const char *newline = memchr(cursor, '\n', end - cursor);
+        num_lines++;
+        if (newline == NULL)
+            break;
+        cursor = newline + 1;
+    }
+    return num_lines;
+}
+
+
+const char *bt_input_next_line(const char *cursor, const char *end)
+{
+    const char *newline = memchr(cursor, '\n', end - cursor);
+    return newline ? newline + 1 : end;
+}
+
+
+static bool is_space(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+
+static const char *skip_blanks(const char *cursor, const char *end)
+{
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+        cursor++;
+    return cursor;
+}
+
+
+/*
+ * parses the number at cursor with strtod(), which needs a NUL-terminated
+ * copy since the input isn't terminated
+ */
+static int parse_double_slow(const char **cursor, const char *end, double *value)
+{
+    const char *token_end = *cursor;
+    while (token_end < end && !is_space(*token_end))
+        token_end++;
+    const size_t length = token_end - *cursor;
+    if (length == 0 || length >= MAX_TOKEN_LENGTH)
+        return -1;
+    char token[MAX_TOKEN_LENGTH];
+    memcpy(token, *cursor, length);
+    token[length] = '\0';
+    char *parsed_end;
+    *value = strtod(token, &parsed_end);
+    if (parsed_end == token)
+        return -1;
+    *cursor += parsed_end - token;
+    return 0;
+}
+
+
+int bt_input_parse_double(const char **cursor, const char *end, double *value)
+{
+    const char *start = skip_blanks(*cursor, end);
+    const char *p = start;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // Mantissa
+    uint64_t mantissa = 0;
+    int num_digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    bool exact = true;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        any_digits = true;
+        const int digit = *p - '0';
+        if (mantissa == 0 && digit == 0)
+            continue;
+        if (num_digits < MAX_FAST_DIGITS) {
+            mantissa = 10 * mantissa + digit;
+            num_digits++;
+        } else {
+            exponent++;
+            exact = false;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            any_digits = true;
+            const int digit = *p - '0';
+            if (mantissa == 0 && digit == 0) {
+                exponent--;
+            } else if (num_digits < MAX_FAST_DIGITS) {
+                mantissa = 10 * mantissa + digit;
+                num_digits++;
+                exponent--;
+            } else {
+                exact = false;
+            }
+        }
+    }
+
+    // Exponent
+    if (any_digits && p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negative_exponent = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            negative_exponent = *q++ == '-';
+        if (q < end && *q >= '0' && *q <= '9') {
+            int e = 0;
+            for (; q < end && *q >= '0' && *q <= '9'; q++)
+                if (e < 100000)
+                    e = 10 * e + (*q - '0');
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+
+    // Anything unusual, or a number that can't be converted exactly, goes
+    // to strtod().
+    if (!any_digits || !exact || (p < end && !is_space(*p))
+        || mantissa > MAX_EXACT_MANTISSA
+        || (mantissa != 0 && (exponent < -MAX_EXACT_POW10 || exponent > MAX_EXACT_POW10))) {
+        *cursor = start;
+        return parse_double_slow(cursor, end, value);
+    }
+
+    // A zero mantissa is zero whatever the exponent, which is unchecked.
+    double result = mantissa;
+    if (mantissa != 0 && exponent < 0)
+        result /= exact_pow10[-exponent];
+    else if (mantissa != 0)
+        result *= exact_pow10[exponent];
+    *value = negative ? -result : result;
+    *cursor = p;
+    return 0;
+}
+
+
+int bt_input_parse_size(const char **cursor, const char *end, size_t *value)
+{
+    const char *p = skip_blanks(*cursor, end);
+    if (p < end && *p == '+')
+        p++;
+    if (p == end || *p < '0' || *p > '9')
+        return -1;
+    size_t result = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        const size_t digit = *p - '0';
+        if (result > (SIZE_MAX - digit) / 10)
+            return -1;
+        result = 10 * result + digit;
+    }
+    *value = result;
+    *cursor = p;
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_input.h
+ *
+ * Memory-mapped input files and parsing of the numbers in them.
+ *
+ * The parsing functions work on a cursor into the contents of a file, which
+ * aren't NUL-terminated, so each takes a pointer to the end of the contents.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Number of bytes that are parsed between calls to the system to drop the
+ * pages of the parsed contents; see bt_input_release().
+ */
+#ifndef BT_INPUT_RELEASE_SIZE
+#define BT_INPUT_RELEASE_SIZE (1 << 22)
+#endif
+
+/**
+ * The contents of an input file.
+ */
+typedef struct bt_input_t {
+    /**
+     * The contents, or `NULL` if the file is empty.
+     *
+     * The mapping is private, so writing to it doesn't change the file.
+     */
+    char *data;
+    /**
+     * Size of the contents in bytes.
+     */
+    size_t size;
+    /**
+     * Whether @p data is mapped (`true`) or allocated (`false`).
+     */
+    bool mapped;
+    /**
+     * Number of leading bytes of @p data whose pages have been dropped.
+     */
+    size_t released;
+} bt_input_t;
+
+/**
+ * Maps the file at @p path into memory.
+ *
+ * On systems without `mmap()`, the file is read into memory instead.
+ *
+ * The returned pointer must be freed with bt_input_close().
+ *
+ * @param[in] path Path where the file is located.
+ * @returns A pointer to the contents, or `NULL` on failure.
+ */
+bt_input_t *bt_input_open(const char *path);
+
+/**
+ * Unmaps a file mapped with bt_input_open().
+ *
+ * @param[in] input The file to unmap.
+ */
+void bt_input_close(bt_input_t *input);
+
+/**
+ * Tells the system that the contents before @p cursor won't be read again.
+ *
+ * Once at least #BT_INPUT_RELEASE_SIZE bytes have been parsed since the last
+ * release, their pages are dropped from memory, so parsing a large file
+ * doesn't keep all of it resident.
+ *
+ * @param[in,out] input The file.
+ * @param[in] cursor Position in the contents before which nothing will be
+ *   read again.
+ */
+void bt_input_release(bt_input_t *input, const char *cursor);
+
+/**
+ * Returns the number of lines from @p cursor to @p end, counting a last line
+ * without a newline.
+ *
+ * @param[in] cursor Start of the text.
+ * @param[in] end End of the text.
+ * @returns The number of lines.
+ */
+size_t bt_input_count_lines(const char *cursor, const char *end);
+
+/**
+ * Returns the start of the line after the one containing @p cursor.
+ *
+ * @param[in] cursor Position in the text.
+ * @param[in] end End of the text.
+ * @returns The start of the next line, or @p end if there isn't one.
+ */
+const char *bt_input_next_line(const char *cursor, const char *end);
+
+/**
+ * Parses a floating-point number, skipping any spaces or tabs before it.
+ *
+ * Decimal numbers with up to 19 significant digits and small exponents are
+ * converted directly, with correct rounding; anything else (such as long
+ * mantissas, `nan`, or hexadecimal) is passed to `strtod()`. Either way, the
+ * result is the same as from `scanf()`.
+ *
+ * @param[in,out] cursor Position in the text, which is advanced past the
+ *   number.
+ * @param[in] end End of the text.
+ * @param[out] value The number.
+ * @returns 0 on success, or -1 if there's no number at @p cursor.
+ */
+int bt_input_parse_double(const char **cursor, const char *end, double *value);
+
+/**
+ * Parses a nonnegative decimal integer, skipping any spaces or tabs before it.
+ *
+ * @param[in,out] cursor Position in the text, which is advanced past the
+ *   number.
+ * @param[in] end End of the text.
+ * @param[out] value The number.
+ * @returns 0 on success, or -1 if there's no number at @p cursor or it's too
+ *   large.
+ */
+int bt_input_parse_size(const char **cursor, const char *end, size_t *value);
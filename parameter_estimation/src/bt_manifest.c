@@ -0,0 +1,115 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_manifest.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * Returns 0 if the line was parsed into the entry, -1 if the line is blank,
+ * or 1 on failure.
+ */
+static int bt_manifest_parse_line(char *line, bt_manifest_entry_t *entry)
+{
+    if (strspn(line, " \t\r\n") == strlen(line))
+        return -1;
+
+    char *fields[4];
+    char *saveptr = NULL;
+    char *token = strtok_r(line, "\t\r\n", &saveptr);
+    for (size_t i = 0; i < 4; i++) {
+        if (token == NULL)
+            return 1;
+        fields[i] = token;
+        token = strtok_r(NULL, "\t\r\n", &saveptr);
+    }
+    if (token != NULL)
+        return 1;
+
+    entry->bounds_path = strdup(fields[0]);
+    entry->data_path = strdup(fields[1]);
+    entry->trials_path = strdup(fields[2]);
+    entry->output_path = strdup(fields[3]);
+    return 0;
+}
+
+
+bt_manifest_t *bt_manifest_load(const char *path)
+{
+    // Open file
+    FILE *file;
+    if ((file = fopen(path, "r")) == NULL)
+        return NULL;
+    char *line = NULL;
+    size_t length = 0;
+
+    // Skip header line
+    if (getline(&line, &length, file) == -1) {
+        free(line);
+        fclose(file);
+        return NULL;
+    }
+
+    // Allocate memory
+    size_t capacity = 16;
+    bt_manifest_t *manifest = calloc(1, sizeof(bt_manifest_t));
+    manifest->entries = malloc(capacity * sizeof(bt_manifest_entry_t));
+
+    // Read entries
+    while (getline(&line, &length, file) != -1) {
+        // Enlarge arrays if necessary
+        if (manifest->size >= capacity) {
+            capacity <<= 1;
+            manifest->entries = realloc(manifest->entries, capacity * sizeof(bt_manifest_entry_t));
+        }
+
+        // Parse line
+        const int status = bt_manifest_parse_line(line, manifest->entries + manifest->size);
+        if (status > 0) {
+            fprintf(stderr, "Unable to parse line '%s'.\n", line);
+            free(line);
+            fclose(file);
+            bt_manifest_free(manifest);
+            return NULL;
+        } else if (status == 0) {
+            manifest->size++;
+        }
+    }
+
+    // Free resources.
+    free(line);
+    fclose(file);
+
+    return manifest;
+}
+
+
+void bt_manifest_free(bt_manifest_t *manifest)
+{
+    if (manifest == NULL)
+        return;
+
+    for (size_t i = 0; i < manifest->size; i++) {
+        free(manifest->entries[i].bounds_path);
+        free(manifest->entries[i].data_path);
+        free(manifest->entries[i].trials_path);
+        free(manifest->entries[i].output_path);
+    }
+    free(manifest->entries);
+    free(manifest);
+}
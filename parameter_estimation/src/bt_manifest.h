@@ -0,0 +1,84 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_manifest.h
+ *
+ * Manifest of input and output files for fitting many athletes in one run.
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+/**
+ * The input and output files for one athlete.
+ */
+typedef struct bt_manifest_entry_t {
+    /**
+     * Path to file with bounds and stdevs for model parameters.
+     */
+    char *bounds_path;
+    /**
+     * Path to file with training test data.
+     */
+    char *data_path;
+    /**
+     * Path (or pattern) of the file with the indices of the performance
+     * trials.
+     */
+    char *trials_path;
+    /**
+     * Path to output file for writing optimal designs.
+     */
+    char *output_path;
+} bt_manifest_entry_t;
+
+/**
+ * A list of athletes to fit.
+ */
+typedef struct bt_manifest_t {
+    /**
+     * Number of entries.
+     */
+    size_t size;
+    /**
+     * Array of entries.
+     */
+    bt_manifest_entry_t *entries;
+} bt_manifest_t;
+
+/**
+ * Reads the manifest from the file located at @p path.
+ *
+ * The file has a header line followed by one line per athlete, each with the
+ * bounds, data, trials, and output paths separated by tabs. Blank lines are
+ * ignored.
+ *
+ * The returned pointer must be freed with bt_manifest_free().
+ *
+ * @param[in] path Path where the input file is located.
+ * @returns A pointer to the manifest, or `NULL` on failure.
+ */
+bt_manifest_t *bt_manifest_load(const char *path);
+
+/**
+ * Frees a manifest allocated by bt_manifest_load().
+ *
+ * @param[in] manifest Manifest to free.
+ */
+void bt_manifest_free(bt_manifest_t *manifest);
@@ -17,6 +17,7 @@
 
 #include "bt_model.h"
 #include <math.h>
+#include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 
@@ -42,10 +43,28 @@ int bt_model_design_var_name_to_index(const char *name) {
 }
 
 
-void bt_model_fprint_designs(FILE *stream, const size_t nmemb,
+void bt_model_fprint_designs(FILE *stream, const enum bt_table_format format, const size_t nmemb,
                              design_var_t (*const designs)[DESIGN_VAR_COUNT],
                              const fitness_t mean_abs_residuals[])
 {
+    if (format == BT_TABLE_BINARY) {
+        const char *names[DESIGN_VAR_COUNT + 1];
+        const size_t num_columns = DESIGN_VAR_COUNT + (mean_abs_residuals ? 1 : 0);
+        double *values = malloc(num_columns * nmemb * sizeof(double));
+        for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+            names[j] = bt_design_var_names[j];
+            for (size_t i = 0; i < nmemb; i++)
+                values[j * nmemb + i] = designs[i][j];
+        }
+        if (mean_abs_residuals) {
+            names[DESIGN_VAR_COUNT] = "mean_abs_residual";
+            memcpy(values + DESIGN_VAR_COUNT * nmemb, mean_abs_residuals, nmemb * sizeof(double));
+        }
+        bt_table_write(stream, num_columns, nmemb, names, NULL, values);
+        free(values);
+        return;
+    }
+
     // Header
     for (int i = 0; i < DESIGN_VAR_COUNT; i++) {
         if (i > 0)
@@ -70,42 +89,23 @@ void bt_model_fprint_designs(FILE *stream, const size_t nmemb,
 }
 
 
-static design_var_t bt_model_calc_fitness_d(const design_var_t fitness, const design_var_t training_stress,
-                                     const design_var_t design[DESIGN_VAR_COUNT])
-{
-    return -1/design[VAR_TAU1] * pow(fitness, design[VAR_ALPHA]) + design[VAR_K1] * training_stress;
-}
-
-
-static design_var_t bt_model_calc_fatigue_d(const design_var_t fatigue, const design_var_t training_stress,
-                                     const design_var_t design[DESIGN_VAR_COUNT])
-{
-    return -1/design[VAR_TAU2] * pow(fatigue, design[VAR_BETA]) + design[VAR_K2] * training_stress;
-}
-
-
-static design_var_t bt_model_euler_step(
-    design_var_t (*y_d)(const design_var_t y, const design_var_t training_stress, const design_var_t design[DESIGN_VAR_COUNT]),
-    const design_var_t y, const design_var_t dt, const design_var_t training_stress, const design_var_t design[DESIGN_VAR_COUNT])
-{
-    return y + dt * y_d(y, training_stress, design);
-}
-
-
 void bt_model_performance_integrate_interval(
     design_var_t *performance, design_var_t *fitness, design_var_t *fatigue,
     const design_var_t training_stress, const design_var_t interval_duration,
-    const design_var_t design[DESIGN_VAR_COUNT])
+    const design_var_t design[DESIGN_VAR_COUNT], const enum bt_ode_method method)
 {
+    const bt_ode_t fitness_ode = {design[VAR_TAU1], design[VAR_ALPHA], design[VAR_K1]};
+    const bt_ode_t fatigue_ode = {design[VAR_TAU2], design[VAR_BETA], design[VAR_K2]};
     // Integrate during the step.
-    *fitness = bt_model_euler_step(bt_model_calc_fitness_d, *fitness, interval_duration, training_stress, design);
-    *fatigue = bt_model_euler_step(bt_model_calc_fatigue_d, *fatigue, interval_duration, training_stress, design);
+    *fitness = bt_ode_advance(method, &fitness_ode, *fitness, training_stress, interval_duration, BT_MODEL_POW_ACCURACY);
+    *fatigue = bt_ode_advance(method, &fatigue_ode, *fatigue, training_stress, interval_duration, BT_MODEL_POW_ACCURACY);
     // Update the performance.
     *performance = design[VAR_P0] + *fitness - *fatigue;
 }
 
 
-void bt_model_integrate(const design_var_t design[DESIGN_VAR_COUNT], bt_data_t *data)
+void bt_model_integrate(const design_var_t design[DESIGN_VAR_COUNT], bt_data_t *data,
+                        const enum bt_ode_method method)
 {
     design_var_t fitness = design[VAR_F0];
     design_var_t fatigue = design[VAR_U0];
@@ -114,18 +114,30 @@ void bt_model_integrate(const design_var_t design[DESIGN_VAR_COUNT], bt_data_t *
     for (size_t interval = 0; interval < data->size - 1; interval++) {
         bt_model_performance_integrate_interval(
             &performance, &fitness, &fatigue, data->training_stress[interval],
-            data->time[interval+1] - data->time[interval], design);
+            data->time[interval+1] - data->time[interval], design, method);
         data->performance[interval+1] = performance;
     }
 }
 
 
-/* TODO: this unnecessarily caluclates the TSS of the data every time */
-fitness_t bt_model_calculate_error(const design_var_t design[DESIGN_VAR_COUNT],
-                                   const bt_data_t *data, const bt_trials_t *trials)
+static int bt_model_design_is_feasible(const design_var_t design[DESIGN_VAR_COUNT])
+{
+    return !(design[VAR_TAU1] < 0 || design[VAR_TAU2] < 0 || design[VAR_K1] < 0 || design[VAR_K2] < 0 || design[VAR_ALPHA] < 1 || design[VAR_BETA] > 1);
+}
+
+
+/*
+ * Calculates the error of a single design, abandoning the integration (and
+ * returning INFINITY) once the partial error exceeds max_error. The number of
+ * records that weren't integrated as a result is added to *skipped_records.
+ */
+static fitness_t bt_model_calculate_error_bounded(const design_var_t design[DESIGN_VAR_COUNT],
+                                                  const bt_plan_t *plan,
+                                                  const fitness_t max_error,
+                                                  size_t *skipped_records)
 {
     // Check parameter constraints first
-    if (design[VAR_TAU1] < 0 || design[VAR_TAU2] < 0 || design[VAR_K1] < 0 || design[VAR_K2] < 0 || design[VAR_ALPHA] < 1 || design[VAR_BETA] > 1)
+    if (!bt_model_design_is_feasible(design))
         return NAN;
 
     // Initialize total error
@@ -135,44 +147,472 @@ fitness_t bt_model_calculate_error(const design_var_t design[DESIGN_VAR_COUNT],
     design_var_t fitness = design[VAR_F0];
     design_var_t fatigue = design[VAR_U0];
     design_var_t performance = design[VAR_P0] + design[VAR_F0] - design[VAR_U0];
-    size_t prev_trial_index = 0;
-    for (size_t trial = 0; trial < trials->size; trial++) {
-        size_t trial_index = trials->trial_indices[trial];
-        for (size_t interval = prev_trial_index; interval < trial_index; interval++) {
+    const bt_plan_record_t *record = plan->records;
+    for (size_t trial = 0; trial < plan->num_trials; trial++) {
+        const bt_plan_record_t *segment_end = record + plan->segment_lengths[trial];
+        for (; record < segment_end; record++) {
             bt_model_performance_integrate_interval(
-                &performance, &fitness, &fatigue, data->training_stress[interval],
-                data->time[interval+1] - data->time[interval], design);
+                &performance, &fitness, &fatigue, record->training_stress,
+                record->dt, design, plan->method);
         }
-        design_var_t residual = data->performance[trial_index] - performance;
+        design_var_t residual = plan->targets[trial] - performance;
         total_error += fabs(residual);
-        prev_trial_index = trial_index;
+        if (total_error > max_error) {
+            *skipped_records += plan->num_records - (record - plan->records);
+            return INFINITY;
+        }
     }
 
     return total_error;
 }
 
 
+fitness_t bt_model_calculate_error(const design_var_t design[DESIGN_VAR_COUNT],
+                                   const bt_plan_t *plan)
+{
+    size_t skipped_records = 0;
+    return bt_model_calculate_error_bounded(design, plan, INFINITY, &skipped_records);
+}
+
+
+/*
+ * Indices of the derivatives of a state of the model with respect to the
+ * variables of its equation.
+ */
+enum bt_model_dual_index {
+    BT_MODEL_DUAL_TAU = 0,
+    BT_MODEL_DUAL_EXPONENT = 1,
+    BT_MODEL_DUAL_GAIN = 2,
+    BT_MODEL_DUAL_INITIAL = 3,
+    BT_MODEL_DUAL_COUNT = 4
+};
+
+
+/*
+ * A state of the model (fitness or fatigue) and its partial derivatives with
+ * respect to the variables of its equation, i.e. a dual number with
+ * BT_MODEL_DUAL_COUNT infinitesimal parts.
+ */
+typedef struct bt_model_dual_t {
+    design_var_t value;
+    design_var_t derivs[BT_MODEL_DUAL_COUNT];
+} bt_model_dual_t;
+
+
+/*
+ * Advances a dual state by one Euler step. The value is computed exactly as
+ * bt_ode_advance() computes it.
+ */
+static void bt_model_dual_euler_step(bt_model_dual_t *state, const bt_ode_t *ode,
+                                     const design_var_t training_stress,
+                                     const design_var_t dt)
+{
+    const design_var_t y = state->value;
+    const design_var_t neg_inv_tau = -1/ode->tau;
+    const design_var_t decay = vpow(y, ode->exponent, BT_MODEL_POW_ACCURACY);
+    // Derivatives of y^exponent with respect to y and the exponent. They're
+    // taken to be 0 at y = 0, e.g. for an initial fatigue of 0.
+    const design_var_t ddecay_dy = y > 0 ? ode->exponent * decay / y : 0;
+    const design_var_t ddecay_dexponent = y > 0 ? decay * log(y) : 0;
+    const design_var_t slope = 1 + dt * neg_inv_tau * ddecay_dy;
+    design_var_t *derivs = state->derivs;
+    derivs[BT_MODEL_DUAL_TAU] = slope * derivs[BT_MODEL_DUAL_TAU]
+                                + dt * decay / (ode->tau * ode->tau);
+    derivs[BT_MODEL_DUAL_EXPONENT] = slope * derivs[BT_MODEL_DUAL_EXPONENT]
+                                     + dt * neg_inv_tau * ddecay_dexponent;
+    derivs[BT_MODEL_DUAL_GAIN] = slope * derivs[BT_MODEL_DUAL_GAIN] + dt * training_stress;
+    derivs[BT_MODEL_DUAL_INITIAL] = slope * derivs[BT_MODEL_DUAL_INITIAL];
+    state->value = y + dt * (neg_inv_tau * decay + ode->gain * training_stress);
+}
+
+
+void bt_model_calculate_residual_jacobian(const design_var_t design[DESIGN_VAR_COUNT],
+                                          const bt_plan_t *plan, design_var_t residuals[],
+                                          design_var_t (*jacobian)[DESIGN_VAR_COUNT])
+{
+    const bt_ode_t fitness_ode = {design[VAR_TAU1], design[VAR_ALPHA], design[VAR_K1]};
+    const bt_ode_t fatigue_ode = {design[VAR_TAU2], design[VAR_BETA], design[VAR_K2]};
+    bt_model_dual_t fitness = {design[VAR_F0], {0, 0, 0, 1}};
+    bt_model_dual_t fatigue = {design[VAR_U0], {0, 0, 0, 1}};
+
+    const bt_plan_record_t *record = plan->records;
+    for (size_t trial = 0; trial < plan->num_trials; trial++) {
+        const bt_plan_record_t *segment_end = record + plan->segment_lengths[trial];
+        for (; record < segment_end; record++) {
+            bt_model_dual_euler_step(&fitness, &fitness_ode, record->training_stress, record->dt);
+            bt_model_dual_euler_step(&fatigue, &fatigue_ode, record->training_stress, record->dt);
+        }
+        const design_var_t performance = design[VAR_P0] + fitness.value - fatigue.value;
+        residuals[trial] = plan->targets[trial] - performance;
+
+        // The residual decreases with the performance, which increases with
+        // the fitness and decreases with the fatigue.
+        design_var_t *row = jacobian[trial];
+        row[VAR_TAU1] = -fitness.derivs[BT_MODEL_DUAL_TAU];
+        row[VAR_ALPHA] = -fitness.derivs[BT_MODEL_DUAL_EXPONENT];
+        row[VAR_K1] = -fitness.derivs[BT_MODEL_DUAL_GAIN];
+        row[VAR_F0] = -fitness.derivs[BT_MODEL_DUAL_INITIAL];
+        row[VAR_TAU2] = fatigue.derivs[BT_MODEL_DUAL_TAU];
+        row[VAR_BETA] = fatigue.derivs[BT_MODEL_DUAL_EXPONENT];
+        row[VAR_K2] = fatigue.derivs[BT_MODEL_DUAL_GAIN];
+        row[VAR_U0] = fatigue.derivs[BT_MODEL_DUAL_INITIAL];
+        row[VAR_P0] = -1;
+    }
+}
+
+
+static void bt_model_store_fitness(const size_t i, const fitness_t error,
+                                   fitness_t fitnesses[], fitness_t mean_abs_residuals[],
+                                   const bt_plan_t *plan)
+{
+    fitness_t mean_abs_residual = error / plan->num_trials;
+    if (!isnan(error)) {
+        if (fitnesses)
+            fitnesses[i] = -error;
+        if (mean_abs_residuals)
+            mean_abs_residuals[i] = mean_abs_residual;
+    } else {
+        if (fitnesses)
+            fitnesses[i] = -INFINITY;
+        if (mean_abs_residuals)
+            mean_abs_residuals[i] = NAN;
+    }
+}
+
+
+/*
+ * Replaces a lane of bt_model_calculate_errors_batch() with a dummy design
+ * whose state stays at zero, so that it doesn't produce NANs or denormals.
+ */
+static void bt_model_mask_lane(const size_t lane, design_var_t neg_inv_tau[],
+                               design_var_t exponent[], design_var_t gain[],
+                               design_var_t state[], design_var_t p0[])
+{
+    for (size_t j = lane; j < 2 * BT_MODEL_LANES; j += BT_MODEL_LANES) {
+        neg_inv_tau[j] = 0;
+        exponent[j] = 1;
+        gain[j] = 0;
+        state[j] = 0;
+    }
+    p0[lane] = 0;
+}
+
+
+/*
+ * Integrates up to BT_MODEL_LANES designs in lockstep with the Euler method.
+ * Each lane performs exactly the same sequence of floating-point operations as
+ * bt_model_calculate_error(), so the results are identical; the lanes just
+ * give the compiler independent work to put in the vector registers.
+ *
+ * A lane whose partial error exceeds max_error is abandoned and given an
+ * error of INFINITY; the number of records it didn't integrate is added to
+ * *skipped_records.
+ */
+static void bt_model_calculate_errors_batch(const size_t count,
+                                            design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                            fitness_t errors[],
+                                            const bt_plan_t *plan,
+                                            const fitness_t max_error,
+                                            size_t *skipped_records)
+{
+    // Struct-of-arrays copy of the designs. The fitness and fatigue equations
+    // have the same form, so the first BT_MODEL_LANES elements of each array
+    // are for fitness and the rest are for fatigue.
+    const size_t width = 2 * BT_MODEL_LANES;
+    design_var_t neg_inv_tau[width], exponent[width], gain[width];
+    design_var_t state[width], decay[width];
+    design_var_t p0[BT_MODEL_LANES], total_error[BT_MODEL_LANES];
+    int active[BT_MODEL_LANES], rejected[BT_MODEL_LANES];
+    int num_active = 0;
+    for (size_t lane = 0; lane < BT_MODEL_LANES; lane++) {
+        if (lane < count && bt_model_design_is_feasible(designs[lane])) {
+            const design_var_t *design = designs[lane];
+            neg_inv_tau[lane] = -1/design[VAR_TAU1];
+            neg_inv_tau[BT_MODEL_LANES + lane] = -1/design[VAR_TAU2];
+            exponent[lane] = design[VAR_ALPHA];
+            exponent[BT_MODEL_LANES + lane] = design[VAR_BETA];
+            gain[lane] = design[VAR_K1];
+            gain[BT_MODEL_LANES + lane] = design[VAR_K2];
+            state[lane] = design[VAR_F0];
+            state[BT_MODEL_LANES + lane] = design[VAR_U0];
+            p0[lane] = design[VAR_P0];
+            active[lane] = 1;
+            num_active++;
+        } else {
+            active[lane] = 0;
+        }
+        rejected[lane] = 0;
+        total_error[lane] = 0;
+    }
+    for (size_t lane = 0; lane < BT_MODEL_LANES; lane++)
+        if (!active[lane])
+            bt_model_mask_lane(lane, neg_inv_tau, exponent, gain, state, p0);
+
+    const bt_plan_record_t *record = plan->records;
+    for (size_t trial = 0; trial < plan->num_trials && num_active > 0; trial++) {
+        const bt_plan_record_t *segment_end = record + plan->segment_lengths[trial];
+        for (; record < segment_end; record++) {
+            const design_var_t training_stress = record->training_stress;
+            const design_var_t dt = record->dt;
+            vpow_array(width, state, exponent, decay, BT_MODEL_POW_ACCURACY);
+            #pragma omp simd
+            for (size_t j = 0; j < width; j++)
+                state[j] = state[j] + dt * (neg_inv_tau[j] * decay[j] + gain[j] * training_stress);
+        }
+        const design_var_t measured = plan->targets[trial];
+        for (size_t lane = 0; lane < BT_MODEL_LANES; lane++) {
+            if (!active[lane])
+                continue;
+            design_var_t residual = measured - (p0[lane] + state[lane] - state[BT_MODEL_LANES + lane]);
+            total_error[lane] += fabs(residual);
+            if (isnan(total_error[lane])) {
+                // The error can't become finite again.
+                active[lane] = 0;
+                num_active--;
+                bt_model_mask_lane(lane, neg_inv_tau, exponent, gain, state, p0);
+            } else if (total_error[lane] > max_error) {
+                // The error can only grow, so the design is already rejected.
+                active[lane] = 0;
+                rejected[lane] = 1;
+                num_active--;
+                bt_model_mask_lane(lane, neg_inv_tau, exponent, gain, state, p0);
+                *skipped_records += plan->num_records - (record - plan->records);
+            }
+        }
+    }
+
+    for (size_t lane = 0; lane < count && lane < BT_MODEL_LANES; lane++) {
+        if (!bt_model_design_is_feasible(designs[lane]))
+            errors[lane] = NAN;
+        else if (rejected[lane])
+            errors[lane] = INFINITY;
+        else
+            errors[lane] = total_error[lane];
+    }
+}
+
+
+/*
+ * Single precision version of bt_model_mask_lane().
+ */
+static void bt_model_mask_lane_mixed(const size_t lane, float neg_inv_tau[],
+                                     float exponent[], float gain[],
+                                     float state[], float p0[])
+{
+    for (size_t j = lane; j < 2 * BT_MODEL_MIXED_LANES; j += BT_MODEL_MIXED_LANES) {
+        neg_inv_tau[j] = 0;
+        exponent[j] = 1;
+        gain[j] = 0;
+        state[j] = 0;
+    }
+    p0[lane] = 0;
+}
+
+
+/*
+ * Integrates up to BT_MODEL_MIXED_LANES designs in lockstep with the Euler
+ * method like bt_model_calculate_errors_batch(), but in single precision.
+ * Only the residuals are calculated and summed in double precision, so the
+ * rounding errors of the integration don't accumulate across trials.
+ */
+static void bt_model_calculate_errors_batch_mixed(const size_t count,
+                                                  design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                                  fitness_t errors[],
+                                                  const bt_plan_t *plan,
+                                                  const fitness_t max_error,
+                                                  size_t *skipped_records)
+{
+    const size_t width = 2 * BT_MODEL_MIXED_LANES;
+    float neg_inv_tau[width], exponent[width], gain[width];
+    float state[width], decay[width];
+    float p0[BT_MODEL_MIXED_LANES];
+    double total_error[BT_MODEL_MIXED_LANES];
+    int active[BT_MODEL_MIXED_LANES], rejected[BT_MODEL_MIXED_LANES];
+    int num_active = 0;
+    for (size_t lane = 0; lane < BT_MODEL_MIXED_LANES; lane++) {
+        if (lane < count && bt_model_design_is_feasible(designs[lane])) {
+            const design_var_t *design = designs[lane];
+            neg_inv_tau[lane] = -1/design[VAR_TAU1];
+            neg_inv_tau[BT_MODEL_MIXED_LANES + lane] = -1/design[VAR_TAU2];
+            exponent[lane] = design[VAR_ALPHA];
+            exponent[BT_MODEL_MIXED_LANES + lane] = design[VAR_BETA];
+            gain[lane] = design[VAR_K1];
+            gain[BT_MODEL_MIXED_LANES + lane] = design[VAR_K2];
+            state[lane] = design[VAR_F0];
+            state[BT_MODEL_MIXED_LANES + lane] = design[VAR_U0];
+            p0[lane] = design[VAR_P0];
+            active[lane] = 1;
+            num_active++;
+        } else {
+            active[lane] = 0;
+        }
+        rejected[lane] = 0;
+        total_error[lane] = 0;
+    }
+    for (size_t lane = 0; lane < BT_MODEL_MIXED_LANES; lane++)
+        if (!active[lane])
+            bt_model_mask_lane_mixed(lane, neg_inv_tau, exponent, gain, state, p0);
+
+    const bt_plan_record_t *record = plan->records;
+    for (size_t trial = 0; trial < plan->num_trials && num_active > 0; trial++) {
+        const bt_plan_record_t *segment_end = record + plan->segment_lengths[trial];
+        for (; record < segment_end; record++) {
+            const float training_stress = record->training_stress;
+            const float dt = record->dt;
+            vpowf_array(width, state, exponent, decay, BT_MODEL_POW_ACCURACY);
+            #pragma omp simd
+            for (size_t j = 0; j < width; j++)
+                state[j] = state[j] + dt * (neg_inv_tau[j] * decay[j] + gain[j] * training_stress);
+        }
+        const double measured = plan->targets[trial];
+        for (size_t lane = 0; lane < BT_MODEL_MIXED_LANES; lane++) {
+            if (!active[lane])
+                continue;
+            const double performance = (double)p0[lane] + state[lane]
+                                       - state[BT_MODEL_MIXED_LANES + lane];
+            total_error[lane] += fabs(measured - performance);
+            if (isnan(total_error[lane])) {
+                active[lane] = 0;
+                num_active--;
+                bt_model_mask_lane_mixed(lane, neg_inv_tau, exponent, gain, state, p0);
+            } else if (total_error[lane] > max_error) {
+                active[lane] = 0;
+                rejected[lane] = 1;
+                num_active--;
+                bt_model_mask_lane_mixed(lane, neg_inv_tau, exponent, gain, state, p0);
+                *skipped_records += plan->num_records - (record - plan->records);
+            }
+        }
+    }
+
+    for (size_t lane = 0; lane < count && lane < BT_MODEL_MIXED_LANES; lane++) {
+        if (!bt_model_design_is_feasible(designs[lane]))
+            errors[lane] = NAN;
+        else if (rejected[lane])
+            errors[lane] = INFINITY;
+        else
+            errors[lane] = total_error[lane];
+    }
+}
+
+
+/*
+ * Returns the number of designs that bt_model_calculate_errors_block()
+ * evaluates at a time.
+ */
+static size_t bt_model_block_size(const bt_plan_t *plan)
+{
+    if (plan->method == BT_ODE_EULER && plan->precision == BT_PLAN_MIXED)
+        return BT_MODEL_MIXED_LANES;
+    return BT_MODEL_LANES;
+}
+
+
+/*
+ * Calculates the errors of up to bt_model_block_size() designs, in lockstep
+ * for the Euler method and one at a time otherwise.
+ */
+static void bt_model_calculate_errors_block(const size_t count,
+                                            design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                            fitness_t errors[],
+                                            const bt_plan_t *plan,
+                                            const fitness_t max_error,
+                                            size_t *skipped_records)
+{
+    if (plan->method == BT_ODE_EULER && plan->precision == BT_PLAN_MIXED) {
+        bt_model_calculate_errors_batch_mixed(count, designs, errors, plan,
+                                              max_error, skipped_records);
+    } else if (plan->method == BT_ODE_EULER) {
+        bt_model_calculate_errors_batch(count, designs, errors, plan,
+                                        max_error, skipped_records);
+    } else {
+        for (size_t i = 0; i < count; i++)
+            errors[i] = bt_model_calculate_error_bounded(designs[i], plan,
+                                                         max_error, skipped_records);
+    }
+}
+
+
+void bt_model_calculate_errors(const size_t nmemb,
+                               design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                               fitness_t errors[],
+                               const bt_plan_t *plan)
+{
+    const size_t block_size = bt_model_block_size(plan);
+    for (size_t i = 0; i < nmemb; i += block_size) {
+        const size_t count = nmemb - i < block_size ? nmemb - i : block_size;
+        size_t skipped_records = 0;
+        bt_model_calculate_errors_block(count, designs + i, errors + i, plan,
+                                        INFINITY, &skipped_records);
+    }
+}
+
+
 void bt_model_update_fitnesses(const size_t nmemb,
                                design_var_t (*const designs)[DESIGN_VAR_COUNT],
                                fitness_t fitnesses[],
                                fitness_t mean_abs_residuals[],
-                               const bt_data_t *data,
-                               const bt_trials_t *trials)
+                               const bt_plan_t *plan, bt_profile_t *profile)
+{
+    const size_t block_size = bt_model_block_size(plan);
+    #pragma omp parallel
+    {
+        bt_profile_laps_t laps = {0};
+        const bt_profile_mark_t start = bt_profile_now(profile);
+        #pragma omp for nowait
+        for (size_t i = 0; i < nmemb; i += block_size) {
+            const size_t count = nmemb - i < block_size ? nmemb - i : block_size;
+            fitness_t errors[BT_MODEL_MIXED_LANES];
+            size_t skipped_records = 0;
+            bt_model_calculate_errors_block(count, designs + i, errors, plan,
+                                            INFINITY, &skipped_records);
+            for (size_t lane = 0; lane < count; lane++)
+                bt_model_store_fitness(i + lane, errors[lane], fitnesses, mean_abs_residuals, plan);
+        }
+        bt_profile_lap(profile, &laps, BT_PROFILE_EVALUATE, start);
+        bt_profile_record_thread(profile, start, &laps);
+    }
+}
+
+
+void bt_model_rescore_fitnesses(const size_t nmemb,
+                                design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                fitness_t fitnesses[], const bt_plan_t *plan)
 {
     #pragma omp parallel for
-    for (size_t i = 0; i < nmemb; i++) {
-        fitness_t error = bt_model_calculate_error(designs[i], data, trials);
-        fitness_t mean_abs_residual = error / trials->size;
-        if (!isnan(error)) {
-            if (fitnesses)
-                fitnesses[i] = -error;
-            if (mean_abs_residuals)
-                mean_abs_residuals[i] = mean_abs_residual;
-        } else {
-            if (fitnesses)
-                fitnesses[i] = -INFINITY;
-            if (mean_abs_residuals)
-                mean_abs_residuals[i] = NAN;
+    for (size_t i = 0; i < nmemb; i++)
+        bt_model_store_fitness(i, bt_model_calculate_error(designs[i], plan), fitnesses, NULL, plan);
+}
+
+
+size_t bt_model_update_fitnesses_bounded(const size_t nmemb,
+                                         design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                         fitness_t fitnesses[],
+                                         fitness_t mean_abs_residuals[],
+                                         const bt_plan_t *plan,
+                                         const fitness_t rejection_threshold,
+                                         bt_profile_t *profile)
+{
+    // The fitness is the negative of the error.
+    const fitness_t max_error = -rejection_threshold;
+    const size_t block_size = bt_model_block_size(plan);
+    size_t skipped_records = 0;
+    #pragma omp parallel reduction(+:skipped_records)
+    {
+        bt_profile_laps_t laps = {0};
+        const bt_profile_mark_t start = bt_profile_now(profile);
+        #pragma omp for nowait
+        for (size_t i = 0; i < nmemb; i += block_size) {
+            const size_t count = nmemb - i < block_size ? nmemb - i : block_size;
+            fitness_t errors[BT_MODEL_MIXED_LANES];
+            bt_model_calculate_errors_block(count, designs + i, errors, plan,
+                                            max_error, &skipped_records);
+            for (size_t lane = 0; lane < count; lane++)
+                bt_model_store_fitness(i + lane, errors[lane], fitnesses, mean_abs_residuals, plan);
         }
+        bt_profile_lap(profile, &laps, BT_PROFILE_EVALUATE, start);
+        bt_profile_record_thread(profile, start, &laps);
     }
+    return skipped_records;
 }
+
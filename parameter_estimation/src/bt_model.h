@@ -24,8 +24,12 @@
 #pragma once
 
 #include "bt_data.h"
-#include "bt_trials.h"
+#include "bt_ode.h"
+#include "bt_plan.h"
+#include "bt_profile.h"
+#include "bt_table.h"
 #include "ga.h"
+#include "vpow.h"
 #include <stdio.h>
 
 /**
@@ -33,6 +37,52 @@
  */
 #define DESIGN_VAR_COUNT 9
 
+/**
+ * Number of designs that bt_model_update_fitnesses() integrates in lockstep
+ * with the #BT_ODE_EULER method.
+ *
+ * This defaults to the number of doubles in two of the widest vector
+ * registers enabled at compile time (e.g. with `-mavx2` or `-mavx512f` in
+ * `CFLAGS`), so that there are enough independent operations to hide the
+ * latency of the power function, or 1 if there is no vector unit. It can be
+ * overridden with `-DBT_MODEL_LANES=N`.
+ */
+#ifndef BT_MODEL_LANES
+#if defined(__AVX512F__)
+#define BT_MODEL_LANES 16
+#elif defined(__AVX__)
+#define BT_MODEL_LANES 8
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+#define BT_MODEL_LANES 4
+#else
+#define BT_MODEL_LANES 1
+#endif
+#endif
+
+/**
+ * Number of designs that bt_model_update_fitnesses() integrates in lockstep
+ * with the #BT_ODE_EULER method in #BT_PLAN_MIXED precision.
+ *
+ * This defaults to twice #BT_MODEL_LANES, since twice as many floats fit in a
+ * vector register. It can be overridden with `-DBT_MODEL_MIXED_LANES=N`, but
+ * must not be less than #BT_MODEL_LANES.
+ */
+#ifndef BT_MODEL_MIXED_LANES
+#define BT_MODEL_MIXED_LANES (2 * BT_MODEL_LANES)
+#endif
+
+/**
+ * Accuracy tier of the power function in the nonlinear model; see
+ * ::vpow_accuracy.
+ *
+ * The default reproduces the C library's `pow()`. Set it with e.g.
+ * `-DBT_MODEL_POW_ACCURACY=VPOW_PRECISE` in `CFLAGS` to use the vectorized
+ * polynomial kernels.
+ */
+#ifndef BT_MODEL_POW_ACCURACY
+#define BT_MODEL_POW_ACCURACY VPOW_EXACT
+#endif
+
 /**
  * Maximum length of any design variable name, excluding the terminating null
  * byte.
@@ -70,9 +120,10 @@ extern const char *bt_design_var_names[DESIGN_VAR_COUNT];
 int bt_model_design_var_name_to_index(const char *name);
 
 /**
- * Writes the designs in tab-separated-value format to the stream.
+ * Writes the designs to the stream as a table.
  *
  * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
  * @param[in] nmemb The number of designs.
  * @param[in] designs The array of designs.
  * @param[in] mean_abs_residuals (Optional) An array of the mean absolute
@@ -84,7 +135,7 @@ int bt_model_design_var_name_to_index(const char *name);
  * would require callers to make an explicit cast. [See RATIONALE for more
  * information.](http://pubs.opengroup.org/onlinepubs/9699919799/functions/exec.html)
  */
-void bt_model_fprint_designs(FILE *stream, const size_t nmemb,
+void bt_model_fprint_designs(FILE *stream, const enum bt_table_format format, const size_t nmemb,
                              design_var_t (*const designs)[DESIGN_VAR_COUNT],
                              const fitness_t mean_abs_residuals[]);
 
@@ -93,22 +144,68 @@ void bt_model_fprint_designs(FILE *stream, const size_t nmemb,
  *
  * @param[in] design Initial conditions and parameters.
  * @param[in,out] data Time and training stress inputs and performance output.
+ * @param[in] method Method used to integrate the model.
  */
 void bt_model_integrate(const design_var_t design[DESIGN_VAR_COUNT],
-                        bt_data_t *data);
+                        bt_data_t *data, const enum bt_ode_method method);
 
 /**
  * Calculates the total absolute residual between the data and the model at the
- * specified trial indices.
+ * trials of the evaluation plan, in double precision regardless of the plan's
+ * precision.
  *
  * @param[in] design Initial conditions and parameters for the model.
- * @param[in] data Training data.
- * @param[in] trials Indices in the training data to compute the residual
- *   between the model and the data.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices.
  * @returns The total absolute residual.
  */
 fitness_t bt_model_calculate_error(const design_var_t design[DESIGN_VAR_COUNT],
-                                   const bt_data_t *data, const bt_trials_t *trials);
+                                   const bt_plan_t *plan);
+
+/**
+ * Calculates the residuals between the data and the model at the trials of the
+ * evaluation plan, and their partial derivatives with respect to the design
+ * variables.
+ *
+ * The derivatives are found in forward mode: the fitness and fatigue states
+ * are carried through the #BT_ODE_EULER recursion as dual numbers, with their
+ * derivatives with respect to the time constant, exponent, gain, and initial
+ * value of their equation. The residuals are the same ones that
+ * bt_model_calculate_error() sums for a #BT_ODE_EULER plan.
+ *
+ * @param[in] design Initial conditions and parameters for the model.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices with the #BT_ODE_EULER method.
+ * @param[out] residuals The array to write the `plan->num_trials` residuals
+ *   (measured minus modeled performance).
+ * @param[out] jacobian The array to write the partial derivatives of each
+ *   residual with respect to the design variables.
+ */
+void bt_model_calculate_residual_jacobian(const design_var_t design[DESIGN_VAR_COUNT],
+                                          const bt_plan_t *plan, design_var_t residuals[],
+                                          design_var_t (*jacobian)[DESIGN_VAR_COUNT]);
+
+/**
+ * Calculates the total absolute residuals of several designs.
+ *
+ * In #BT_PLAN_DOUBLE precision, this gives the same results as calling
+ * bt_model_calculate_error() for each design, but integrates #BT_MODEL_LANES
+ * designs at a time in lockstep. In #BT_PLAN_MIXED precision, the #BT_ODE_EULER
+ * method integrates #BT_MODEL_MIXED_LANES designs at a time in single
+ * precision, and only the residuals are summed in double precision.
+ * Infeasible designs, and designs whose integration becomes `NAN`, are masked
+ * out of their batch early and have an error of `NAN`.
+ *
+ * @param[in] nmemb The number of designs.
+ * @param[in] designs The array of designs.
+ * @param[out] errors The array to write the total absolute residuals.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices.
+ */
+void bt_model_calculate_errors(const size_t nmemb,
+                               design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                               fitness_t errors[],
+                               const bt_plan_t *plan);
 
 /**
  * Updates the objective function values and mean absolute residuals
@@ -120,9 +217,10 @@ fitness_t bt_model_calculate_error(const design_var_t design[DESIGN_VAR_COUNT],
  *   values. If this is `NULL`, it is ignored.
  * @param[out] mean_abs_residuals (Optional) The array to write the mean
  *   absolute residuals. If this is `NULL`, it is ignored.
- * @param[in] data Training data.
- * @param[in] trials Indices in the training data to compute the residual
- *   between the model and the data.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices.
+ * @param[in,out] profile (Optional) Profile in which each thread records its
+ *   evaluation time, or `NULL`.
  *
  * @note Ideally, @p designs would be defined as `const design_var_t (*const
  * designs)[DESIGN_VAR_COUNT]`, but due to limitations in the C standard, that
@@ -133,5 +231,54 @@ void bt_model_update_fitnesses(const size_t nmemb,
                                design_var_t (*const designs)[DESIGN_VAR_COUNT],
                                fitness_t fitnesses[],
                                fitness_t mean_abs_residuals[],
-                               const bt_data_t *data,
-                               const bt_trials_t *trials);
+                               const bt_plan_t *plan, bt_profile_t *profile);
+
+/**
+ * Recalculates the objective function values of the designs in double
+ * precision with bt_model_calculate_error().
+ *
+ * In #BT_PLAN_MIXED precision, this keeps the rounding errors of single
+ * precision from deciding which designs survive.
+ *
+ * @param[in] nmemb The number of designs.
+ * @param[in] designs The array of designs.
+ * @param[out] fitnesses The array to write the objective function values.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices.
+ */
+void bt_model_rescore_fitnesses(const size_t nmemb,
+                                design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                fitness_t fitnesses[], const bt_plan_t *plan);
+
+/**
+ * Like bt_model_update_fitnesses(), but stops integrating a design as soon as
+ * its partial error shows that its objective function value will be less
+ * than @p rejection_threshold.
+ *
+ * The error only grows as more trials are added, so a rejected design is
+ * known to be strictly worse than @p rejection_threshold. Its objective
+ * function value is set to `-INFINITY` and its mean absolute residual to
+ * `INFINITY`. Designs that aren't rejected get exactly the same values as
+ * with bt_model_update_fitnesses().
+ *
+ * @param[in] nmemb The number of designs.
+ * @param[in] designs The array of designs.
+ * @param[out] fitnesses (Optional) The array to write the objective function
+ *   values. If this is `NULL`, it is ignored.
+ * @param[out] mean_abs_residuals (Optional) The array to write the mean
+ *   absolute residuals. If this is `NULL`, it is ignored.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices.
+ * @param[in] rejection_threshold Objective function value below which designs
+ *   are rejected. Use `-INFINITY` to reject none.
+ * @param[in,out] profile (Optional) Profile in which each thread records its
+ *   evaluation time, or `NULL`.
+ * @returns The number of training data intervals that were skipped.
+ */
+size_t bt_model_update_fitnesses_bounded(const size_t nmemb,
+                                         design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                                         fitness_t fitnesses[],
+                                         fitness_t mean_abs_residuals[],
+                                         const bt_plan_t *plan,
+                                         const fitness_t rejection_threshold,
+                                         bt_profile_t *profile);
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_ode.h"
+#include <math.h>
+#include <strings.h>
+
+
+const char *bt_ode_method_names[BT_ODE_METHOD_COUNT] = {
+    "euler",
+    "rk4",
+    "adaptive"
+};
+
+
+int bt_ode_method_from_name(const char *name)
+{
+    for (int i = 0; i < BT_ODE_METHOD_COUNT; i++)
+        if (strcasecmp(bt_ode_method_names[i], name) == 0)
+            return i;
+    return -1;
+}
+
+
+static inline double bt_ode_derivative(const bt_ode_t *ode, const double y,
+                                       const double training_stress,
+                                       const enum vpow_accuracy accuracy)
+{
+    return -1/ode->tau * vpow(y, ode->exponent, accuracy) + ode->gain * training_stress;
+}
+
+
+double bt_ode_decay(const bt_ode_t *ode, const double y, const double duration,
+                    const enum vpow_accuracy accuracy)
+{
+    if (ode->exponent == 1)
+        return y * exp(-duration / ode->tau);
+    if (y == 0)
+        return 0;
+    if (!(y > 0))
+        return NAN;
+    // Separating variables gives y^(1-a) = y0^(1-a) - (1-a)*t/tau.
+    const double one_minus_a = 1 - ode->exponent;
+    const double base = vpow(y, one_minus_a, accuracy) - one_minus_a * duration / ode->tau;
+    if (base <= 0)
+        return 0;
+    return vpow(base, 1 / one_minus_a, accuracy);
+}
+
+
+static double bt_ode_rk4(const bt_ode_t *ode, const double y,
+                         const double training_stress, const double h,
+                         const enum vpow_accuracy accuracy)
+{
+    const double k1 = bt_ode_derivative(ode, y, training_stress, accuracy);
+    const double k2 = bt_ode_derivative(ode, y + h/2 * k1, training_stress, accuracy);
+    const double k3 = bt_ode_derivative(ode, y + h/2 * k2, training_stress, accuracy);
+    const double k4 = bt_ode_derivative(ode, y + h * k3, training_stress, accuracy);
+    return y + h/6 * (k1 + 2*k2 + 2*k3 + k4);
+}
+
+
+static double bt_ode_adaptive(const bt_ode_t *ode, double y,
+                              const double training_stress, const double duration,
+                              const enum vpow_accuracy accuracy)
+{
+    // Dormand-Prince 5(4) coefficients. The equation is autonomous over the
+    // interval, so the nodes aren't needed.
+    static const double a21 = 1./5;
+    static const double a31 = 3./40, a32 = 9./40;
+    static const double a41 = 44./45, a42 = -56./15, a43 = 32./9;
+    static const double a51 = 19372./6561, a52 = -25360./2187, a53 = 64448./6561,
+        a54 = -212./729;
+    static const double a61 = 9017./3168, a62 = -355./33, a63 = 46732./5247,
+        a64 = 49./176, a65 = -5103./18656;
+    static const double b1 = 35./384, b3 = 500./1113, b4 = 125./192,
+        b5 = -2187./6784, b6 = 11./84;
+    // Differences between the fifth- and fourth-order weights.
+    static const double e1 = 71./57600, e3 = -71./16695, e4 = 71./1920,
+        e5 = -17253./339200, e6 = 22./525, e7 = -1./40;
+
+    double remaining = duration;
+    double h = duration;
+    for (int step = 0; step < BT_ODE_MAX_STEPS && remaining > 0; step++) {
+        if (h > remaining)
+            h = remaining;
+        const double s = training_stress;
+        const double k1 = bt_ode_derivative(ode, y, s, accuracy);
+        if (isnan(k1))
+            // Shorter steps can't help if the current point is invalid.
+            return NAN;
+        const double k2 = bt_ode_derivative(ode, y + h * (a21*k1), s, accuracy);
+        const double k3 = bt_ode_derivative(ode, y + h * (a31*k1 + a32*k2), s, accuracy);
+        const double k4 = bt_ode_derivative(ode, y + h * (a41*k1 + a42*k2 + a43*k3), s, accuracy);
+        const double k5 = bt_ode_derivative(ode, y + h * (a51*k1 + a52*k2 + a53*k3 + a54*k4), s, accuracy);
+        const double k6 = bt_ode_derivative(ode, y + h * (a61*k1 + a62*k2 + a63*k3 + a64*k4 + a65*k5), s, accuracy);
+        const double y_new = y + h * (b1*k1 + b3*k3 + b4*k4 + b5*k5 + b6*k6);
+        const double k7 = bt_ode_derivative(ode, y_new, s, accuracy);
+        const double error = h * (e1*k1 + e3*k3 + e4*k4 + e5*k5 + e6*k6 + e7*k7);
+        const double ratio = fabs(error) / (BT_ODE_TOLERANCE * (1 + fmax(fabs(y), fabs(y_new))));
+
+        if (ratio <= 1) {
+            y = y_new;
+            remaining -= h;
+        }
+        // Standard step size controller with a safety factor. A NAN ratio
+        // (e.g. from overshooting below zero) shrinks the step as much as
+        // possible.
+        double factor = ratio > 0 ? 0.9 * pow(ratio, -0.2) : 5;
+        if (!(factor >= 0.2))
+            factor = 0.2;
+        else if (factor > 5)
+            factor = 5;
+        h *= factor;
+    }
+    return remaining > 0 ? NAN : y;
+}
+
+
+double bt_ode_advance(const enum bt_ode_method method, const bt_ode_t *ode,
+                      const double y, const double training_stress,
+                      const double duration, const enum vpow_accuracy accuracy)
+{
+    if (method == BT_ODE_EULER)
+        return y + duration * bt_ode_derivative(ode, y, training_stress, accuracy);
+    if (training_stress == 0)
+        return bt_ode_decay(ode, y, duration, accuracy);
+    if (method == BT_ODE_RK4)
+        return bt_ode_rk4(ode, y, training_stress, duration, accuracy);
+    return bt_ode_adaptive(ode, y, training_stress, duration, accuracy);
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_ode.h
+ *
+ * Integrators for the fitness and fatigue equations of the nonlinear model.
+ *
+ * Both equations have the form `y' = -y^a/tau + k*s`, where `s` is the
+ * training stress, which is constant over each interval.
+ */
+
+#pragma once
+
+#include "vpow.h"
+
+/**
+ * Number of methods in ::bt_ode_method.
+ */
+#define BT_ODE_METHOD_COUNT 3
+
+/**
+ * Relative and absolute tolerance of the #BT_ODE_ADAPTIVE method for each
+ * interval.
+ */
+#ifndef BT_ODE_TOLERANCE
+#define BT_ODE_TOLERANCE 1e-8
+#endif
+
+/**
+ * Maximum number of attempted steps of the #BT_ODE_ADAPTIVE method for each
+ * interval.
+ */
+#ifndef BT_ODE_MAX_STEPS
+#define BT_ODE_MAX_STEPS 10000
+#endif
+
+/**
+ * Integration method.
+ *
+ * All methods except #BT_ODE_EULER advance intervals with zero training stress
+ * using the exact solution (see bt_ode_decay()), so they can also advance
+ * consecutive rest intervals in a single step.
+ */
+enum bt_ode_method {
+    /**
+     * One step of the explicit Euler method per interval.
+     */
+    BT_ODE_EULER = 0,
+    /**
+     * One step of the classic fourth-order Runge-Kutta method per interval.
+     */
+    BT_ODE_RK4 = 1,
+    /**
+     * Dormand-Prince 5(4) embedded Runge-Kutta method with adaptive step size
+     * control to a tolerance of #BT_ODE_TOLERANCE.
+     */
+    BT_ODE_ADAPTIVE = 2
+};
+
+/**
+ * Names of the integration methods, indexed by ::bt_ode_method.
+ */
+extern const char *bt_ode_method_names[BT_ODE_METHOD_COUNT];
+
+/**
+ * Coefficients of one equation of the form `y' = -y^exponent/tau + gain*s`.
+ */
+typedef struct bt_ode_t {
+    double tau;
+    double exponent;
+    double gain;
+} bt_ode_t;
+
+/**
+ * Returns the method with the given name (case insensitive).
+ *
+ * @param[in] name Name of the method.
+ * @returns The method, or -1 if there is no method with that name.
+ */
+int bt_ode_method_from_name(const char *name);
+
+/**
+ * Returns the exact solution of `y' = -y^exponent/tau` (i.e. with zero
+ * training stress) after time @p duration.
+ *
+ * Solutions that reach zero in finite time (which happens for exponents less
+ * than 1) stay at zero. If @p y is negative and the exponent isn't 1, the
+ * solution isn't defined, so the result is `NAN`.
+ *
+ * @param[in] ode Coefficients of the equation.
+ * @param[in] y Initial value.
+ * @param[in] duration Time to advance.
+ * @param[in] accuracy Accuracy tier of the power function.
+ * @returns The value after @p duration.
+ */
+double bt_ode_decay(const bt_ode_t *ode, const double y, const double duration,
+                    const enum vpow_accuracy accuracy);
+
+/**
+ * Advances the solution across an interval with constant training stress.
+ *
+ * @param[in] method Integration method.
+ * @param[in] ode Coefficients of the equation.
+ * @param[in] y Value at the start of the interval.
+ * @param[in] training_stress Training stress during the interval.
+ * @param[in] duration Length of the interval.
+ * @param[in] accuracy Accuracy tier of the power function.
+ * @returns The value at the end of the interval, or `NAN` if the method
+ *   failed.
+ */
+double bt_ode_advance(const enum bt_ode_method method, const bt_ode_t *ode,
+                      const double y, const double training_stress,
+                      const double duration, const enum vpow_accuracy accuracy);
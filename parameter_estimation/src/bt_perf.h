@@ -0,0 +1,59 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+/**
+ * @file bt_perf.h
+ *
+ * Hardware performance counters of the calling thread.
+ *
+ * The counters are opened with `perf_event_open` the first time a thread
+ * reads them and count that thread's user-space events from then on, so the
+ * difference between two readings on the same thread is the number of events
+ * in between. Where `perf_event_open` isn't available (e.g. on other
+ * operating systems, or when `/proc/sys/kernel/perf_event_paranoid` forbids
+ * it), no counters are available and they all read as 0.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Counted events.
+ */
+enum bt_perf_counter {
+    BT_PERF_CYCLES = 0,
+    BT_PERF_INSTRUCTIONS = 1,
+    BT_PERF_L1D_MISSES = 2,
+    BT_PERF_LLC_MISSES = 3,
+    BT_PERF_BRANCH_MISSES = 4,
+    BT_PERF_NUM_COUNTERS = 5
+};
+
+/**
+ * Names of the counters, indexed by #bt_perf_counter.
+ */
+extern const char *const bt_perf_counter_names[];
+
+/**
+ * Reads the counters of the calling thread, opening them if this is the
+ * thread's first call. Counters that aren't available read as 0.
+ *
+ * @param[out] values Array of #BT_PERF_NUM_COUNTERS counter values.
+ * @returns A bit mask of the available counters, where bit `i` is set if
+ *   counter `i` is available.
+ */
+unsigned bt_perf_read(uint64_t values[]);
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_plan.h"
+#include <stdlib.h>
+#include <strings.h>
+
+
+const char *bt_plan_precision_names[BT_PLAN_PRECISION_COUNT] = {
+    "double",
+    "mixed"
+};
+
+
+int bt_plan_precision_from_name(const char *name)
+{
+    for (int i = 0; i < BT_PLAN_PRECISION_COUNT; i++)
+        if (strcasecmp(bt_plan_precision_names[i], name) == 0)
+            return i;
+    return -1;
+}
+
+
+static size_t bt_plan_segment_length(const size_t start, const size_t end)
+{
+    return end > start ? end - start : 0;
+}
+
+
+bt_plan_t *bt_plan_compile(const bt_data_t *data, const bt_trials_t *trials,
+                           const enum bt_ode_method method,
+                           const enum bt_plan_precision precision)
+{
+    bt_plan_t *plan = calloc(1, sizeof(bt_plan_t));
+    plan->method = method;
+    plan->precision = method == BT_ODE_EULER ? precision : BT_PLAN_DOUBLE;
+    plan->num_trials = trials->size;
+    plan->targets = malloc(trials->size * sizeof(double));
+    plan->segment_lengths = malloc(trials->size * sizeof(size_t));
+
+    // Gather the targets and segment lengths.
+    size_t prev_trial_index = 0;
+    for (size_t trial = 0; trial < trials->size; trial++) {
+        const size_t trial_index = trials->trial_indices[trial];
+        plan->targets[trial] = data->performance[trial_index];
+        plan->segment_lengths[trial] = bt_plan_segment_length(prev_trial_index, trial_index);
+        plan->num_records += plan->segment_lengths[trial];
+        prev_trial_index = trial_index;
+    }
+
+    // Interleave the interval durations and training stresses, merging runs
+    // of rest intervals if the method advances them exactly.
+    const int merge_rest = method != BT_ODE_EULER;
+    plan->records = malloc(plan->num_records * sizeof(bt_plan_record_t));
+    bt_plan_record_t *record = plan->records;
+    prev_trial_index = 0;
+    for (size_t trial = 0; trial < trials->size; trial++) {
+        const size_t trial_index = trials->trial_indices[trial];
+        const bt_plan_record_t *segment_start = record;
+        for (size_t interval = prev_trial_index; interval < trial_index; interval++) {
+            const double dt = data->time[interval+1] - data->time[interval];
+            const double training_stress = data->training_stress[interval];
+            if (merge_rest && training_stress == 0 && record > segment_start &&
+                record[-1].training_stress == 0) {
+                record[-1].dt += dt;
+                continue;
+            }
+            record->dt = dt;
+            record->training_stress = training_stress;
+            record++;
+        }
+        plan->segment_lengths[trial] = record - segment_start;
+        prev_trial_index = trial_index;
+    }
+    plan->num_records = record - plan->records;
+
+    return plan;
+}
+
+
+void bt_plan_free(bt_plan_t *plan)
+{
+    if (plan == NULL)
+        return;
+
+    free(plan->records);
+    free(plan->targets);
+    free(plan->segment_lengths);
+    free(plan);
+}
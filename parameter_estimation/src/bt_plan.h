@@ -0,0 +1,146 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_plan.h
+ *
+ * Precompiled evaluation plan for the objective function and related
+ * functions.
+ */
+
+#pragma once
+
+#include "bt_data.h"
+#include "bt_ode.h"
+#include "bt_trials.h"
+
+/**
+ * Number of precisions in ::bt_plan_precision.
+ */
+#define BT_PLAN_PRECISION_COUNT 2
+
+/**
+ * Floating-point precision of the integration with the #BT_ODE_EULER method.
+ * The other methods always integrate in double precision.
+ */
+enum bt_plan_precision {
+    /**
+     * Integrate and sum the residuals in double precision.
+     */
+    BT_PLAN_DOUBLE = 0,
+    /**
+     * Integrate in single precision, which fits twice as many designs in
+     * each vector register, and sum the residuals in double precision.
+     */
+    BT_PLAN_MIXED = 1
+};
+
+/**
+ * Names of the precisions, indexed by ::bt_plan_precision.
+ */
+extern const char *bt_plan_precision_names[BT_PLAN_PRECISION_COUNT];
+
+/**
+ * One interval of the training data to integrate over.
+ */
+typedef struct bt_plan_record_t {
+    /**
+     * Duration of the interval.
+     */
+    double dt;
+    /**
+     * Training stress during the interval.
+     */
+    double training_stress;
+} bt_plan_record_t;
+
+/**
+ * The training data and trial indices rearranged for evaluating the objective
+ * function.
+ *
+ * Evaluating a design consists of integrating over the records, comparing
+ * the model's performance to the target after each segment. That is, the
+ * first `segment_lengths[0]` records lead up to trial 0, the next
+ * `segment_lengths[1]` records lead up to trial 1, etc. Records after the
+ * last trial are omitted.
+ *
+ * For methods that integrate rest intervals exactly (all except
+ * #BT_ODE_EULER), consecutive intervals with zero training stress within a
+ * segment are merged into a single record.
+ */
+typedef struct bt_plan_t {
+    /**
+     * Method used to integrate the model.
+     */
+    enum bt_ode_method method;
+    /**
+     * Precision of the integration.
+     */
+    enum bt_plan_precision precision;
+    /**
+     * Number of records (i.e. the sum of the segment lengths).
+     */
+    size_t num_records;
+    /**
+     * Array of intervals to integrate over, in order.
+     */
+    bt_plan_record_t *records;
+    /**
+     * Number of trials (i.e. the length of @p targets and @p segment_lengths).
+     */
+    size_t num_trials;
+    /**
+     * Array of the measured performance values at the trials.
+     */
+    double *targets;
+    /**
+     * Array of the number of records to integrate before each trial.
+     */
+    size_t *segment_lengths;
+} bt_plan_t;
+
+/**
+ * Returns the precision with the given name (case insensitive).
+ *
+ * @param[in] name Name of the precision.
+ * @returns The precision, or -1 if there is no precision with that name.
+ */
+int bt_plan_precision_from_name(const char *name);
+
+/**
+ * Creates the evaluation plan for the given training data and trials.
+ *
+ * The resulting pointer must be freed with bt_plan_free().
+ *
+ * @param[in] data Training data.
+ * @param[in] trials Indices in the training data to compute the residual
+ *   between the model and the data.
+ * @param[in] method Method used to integrate the model.
+ * @param[in] precision Precision of the integration. Methods other than
+ *   #BT_ODE_EULER always use #BT_PLAN_DOUBLE.
+ * @returns A pointer to the evaluation plan.
+ */
+bt_plan_t *bt_plan_compile(const bt_data_t *data, const bt_trials_t *trials,
+                           const enum bt_ode_method method,
+                           const enum bt_plan_precision precision);
+
+/**
+ * Frees a pointer allocated by bt_plan_compile().
+ *
+ * @param[in] plan The plan to free.
+ */
+void bt_plan_free(bt_plan_t *plan);
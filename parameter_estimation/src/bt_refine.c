@@ -0,0 +1,206 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_refine.h"
+#include "stats.h"
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Damping of the first step, relative to the diagonal of the Gauss-Newton
+ * matrix, and the factors it changes by after accepted and rejected steps.
+ */
+#define BT_REFINE_INITIAL_DAMPING 1e-3
+#define BT_REFINE_DAMPING_DECREASE 3.
+#define BT_REFINE_DAMPING_INCREASE 4.
+
+/*
+ * Damping at which the steps are too short to make progress.
+ */
+#define BT_REFINE_MAX_DAMPING 1e12
+
+
+/*
+ * Feasible region of the model (see bt_model_calculate_error()).
+ */
+static const design_var_t bt_refine_lower_bounds[DESIGN_VAR_COUNT] = {
+    [VAR_TAU1] = 0, [VAR_TAU2] = 0, [VAR_ALPHA] = 1, [VAR_BETA] = -INFINITY,
+    [VAR_K1] = 0, [VAR_K2] = 0, [VAR_P0] = -INFINITY, [VAR_F0] = -INFINITY,
+    [VAR_U0] = -INFINITY
+};
+static const design_var_t bt_refine_upper_bounds[DESIGN_VAR_COUNT] = {
+    [VAR_TAU1] = INFINITY, [VAR_TAU2] = INFINITY, [VAR_ALPHA] = INFINITY, [VAR_BETA] = 1,
+    [VAR_K1] = INFINITY, [VAR_K2] = INFINITY, [VAR_P0] = INFINITY, [VAR_F0] = INFINITY,
+    [VAR_U0] = INFINITY
+};
+
+
+/*
+ * Forms the Gauss-Newton matrix and gradient of the smoothed loss, i.e.
+ * J^T W J and J^T W r with the weights W = 1/sqrt(r^2 + smoothing^2).
+ */
+static void bt_refine_normal_equations(const size_t num_trials, const design_var_t residuals[],
+                                       design_var_t (*const jacobian)[DESIGN_VAR_COUNT],
+                                       const double smoothing,
+                                       double matrix[DESIGN_VAR_COUNT][DESIGN_VAR_COUNT],
+                                       double gradient[DESIGN_VAR_COUNT])
+{
+    memset(matrix, 0, DESIGN_VAR_COUNT * sizeof(matrix[0]));
+    memset(gradient, 0, DESIGN_VAR_COUNT * sizeof(gradient[0]));
+    for (size_t trial = 0; trial < num_trials; trial++) {
+        const double r = residuals[trial];
+        const double weight = 1 / sqrt(r * r + smoothing * smoothing);
+        const design_var_t *row = jacobian[trial];
+        for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+            gradient[j] += weight * r * row[j];
+            for (size_t k = 0; k <= j; k++)
+                matrix[j][k] += weight * row[j] * row[k];
+        }
+    }
+}
+
+
+/*
+ * Solves (matrix + damping * diag(matrix)) step = -gradient by Cholesky
+ * decomposition of the lower triangle. Returns 0 on success, or -1 if the
+ * damped matrix isn't positive definite.
+ */
+static int bt_refine_solve(double matrix[DESIGN_VAR_COUNT][DESIGN_VAR_COUNT],
+                           const double gradient[DESIGN_VAR_COUNT], const double damping,
+                           double step[DESIGN_VAR_COUNT])
+{
+    // Variables that don't affect the residuals would make the matrix
+    // singular, so their diagonal is raised to a tiny fraction of the largest.
+    double max_diagonal = 0;
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++)
+        max_diagonal = fmax(max_diagonal, matrix[j][j]);
+    double factor[DESIGN_VAR_COUNT][DESIGN_VAR_COUNT];
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+        for (size_t k = 0; k < j; k++)
+            factor[j][k] = matrix[j][k];
+        factor[j][j] = matrix[j][j] + damping * fmax(matrix[j][j], DBL_EPSILON * max_diagonal);
+    }
+
+    // Decompose, so that factor holds L with L L^T the damped matrix.
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+        for (size_t k = 0; k < j; k++)
+            factor[j][j] -= factor[j][k] * factor[j][k];
+        if (!(factor[j][j] > 0))
+            return -1;
+        factor[j][j] = sqrt(factor[j][j]);
+        for (size_t i = j + 1; i < DESIGN_VAR_COUNT; i++) {
+            for (size_t k = 0; k < j; k++)
+                factor[i][j] -= factor[i][k] * factor[j][k];
+            factor[i][j] /= factor[j][j];
+        }
+    }
+
+    // Solve L y = -gradient, then L^T step = y.
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+        double sum = -gradient[j];
+        for (size_t k = 0; k < j; k++)
+            sum -= factor[j][k] * step[k];
+        step[j] = sum / factor[j][j];
+    }
+    for (size_t j = DESIGN_VAR_COUNT; j-- > 0;) {
+        double sum = step[j];
+        for (size_t k = j + 1; k < DESIGN_VAR_COUNT; k++)
+            sum -= factor[k][j] * step[k];
+        step[j] = sum / factor[j][j];
+    }
+    return 0;
+}
+
+
+fitness_t bt_refine_design(design_var_t design[DESIGN_VAR_COUNT], const bt_plan_t *plan,
+                           const size_t max_steps, size_t *num_evaluations)
+{
+    const size_t num_trials = plan->num_trials;
+    design_var_t *residuals = malloc(num_trials * sizeof(design_var_t));
+    design_var_t (*jacobian)[DESIGN_VAR_COUNT] = malloc(num_trials * sizeof(*jacobian));
+    double matrix[DESIGN_VAR_COUNT][DESIGN_VAR_COUNT], gradient[DESIGN_VAR_COUNT];
+
+    fitness_t error = bt_model_calculate_error(design, plan);
+    (*num_evaluations)++;
+    double damping = BT_REFINE_INITIAL_DAMPING;
+    int moved = 1;
+    for (size_t i = 0; i < max_steps && isfinite(error) && error > 0
+                       && damping < BT_REFINE_MAX_DAMPING; i++) {
+        // The Jacobian only changes when the design does.
+        if (moved) {
+            bt_model_calculate_residual_jacobian(design, plan, residuals, jacobian);
+            (*num_evaluations)++;
+            bt_refine_normal_equations(num_trials, residuals, jacobian,
+                                       BT_REFINE_SMOOTHING * error / num_trials,
+                                       matrix, gradient);
+            moved = 0;
+        }
+        double step[DESIGN_VAR_COUNT];
+        if (bt_refine_solve(matrix, gradient, damping, step) != 0) {
+            damping *= BT_REFINE_DAMPING_INCREASE;
+            continue;
+        }
+        design_var_t candidate[DESIGN_VAR_COUNT];
+        for (size_t j = 0; j < DESIGN_VAR_COUNT; j++)
+            candidate[j] = fmin(fmax(design[j] + step[j], bt_refine_lower_bounds[j]),
+                                bt_refine_upper_bounds[j]);
+        const fitness_t candidate_error = bt_model_calculate_error(candidate, plan);
+        (*num_evaluations)++;
+        if (candidate_error < error) {
+            memcpy(design, candidate, sizeof(candidate));
+            error = candidate_error;
+            damping /= BT_REFINE_DAMPING_DECREASE;
+            moved = 1;
+        } else {
+            damping *= BT_REFINE_DAMPING_INCREASE;
+        }
+    }
+
+    free(jacobian);
+    free(residuals);
+    return error;
+}
+
+
+size_t bt_refine_best_designs(const size_t nmemb, design_var_t (*designs)[DESIGN_VAR_COUNT],
+                              fitness_t fitnesses[], const bt_refine_options_t *options,
+                              const bt_plan_t *plan)
+{
+    const size_t num_refined = options->num_designs < nmemb ? options->num_designs : nmemb;
+    size_t *indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(indices, fitnesses, nmemb, nmemb - num_refined);
+    size_t num_evaluations = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:num_evaluations)
+    for (size_t i = nmemb - num_refined; i < nmemb; i++) {
+        const size_t index = indices[i];
+        if (isfinite(fitnesses[index])) {
+            fitnesses[index] = -bt_refine_design(designs[index], plan, options->max_steps,
+                                                 &num_evaluations);
+        }
+    }
+    free(indices);
+    return num_evaluations;
+}
+
+
+size_t bt_refine_max_evaluations(const size_t nmemb, const bt_refine_options_t *options)
+{
+    const size_t num_refined = options->num_designs < nmemb ? options->num_designs : nmemb;
+    return num_refined * (2 * options->max_steps + 1);
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_refine.h
+ *
+ * Local refinement of designs with the gradients of the objective function,
+ * for running the genetic algorithm as a memetic algorithm.
+ */
+
+#pragma once
+
+#include "bt_model.h"
+#include "bt_plan.h"
+#include "ga.h"
+#include <stddef.h>
+
+/**
+ * Smoothing of the absolute residuals in the refinement steps, relative to
+ * the mean absolute residual of the design being refined.
+ */
+#ifndef BT_REFINE_SMOOTHING
+#define BT_REFINE_SMOOTHING 0.01
+#endif
+
+/**
+ * Options for refining the best designs of the population.
+ */
+typedef struct {
+    /**
+     * Number of generations between refinements, or 0 to never refine.
+     */
+    size_t interval;
+    /**
+     * Number of the best designs of each island to refine.
+     */
+    size_t num_designs;
+    /**
+     * Maximum number of steps (and therefore objective function evaluations)
+     * per design.
+     */
+    size_t max_steps;
+} bt_refine_options_t;
+
+/**
+ * Refines a design with damped Gauss-Newton (Levenberg-Marquardt) steps.
+ *
+ * The total absolute residual isn't differentiable where a residual is 0, so
+ * each step minimizes the smoothed loss `sum(sqrt(r^2 + eps^2))` instead,
+ * where `eps` is #BT_REFINE_SMOOTHING times the mean absolute residual. This
+ * is done as a Gauss-Newton step of the least squares problem weighted by
+ * `1/sqrt(r^2 + eps^2)`, using the Jacobian from
+ * bt_model_calculate_residual_jacobian(). The step is projected onto the
+ * feasible region of the model (`tau1`, `tau2`, `k1`, `k2 >= 0`, `alpha >= 1`,
+ * and `beta <= 1`) and only accepted if it reduces the total absolute
+ * residual, so the refined design is never worse than the original.
+ *
+ * Each evaluation of the objective function and each Jacobian counts as one
+ * evaluation, so a design takes at most `2 * max_steps + 1`.
+ *
+ * @param[in,out] design The design to refine.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices with the #BT_ODE_EULER method.
+ * @param[in] max_steps Maximum number of steps to try.
+ * @param[in,out] num_evaluations Incremented by the number of evaluations.
+ * @returns The total absolute residual of the refined design, as calculated
+ *   by bt_model_calculate_error().
+ */
+fitness_t bt_refine_design(design_var_t design[DESIGN_VAR_COUNT], const bt_plan_t *plan,
+                           const size_t max_steps, size_t *num_evaluations);
+
+/**
+ * Refines the best designs of a population with bt_refine_design(), in
+ * parallel, and updates their objective function values. Designs with
+ * infinite or `NAN` objective function values aren't refined.
+ *
+ * @param[in] nmemb The number of designs.
+ * @param[in,out] designs The array of designs.
+ * @param[in,out] fitnesses The objective function values of the designs.
+ * @param[in] options Numbers of designs and steps to refine.
+ * @param[in] plan Evaluation plan compiled from the training data and trial
+ *   indices with the #BT_ODE_EULER method.
+ * @returns The number of evaluations, counted as by bt_refine_design().
+ */
+size_t bt_refine_best_designs(const size_t nmemb, design_var_t (*designs)[DESIGN_VAR_COUNT],
+                              fitness_t fitnesses[], const bt_refine_options_t *options,
+                              const bt_plan_t *plan);
+
+/**
+ * Returns the largest number of evaluations that bt_refine_best_designs() can
+ * take for a population.
+ *
+ * @param[in] nmemb The number of designs.
+ * @param[in] options Numbers of designs and steps to refine.
+ * @returns The number of evaluations, counted as by bt_refine_design().
+ */
+size_t bt_refine_max_evaluations(const size_t nmemb, const bt_refine_options_t *options);
@@ -0,0 +1,267 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_table.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+/*
+ * number of values converted to little-endian at a time when writing or
+ * reading the body of a table
+ */
+#define BLOCK_SIZE 512
+
+
+static void store_u64(unsigned char *bytes, uint64_t value)
+{
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = value & 0xff;
+        value >>= 8;
+    }
+}
+
+
+static uint64_t load_u64(const unsigned char *bytes)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | bytes[i];
+    return value;
+}
+
+
+static void store_double(unsigned char *bytes, const double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    store_u64(bytes, bits);
+}
+
+
+static double load_double(const unsigned char *bytes)
+{
+    const uint64_t bits = load_u64(bytes);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+
+int bt_table_parse_format(const char *name, enum bt_table_format *format)
+{
+    if (strcasecmp(name, "tsv") == 0)
+        *format = BT_TABLE_TSV;
+    else if (strcasecmp(name, "binary") == 0)
+        *format = BT_TABLE_BINARY;
+    else
+        return -1;
+    return 0;
+}
+
+
+int bt_table_write(FILE *stream, const size_t num_columns, const size_t num_rows,
+                   const char *const names[], const enum bt_table_column_type types[],
+                   const double values[])
+{
+    // Header
+    size_t names_size = 0;
+    for (size_t j = 0; j < num_columns; j++)
+        names_size += strlen(names[j]) + 1;
+    const size_t header_size = (BT_TABLE_FIXED_HEADER_SIZE + names_size + num_columns + 7) / 8 * 8;
+    unsigned char *header = calloc(header_size, 1);
+    memcpy(header, BT_TABLE_MAGIC, 8);
+    store_u64(header + 8, header_size);
+    store_u64(header + 16, num_columns);
+    store_u64(header + 24, num_rows);
+    unsigned char *name = header + BT_TABLE_FIXED_HEADER_SIZE;
+    for (size_t j = 0; j < num_columns; j++) {
+        const size_t length = strlen(names[j]) + 1;
+        memcpy(name, names[j], length);
+        name += length;
+    }
+    for (size_t j = 0; j < num_columns; j++)
+        name[j] = types ? types[j] : BT_TABLE_DOUBLE;
+    const size_t header_written = fwrite(header, 1, header_size, stream);
+    free(header);
+    if (header_written != header_size)
+        return -1;
+
+    // Values
+    unsigned char block[BLOCK_SIZE * 8];
+    const size_t num_values = num_columns * num_rows;
+    for (size_t start = 0; start < num_values; start += BLOCK_SIZE) {
+        const size_t count = num_values - start < BLOCK_SIZE ? num_values - start : BLOCK_SIZE;
+        for (size_t i = 0; i < count; i++)
+            store_double(block + 8 * i, values[start + i]);
+        if (fwrite(block, 8, count, stream) != count)
+            return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * validates the fixed-length portion of a header; returns 0 on success, or -1
+ * if it isn't a table header
+ */
+static int parse_fixed_header(const unsigned char *fixed, size_t *header_size,
+                              size_t *num_columns, size_t *num_rows)
+{
+    if (memcmp(fixed, BT_TABLE_MAGIC, 8) != 0)
+        return -1;
+    const uint64_t header_size64 = load_u64(fixed + 8);
+    const uint64_t num_columns64 = load_u64(fixed + 16);
+    const uint64_t num_rows64 = load_u64(fixed + 24);
+    if (header_size64 < BT_TABLE_FIXED_HEADER_SIZE || header_size64 % 8 != 0
+        || header_size64 - BT_TABLE_FIXED_HEADER_SIZE < num_columns64
+        || header_size64 > SIZE_MAX || num_rows64 > SIZE_MAX
+        || (num_rows64 != 0 && num_columns64 > SIZE_MAX / 8 / num_rows64))
+        return -1;
+    *header_size = header_size64;
+    *num_columns = num_columns64;
+    *num_rows = num_rows64;
+    return 0;
+}
+
+
+int bt_table_parse_header(const void *bytes, const size_t size, size_t *header_size,
+                          size_t *num_columns, size_t *num_rows)
+{
+    if (size < BT_TABLE_FIXED_HEADER_SIZE
+        || parse_fixed_header(bytes, header_size, num_columns, num_rows) != 0
+        || *header_size > size
+        || (size - *header_size) / 8 / (*num_rows > 0 ? *num_rows : 1) < *num_columns)
+        return -1;
+    return 0;
+}
+
+
+bool bt_table_native(void)
+{
+    const double one = 1;
+    unsigned char bytes[8];
+    store_double(bytes, one);
+    return memcmp(bytes, &one, sizeof(one)) == 0;
+}
+
+
+double bt_table_value(const void *column, const size_t index)
+{
+    return load_double((const unsigned char *)column + 8 * index);
+}
+
+
+bt_table_t *bt_table_read(FILE *stream)
+{
+    // Fixed-length header
+    unsigned char fixed[BT_TABLE_FIXED_HEADER_SIZE];
+    size_t header_size, num_columns, num_rows;
+    if (fread(fixed, 1, BT_TABLE_FIXED_HEADER_SIZE, stream) != BT_TABLE_FIXED_HEADER_SIZE
+        || parse_fixed_header(fixed, &header_size, &num_columns, &num_rows) != 0)
+        return NULL;
+
+    // Column names
+    const size_t names_size = header_size - BT_TABLE_FIXED_HEADER_SIZE;
+    char *names = malloc(names_size + 1);
+    if (fread(names, 1, names_size, stream) != names_size) {
+        free(names);
+        return NULL;
+    }
+    names[names_size] = '\0';
+    bt_table_t *table = calloc(1, sizeof(bt_table_t));
+    table->num_columns = num_columns;
+    table->num_rows = num_rows;
+    table->names = calloc(num_columns > 0 ? num_columns : 1, sizeof(char *));
+    table->types = calloc(num_columns > 0 ? num_columns : 1, sizeof(enum bt_table_column_type));
+    size_t offset = 0;
+    for (size_t j = 0; j < num_columns; j++) {
+        if (offset >= names_size) {
+            free(names);
+            bt_table_free(table);
+            return NULL;
+        }
+        table->names[j] = strdup(names + offset);
+        offset += strlen(names + offset) + 1;
+    }
+    // The types follow the names; any that don't fit are in the padding,
+    // which is zero, i.e. BT_TABLE_DOUBLE.
+    for (size_t j = 0; j < num_columns && offset + j < names_size; j++) {
+        const unsigned char type = names[offset + j];
+        if (type > BT_TABLE_INTEGER) {
+            free(names);
+            bt_table_free(table);
+            return NULL;
+        }
+        table->types[j] = type;
+    }
+    free(names);
+
+    // Values
+    const size_t num_values = table->num_columns * table->num_rows;
+    table->values = malloc((num_values > 0 ? num_values : 1) * sizeof(double));
+    unsigned char block[BLOCK_SIZE * 8];
+    for (size_t start = 0; start < num_values; start += BLOCK_SIZE) {
+        const size_t count = num_values - start < BLOCK_SIZE ? num_values - start : BLOCK_SIZE;
+        if (fread(block, 8, count, stream) != count) {
+            bt_table_free(table);
+            return NULL;
+        }
+        for (size_t i = 0; i < count; i++)
+            table->values[start + i] = load_double(block + 8 * i);
+    }
+    return table;
+}
+
+
+void bt_table_write_tsv(FILE *stream, const bt_table_t *table)
+{
+    for (size_t j = 0; j < table->num_columns; j++) {
+        if (j > 0)
+            fprintf(stream, "\t");
+        fprintf(stream, "%s", table->names[j]);
+    }
+    fprintf(stream, "\n");
+    for (size_t i = 0; i < table->num_rows; i++) {
+        for (size_t j = 0; j < table->num_columns; j++) {
+            if (j > 0)
+                fprintf(stream, "\t");
+            const double value = table->values[j * table->num_rows + i];
+            if (table->types[j] == BT_TABLE_INTEGER)
+                fprintf(stream, "%zd", (size_t)value);
+            else
+                fprintf(stream, "%lf", value);
+        }
+        fprintf(stream, "\n");
+    }
+}
+
+
+void bt_table_free(bt_table_t *table)
+{
+    if (table == NULL)
+        return;
+
+    if (table->names != NULL)
+        for (size_t j = 0; j < table->num_columns; j++)
+            free(table->names[j]);
+    free(table->names);
+    free(table->types);
+    free(table->values);
+    free(table);
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_table.h
+ *
+ * Binary columnar tables of double-precision values.
+ *
+ * A table file starts with a header, followed by the values of each column in
+ * turn:
+ *
+ * | Offset | Size     | Contents                                           |
+ * |--------|----------|----------------------------------------------------|
+ * | 0      | 8        | #BT_TABLE_MAGIC                                    |
+ * | 8      | 8        | Size of the header in bytes (a multiple of 8)      |
+ * | 16     | 8        | Number of columns                                  |
+ * | 24     | 8        | Number of rows                                     |
+ * | 32     | variable | NUL-terminated column names                        |
+ * |        | variable | Column types (#bt_table_column_type), one byte per |
+ * |        |          | column, NUL-padded to 8 bytes                      |
+ *
+ * All integers are little-endian unsigned 64-bit values, and all values are
+ * little-endian IEEE 754 doubles, including those of integer columns. Since
+ * the header size is a multiple of 8, the values are suitably aligned when
+ * the file is mapped into memory, and column `j` starts at byte
+ * `header_size + 8 * j * num_rows`. Missing type bytes mean
+ * #BT_TABLE_DOUBLE, so tables written without them read as all doubles.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The first eight bytes of a table file.
+ */
+#define BT_TABLE_MAGIC "BTTABLE1"
+
+/**
+ * Size of the fixed-length portion of the header, in bytes.
+ */
+#define BT_TABLE_FIXED_HEADER_SIZE 32
+
+/**
+ * Formats of the tables written by the output functions.
+ */
+enum bt_table_format {
+    /**
+     * Text with tab-separated values.
+     */
+    BT_TABLE_TSV,
+    /**
+     * Binary columnar table (see bt_table.h).
+     */
+    BT_TABLE_BINARY
+};
+
+/**
+ * Types of the columns of a table, which only affect how they're written as
+ * TSV.
+ */
+enum bt_table_column_type {
+    /**
+     * Doubles, written with `%lf`.
+     */
+    BT_TABLE_DOUBLE = 0,
+    /**
+     * Nonnegative integers, written with `%zd`.
+     */
+    BT_TABLE_INTEGER = 1
+};
+
+/**
+ * A table read from a file.
+ */
+typedef struct bt_table_t {
+    /**
+     * Number of columns.
+     */
+    size_t num_columns;
+    /**
+     * Number of rows.
+     */
+    size_t num_rows;
+    /**
+     * Array of column names.
+     */
+    char **names;
+    /**
+     * Array of column types.
+     */
+    enum bt_table_column_type *types;
+    /**
+     * Values in column-major order; row `i` of column `j` is at index
+     * `j * num_rows + i`.
+     */
+    double *values;
+} bt_table_t;
+
+/**
+ * Parses the name of a table format ("tsv" or "binary").
+ *
+ * @param[in] name The name, compared case-insensitively.
+ * @param[out] format The corresponding format.
+ * @returns 0 on success, or -1 if the name isn't recognized.
+ */
+int bt_table_parse_format(const char *name, enum bt_table_format *format);
+
+/**
+ * Writes a binary table.
+ *
+ * @param[in,out] stream The stream to write to.
+ * @param[in] num_columns Number of columns.
+ * @param[in] num_rows Number of rows.
+ * @param[in] names Array of column names.
+ * @param[in] types Array of column types, or `NULL` if all the columns hold
+ *     doubles.
+ * @param[in] values Values in column-major order; row `i` of column `j` is
+ *     at index `j * num_rows + i`.
+ * @returns 0 on success, or -1 on a write error.
+ */
+int bt_table_write(FILE *stream, const size_t num_columns, const size_t num_rows,
+                   const char *const names[], const enum bt_table_column_type types[],
+                   const double values[]);
+
+/**
+ * Reads a binary table.
+ *
+ * The resulting pointer must be freed with bt_table_free().
+ *
+ * @param[in,out] stream The stream to read from.
+ * @returns A pointer to the table, or `NULL` if the stream doesn't contain a
+ *     valid table.
+ */
+bt_table_t *bt_table_read(FILE *stream);
+
+/**
+ * Reads the header of a binary table in memory, such as a mapped file.
+ *
+ * The values of column `j` start at byte `header_size + 8 * j * num_rows`;
+ * see bt_table_native() and bt_table_value() for how to read them.
+ *
+ * @param[in] bytes The table.
+ * @param[in] size Size of @p bytes.
+ * @param[out] header_size Size of the header in bytes.
+ * @param[out] num_columns Number of columns.
+ * @param[out] num_rows Number of rows.
+ * @returns 0 on success, or -1 if @p bytes doesn't hold a complete table.
+ */
+int bt_table_parse_header(const void *bytes, const size_t size, size_t *header_size,
+                          size_t *num_columns, size_t *num_rows);
+
+/**
+ * Returns whether the values of a table in memory can be used in place as
+ * `double`s, i.e. whether the host is little-endian.
+ *
+ * @returns `true` if the values can be used in place.
+ */
+bool bt_table_native(void);
+
+/**
+ * Returns a value of a column of a table in memory.
+ *
+ * @param[in] column Start of the column.
+ * @param[in] index Index of the row.
+ * @returns The value.
+ */
+double bt_table_value(const void *column, const size_t index);
+
+/**
+ * Writes a table as TSV, with a header row of the column names, formatting
+ * each column according to its type as the text outputs do.
+ *
+ * @param[in,out] stream The stream to write to.
+ * @param[in] table The table.
+ */
+void bt_table_write_tsv(FILE *stream, const bt_table_t *table);
+
+/**
+ * Frees a table allocated with bt_table_read().
+ *
+ * @param[in] table The table to free.
+ */
+void bt_table_free(bt_table_t *table);
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_threads.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+bt_threads_split_t bt_threads_split(const size_t num_seeds, const size_t population_size,
+                                    const size_t work_per_member,
+                                    const int requested_seed_threads)
+{
+    bt_threads_split_t split = {1, 1};
+#ifdef _OPENMP
+    if (omp_in_parallel())
+        return split;
+    const int total_threads = omp_get_max_threads();
+
+    // Seeds first.
+    size_t seed_threads = requested_seed_threads > 0 ? (size_t)requested_seed_threads : (size_t)total_threads;
+    if (seed_threads > num_seeds)
+        seed_threads = num_seeds > 0 ? num_seeds : 1;
+    if (seed_threads > (size_t)total_threads)
+        seed_threads = total_threads;
+
+    // Then the rest to evaluation, as long as there's enough work.
+    size_t eval_threads = total_threads / seed_threads;
+    const size_t max_eval_threads = population_size * work_per_member / BT_THREADS_MIN_WORK;
+    if (eval_threads > max_eval_threads)
+        eval_threads = max_eval_threads;
+    if (eval_threads < 1)
+        eval_threads = 1;
+
+    split.seed_threads = seed_threads;
+    split.eval_threads = eval_threads;
+#endif
+    return split;
+}
+
+
+void bt_threads_enable_nesting(const bt_threads_split_t *split)
+{
+#ifdef _OPENMP
+    if (split->seed_threads > 1 && split->eval_threads > 1 && omp_get_max_active_levels() < 2)
+        omp_set_max_active_levels(2);
+#endif
+}
+
+
+void bt_threads_limit_eval(const bt_threads_split_t *split)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(split->eval_threads);
+#endif
+}
@@ -16,62 +16,88 @@
  */
 
 #include "bt_trials.h"
+#include "bt_input.h"
+#include "bt_table.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 
-static int bt_trials_parse_line(const char *line, bt_trials_t *trials) {
-    return sscanf(line, "%zd", trials->trial_indices + trials->size) == 1 ? 0 : 1;
+static int bt_trials_parse_line(const char *line, const char *end, bt_trials_t *trials) {
+    return bt_input_parse_size(&line, end, trials->trial_indices + trials->size) == 0 ? 0 : 1;
 }
 
 
-bt_trials_t *bt_trials_load(const char *path)
+/*
+ * parses the trial indices from a TSV file
+ */
+static bt_trials_t *bt_trials_parse_text(bt_input_t *input)
 {
-    // Open file
-    FILE *file;
-    if ((file = fopen(path, "r")) == NULL)
-        return NULL;
-    char *line = NULL;
-    size_t length = 0;
+    const char *end = input->data + input->size;
 
     // Skip header line
-    if (getline(&line, &length, file) == -1) {
-        free(line);
-        fclose(file);
+    if (input->size == 0)
         return NULL;
-    }
+    const char *line = bt_input_next_line(input->data, end);
 
     // Allocate memory
-    size_t capacity = 1000;
+    const size_t capacity = bt_input_count_lines(line, end);
     bt_trials_t *trials = calloc(1, sizeof(bt_trials_t));
-    trials->trial_indices = malloc(capacity * sizeof(size_t));
+    trials->trial_indices = malloc((capacity > 0 ? capacity : 1) * sizeof(size_t));
 
     // Read trials
-    while (getline(&line, &length, file) != -1) {
-        // Enlarge arrays if necessary
-        if (trials->size >= capacity) {
-            capacity <<= 1;
-            trials->trial_indices = realloc(trials->trial_indices, capacity * sizeof(size_t));
+    while (line < end) {
+        const char *next_line = bt_input_next_line(line, end);
+        if (bt_trials_parse_line(line, next_line, trials) != 0) {
+            fprintf(stderr, "Unable to parse line '%.*s'.\n", (int)(next_line - line), line);
+            bt_trials_free(trials);
+            return NULL;
         }
+        trials->size++;
+        line = next_line;
+        bt_input_release(input, line);
+    }
+    return trials;
+}
+
 
-        // Parse line
-        if (bt_trials_parse_line(line, trials) != 0) {
-            fprintf(stderr, "Unable to parse line '%s'.\n", line);
-            free(line);
-            fclose(file);
+/*
+ * converts the first column of a binary table to trial indices
+ */
+static bt_trials_t *bt_trials_from_table(const bt_input_t *input)
+{
+    size_t header_size, num_columns, num_rows;
+    if (bt_table_parse_header(input->data, input->size, &header_size, &num_columns, &num_rows) != 0
+        || num_columns < 1)
+        return NULL;
+    const char *column = input->data + header_size;
+    bt_trials_t *trials = calloc(1, sizeof(bt_trials_t));
+    trials->trial_indices = malloc((num_rows > 0 ? num_rows : 1) * sizeof(size_t));
+    for (size_t i = 0; i < num_rows; i++) {
+        const double value = bt_table_value(column, i);
+        if (!(value >= 0 && value < SIZE_MAX) || value != (size_t)value) {
+            fprintf(stderr, "Invalid trial index %lf.\n", value);
             bt_trials_free(trials);
             return NULL;
         }
-        trials->size++;
+        trials->trial_indices[trials->size++] = value;
     }
+    return trials;
+}
 
-    // Free resources.
-    free(line);
-    fclose(file);
 
-    // Resize arrays to the number of values they contain
-    trials->trial_indices = realloc(trials->trial_indices, trials->size * sizeof(size_t));
+bt_trials_t *bt_trials_load(const char *path)
+{
+    bt_input_t *input;
+    if ((input = bt_input_open(path)) == NULL)
+        return NULL;
 
+    bt_trials_t *trials;
+    if (input->size >= 8 && memcmp(input->data, BT_TABLE_MAGIC, 8) == 0)
+        trials = bt_trials_from_table(input);
+    else
+        trials = bt_trials_parse_text(input);
+    bt_input_close(input);
     return trials;
 }
 
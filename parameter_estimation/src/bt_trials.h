@@ -43,6 +43,9 @@ typedef struct bt_trials_t {
 /**
  * Reads the trial indices from the file located at @p path.
  *
+ * The file is either a TSV file with a header line and one index per line,
+ * or a binary table (see bt_table.h) whose first column is the indices.
+ *
  * The returned pointer must be freed with bt_trials_free().
  *
  * @param[in] path Path where the input file is located.
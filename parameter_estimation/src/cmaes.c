@@ -0,0 +1,305 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "cmaes.h"
+#include "stats.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Maximum number of sweeps of the Jacobi eigenvalue method.
+ */
+#define CMAES_MAX_JACOBI_SWEEPS 50
+
+
+/*
+ * Finds the eigenvalues and eigenvectors (as the columns of vectors) of the
+ * symmetric n-by-n matrix a with the cyclic Jacobi method, which destroys a.
+ */
+static void cmaes_eigen(const size_t n, double a[n][n], double vectors[n][n], double values[n])
+{
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < n; j++)
+            vectors[i][j] = i == j;
+    for (size_t sweep = 0; sweep < CMAES_MAX_JACOBI_SWEEPS; sweep++) {
+        double off_diagonal = 0, diagonal = 0;
+        for (size_t p = 0; p < n; p++) {
+            diagonal += a[p][p] * a[p][p];
+            for (size_t q = p + 1; q < n; q++)
+                off_diagonal += a[p][q] * a[p][q];
+        }
+        if (off_diagonal <= 1e-30 * diagonal)
+            break;
+        for (size_t p = 0; p < n; p++) {
+            for (size_t q = p + 1; q < n; q++) {
+                if (a[p][q] == 0)
+                    continue;
+                // Rotate so that a[p][q] becomes 0.
+                const double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+                const double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                const double c = 1 / sqrt(t * t + 1);
+                const double s = t * c;
+                for (size_t k = 0; k < n; k++) {
+                    const double a_kp = a[k][p], a_kq = a[k][q];
+                    a[k][p] = c * a_kp - s * a_kq;
+                    a[k][q] = s * a_kp + c * a_kq;
+                }
+                for (size_t k = 0; k < n; k++) {
+                    const double a_pk = a[p][k], a_qk = a[q][k];
+                    a[p][k] = c * a_pk - s * a_qk;
+                    a[q][k] = s * a_pk + c * a_qk;
+                }
+                for (size_t k = 0; k < n; k++) {
+                    const double v_kp = vectors[k][p], v_kq = vectors[k][q];
+                    vectors[k][p] = c * v_kp - s * v_kq;
+                    vectors[k][q] = s * v_kp + c * v_kq;
+                }
+            }
+        }
+    }
+    for (size_t i = 0; i < n; i++)
+        values[i] = a[i][i];
+}
+
+
+/*
+ * Updates the eigendecomposition of the covariance matrix. Eigenvalues that
+ * rounding made nonpositive are raised to the smallest positive one the
+ * condition limit allows.
+ */
+static void cmaes_decompose(cmaes_t *es)
+{
+    const size_t n = es->design_var_count;
+    double (*a)[n] = malloc(n * sizeof(*a));
+    memcpy(a, es->covariance, n * sizeof(*a));
+    cmaes_eigen(n, a, (double (*)[n])es->eigenvectors, es->axis_lengths);
+    free(a);
+    double max_value = 0;
+    for (size_t i = 0; i < n; i++)
+        max_value = fmax(max_value, es->axis_lengths[i]);
+    for (size_t i = 0; i < n; i++)
+        es->axis_lengths[i] = sqrt(fmax(es->axis_lengths[i], max_value / CMAES_MAX_CONDITION / 10));
+}
+
+
+size_t cmaes_default_nmemb(const size_t design_var_count)
+{
+    return 4 + (size_t)(3 * log(design_var_count));
+}
+
+
+cmaes_t *cmaes_alloc(const size_t design_var_count, const size_t nmemb)
+{
+    const size_t n = design_var_count;
+    cmaes_t *es = malloc(sizeof(cmaes_t));
+    es->design_var_count = n;
+    es->nmemb = nmemb;
+    es->num_parents = nmemb / 2;
+    es->weights = malloc(es->num_parents * sizeof(double));
+    es->mean = malloc(n * sizeof(design_var_t));
+    es->path_c = malloc(n * sizeof(double));
+    es->path_sigma = malloc(n * sizeof(double));
+    es->covariance = malloc(n * n * sizeof(double));
+    es->eigenvectors = malloc(n * n * sizeof(double));
+    es->axis_lengths = malloc(n * sizeof(double));
+    es->initial_stdevs = malloc(n * sizeof(double));
+
+    // Default strategy parameters of Hansen, "The CMA Evolution Strategy: A
+    // Tutorial" (2016).
+    const size_t mu = es->num_parents;
+    double sum = 0, sum_squares = 0;
+    for (size_t i = 0; i < mu; i++) {
+        es->weights[i] = log((nmemb + 1) / 2.) - log(i + 1);
+        sum += es->weights[i];
+    }
+    for (size_t i = 0; i < mu; i++) {
+        es->weights[i] /= sum;
+        sum_squares += es->weights[i] * es->weights[i];
+    }
+    const double mu_eff = 1 / sum_squares;
+    es->mu_eff = mu_eff;
+    es->c_c = (4 + mu_eff / n) / (n + 4 + 2 * mu_eff / n);
+    es->c_sigma = (mu_eff + 2) / (n + mu_eff + 5);
+    es->c_1 = 2 / ((n + 1.3) * (n + 1.3) + mu_eff);
+    es->c_mu = fmin(1 - es->c_1, 2 * (mu_eff - 2 + 1 / mu_eff) / ((n + 2.) * (n + 2.) + mu_eff));
+    es->d_sigma = 1 + 2 * fmax(0, sqrt((mu_eff - 1) / (n + 1)) - 1) + es->c_sigma;
+    es->chi_n = sqrt(n) * (1 - 1 / (4. * n) + 1 / (21. * n * n));
+    return es;
+}
+
+
+void cmaes_init(cmaes_t *es, const design_var_t mean[], const design_var_t stdevs[])
+{
+    const size_t n = es->design_var_count;
+    memcpy(es->mean, mean, n * sizeof(design_var_t));
+    memcpy(es->initial_stdevs, stdevs, n * sizeof(double));
+    es->sigma = 1;
+    for (size_t i = 0; i < n; i++) {
+        es->path_c[i] = 0;
+        es->path_sigma[i] = 0;
+        es->axis_lengths[i] = stdevs[i];
+        for (size_t j = 0; j < n; j++) {
+            es->covariance[i*n + j] = i == j ? stdevs[i] * stdevs[i] : 0;
+            es->eigenvectors[i*n + j] = i == j;
+        }
+    }
+    es->generation = 0;
+    es->flat_generations = 0;
+}
+
+
+void cmaes_sample(const cmaes_t *es, design_var_t (*designs)[es->design_var_count],
+                  const uint64_t key)
+{
+    const size_t n = es->design_var_count;
+    #pragma omp parallel for if(es->nmemb * n >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < es->nmemb; i++) {
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, i));
+        double scaled[n];
+        for (size_t j = 0; j < n; j++)
+            scaled[j] = es->axis_lengths[j] * rng_stream_gauss(&rng);
+        for (size_t j = 0; j < n; j++) {
+            double step = 0;
+            for (size_t k = 0; k < n; k++)
+                step += es->eigenvectors[j*n + k] * scaled[k];
+            designs[i][j] = es->mean[j] + es->sigma * step;
+        }
+    }
+}
+
+
+void cmaes_update(cmaes_t *es, design_var_t (*const designs)[es->design_var_count],
+                  const fitness_t fitnesses[])
+{
+    const size_t n = es->design_var_count;
+    const size_t mu = es->num_parents;
+    size_t *order = malloc(es->nmemb * sizeof(size_t));
+    stats_sort_index(order, fitnesses, es->nmemb);
+
+    // The generation is flat when its finite values are all within
+    // CMAES_TOL_FUN of the best, relative to its magnitude. Infeasible
+    // designs (NAN or -INFINITY) sort first and are left out, so that a few
+    // of them near the bounds don't hide a flat generation.
+    size_t first_finite = 0;
+    while (first_finite < es->nmemb && !isfinite(fitnesses[order[first_finite]]))
+        first_finite++;
+    const fitness_t best = fitnesses[order[es->nmemb - 1]];
+    if (first_finite < es->nmemb
+        && best - fitnesses[order[first_finite]] <= CMAES_TOL_FUN * fmax(1, fabs(best)))
+        es->flat_generations++;
+    else
+        es->flat_generations = 0;
+
+    // Steps of the parents, best first, in units of sigma.
+    double (*steps)[n] = malloc(mu * sizeof(*steps));
+    double mean_step[n];
+    for (size_t j = 0; j < n; j++)
+        mean_step[j] = 0;
+    for (size_t i = 0; i < mu; i++) {
+        const design_var_t *design = designs[order[es->nmemb - 1 - i]];
+        for (size_t j = 0; j < n; j++) {
+            steps[i][j] = (design[j] - es->mean[j]) / es->sigma;
+            mean_step[j] += es->weights[i] * steps[i][j];
+        }
+    }
+    for (size_t j = 0; j < n; j++)
+        es->mean[j] += es->sigma * mean_step[j];
+
+    // Step size path, with the mean step whitened by C^(-1/2) = B D^-1 B^T.
+    double rotated[n];
+    for (size_t k = 0; k < n; k++) {
+        double sum = 0;
+        for (size_t j = 0; j < n; j++)
+            sum += es->eigenvectors[j*n + k] * mean_step[j];
+        rotated[k] = sum / es->axis_lengths[k];
+    }
+    const double sigma_rate = sqrt(es->c_sigma * (2 - es->c_sigma) * es->mu_eff);
+    double path_sigma_norm = 0;
+    for (size_t j = 0; j < n; j++) {
+        double whitened = 0;
+        for (size_t k = 0; k < n; k++)
+            whitened += es->eigenvectors[j*n + k] * rotated[k];
+        es->path_sigma[j] = (1 - es->c_sigma) * es->path_sigma[j] + sigma_rate * whitened;
+        path_sigma_norm += es->path_sigma[j] * es->path_sigma[j];
+    }
+    path_sigma_norm = sqrt(path_sigma_norm);
+    es->generation++;
+
+    // Covariance path, which stalls while the step size path is long, so that
+    // C doesn't grow too fast when sigma is too small.
+    const double correction = sqrt(1 - pow(1 - es->c_sigma, 2. * es->generation));
+    const bool h_sigma = path_sigma_norm / correction < (1.4 + 2. / (n + 1)) * es->chi_n;
+    const double c_rate = sqrt(es->c_c * (2 - es->c_c) * es->mu_eff);
+    for (size_t j = 0; j < n; j++)
+        es->path_c[j] = (1 - es->c_c) * es->path_c[j] + h_sigma * c_rate * mean_step[j];
+
+    // Rank-one and rank-mu updates of the covariance matrix.
+    const double stall = (1 - h_sigma) * es->c_c * (2 - es->c_c);
+    const double decay = 1 - es->c_1 - es->c_mu + es->c_1 * stall;
+    for (size_t j = 0; j < n; j++) {
+        for (size_t k = 0; k <= j; k++) {
+            double rank_mu = 0;
+            for (size_t i = 0; i < mu; i++)
+                rank_mu += es->weights[i] * steps[i][j] * steps[i][k];
+            const double value = decay * es->covariance[j*n + k]
+                + es->c_1 * es->path_c[j] * es->path_c[k] + es->c_mu * rank_mu;
+            es->covariance[j*n + k] = value;
+            es->covariance[k*n + j] = value;
+        }
+    }
+    es->sigma *= exp(es->c_sigma / es->d_sigma * (path_sigma_norm / es->chi_n - 1));
+    cmaes_decompose(es);
+
+    free(steps);
+    free(order);
+}
+
+
+bool cmaes_converged(const cmaes_t *es)
+{
+    const size_t n = es->design_var_count;
+    const size_t flat_limit = 10 + (30 * n + es->nmemb - 1) / es->nmemb;
+    if (es->flat_generations >= flat_limit)
+        return true;
+    bool small = true;
+    double min_axis = INFINITY, max_axis = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (es->sigma * sqrt(es->covariance[j*n + j]) >= CMAES_TOL_X * es->initial_stdevs[j])
+            small = false;
+        min_axis = fmin(min_axis, es->axis_lengths[j]);
+        max_axis = fmax(max_axis, es->axis_lengths[j]);
+    }
+    return small || max_axis * max_axis > CMAES_MAX_CONDITION * min_axis * min_axis;
+}
+
+
+void cmaes_free(cmaes_t *es)
+{
+    if (es == NULL)
+        return;
+    free(es->initial_stdevs);
+    free(es->axis_lengths);
+    free(es->eigenvectors);
+    free(es->covariance);
+    free(es->path_sigma);
+    free(es->path_c);
+    free(es->mean);
+    free(es->weights);
+    free(es);
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file cmaes.h
+ *
+ * Covariance matrix adaptation evolution strategy (CMA-ES), an alternative to
+ * the genetic algorithm for continuous designs.
+ */
+
+#pragma once
+
+#include "ga.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Tolerance on the standard deviations of the search distribution, relative
+ * to the initial standard deviations, below which the search has converged.
+ */
+#ifndef CMAES_TOL_X
+#define CMAES_TOL_X 1e-12
+#endif
+
+/**
+ * Tolerance on the range of the finite objective function values of a
+ * generation, relative to the magnitude of the best value (or 1, if that's
+ * smaller), below which the generation counts as flat.
+ */
+#ifndef CMAES_TOL_FUN
+#define CMAES_TOL_FUN 1e-10
+#endif
+
+/**
+ * Condition number of the covariance matrix above which the search has
+ * converged.
+ */
+#ifndef CMAES_MAX_CONDITION
+#define CMAES_MAX_CONDITION 1e14
+#endif
+
+/**
+ * Options of the CMA-ES engine.
+ */
+typedef struct cmaes_options_t {
+    /**
+     * Number of designs sampled in each generation (see
+     * cmaes_default_nmemb()).
+     */
+    size_t nmemb;
+    /**
+     * Maximum number of restarts with a doubled population size when the
+     * search converges (IPOP-CMA-ES), or 0 to stop instead.
+     */
+    size_t max_restarts;
+} cmaes_options_t;
+
+/**
+ * State of the search distribution.
+ *
+ * Designs are sampled from the multivariate normal distribution with mean
+ * @p mean and covariance `sigma^2 C`, where `C` is kept in its eigendecomposition
+ * `B diag(D)^2 B^T` for sampling.
+ */
+typedef struct cmaes_t {
+    /**
+     * Number of variables in each design.
+     */
+    size_t design_var_count;
+    /**
+     * Number of designs sampled in each generation.
+     */
+    size_t nmemb;
+    /**
+     * Number of the best designs recombined into the new mean.
+     */
+    size_t num_parents;
+    /**
+     * Recombination weights of the parents, best first.
+     */
+    double *weights;
+    /**
+     * Variance effective selection mass of the weights.
+     */
+    double mu_eff;
+    /**
+     * Learning rates of the evolution paths, the rank-one update, and the
+     * rank-mu update, and the damping of the step size.
+     */
+    double c_c, c_sigma, c_1, c_mu, d_sigma;
+    /**
+     * Expected length of a standard normal vector.
+     */
+    double chi_n;
+    /**
+     * Mean of the distribution.
+     */
+    design_var_t *mean;
+    /**
+     * Step size.
+     */
+    double sigma;
+    /**
+     * Evolution paths of the covariance matrix and the step size.
+     */
+    double *path_c, *path_sigma;
+    /**
+     * Covariance matrix `C`, row-major.
+     */
+    double *covariance;
+    /**
+     * Eigenvectors `B` of the covariance matrix, as columns, row-major.
+     */
+    double *eigenvectors;
+    /**
+     * Square roots `D` of the eigenvalues of the covariance matrix.
+     */
+    double *axis_lengths;
+    /**
+     * Standard deviations the search started with.
+     */
+    double *initial_stdevs;
+    /**
+     * Number of updates since the search started.
+     */
+    size_t generation;
+    /**
+     * Number of consecutive generations whose finite objective function
+     * values were flat (see #CMAES_TOL_FUN).
+     */
+    size_t flat_generations;
+} cmaes_t;
+
+/**
+ * Returns the default number of designs per generation,
+ * `4 + floor(3 ln(design_var_count))`.
+ *
+ * @param[in] design_var_count The number of variables in each design.
+ * @returns The default population size.
+ */
+size_t cmaes_default_nmemb(const size_t design_var_count);
+
+/**
+ * Allocates the state of a search.
+ *
+ * The returned pointer must be freed with cmaes_free(), and the state must be
+ * initialized with cmaes_init() before sampling.
+ *
+ * @param[in] design_var_count The number of variables in each design.
+ * @param[in] nmemb The number of designs sampled in each generation (at least
+ *   2).
+ * @returns A pointer to the state.
+ */
+cmaes_t *cmaes_alloc(const size_t design_var_count, const size_t nmemb);
+
+/**
+ * Starts a search from the given mean, with the given standard deviations of
+ * each variable and no correlations between them.
+ *
+ * @param[in,out] es The state of the search.
+ * @param[in] mean The initial mean.
+ * @param[in] stdevs The initial standard deviations.
+ */
+void cmaes_init(cmaes_t *es, const design_var_t mean[], const design_var_t stdevs[]);
+
+/**
+ * Samples a generation of designs from the search distribution.
+ *
+ * @param[in] es The state of the search.
+ * @param[out] designs The `es->nmemb` designs to write.
+ * @param[in] key The key of the operator's random stream. Each design draws
+ *   from its own child stream, so the result doesn't depend on the number of
+ *   threads.
+ */
+void cmaes_sample(const cmaes_t *es, design_var_t (*designs)[es->design_var_count],
+                  const uint64_t key);
+
+/**
+ * Updates the search distribution from a generation of designs and their
+ * objective function values, which are maximized.
+ *
+ * `NAN` values are ranked below all other values (see stats_sort_index()).
+ *
+ * @param[in,out] es The state of the search.
+ * @param[in] designs The designs sampled by cmaes_sample().
+ * @param[in] fitnesses The objective function values of @p designs.
+ */
+void cmaes_update(cmaes_t *es, design_var_t (*const designs)[es->design_var_count],
+                  const fitness_t fitnesses[]);
+
+/**
+ * Checks whether the search has converged: the standard deviations have
+ * shrunk by a factor of #CMAES_TOL_X, the covariance matrix has a condition
+ * number above #CMAES_MAX_CONDITION, or the objective function values have
+ * been flat for `10 + 30 design_var_count / nmemb` generations.
+ *
+ * @param[in] es The state of the search.
+ * @returns Whether the search has converged.
+ */
+bool cmaes_converged(const cmaes_t *es);
+
+/**
+ * Frees a pointer allocated by cmaes_alloc().
+ *
+ * @param[in] es The state to free.
+ */
+void cmaes_free(cmaes_t *es);
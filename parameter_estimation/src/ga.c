@@ -16,9 +16,10 @@
  */
 
 #include "ga.h"
-#include "randomkit.h"
 #include "stats.h"
 #include <assert.h>
+#include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -27,23 +28,29 @@ void init_random_population(const size_t nmemb, const size_t design_var_count,
                             design_var_t designs[][design_var_count],
                             const design_var_t lower_bounds[],
                             const design_var_t upper_bounds[],
-                            rk_state *rng)
+                            const uint64_t key)
 {
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
     for (size_t i = 0; i < nmemb; i++) {
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, i));
         for (size_t j = 0; j < design_var_count; j++) {
             designs[i][j] = lower_bounds[j] +
-                rk_double(rng) * (upper_bounds[j] - lower_bounds[j]);
+                rng_stream_double(&rng) * (upper_bounds[j] - lower_bounds[j]);
         }
     }
 }
 
 void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
                           const size_t num_winners, size_t winner_indices[],
-                          rk_state *rng)
+                          const uint64_t key)
 {
+    #pragma omp parallel for if(2 * num_winners >= GA_PARALLEL_MIN_DRAWS)
     for (size_t i = 0; i < num_winners; i++) {
-        size_t comp1 = rk_interval(nmemb - 1, rng);
-        size_t comp2 = rk_interval(nmemb - 1, rng);
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, i));
+        size_t comp1 = rng_stream_interval(nmemb - 1, &rng);
+        size_t comp2 = rng_stream_interval(nmemb - 1, &rng);
         winner_indices[i] = fitnesses[comp1] >= fitnesses[comp2] ? comp1 : comp2;
     }
 }
@@ -53,19 +60,28 @@ void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
                   const size_t parent_indices[],
                   design_var_t (*children)[design_var_count],
                   const double alpha,
-                  rk_state *rng)
+                  const uint64_t key)
 {
-    for (size_t i = 0; i < nmemb-1; i += 2) {
+    // With an odd number of designs, the last child has the first winner as
+    // its second parent, and the pair only makes that one child.
+    const size_t num_pairs = (nmemb + 1) / 2;
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t pair = 0; pair < num_pairs; pair++) {
+        const size_t i = 2 * pair;
+        const bool has_second_child = i + 1 < nmemb;
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, pair));
         const design_var_t *p1 = population[parent_indices[i]];  // Select first parent
-        const design_var_t *p2 = population[parent_indices[i+1]];  // Select second parent
+        const design_var_t *p2 = population[parent_indices[has_second_child ? i+1 : 0]];  // Select second parent
         for (size_t j = 0; j < design_var_count; j++) {
             design_var_t cmin = p1[j] <= p2[j] ? p1[j] : p2[j];  // Select min value
             design_var_t cmax = p1[j] > p2[j] ? p1[j] : p2[j];  // Select max value
             design_var_t range = cmax - cmin;  // Select range
             design_var_t a = cmin - range * alpha;  // Select lower bound
             design_var_t b = cmax + range * alpha;  // Select upper bound
-            children[i][j] = a + (b - a) * rk_double(rng); // Set child design
-            children[i+1][j] = a + (b - a) * rk_double(rng); // Set child design
+            children[i][j] = a + (b - a) * rng_stream_double(&rng); // Set child design
+            if (has_second_child)
+                children[i+1][j] = a + (b - a) * rng_stream_double(&rng); // Set child design
         }
     }
 }
@@ -73,17 +89,16 @@ void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
 void ga_mutate(const size_t nmemb, const size_t design_var_count,
                design_var_t population[][design_var_count],
                const design_var_t design_var_stdevs[],
-               const double mutate_probability, rk_state *rng)
+               const double mutate_probability, const uint64_t key)
 {
-    for (size_t i = 0; i < nmemb; i++)
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < nmemb; i++) {
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, i));
         for (size_t j = 0; j < design_var_count; j++)
-            if (rk_double(rng) < mutate_probability)
-                population[i][j] += design_var_stdevs[j] * rk_gauss(rng);
-}
-
-static int compare_size_t(const void *first, const void *second)
-{
-    return (int)((long long)(*((size_t *) first)) - (long long)(*((size_t *) second)));
+            if (rng_stream_double(&rng) < mutate_probability)
+                population[i][j] += design_var_stdevs[j] * rng_stream_gauss(&rng);
+    }
 }
 
 void ga_cull(const size_t nmemb,
@@ -95,50 +110,154 @@ void ga_cull(const size_t nmemb,
              fitness_t child_fitnesses[])
 {
     assert(num_keep <= nmemb);
+    const bool parallel = nmemb * design_var_count >= GA_CULL_PARALLEL_MIN_VALUES;
 
-    // Copy best parents to the start of the arrays.
-    size_t sorted_indices[nmemb];
-    stats_sort_index(sorted_indices, fitnesses, nmemb);
-    qsort(sorted_indices + (nmemb - num_keep), num_keep, sizeof(size_t), compare_size_t);
-    for (size_t i = 0; i < num_keep; i++) {
-        memmove(designs[i], designs[sorted_indices[i + (nmemb - num_keep)]],
-                design_var_count * sizeof(design_var_t));
-        fitnesses[i] = fitnesses[sorted_indices[i + (nmemb - num_keep)]];
+    // Move the best parents to the start of the arrays. Those that are
+    // already there stay, and the rest fill the places of the discarded
+    // parents.
+    size_t *parent_indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(parent_indices, fitnesses, nmemb, nmemb - num_keep);
+    size_t num_moves = 0;
+    for (size_t i = 0; i < nmemb - num_keep; i++)
+        if (parent_indices[i] < num_keep)
+            parent_indices[num_moves++] = parent_indices[i];
+    size_t *sources = parent_indices + (nmemb - num_keep);
+    size_t num_sources = 0;
+    for (size_t i = 0; i < num_keep; i++)
+        if (sources[i] >= num_keep)
+            sources[num_sources++] = sources[i];
+    assert(num_sources == num_moves);
+    #pragma omp parallel for if(parallel)
+    for (size_t i = 0; i < num_moves; i++) {
+        memcpy(designs[parent_indices[i]], designs[sources[i]],
+               design_var_count * sizeof(design_var_t));
+        fitnesses[parent_indices[i]] = fitnesses[sources[i]];
     }
+    free(parent_indices);
 
     // Copy best children to the rest of the arrays.
-    size_t sorted_child_indices[nmemb];
-    stats_sort_index(sorted_child_indices, child_fitnesses, nmemb);
+    size_t *child_indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(child_indices, child_fitnesses, nmemb, num_keep);
+    #pragma omp parallel for if(parallel)
     for (size_t i = num_keep; i < nmemb; i++) {
-        memcpy(designs[i], child_designs[sorted_child_indices[i]], design_var_count * sizeof(design_var_t));
-        fitnesses[i] = child_fitnesses[sorted_child_indices[i]];
+        memcpy(designs[i], child_designs[child_indices[i]], design_var_count * sizeof(design_var_t));
+        fitnesses[i] = child_fitnesses[child_indices[i]];
     }
+    free(child_indices);
 }
 
-void fprintf_fitness_summary(FILE *stream, const size_t nmemb, const fitness_t fitnesses[])
+void ga_migrate(const size_t design_var_count,
+                const ga_islands_t *islands,
+                const size_t island_offsets[],
+                design_var_t (*designs)[design_var_count],
+                fitness_t fitnesses[])
 {
-    fitness_t min_fitness, max_fitness, median_fitness;
-    fitness_t fitnesses_copy[nmemb];
-    memcpy(fitnesses_copy, fitnesses, nmemb * sizeof(fitness_t));
-    stats_sort(fitnesses_copy, nmemb);
-    min_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.0);
-    max_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 1.0);
-    median_fitness = stats_median_from_sorted(fitnesses_copy, nmemb);
-    fprintf(stream, "Min: %lf\tMedian: %lf\t Max: %lf",
-            min_fitness, median_fitness, max_fitness);
+    const size_t num_islands = islands->num_islands;
+    const size_t num_migrants = islands->num_migrants;
+    if (num_islands < 2 || num_migrants == 0)
+        return;
+
+    // Copy the best designs of each island to its mailbox.
+    design_var_t (*mail_designs)[design_var_count] = malloc(num_islands * num_migrants * design_var_count * sizeof(design_var_t));
+    fitness_t *mail_fitnesses = malloc(num_islands * num_migrants * sizeof(fitness_t));
+    size_t mail_counts[num_islands];
+    size_t max_size = 0;
+    for (size_t k = 0; k < num_islands; k++)
+        if (island_offsets[k+1] - island_offsets[k] > max_size)
+            max_size = island_offsets[k+1] - island_offsets[k];
+    size_t *indices = malloc(max_size * sizeof(size_t));
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t offset = island_offsets[k];
+        const size_t size = island_offsets[k+1] - offset;
+        mail_counts[k] = num_migrants < size ? num_migrants : size;
+        stats_select_index(indices, fitnesses + offset, size, size - mail_counts[k]);
+        for (size_t j = 0; j < mail_counts[k]; j++) {
+            const size_t best = offset + indices[size - 1 - j];
+            memcpy(mail_designs[k * num_migrants + j], designs[best],
+                   design_var_count * sizeof(design_var_t));
+            mail_fitnesses[k * num_migrants + j] = fitnesses[best];
+        }
+    }
+
+    // Replace the worst designs of each island with the mail from its
+    // neighbors.
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t offset = island_offsets[k];
+        const size_t size = island_offsets[k+1] - offset;
+        const size_t num_sources = islands->topology == GA_TOPOLOGY_RING ? 1 : num_islands - 1;
+        size_t num_mail = 0;
+        for (size_t step = 1; step <= num_sources; step++)
+            num_mail += mail_counts[(k + num_islands - step) % num_islands];
+        stats_select_index(indices, fitnesses + offset, size,
+                           num_mail < size / 2 ? num_mail : size / 2);
+        size_t num_replaced = 0;
+        for (size_t step = 1; step < num_islands; step++) {
+            const size_t source = (k + num_islands - step) % num_islands;
+            for (size_t j = 0; j < mail_counts[source] && num_replaced < size / 2; j++) {
+                const size_t worst = offset + indices[num_replaced++];
+                memcpy(designs[worst], mail_designs[source * num_migrants + j],
+                       design_var_count * sizeof(design_var_t));
+                fitnesses[worst] = mail_fitnesses[source * num_migrants + j];
+            }
+            if (islands->topology == GA_TOPOLOGY_RING)
+                break;
+        }
+    }
+
+    free(indices);
+    free(mail_fitnesses);
+    free(mail_designs);
 }
 
-void fprintf_fitness_quartiles(FILE *stream, const size_t nmemb, const fitness_t fitnesses[])
+const char *const ga_stop_reason_names[] = {
+    "max_generations", "stall", "spread", "budget", "converged"
+};
+
+
+void ga_progress_init(ga_progress_t *progress)
+{
+    progress->best_fitness = -INFINITY;
+    progress->best_generation = 0;
+}
+
+
+enum ga_stop_reason ga_check_stop(const ga_stopping_t *stopping,
+                                  ga_progress_t *progress,
+                                  const size_t generation,
+                                  const size_t num_evaluations,
+                                  const size_t nmemb, const fitness_t fitnesses[])
+{
+    if (stopping->stall_generations > 0) {
+        // Comparisons with NAN are false, so NAN values are skipped.
+        fitness_t best = -INFINITY;
+        for (size_t i = 0; i < nmemb; i++)
+            if (fitnesses[i] > best)
+                best = fitnesses[i];
+        if (best > progress->best_fitness + stopping->stall_epsilon) {
+            progress->best_fitness = best;
+            progress->best_generation = generation;
+        } else if (generation - progress->best_generation >= stopping->stall_generations) {
+            return GA_STOP_STALL;
+        }
+    }
+    if (stopping->min_spread > 0) {
+        static const double qs[] = {0.25, 0.75};
+        fitness_t quartiles[2];
+        stats_quantiles(quartiles, qs, 2, fitnesses, nmemb);
+        if (quartiles[1] - quartiles[0] < stopping->min_spread)
+            return GA_STOP_SPREAD;
+    }
+    if (stopping->max_evaluations > 0 && num_evaluations + nmemb > stopping->max_evaluations)
+        return GA_STOP_BUDGET;
+    return GA_STOP_MAX_GENERATIONS;
+}
+
+
+void fprintf_fitness_summary(FILE *stream, const size_t nmemb, const fitness_t fitnesses[])
 {
-    fitness_t min_fitness, q1_fitness, median_fitness, q3_fitness, max_fitness;
-    fitness_t fitnesses_copy[nmemb];
-    memcpy(fitnesses_copy, fitnesses, nmemb * sizeof(fitness_t));
-    stats_sort(fitnesses_copy, nmemb);
-    min_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.0);
-    max_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 1.0);
-    median_fitness = stats_median_from_sorted(fitnesses_copy, nmemb);
-    q1_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.25);
-    q3_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.75);
-    fprintf(stream, "%lf\t%lf\t%lf\t%lf\t%lf",
-            min_fitness, q1_fitness, median_fitness, q3_fitness, max_fitness);
+    static const double qs[] = {0., 0.5, 1.};
+    fitness_t summary[3];
+    stats_quantiles(summary, qs, 3, fitnesses, nmemb);
+    fprintf(stream, "Min: %lf\tMedian: %lf\t Max: %lf",
+            summary[0], summary[1], summary[2]);
 }
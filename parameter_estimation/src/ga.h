@@ -23,9 +23,25 @@
 
 #pragma once
 
-#include "randomkit.h"
+#include "rng_stream.h"
 #include <stdio.h>
 
+/**
+ * Minimum number of random draws in one call of a variation operator that
+ * makes it worthwhile to run the operator on multiple threads.
+ */
+#ifndef GA_PARALLEL_MIN_DRAWS
+#define GA_PARALLEL_MIN_DRAWS 20000
+#endif
+
+/**
+ * Minimum number of values copied by ga_cull() that makes it worthwhile to
+ * copy the designs on multiple threads.
+ */
+#ifndef GA_CULL_PARALLEL_MIN_VALUES
+#define GA_CULL_PARALLEL_MIN_VALUES 200000
+#endif
+
 /**
  * Type of design variable values.
  *
@@ -42,6 +58,119 @@ typedef double design_var_t;
  */
 typedef double fitness_t;
 
+/**
+ * Purposes of the random streams of one generation.
+ *
+ * Each operator draws from its own child of the generation's key (see
+ * rng_stream_key()), and each design (or pair of designs, for crossover) from
+ * its own child of that, so the operators can process the designs in
+ * parallel and in any order.
+ */
+enum ga_stream {
+    GA_STREAM_INIT = 0,
+    GA_STREAM_SELECT = 1,
+    GA_STREAM_CROSSOVER = 2,
+    GA_STREAM_MUTATE = 3
+};
+
+/**
+ * Topology of the migration between islands.
+ */
+enum ga_topology {
+    /**
+     * Each island sends its emigrants to the next island, wrapping around.
+     */
+    GA_TOPOLOGY_RING = 0,
+    /**
+     * Each island sends its emigrants to every other island.
+     */
+    GA_TOPOLOGY_FULL = 1
+};
+
+/**
+ * Configuration of the island model.
+ *
+ * The population is split into @p num_islands contiguous sub-populations that
+ * evolve independently and exchange designs every @p migration_interval
+ * generations.
+ */
+typedef struct ga_islands_t {
+    size_t num_islands;
+    size_t migration_interval;
+    size_t num_migrants;
+    enum ga_topology topology;
+} ga_islands_t;
+
+/**
+ * Reasons for a run of the GA to stop.
+ */
+enum ga_stop_reason {
+    /**
+     * The maximum number of generations was run (or the run hasn't stopped
+     * yet).
+     */
+    GA_STOP_MAX_GENERATIONS = 0,
+    /**
+     * The best objective function value stopped improving.
+     */
+    GA_STOP_STALL = 1,
+    /**
+     * The spread of the objective function values collapsed.
+     */
+    GA_STOP_SPREAD = 2,
+    /**
+     * The budget of objective function evaluations was used up.
+     */
+    GA_STOP_BUDGET = 3,
+    /**
+     * The search distribution of CMA-ES converged (see cmaes_converged()),
+     * with no restarts left.
+     */
+    GA_STOP_CONVERGED = 4
+};
+
+/**
+ * Names of the stop reasons, indexed by #ga_stop_reason.
+ */
+extern const char *const ga_stop_reason_names[];
+
+/**
+ * Criteria for stopping a run of the GA before the maximum number of
+ * generations. A criterion is disabled when its count or threshold is 0.
+ */
+typedef struct ga_stopping_t {
+    /**
+     * Stop when the best objective function value hasn't improved by more
+     * than @p stall_epsilon in this many generations.
+     */
+    size_t stall_generations;
+    double stall_epsilon;
+    /**
+     * Stop when the interquartile range (q3 - q1) of the objective function
+     * values falls below this.
+     */
+    double min_spread;
+    /**
+     * Stop when the next generation would make the number of objective
+     * function evaluations exceed this.
+     */
+    size_t max_evaluations;
+} ga_stopping_t;
+
+/**
+ * State of the stopping criteria that carries over between generations.
+ */
+typedef struct ga_progress_t {
+    /**
+     * The best objective function value that counted as an improvement.
+     */
+    fitness_t best_fitness;
+    /**
+     * The generation of @p best_fitness.
+     */
+    size_t best_generation;
+} ga_progress_t;
+
 /**
  * Generates a random population of designs, where the design variable
  * values are within the specified bounds.
@@ -51,13 +180,13 @@ typedef double fitness_t;
  * @param[out] designs The population of designs to write.
  * @param[in] lower_bounds The lower bounds for the design variables.
  * @param[in] upper_bounds The upper bounds for the design variables.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void init_random_population(const size_t nmemb, const size_t design_var_count,
                             design_var_t designs[][design_var_count],
                             const design_var_t lower_bounds[],
                             const design_var_t upper_bounds[],
-                            rk_state *rng);
+                            const uint64_t key);
 
 /**
  * Selects indices of suitable parents by tournament selection.
@@ -66,15 +195,18 @@ void init_random_population(const size_t nmemb, const size_t design_var_count,
  * @param[in] fitnesses The objective function values of the designs.
  * @param[in] num_winners The number of designs to select.
  * @param[out] winner_indices The indices of the selected designs.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
                           const size_t num_winners, size_t winner_indices[],
-                          rk_state *rng);
+                          const uint64_t key);
 
 /**
  * Creates children by combining (crossover) the parents by BLX-alpha.
  *
+ * Each pair of parents makes a pair of children. If @p nmemb is odd, the last
+ * child is made from the last parent and the first, so every child is set.
+ *
  * You may want to update the objective function values of @p children after
  * this.
  *
@@ -85,7 +217,7 @@ void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
  * @param[in] parent_indices Indices within @p population to use as parents.
  * @param[out] children The population of children to generate.
  * @param[in] alpha The alpha parameter to use for BLX-alpha crossover.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  *
  * @note Ideally, @p population would be defined as `const design_var_t (*const
  * population)[design_var_count]`, but due to limitations in the C standard,
@@ -97,7 +229,7 @@ void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
                   const size_t parent_indices[],
                   design_var_t (*children)[design_var_count],
                   const double alpha,
-                  rk_state *rng);
+                  const uint64_t key);
 
 /**
  * Mutates the population (randomly changes the design variables) using
@@ -112,12 +244,12 @@ void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
  * @param[in] design_var_stdevs Standard deviations for Gaussian mutation.
  * @param[in] mutate_probability Probability that any individual design
  *   variable value will be mutated.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void ga_mutate(const size_t nmemb, const size_t design_var_count,
                design_var_t population[][design_var_count],
                const design_var_t design_var_stdevs[],
-               const double mutate_probability, rk_state *rng);
+               const double mutate_probability, const uint64_t key);
 
 /**
  * Combines the two populations, keeping @p num_keep of the best parents. The
@@ -126,6 +258,11 @@ void ga_mutate(const size_t nmemb, const size_t design_var_count,
  * The fitnesses of the parents (@p fitnesses) and children (@p
  * child_fitnesses) must be correct on entry.
  *
+ * The best designs are found by selection rather than sorting, so this takes
+ * linear time on average. Kept parents that are already among the first @p
+ * num_keep designs stay where they are, and the order of the output
+ * population is otherwise unspecified.
+ *
  * @param[in] nmemb The number of designs in each population.
  * @param[in] design_var_count The number of variables in each design.
  * @param[in,out] designs The parent population (and the output population).
@@ -151,23 +288,67 @@ void ga_cull(const size_t nmemb,
              fitness_t child_fitnesses[]);
 
 /**
- * Writes a summary (min/median/max) of the objective function values to the
- * given stream.
+ * Migrates the best designs of each island to its neighbors.
  *
- * @param[in,out] stream The stream to write to.
- * @param[in] nmemb Number of objective function values.
- * @param[in] fitnesses Array of objective function values.
+ * The @p num_migrants best designs of every island are copied out first, and
+ * then each island replaces its worst designs with the copies from its
+ * neighbors (as given by the topology), so the result doesn't depend on the
+ * order in which the islands are visited. At most half of each island is
+ * replaced. The best and worst designs are found by selection rather than
+ * sorting, so they are taken in no particular order.
+ *
+ * @param[in] design_var_count The number of variables in each design.
+ * @param[in] islands The island model configuration.
+ * @param[in] island_offsets Array of `islands->num_islands + 1` indices, where
+ *   island `k` consists of the designs from `island_offsets[k]` up to (but not
+ *   including) `island_offsets[k+1]`.
+ * @param[in,out] designs The population.
+ * @param[in,out] fitnesses The objective function values of the population.
  */
-void fprintf_fitness_summary(FILE *stream,
-                             const size_t nmemb, const fitness_t fitnesses[]);
+void ga_migrate(const size_t design_var_count,
+                const ga_islands_t *islands,
+                const size_t island_offsets[],
+                design_var_t (*designs)[design_var_count],
+                fitness_t fitnesses[]);
 
 /**
- * Writes a summary (min/q1/median/q3/max) of the objective function values to
- * the given stream.
+ * Resets the state of the stopping criteria for a new run.
+ *
+ * @param[out] progress The state to reset.
+ */
+void ga_progress_init(ga_progress_t *progress);
+
+/**
+ * Checks the stopping criteria against the population after the given number
+ * of generations.
+ *
+ * `NAN` objective function values never count as an improvement, and a
+ * spread involving them never counts as collapsed.
+ *
+ * @param[in] stopping The stopping criteria.
+ * @param[in,out] progress The state of the stopping criteria, which must be
+ *   passed to each generation in order.
+ * @param[in] generation The number of generations run so far.
+ * @param[in] num_evaluations The number of objective function evaluations so
+ *   far.
+ * @param[in] nmemb Number of designs in the population (and the number of
+ *   evaluations of one generation).
+ * @param[in] fitnesses The objective function values of the population.
+ * @returns The reason to stop, or #GA_STOP_MAX_GENERATIONS to continue.
+ */
+enum ga_stop_reason ga_check_stop(const ga_stopping_t *stopping,
+                                  ga_progress_t *progress,
+                                  const size_t generation,
+                                  const size_t num_evaluations,
+                                  const size_t nmemb, const fitness_t fitnesses[]);
+
+/**
+ * Writes a summary (min/median/max) of the objective function values to the
+ * given stream.
  *
  * @param[in,out] stream The stream to write to.
  * @param[in] nmemb Number of objective function values.
  * @param[in] fitnesses Array of objective function values.
  */
-void fprintf_fitness_quartiles(FILE *stream,
-                               const size_t nmemb, const fitness_t fitnesses[]);
+void fprintf_fitness_summary(FILE *stream,
+                             const size_t nmemb, const fitness_t fitnesses[]);
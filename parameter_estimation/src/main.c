@@ -16,13 +16,21 @@
  */
 
 #include "bt_bounds.h"
+#include "bt_checkpoint.h"
+#include "bt_convergence.h"
 #include "bt_data.h"
+#include "bt_manifest.h"
 #include "bt_trials.h"
 #include "bt_model.h"
+#include "bt_plan.h"
+#include "bt_profile.h"
+#include "bt_refine.h"
+#include "bt_threads.h"
+#include "cmaes.h"
 #include "ga.h"
-#include "randomkit.h"
 #include "stats.h"
 #include <getopt.h>
+#include <math.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -33,20 +41,48 @@
 #define MAX_PATH_LENGTH 1000
 
 
+/*
+ * Optimization engines.
+ */
+enum optimizer {
+    OPTIMIZER_GA = 0,
+    OPTIMIZER_CMAES = 1
+};
+
+static const char *const optimizer_names[] = {"ga", "cmaes"};
+
+
 struct arguments {
     char *bounds_path;
     char *data_path;
     char *trials_path;
     char *output_path;
+    char *manifest_path;
     size_t num_iterations;
     size_t max_generations;
     size_t population_size;
     size_t cull_keep;
     double mutate_probability;
     double blx_alpha;
+    enum bt_ode_method integrator;
+    enum bt_plan_precision precision;
+    enum optimizer optimizer;
+    cmaes_options_t cmaes;
+    ga_islands_t islands;
+    ga_stopping_t stopping;
+    bt_refine_options_t refine;
     char *output_integration;
     char *output_population;
     char *output_convergence;
+    enum bt_table_format output_format;
+    char *checkpoint;
+    size_t checkpoint_interval;
+    bool resume;
+    int seed_threads;
+    bool bounded_evaluation;
+    bool profile;
+    bool perf_counters;
+    char *output_trace;
     bool debug;
 };
 
@@ -67,6 +103,7 @@ static void usage(const char *program_name)
         stderr,
         "Usage:\n"
         "  %s [OPTION...] BOUNDS_PATH DATA_PATH TRIALS_PATH OUTPUT_PATH\n"
+        "  %s [OPTION...] --manifest=MANIFEST_PATH\n"
         "\n"
         "Positional arguments:\n"
         "  BOUNDS_PATH  Path to file with bounds and stdevs for model parameters.\n"
@@ -76,6 +113,15 @@ static void usage(const char *program_name)
         "                 where the input is the iteration number.\n"
         "  OUTPUT_PATH  Path to output file for writing optimal designs.\n"
         "\n"
+        "Batch mode:\n"
+        "  -fPATH, --manifest=PATH             Fit every athlete listed in the manifest\n"
+        "                                        file instead. Each line after the header\n"
+        "                                        has tab-separated BOUNDS_PATH, DATA_PATH,\n"
+        "                                        TRIALS_PATH, and OUTPUT_PATH values.\n"
+        "                                        Relative PATTERNs of the extra outputs\n"
+        "                                        are relative to the directory of each\n"
+        "                                        OUTPUT_PATH.\n"
+        "\n"
         "Options:\n"
         "  -nCOUNT, --num-iterations=COUNT     Number of iterations of the genetic\n"
         "                                         algorithm.\n"
@@ -86,6 +132,50 @@ static void usage(const char *program_name)
         "  -mFLOAT, --mutate-probability=FLOAT Probability of mutating each design\n"
         "                                         variable.\n"
         "  -aFLOAT, --blx-alpha=FLOAT          Alpha to use for BLX-alpha crossover.\n"
+        "  -eMETHOD, --integrator=METHOD       Method used to integrate the model: euler\n"
+        "                                        (default), rk4, or adaptive.\n"
+        "  -xMODE, --precision=MODE            Precision of the objective function: double\n"
+        "                                        (default) or mixed. Mixed integrates\n"
+        "                                        the euler method in single precision and\n"
+        "                                        re-scores the elites in double.\n"
+        "  -oNAME, --optimizer=NAME            Optimization engine: ga (default) or\n"
+        "                                        cmaes. CMA-ES samples each generation\n"
+        "                                        from a normal distribution that adapts\n"
+        "                                        to the best designs, starting from the\n"
+        "                                        best of a random population and the\n"
+        "                                        stdevs.\n"
+        "  -lCOUNT, --cmaes-population=COUNT   Number of designs in each generation of\n"
+        "                                        CMA-ES (default 10).\n"
+        "  -rCOUNT, --restarts=COUNT           Number of times CMA-ES restarts with a\n"
+        "                                        doubled population when it converges\n"
+        "                                        (IPOP-CMA-ES, default 0).\n"
+        "  -ICOUNT, --islands=COUNT            Number of islands to split the population\n"
+        "                                        into (default 1). The islands evolve\n"
+        "                                        concurrently.\n"
+        "  -MCOUNT, --migration-interval=COUNT Number of generations between migrations\n"
+        "                                        (default 10).\n"
+        "  -ECOUNT, --migrants=COUNT           Number of the best designs each island\n"
+        "                                        sends to its neighbors (default 2).\n"
+        "  -TNAME, --topology=NAME             Migration topology: ring (default) or\n"
+        "                                        full.\n"
+        "  -sCOUNT, --stall-generations=COUNT  Stop when the best fitness hasn't improved\n"
+        "                                        in COUNT generations (default 0, never).\n"
+        "  -tFLOAT, --stall-epsilon=FLOAT      Smallest change of the best fitness that\n"
+        "                                        counts as an improvement (default 0).\n"
+        "  -qFLOAT, --min-spread=FLOAT         Stop when the interquartile range of the\n"
+        "                                        fitnesses falls below FLOAT (default 0,\n"
+        "                                        never).\n"
+        "  -BCOUNT, --max-evaluations=COUNT    Stop before the number of fitness\n"
+        "                                        evaluations exceeds COUNT (default 0,\n"
+        "                                        unlimited).\n"
+        "  -LCOUNT, --refine-interval=COUNT    Number of generations between local\n"
+        "                                        refinements of the best designs with\n"
+        "                                        gradient steps (default 0, never).\n"
+        "                                        Requires the euler integrator.\n"
+        "  -NCOUNT, --refine-designs=COUNT     Number of the best designs of each island\n"
+        "                                        to refine (default 5).\n"
+        "  -SCOUNT, --refine-steps=COUNT       Maximum number of steps per refined\n"
+        "                                        design (default 20).\n"
         "  -i[PATTERN], --output-integration[=PATTERN]\n"
         "                                      Output the integration of the best design\n"
         "                                        from each iteration. PATTERN specifies\n"
@@ -102,9 +192,43 @@ static void usage(const char *program_name)
         "                                        specifies the names of the files, where\n"
         "                                        %%zd is replaced by the iteration\n"
         "                                        number.\n"
+        "  -FFORMAT, --output-format=FORMAT    Format of the files written by -i, -w,\n"
+        "                                        and -c: tsv (default) or binary. Use\n"
+        "                                        bt_table_tsv to convert binary files\n"
+        "                                        to TSV.\n"
+        "  -C[PATTERN], --checkpoint[=PATTERN] Save the state of each iteration to a\n"
+        "                                        checkpoint file. PATTERN specifies the\n"
+        "                                        names of the files, where %%zd is\n"
+        "                                        replaced by the iteration number.\n"
+        "  -KCOUNT, --checkpoint-interval=COUNT\n"
+        "                                      Number of generations between\n"
+        "                                        checkpoints (default 100). The last\n"
+        "                                        generation is always saved.\n"
+        "  -R, --resume                        Continue each iteration from its\n"
+        "                                        checkpoint, if there is one.\n"
+        "  -jCOUNT, --seed-threads=COUNT       Number of iterations to run concurrently.\n"
+        "                                        The default (0) divides the threads\n"
+        "                                        between iterations and evaluation\n"
+        "                                        automatically.\n"
+        "  -b, --bounded-evaluation            Stop integrating children as soon as they\n"
+        "                                        can't survive culling.\n"
+        "  -P, --profile                       Write the time spent in each phase of the\n"
+        "                                        GA, and by each thread, after each\n"
+        "                                        iteration.\n"
+        "  -H, --perf-counters                 Also count the cycles, instructions, L1\n"
+        "                                        data and last level cache misses, and\n"
+        "                                        branch misses of each phase with\n"
+        "                                        perf_event_open, and write them with\n"
+        "                                        the profile.\n"
+        "  -J[PATTERN], --output-trace[=PATTERN]\n"
+        "                                      Output a Chrome trace (JSON) of the\n"
+        "                                        phases from each iteration. PATTERN\n"
+        "                                        specifies the names of the files, where\n"
+        "                                        %%zd is replaced by the iteration\n"
+        "                                        number.\n"
         "  -d, --debug                         Show debug output.\n"
         "  -h, --help                          Show this message.\n",
-        program_name);
+        program_name, program_name);
     exit(EXIT_FAILURE);
 }
 
@@ -116,27 +240,79 @@ static void parse_arguments(const int argc, char * const argv[], struct argument
     args->data_path = NULL;
     args->trials_path = NULL;
     args->output_path = NULL;
+    args->manifest_path = NULL;
     args->num_iterations = 1;
     args->max_generations = 100;
     args->population_size = 100;
     args->cull_keep = 10;
     args->mutate_probability = 0.1;
     args->blx_alpha = 0.5;
+    args->integrator = BT_ODE_EULER;
+    args->precision = BT_PLAN_DOUBLE;
+    args->optimizer = OPTIMIZER_GA;
+    args->cmaes.nmemb = cmaes_default_nmemb(DESIGN_VAR_COUNT);
+    args->cmaes.max_restarts = 0;
+    args->islands.num_islands = 1;
+    args->islands.migration_interval = 10;
+    args->islands.num_migrants = 2;
+    args->islands.topology = GA_TOPOLOGY_RING;
+    args->stopping.stall_generations = 0;
+    args->stopping.stall_epsilon = 0.;
+    args->stopping.min_spread = 0.;
+    args->stopping.max_evaluations = 0;
+    args->refine.interval = 0;
+    args->refine.num_designs = 5;
+    args->refine.max_steps = 20;
     args->output_integration = NULL;
     args->output_population = NULL;
     args->output_convergence = NULL;
+    args->output_format = BT_TABLE_TSV;
+    args->checkpoint = NULL;
+    args->checkpoint_interval = 100;
+    args->resume = false;
+    args->seed_threads = 0;
+    args->bounded_evaluation = false;
+    args->profile = false;
+    args->perf_counters = false;
+    args->output_trace = NULL;
     args->debug = false;
 
     // Options
     static const struct option long_options[] = {
+        {"manifest", 1, NULL, 'f'},
         {"num-iterations", 1, NULL, 'n'},
         {"max-generations", 1, NULL, 'g'},
         {"population-size", 1, NULL, 'p'},
         {"cull-keep", 1, NULL, 'k'},
         {"mutate-probability", 1, NULL, 'm'},
         {"blx-alpha", 1, NULL, 'a'},
+        {"integrator", 1, NULL, 'e'},
+        {"precision", 1, NULL, 'x'},
+        {"optimizer", 1, NULL, 'o'},
+        {"cmaes-population", 1, NULL, 'l'},
+        {"restarts", 1, NULL, 'r'},
+        {"islands", 1, NULL, 'I'},
+        {"migration-interval", 1, NULL, 'M'},
+        {"migrants", 1, NULL, 'E'},
+        {"topology", 1, NULL, 'T'},
+        {"stall-generations", 1, NULL, 's'},
+        {"stall-epsilon", 1, NULL, 't'},
+        {"min-spread", 1, NULL, 'q'},
+        {"max-evaluations", 1, NULL, 'B'},
+        {"refine-interval", 1, NULL, 'L'},
+        {"refine-designs", 1, NULL, 'N'},
+        {"refine-steps", 1, NULL, 'S'},
         {"output-integration", 2, NULL, 'i'},
         {"output-population", 2, NULL, 'w'},
+        {"output-format", 1, NULL, 'F'},
+        {"checkpoint", 2, NULL, 'C'},
+        {"checkpoint-interval", 1, NULL, 'K'},
+        {"resume", 0, NULL, 'R'},
+        {"seed-threads", 1, NULL, 'j'},
+        {"bounded-evaluation", 0, NULL, 'b'},
+        {"profile", 0, NULL, 'P'},
+        {"perf-counters", 0, NULL, 'H'},
+        {"output-trace", 2, NULL, 'J'},
         {"debug", 0, NULL, 'd'},
         {"help", 0, NULL, 'h'},
         {NULL}
@@ -144,8 +320,11 @@ static void parse_arguments(const int argc, char * const argv[], struct argument
 
     // Parse options
     int c;
-    while ((c = getopt_long(argc, argv, "n:g:p:k:m:a:i::w::c::dh", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "f:n:g:p:k:m:a:e:x:o:l:r:I:M:E:T:s:t:q:B:L:N:S:i::w::c::F:C::K:Rj:bPHJ::dh", long_options, NULL)) != -1) {
         switch (c) {
+        case 'f':
+            args->manifest_path = optarg;
+            break;
         case 'n':
             if (sscanf(optarg, "%zd", &args->num_iterations) != 1)
                 usage(argv[0]);
@@ -170,6 +349,84 @@ static void parse_arguments(const int argc, char * const argv[], struct argument
             if (sscanf(optarg, "%lf", &args->blx_alpha) != 1)
                 usage(argv[0]);
             break;
+        case 'e': {
+            int method = bt_ode_method_from_name(optarg);
+            if (method < 0)
+                usage(argv[0]);
+            args->integrator = method;
+            break;
+        }
+        case 'x': {
+            int precision = bt_plan_precision_from_name(optarg);
+            if (precision < 0)
+                usage(argv[0]);
+            args->precision = precision;
+            break;
+        }
+        case 'o':
+            if (strcmp(optarg, "ga") == 0)
+                args->optimizer = OPTIMIZER_GA;
+            else if (strcmp(optarg, "cmaes") == 0)
+                args->optimizer = OPTIMIZER_CMAES;
+            else
+                usage(argv[0]);
+            break;
+        case 'l':
+            if (sscanf(optarg, "%zd", &args->cmaes.nmemb) != 1)
+                usage(argv[0]);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%zd", &args->cmaes.max_restarts) != 1)
+                usage(argv[0]);
+            break;
+        case 'I':
+            if (sscanf(optarg, "%zd", &args->islands.num_islands) != 1)
+                usage(argv[0]);
+            break;
+        case 'M':
+            if (sscanf(optarg, "%zd", &args->islands.migration_interval) != 1)
+                usage(argv[0]);
+            break;
+        case 'E':
+            if (sscanf(optarg, "%zd", &args->islands.num_migrants) != 1)
+                usage(argv[0]);
+            break;
+        case 'T':
+            if (strcmp(optarg, "ring") == 0)
+                args->islands.topology = GA_TOPOLOGY_RING;
+            else if (strcmp(optarg, "full") == 0)
+                args->islands.topology = GA_TOPOLOGY_FULL;
+            else
+                usage(argv[0]);
+            break;
+        case 's':
+            if (sscanf(optarg, "%zd", &args->stopping.stall_generations) != 1)
+                usage(argv[0]);
+            break;
+        case 't':
+            if (sscanf(optarg, "%lf", &args->stopping.stall_epsilon) != 1)
+                usage(argv[0]);
+            break;
+        case 'q':
+            if (sscanf(optarg, "%lf", &args->stopping.min_spread) != 1)
+                usage(argv[0]);
+            break;
+        case 'B':
+            if (sscanf(optarg, "%zd", &args->stopping.max_evaluations) != 1)
+                usage(argv[0]);
+            break;
+        case 'L':
+            if (sscanf(optarg, "%zd", &args->refine.interval) != 1)
+                usage(argv[0]);
+            break;
+        case 'N':
+            if (sscanf(optarg, "%zd", &args->refine.num_designs) != 1)
+                usage(argv[0]);
+            break;
+        case 'S':
+            if (sscanf(optarg, "%zd", &args->refine.max_steps) != 1)
+                usage(argv[0]);
+            break;
         case 'i':
             if (optarg)
                 args->output_integration = optarg;
@@ -188,6 +445,42 @@ static void parse_arguments(const int argc, char * const argv[], struct argument
             else
                 args->output_convergence = "convergence%04zd.tsv";
             break;
+        case 'F':
+            if (bt_table_parse_format(optarg, &args->output_format) != 0)
+                usage(argv[0]);
+            break;
+        case 'C':
+            if (optarg)
+                args->checkpoint = optarg;
+            else
+                args->checkpoint = "checkpoint%04zd.bin";
+            break;
+        case 'K':
+            if (sscanf(optarg, "%zd", &args->checkpoint_interval) != 1)
+                usage(argv[0]);
+            break;
+        case 'R':
+            args->resume = true;
+            break;
+        case 'j':
+            if (sscanf(optarg, "%d", &args->seed_threads) != 1)
+                usage(argv[0]);
+            break;
+        case 'b':
+            args->bounded_evaluation = true;
+            break;
+        case 'P':
+            args->profile = true;
+            break;
+        case 'H':
+            args->perf_counters = true;
+            break;
+        case 'J':
+            if (optarg)
+                args->output_trace = optarg;
+            else
+                args->output_trace = "trace%04zd.json";
+            break;
         case 'd':
             args->debug = true;
             break;
@@ -201,8 +494,10 @@ static void parse_arguments(const int argc, char * const argv[], struct argument
     }
 
     // Parse positional args
-    static const int num_required_positional_args = 4;
-    if (argc - optind == num_required_positional_args) {
+    const int num_required_positional_args = args->manifest_path ? 0 : 4;
+    if (argc - optind == num_required_positional_args && args->manifest_path) {
+        return;
+    } else if (argc - optind == num_required_positional_args) {
         args->bounds_path = argv[optind++];
         args->data_path = argv[optind++];
         args->trials_path = argv[optind++];
@@ -223,202 +518,1072 @@ void fprintf_arguments(FILE *stream, struct arguments *args)
     fprintf(stream, "DATA_PATH = %s\n", args->data_path);
     fprintf(stream, "TRIALS_PATH = %s\n", args->trials_path);
     fprintf(stream, "OUTPUT_PATH = %s\n", args->output_path);
+    fprintf(stream, "manifest = %s\n", args->manifest_path);
     fprintf(stream, "num-iterations = %zd\n", args->num_iterations);
     fprintf(stream, "max-generations = %zd\n", args->max_generations);
     fprintf(stream, "population-size = %zd\n", args->population_size);
     fprintf(stream, "cull-keep = %zd\n", args->cull_keep);
     fprintf(stream, "mutate-probability = %lf\n", args->mutate_probability);
     fprintf(stream, "blx-alpha = %lf\n", args->blx_alpha);
+    fprintf(stream, "integrator = %s\n", bt_ode_method_names[args->integrator]);
+    fprintf(stream, "precision = %s\n", bt_plan_precision_names[args->precision]);
+    fprintf(stream, "optimizer = %s\n", optimizer_names[args->optimizer]);
+    fprintf(stream, "cmaes-population = %zd\n", args->cmaes.nmemb);
+    fprintf(stream, "restarts = %zd\n", args->cmaes.max_restarts);
+    fprintf(stream, "islands = %zd\n", args->islands.num_islands);
+    fprintf(stream, "migration-interval = %zd\n", args->islands.migration_interval);
+    fprintf(stream, "migrants = %zd\n", args->islands.num_migrants);
+    fprintf(stream, "topology = %s\n",
+            args->islands.topology == GA_TOPOLOGY_RING ? "ring" : "full");
+    fprintf(stream, "stall-generations = %zd\n", args->stopping.stall_generations);
+    fprintf(stream, "stall-epsilon = %lf\n", args->stopping.stall_epsilon);
+    fprintf(stream, "min-spread = %lf\n", args->stopping.min_spread);
+    fprintf(stream, "max-evaluations = %zd\n", args->stopping.max_evaluations);
+    fprintf(stream, "refine-interval = %zd\n", args->refine.interval);
+    fprintf(stream, "refine-designs = %zd\n", args->refine.num_designs);
+    fprintf(stream, "refine-steps = %zd\n", args->refine.max_steps);
     fprintf(stream, "output-integration = %s\n", args->output_integration);
     fprintf(stream, "output-population = %s\n", args->output_population);
     fprintf(stream, "output-convergence = %s\n", args->output_convergence);
+    fprintf(stream, "output-format = %s\n",
+            args->output_format == BT_TABLE_TSV ? "tsv" : "binary");
+    fprintf(stream, "checkpoint = %s\n", args->checkpoint);
+    fprintf(stream, "checkpoint-interval = %zd\n", args->checkpoint_interval);
+    fprintf(stream, "resume = %d\n", args->resume);
+    fprintf(stream, "seed-threads = %d\n", args->seed_threads);
+    fprintf(stream, "bounded-evaluation = %d\n", args->bounded_evaluation);
+    fprintf(stream, "profile = %d\n", args->profile);
+    fprintf(stream, "perf-counters = %d\n", args->perf_counters);
+    fprintf(stream, "output-trace = %s\n", args->output_trace);
     fprintf(stream, "debug = %d\n", args->debug);
 }
 
 
-void run_ga(design_var_t best_design[], fitness_t *best_mean_abs_residual,
+/*
+ * Runs one generation of the GA on one island, i.e. a contiguous slice of
+ * the population, drawing random numbers from the children of key. The time
+ * of each step is recorded in profile, which may be NULL. If refine isn't
+ * NULL, the best designs are refined after culling, and refine_evaluations
+ * is set to the number of evaluations that took (0 otherwise). Returns the
+ * number of integration intervals skipped by bounded evaluation.
+ */
+static size_t evolve_island(const size_t population_size, const size_t cull_keep,
+                            design_var_t (*designs)[DESIGN_VAR_COUNT], fitness_t fitnesses[],
+                            size_t winners[], design_var_t (*children)[DESIGN_VAR_COUNT],
+                            fitness_t child_fitnesses[], const double mutate_probability,
+                            const double blx_alpha, const bt_design_bounds_t *bt_design_bounds,
+                            const bt_plan_t *plan, const bool bounded_evaluation,
+                            const bt_refine_options_t *refine, const uint64_t key,
+                            size_t *refine_evaluations, bt_profile_t *profile)
+{
+    size_t skipped_intervals = 0;
+    *refine_evaluations = 0;
+    bt_profile_mark_t start = bt_profile_now(profile);
+    ga_tournament_select(population_size, fitnesses,
+                         population_size, winners,
+                         rng_stream_key(key, GA_STREAM_SELECT));
+    bt_profile_record(profile, BT_PROFILE_SELECT, start);
+    start = bt_profile_now(profile);
+    ga_blx_alpha(population_size, DESIGN_VAR_COUNT, designs, winners,
+                 children, blx_alpha, rng_stream_key(key, GA_STREAM_CROSSOVER));
+    bt_profile_record(profile, BT_PROFILE_CROSSOVER, start);
+    start = bt_profile_now(profile);
+    ga_mutate(population_size, DESIGN_VAR_COUNT, children,
+              bt_design_bounds->stdevs, mutate_probability,
+              rng_stream_key(key, GA_STREAM_MUTATE));
+    bt_profile_record(profile, BT_PROFILE_MUTATE, start);
+    start = bt_profile_now(profile);
+    if (bounded_evaluation && cull_keep > 0 && cull_keep < population_size) {
+        // Only the best (population_size - cull_keep) children survive
+        // culling, so once that many have been evaluated, any child
+        // worse than all of them can be rejected early.
+        const size_t num_survivors = population_size - cull_keep;
+        bt_model_update_fitnesses(num_survivors, children, child_fitnesses, NULL, plan, profile);
+        const fitness_t threshold = child_fitnesses[stats_min_index(child_fitnesses, num_survivors)];
+        skipped_intervals += bt_model_update_fitnesses_bounded(
+            cull_keep, children + num_survivors, child_fitnesses + num_survivors,
+            NULL, plan, threshold, profile);
+    } else {
+        bt_model_update_fitnesses(population_size, children, child_fitnesses, NULL, plan,
+                                  profile);
+    }
+    bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+    start = bt_profile_now(profile);
+    ga_cull(population_size, DESIGN_VAR_COUNT,
+            designs, fitnesses, cull_keep,
+            children, child_fitnesses);
+    bt_profile_record(profile, BT_PROFILE_CULL, start);
+    if (plan->precision == BT_PLAN_MIXED) {
+        // The elites are kept at the start of the population. Re-score them
+        // in double precision, so that single precision rounding can't keep
+        // a design alive for generations.
+        start = bt_profile_now(profile);
+        bt_model_rescore_fitnesses(cull_keep, designs, fitnesses, plan);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+    }
+    if (refine) {
+        start = bt_profile_now(profile);
+        *refine_evaluations = bt_refine_best_designs(population_size, designs, fitnesses,
+                                                     refine, plan);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+    }
+    return skipped_intervals;
+}
+
+
+/*
+ * Saves the state of a run after the given number of generations. A failure
+ * is reported but doesn't stop the run.
+ */
+static void save_checkpoint(const char *path, const unsigned long random_seed,
+                            const size_t population_size, const size_t num_islands,
+                            const size_t generation, const size_t num_evaluations,
+                            const size_t skipped_intervals,
+                            const enum ga_stop_reason stop_reason,
+                            const ga_progress_t *progress,
+                            design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                            const fitness_t fitnesses[], const bt_convergence_t *conv_log)
+{
+    bt_checkpoint_t *checkpoint = bt_checkpoint_create(path);
+    if (checkpoint == NULL) {
+        fprintf(stderr, "Unable to create checkpoint file: %s.\n", path);
+        return;
+    }
+    bt_checkpoint_put_size(checkpoint, random_seed);
+    bt_checkpoint_put_size(checkpoint, population_size);
+    bt_checkpoint_put_size(checkpoint, DESIGN_VAR_COUNT);
+    bt_checkpoint_put_size(checkpoint, num_islands);
+    bt_checkpoint_put_size(checkpoint, generation);
+    bt_checkpoint_put_size(checkpoint, num_evaluations);
+    bt_checkpoint_put_size(checkpoint, skipped_intervals);
+    bt_checkpoint_put_size(checkpoint, stop_reason);
+    bt_checkpoint_put_size(checkpoint, progress->best_generation);
+    bt_checkpoint_put_doubles(checkpoint, 1, &progress->best_fitness);
+    bt_checkpoint_put_doubles(checkpoint, population_size * DESIGN_VAR_COUNT, designs[0]);
+    bt_checkpoint_put_doubles(checkpoint, population_size, fitnesses);
+    const size_t num_rows = conv_log ? conv_log->num_rows : 0;
+    bt_checkpoint_put_size(checkpoint, num_rows);
+    bt_checkpoint_put_doubles(checkpoint, num_rows * BT_CONVERGENCE_NUM_COLUMNS,
+                              conv_log ? conv_log->rows : NULL);
+    if (bt_checkpoint_commit(checkpoint) != 0)
+        fprintf(stderr, "Unable to write checkpoint file: %s.\n", path);
+}
+
+
+/*
+ * Restores the state of a run from a checkpoint, appending its convergence
+ * rows to conv_log (if it isn't NULL). Sets generation to the number of
+ * generations that were run, or 0 if there's no checkpoint, and
+ * num_evaluations to the number of evaluations so far. If the run was
+ * stopped early, stop_reason is set to the reason. Returns 0 on success, or 1
+ * (after writing an error message) if the checkpoint doesn't match the run
+ * or can't be parsed.
+ */
+static int load_checkpoint(const char *path, const unsigned long random_seed,
+                           const size_t population_size, const size_t num_islands,
+                           const size_t max_generations, size_t *generation,
+                           size_t *num_evaluations, size_t *skipped_intervals,
+                           enum ga_stop_reason *stop_reason,
+                           ga_progress_t *progress, design_var_t (*designs)[DESIGN_VAR_COUNT],
+                           fitness_t fitnesses[], bt_convergence_t *conv_log)
+{
+    *generation = 0;
+    bt_checkpoint_t *checkpoint = bt_checkpoint_open(path);
+    if (checkpoint == NULL)
+        return 0;
+    const bool matches = bt_checkpoint_get_size(checkpoint) == random_seed
+        && bt_checkpoint_get_size(checkpoint) == population_size
+        && bt_checkpoint_get_size(checkpoint) == DESIGN_VAR_COUNT
+        && bt_checkpoint_get_size(checkpoint) == num_islands;
+    const size_t num_generations = bt_checkpoint_get_size(checkpoint);
+    if (!matches || num_generations > max_generations) {
+        bt_checkpoint_close(checkpoint);
+        fprintf(stderr, "Checkpoint file %s doesn't match the arguments.\n", path);
+        return 1;
+    }
+    *num_evaluations = bt_checkpoint_get_size(checkpoint);
+    *skipped_intervals = bt_checkpoint_get_size(checkpoint);
+    const size_t reason = bt_checkpoint_get_size(checkpoint);
+    if (reason > GA_STOP_BUDGET)
+        checkpoint->failed = true;
+    *stop_reason = checkpoint->failed ? GA_STOP_MAX_GENERATIONS : reason;
+    progress->best_generation = bt_checkpoint_get_size(checkpoint);
+    bt_checkpoint_get_doubles(checkpoint, 1, &progress->best_fitness);
+    bt_checkpoint_get_doubles(checkpoint, population_size * DESIGN_VAR_COUNT, designs[0]);
+    bt_checkpoint_get_doubles(checkpoint, population_size, fitnesses);
+    size_t num_rows = bt_checkpoint_get_size(checkpoint);
+    if (num_rows > num_generations) {
+        checkpoint->failed = true;
+        num_rows = 0;
+    }
+    double *rows = malloc((num_rows > 0 ? num_rows : 1) * BT_CONVERGENCE_NUM_COLUMNS * sizeof(double));
+    bt_checkpoint_get_doubles(checkpoint, num_rows * BT_CONVERGENCE_NUM_COLUMNS, rows);
+    if (bt_checkpoint_close(checkpoint) != 0) {
+        free(rows);
+        fprintf(stderr, "Unable to parse checkpoint file: %s.\n", path);
+        return 1;
+    }
+    if (conv_log)
+        bt_convergence_restore(conv_log, num_rows, rows);
+    free(rows);
+    *generation = num_generations;
+    return 0;
+}
+
+
+/*
+ * Starts profiling a run, if requested, and sets profile to NULL otherwise, so
+ * the timing calls do nothing. Returns 0 on success, or 1 (after writing an
+ * error message) if the trace file can't be opened.
+ */
+static int start_profile(bt_profile_t **profile, const unsigned long random_seed,
+                         const bool profile_summary, const bool perf_counters,
+                         const char *output_trace)
+{
+    *profile = NULL;
+    if (!profile_summary && !perf_counters && !output_trace)
+        return 0;
+    char trace_path[MAX_PATH_LENGTH];
+    if (output_trace)
+        snprintf(trace_path, MAX_PATH_LENGTH, output_trace, random_seed);
+    *profile = bt_profile_create(random_seed, output_trace ? trace_path : NULL, perf_counters);
+    if (*profile == NULL) {
+        fprintf(stderr, "Unable to open trace file: %s.\n", trace_path);
+        return 1;
+    }
+    if (perf_counters && !(*profile)->perf_counters)
+        fprintf(stderr, "Unable to open performance counters for seed %lu.\n", random_seed);
+    return 0;
+}
+
+
+/*
+ * Opens the convergence file of a run, if requested, and sets conv_log to
+ * NULL otherwise. Returns 0 on success, or 1 (after writing an error
+ * message) if the file can't be opened.
+ */
+static int open_convergence(bt_convergence_t **conv_log, const unsigned long random_seed,
+                            const char *output_convergence,
+                            const enum bt_table_format output_format)
+{
+    *conv_log = NULL;
+    if (!output_convergence)
+        return 0;
+    char conv_path[MAX_PATH_LENGTH];
+    snprintf(conv_path, MAX_PATH_LENGTH, output_convergence, random_seed);
+    if ((*conv_log = bt_convergence_open(conv_path, output_format)) == NULL) {
+        fprintf(stderr, "Unable to open convergence file: %s.\n", conv_path);
+        return 1;
+    }
+    return 0;
+}
+
+
+/*
+ * Writes the designs and their mean absolute residuals to the population
+ * file of a run. Returns 0 on success, or 1 (after writing an error message)
+ * if the file can't be opened.
+ */
+static int write_population(const char *output_population, const unsigned long random_seed,
+                            const enum bt_table_format output_format, const size_t nmemb,
+                            design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                            const bt_plan_t *plan)
+{
+    char pop_path[MAX_PATH_LENGTH];
+    snprintf(pop_path, MAX_PATH_LENGTH, output_population, random_seed);
+    FILE *pop_file = fopen(pop_path, "w");
+    if (pop_file == NULL) {
+        fprintf(stderr, "Unable to open population file: %s.\n", pop_path);
+        return 1;
+    }
+    fitness_t *mean_abs_residuals = malloc(nmemb * sizeof(fitness_t));
+    bt_model_update_fitnesses(nmemb, designs, NULL, mean_abs_residuals, plan, NULL);
+    bt_model_fprint_designs(pop_file, output_format, nmemb, designs, mean_abs_residuals);
+    free(mean_abs_residuals);
+    fclose(pop_file);
+    return 0;
+}
+
+
+/*
+ * Writes the integration of a design to the integration file of a run.
+ * Returns 0 on success, or 1 (after writing an error message) if the file
+ * can't be opened.
+ */
+static int write_integration(const char *output_integration, const unsigned long random_seed,
+                             const enum bt_table_format output_format,
+                             const design_var_t design[], const bt_data_t *bt_data,
+                             const enum bt_ode_method integrator)
+{
+    char integ_path[MAX_PATH_LENGTH];
+    snprintf(integ_path, MAX_PATH_LENGTH, output_integration, random_seed);
+    FILE *integ_file = fopen(integ_path, "w");
+    if (integ_file == NULL) {
+        fprintf(stderr, "Unable to open integration file: %s.\n", integ_path);
+        return 1;
+    }
+    bt_data_t *integ_data = bt_data_copy(bt_data);
+    bt_model_integrate(design, integ_data, integrator);
+    bt_data_write(integ_file, output_format, integ_data);
+    bt_data_free(integ_data);
+    fclose(integ_file);
+    return 0;
+}
+
+
+/*
+ * Runs the GA for one iteration, writing its extra outputs. Returns 0 on
+ * success, or 1 (after writing an error message) if a file couldn't be
+ * opened or the checkpoint couldn't be restored, in which case the results
+ * aren't set.
+ */
+int run_ga(design_var_t best_design[], fitness_t *best_mean_abs_residual,
+            size_t *num_generations, enum ga_stop_reason *stop_reason,
             const size_t max_generations, const size_t population_size,
             const size_t cull_keep, const double mutate_probability,
-            const double blx_alpha, const bt_design_bounds_t *bt_design_bounds,
+            const double blx_alpha, const enum bt_ode_method integrator,
+            const enum bt_plan_precision precision,
+            const ga_islands_t *islands, const ga_stopping_t *stopping,
+            const bt_refine_options_t *refine,
+            const bt_design_bounds_t *bt_design_bounds,
             const bt_data_t *bt_data, const bt_trials_t *bt_trials,
             const unsigned long random_seed, const char *output_integration,
             const char *output_population, const char *output_convergence,
-            const bool debug)
+            const enum bt_table_format output_format, const char *checkpoint,
+            const size_t checkpoint_interval, const bool resume,
+            const bool bounded_evaluation, const bool profile_summary,
+            const bool perf_counters, const char *output_trace, const bool debug)
 {
+    const size_t num_islands = islands->num_islands;
+
+    // Start profiling, if requested, and open the convergence file.
+    bt_profile_t *profile;
+    if (start_profile(&profile, random_seed, profile_summary, perf_counters, output_trace) != 0)
+        return 1;
+    bt_profile_mark_t start = bt_profile_now(profile);
+    bt_convergence_t *conv_log;
+    if (open_convergence(&conv_log, random_seed, output_convergence, output_format) != 0) {
+        bt_profile_close(profile);
+        return 1;
+    }
+
     // Allocate objects
     design_var_t (*designs)[DESIGN_VAR_COUNT] = malloc(population_size * DESIGN_VAR_COUNT * sizeof(design_var_t));
     fitness_t *fitnesses = malloc(population_size * sizeof(fitness_t));
-    rk_state *rng = malloc(sizeof(rk_state));
+
+    // Restore the state from the checkpoint, if there is one. The random
+    // streams only depend on the generation, so the run continues exactly as
+    // if it hadn't been interrupted.
+    char checkpoint_path[MAX_PATH_LENGTH];
+    if (checkpoint)
+        snprintf(checkpoint_path, MAX_PATH_LENGTH, checkpoint, random_seed);
+    size_t skipped_intervals = 0;
+    size_t first_generation = 0;
+    size_t num_evaluations = population_size;
+    enum ga_stop_reason reason = GA_STOP_MAX_GENERATIONS;
+    ga_progress_t progress;
+    ga_progress_init(&progress);
+    if (checkpoint && resume
+        && load_checkpoint(checkpoint_path, random_seed, population_size, num_islands,
+                           max_generations, &first_generation, &num_evaluations,
+                           &skipped_intervals, &reason, &progress, designs, fitnesses,
+                           conv_log) != 0) {
+        bt_convergence_close(conv_log);
+        bt_profile_close(profile);
+        free(fitnesses);
+        free(designs);
+        return 1;
+    }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+    const size_t first_skipped_intervals = skipped_intervals;
 
     // Temporary variables for the GA
     size_t *winners = malloc(population_size * sizeof(size_t));
     design_var_t (*children)[DESIGN_VAR_COUNT] = malloc(population_size * DESIGN_VAR_COUNT * sizeof(design_var_t));
     fitness_t *child_fitnesses = malloc(population_size * sizeof(fitness_t));
+    bt_plan_t *plan = bt_plan_compile(bt_data, bt_trials, integrator, precision);
+    const bool mixed_precision = plan->precision == BT_PLAN_MIXED;
 
-    // Initialize objects
-    rk_seed(random_seed, rng);
-    init_random_population(population_size, DESIGN_VAR_COUNT, designs,
-                           bt_design_bounds->lower_bounds, bt_design_bounds->upper_bounds, rng);
-    bt_model_update_fitnesses(population_size, designs, fitnesses, NULL, bt_data, bt_trials);
+    // Split the population into islands of (nearly) equal size, each with its
+    // own share of the kept parents. With one island, this is the whole
+    // population.
+    size_t island_offsets[num_islands + 1];
+    size_t island_cull_keeps[num_islands];
+    for (size_t k = 0; k <= num_islands; k++)
+        island_offsets[k] = k * population_size / num_islands;
+    size_t max_refine_evaluations = 0;
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t size = island_offsets[k+1] - island_offsets[k];
+        island_cull_keeps[k] = cull_keep * size / population_size;
+        max_refine_evaluations += bt_refine_max_evaluations(size, refine);
+    }
 
-    // Open convergence file
-    FILE *conv_file = NULL;
-    if (output_convergence) {
-        char conv_path[MAX_PATH_LENGTH];
-        snprintf(conv_path, MAX_PATH_LENGTH, output_convergence, random_seed);
-        if ((conv_file = fopen(conv_path, "w")) == NULL)
-            fail("Unable to open convergence file: %s.\n", conv_path);
-        fprintf(conv_file, "generation\tmin\tq1\tmedian\tq3\tmax\n");
+    // Initialize objects. The random streams are keyed by the seed, then the
+    // generation (0 for the initial population), then the island, so the
+    // results don't depend on the number of threads.
+    const uint64_t seed_key = rng_stream_key(0, random_seed);
+    const uint64_t init_key = rng_stream_key(seed_key, 0);
+    if (first_generation == 0) {
+        for (size_t k = 0; k < num_islands; k++) {
+            init_random_population(island_offsets[k+1] - island_offsets[k], DESIGN_VAR_COUNT,
+                                   designs + island_offsets[k], bt_design_bounds->lower_bounds,
+                                   bt_design_bounds->upper_bounds,
+                                   rng_stream_key(rng_stream_key(init_key, k), GA_STREAM_INIT));
+        }
+        start = bt_profile_now(profile);
+        bt_model_update_fitnesses(population_size, designs, fitnesses, NULL, plan, profile);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
     }
 
-    // Run the GA
-    for (ssize_t i = 0; i < max_generations; i++) {
+    // Run the GA. The islands evolve independently between migrations, so
+    // they can run concurrently. The stopping criteria are checked before each
+    // generation, and the population that met them is saved.
+    size_t generations_run = first_generation;
+    for (ssize_t i = first_generation; i < max_generations && reason == GA_STOP_MAX_GENERATIONS; i++) {
+        const bt_profile_mark_t generation_start = bt_profile_now(profile);
+        start = generation_start;
+        const bool refine_generation = refine->interval > 0 && (i+1) % refine->interval == 0;
+        reason = ga_check_stop(stopping, &progress, i, num_evaluations,
+                               population_size, fitnesses);
+        if (reason == GA_STOP_MAX_GENERATIONS && refine_generation
+            && stopping->max_evaluations > 0
+            && num_evaluations + population_size + max_refine_evaluations
+               > stopping->max_evaluations) {
+            // Refinement may also take up to max_refine_evaluations.
+            reason = GA_STOP_BUDGET;
+        }
+        if (reason != GA_STOP_MAX_GENERATIONS) {
+            bt_profile_record(profile, BT_PROFILE_STATS, start);
+            start = bt_profile_now(profile);
+            if (checkpoint) {
+                save_checkpoint(checkpoint_path, random_seed, population_size, num_islands,
+                                i, num_evaluations, skipped_intervals, reason, &progress,
+                                designs, fitnesses, conv_log);
+            }
+            bt_profile_record(profile, BT_PROFILE_IO, start);
+            break;
+        }
         if (debug) {
             fprintf(stderr, "Seed %lu, Generation %zd:\t", random_seed, i+1);
             fprintf_fitness_summary(stderr, population_size, fitnesses);
             fprintf(stderr, "\n");
         }
-        if (output_convergence) {
-            fprintf(conv_file, "%zd\t", i+1);
-            fprintf_fitness_quartiles(conv_file, population_size, fitnesses);
-            fprintf(conv_file, "\n");
+        if (output_convergence)
+            bt_convergence_write(conv_log, i+1, population_size, fitnesses);
+        bt_profile_record(profile, BT_PROFILE_STATS, start);
+        const uint64_t generation_key = rng_stream_key(seed_key, i+1);
+        size_t refine_evaluations = 0;
+        #pragma omp parallel for schedule(dynamic, 1) if(num_islands > 1) reduction(+:skipped_intervals, refine_evaluations)
+        for (size_t k = 0; k < num_islands; k++) {
+            const size_t offset = island_offsets[k];
+            size_t island_refine_evaluations;
+            skipped_intervals += evolve_island(
+                island_offsets[k+1] - offset, island_cull_keeps[k],
+                designs + offset, fitnesses + offset, winners + offset,
+                children + offset, child_fitnesses + offset,
+                mutate_probability, blx_alpha, bt_design_bounds, plan,
+                bounded_evaluation, refine_generation ? refine : NULL,
+                rng_stream_key(generation_key, k), &island_refine_evaluations, profile);
+            refine_evaluations += island_refine_evaluations;
+        }
+        num_evaluations += population_size + refine_evaluations;
+        if (islands->migration_interval > 0 && (i+1) % islands->migration_interval == 0) {
+            start = bt_profile_now(profile);
+            ga_migrate(DESIGN_VAR_COUNT, islands, island_offsets, designs, fitnesses);
+            bt_profile_record(profile, BT_PROFILE_MIGRATE, start);
         }
-        ga_tournament_select(population_size, fitnesses,
-                             population_size, winners, rng);
-        ga_blx_alpha(population_size, DESIGN_VAR_COUNT, designs, winners,
-                     children, blx_alpha, rng);
-        ga_mutate(population_size, DESIGN_VAR_COUNT, children,
-                  bt_design_bounds->stdevs, mutate_probability, rng);
-        bt_model_update_fitnesses(population_size, children, child_fitnesses, NULL, bt_data, bt_trials);
-        ga_cull(population_size, DESIGN_VAR_COUNT,
-                designs, fitnesses, cull_keep,
-                children, child_fitnesses);
+        if (checkpoint && ((checkpoint_interval > 0 && (i+1) % checkpoint_interval == 0)
+                           || i+1 == max_generations)) {
+            start = bt_profile_now(profile);
+            save_checkpoint(checkpoint_path, random_seed, population_size, num_islands,
+                            i+1, num_evaluations, skipped_intervals, reason, &progress,
+                            designs, fitnesses, conv_log);
+            bt_profile_record(profile, BT_PROFILE_IO, start);
+        }
+        bt_profile_record_generation(profile, i+1, generation_start);
+        generations_run = i+1;
     }
+    *num_generations = generations_run;
+    *stop_reason = reason;
 
     // Close convergence file
+    start = bt_profile_now(profile);
     if (output_convergence) {
-        fclose(conv_file);
+        bt_convergence_close(conv_log);
+    }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+
+    if (debug && reason != GA_STOP_MAX_GENERATIONS) {
+        fprintf(stderr, "Seed %lu: stopped after %zd generations (%s)\n",
+                random_seed, generations_run, ga_stop_reason_names[reason]);
+    }
+    if (debug && bounded_evaluation) {
+        fprintf(stderr, "Seed %lu: skipped %zd of %zd integration intervals\n",
+                random_seed, skipped_intervals,
+                generations_run * population_size * plan->num_records);
+    }
+
+    // Score the final population in double precision, so that the best design
+    // and the written population don't depend on mixed precision rounding.
+    if (mixed_precision) {
+        start = bt_profile_now(profile);
+        plan->precision = BT_PLAN_DOUBLE;
+        bt_model_update_fitnesses(population_size, designs, fitnesses, NULL, plan, profile);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
     }
 
     // Copy the best design to the output variables
+    start = bt_profile_now(profile);
     size_t best_index = stats_max_index(fitnesses, population_size);
-    design_var_t min_error = bt_model_calculate_error(designs[best_index], bt_data, bt_trials);
+    design_var_t min_error = bt_model_calculate_error(designs[best_index], plan);
     memcpy(best_design, designs[best_index], sizeof(design_var_t[DESIGN_VAR_COUNT]));
     *best_mean_abs_residual = min_error / bt_trials->size;
+    bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
 
-    // Write final population.
-    if (output_population) {
-        char pop_path[MAX_PATH_LENGTH];
-        snprintf(pop_path, MAX_PATH_LENGTH, output_population, random_seed);
-        FILE *pop_file = fopen(pop_path, "w");
-        fitness_t mean_abs_residuals[population_size];
-        bt_model_update_fitnesses(population_size, designs, NULL,
-                                  mean_abs_residuals, bt_data, bt_trials);
-        bt_model_fprint_designs(pop_file, population_size, designs, mean_abs_residuals);
-        fclose(pop_file);
-    }
-
-    // Write integration of best design.
-    if (output_integration) {
-        bt_data_t *integ_data = bt_data_copy(bt_data);
-        bt_model_integrate(designs[best_index], integ_data);
-        char integ_path[MAX_PATH_LENGTH];
-        snprintf(integ_path, MAX_PATH_LENGTH, output_integration, random_seed);
-        FILE *integ_file = fopen(integ_path, "w");
-        bt_data_write(integ_file, integ_data);
-        fclose(integ_file);
+    // Write final population and integration of best design.
+    start = bt_profile_now(profile);
+    int status = 0;
+    if (output_population)
+        status |= write_population(output_population, random_seed, output_format,
+                                   population_size, designs, plan);
+    if (output_integration)
+        status |= write_integration(output_integration, random_seed, output_format,
+                                    designs[best_index], bt_data, integrator);
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+
+    // Finish the profile.
+    if (profile_summary || perf_counters) {
+        const size_t num_evaluations = (first_generation == 0) + mixed_precision
+                                       + generations_run - first_generation;
+        bt_profile_fprint_summary(stderr, profile,
+                                  num_evaluations * population_size * plan->num_records
+                                  - (skipped_intervals - first_skipped_intervals));
     }
+    if (bt_profile_close(profile) != 0)
+        fprintf(stderr, "Unable to write trace file for seed %lu.\n", random_seed);
 
     // Free objects
+    bt_plan_free(plan);
     free(child_fitnesses);
     free(children);
     free(winners);
-    free(rng);
     free(fitnesses);
     free(designs);
+    return status;
 }
 
 
-int main(int argc, char *argv[])
+/*
+ * Runs CMA-ES instead of the GA, with the same outputs as run_ga(). Much of
+ * the bounds can be infeasible, so the search starts from the best of
+ * init_population_size random designs within the bounds, with the bounds'
+ * standard deviations. When it converges, it restarts from the best of a new
+ * random population with twice as many designs per generation, up to
+ * cmaes->max_restarts times. The stall and spread criteria of stopping end a
+ * search in the same way. The written population is the last generation's
+ * samples. Returns 0 on success, or 1 (after writing an error message) if a
+ * file couldn't be opened, in which case the results aren't set.
+ */
+int run_cmaes(design_var_t best_design[], fitness_t *best_mean_abs_residual,
+               size_t *num_generations, enum ga_stop_reason *stop_reason,
+               const size_t max_generations, const size_t init_population_size,
+               const cmaes_options_t *cmaes,
+               const enum bt_ode_method integrator, const enum bt_plan_precision precision,
+               const ga_stopping_t *stopping, const bt_design_bounds_t *bt_design_bounds,
+               const bt_data_t *bt_data, const bt_trials_t *bt_trials,
+               const unsigned long random_seed, const char *output_integration,
+               const char *output_population, const char *output_convergence,
+               const enum bt_table_format output_format, const bool profile_summary,
+               const bool perf_counters, const char *output_trace, const bool debug)
 {
-    // Parse the arguments.
-    struct arguments args;
-    parse_arguments(argc, argv, &args);
-    if (args.debug) {
-        fprintf(stderr, "Using arguments:\n");
-        fprintf_arguments(stderr, &args);
-        fprintf(stderr, "\n");
+    // Start profiling, if requested, and open the convergence file.
+    bt_profile_t *profile;
+    if (start_profile(&profile, random_seed, profile_summary, perf_counters, output_trace) != 0)
+        return 1;
+    bt_profile_mark_t start = bt_profile_now(profile);
+    bt_convergence_t *conv_log;
+    if (open_convergence(&conv_log, random_seed, output_convergence, output_format) != 0) {
+        bt_profile_close(profile);
+        return 1;
     }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+    bt_plan_t *plan = bt_plan_compile(bt_data, bt_trials, integrator, precision);
+
+    // Run CMA-ES. The random streams are keyed by the seed and the
+    // generation, like those of the GA.
+    const uint64_t seed_key = rng_stream_key(0, random_seed);
+    size_t nmemb = cmaes->nmemb;
+    cmaes_t *es = NULL;
+    design_var_t (*designs)[DESIGN_VAR_COUNT] = NULL;
+    fitness_t *fitnesses = NULL;
+    design_var_t (*init_designs)[DESIGN_VAR_COUNT] = malloc(init_population_size * sizeof(*init_designs));
+    fitness_t *init_fitnesses = malloc(init_population_size * sizeof(fitness_t));
+    fitness_t best_fitness = -INFINITY;
+    size_t num_restarts = 0;
+    size_t num_evaluations = 0;
+    size_t generations_run = 0;
+    bool restart = true;
+    enum ga_stop_reason reason = GA_STOP_MAX_GENERATIONS;
+    ga_progress_t progress;
+    ga_progress_init(&progress);
+    for (size_t i = 0; i < max_generations; i++) {
+        const bt_profile_mark_t generation_start = bt_profile_now(profile);
+        const uint64_t generation_key = rng_stream_key(seed_key, i+1);
+        start = generation_start;
+        if (restart) {
+            cmaes_free(es);
+            es = cmaes_alloc(DESIGN_VAR_COUNT, nmemb);
+            designs = realloc(designs, nmemb * sizeof(*designs));
+            fitnesses = realloc(fitnesses, nmemb * sizeof(fitness_t));
+            init_random_population(init_population_size, DESIGN_VAR_COUNT, init_designs,
+                                   bt_design_bounds->lower_bounds,
+                                   bt_design_bounds->upper_bounds,
+                                   rng_stream_key(generation_key, GA_STREAM_INIT));
+            bt_profile_record(profile, BT_PROFILE_MUTATE, start);
+            start = bt_profile_now(profile);
+            bt_model_update_fitnesses(init_population_size, init_designs, init_fitnesses, NULL,
+                                      plan, profile);
+            num_evaluations += init_population_size;
+            bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+            start = bt_profile_now(profile);
+            const size_t init_index = stats_max_index(init_fitnesses, init_population_size);
+            cmaes_init(es, init_designs[init_index], bt_design_bounds->stdevs);
+            restart = false;
+        }
+        cmaes_sample(es, designs, rng_stream_key(generation_key, GA_STREAM_MUTATE));
+        bt_profile_record(profile, BT_PROFILE_MUTATE, start);
+        start = bt_profile_now(profile);
+        bt_model_update_fitnesses(nmemb, designs, fitnesses, NULL, plan, profile);
+        num_evaluations += nmemb;
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+
+        // Keep the best design of all the generations and restarts.
+        start = bt_profile_now(profile);
+        const size_t best_index = stats_max_index(fitnesses, nmemb);
+        if (fitnesses[best_index] > best_fitness || generations_run == 0) {
+            best_fitness = fitnesses[best_index];
+            memcpy(best_design, designs[best_index], sizeof(design_var_t[DESIGN_VAR_COUNT]));
+        }
+        if (debug) {
+            fprintf(stderr, "Seed %lu, Generation %zd:\t", random_seed, i+1);
+            fprintf_fitness_summary(stderr, nmemb, fitnesses);
+            fprintf(stderr, "\tSigma: %lf\n", es->sigma);
+        }
+        if (output_convergence)
+            bt_convergence_write(conv_log, i+1, nmemb, fitnesses);
+        bt_profile_record(profile, BT_PROFILE_STATS, start);
 
-    // Load the input files.
-    bt_data_t *bt_data;
-    if ((bt_data = bt_data_load(args.data_path)) == NULL)
-        fail("Unable to parse data file.\n");
-    bt_trials_t *bt_trials[args.num_iterations];
-    bool trials_is_pattern = strchr(args.trials_path, '%');
-    if (trials_is_pattern) {
+        // Selection and recombination of the best designs.
+        start = bt_profile_now(profile);
+        cmaes_update(es, designs, fitnesses);
+        bt_profile_record(profile, BT_PROFILE_SELECT, start);
+        bt_profile_record_generation(profile, i+1, generation_start);
+        generations_run = i+1;
+
+        // A stall or a collapsed spread also ends a search, which restarts if
+        // there are restarts left.
+        reason = ga_check_stop(stopping, &progress, i+1, num_evaluations, nmemb, fitnesses);
+        if (reason == GA_STOP_BUDGET)
+            break;
+        if (reason != GA_STOP_MAX_GENERATIONS || cmaes_converged(es)) {
+            if (num_restarts == cmaes->max_restarts) {
+                if (reason == GA_STOP_MAX_GENERATIONS)
+                    reason = GA_STOP_CONVERGED;
+                break;
+            }
+            reason = GA_STOP_MAX_GENERATIONS;
+            ga_progress_init(&progress);
+            num_restarts++;
+            nmemb *= 2;
+            restart = true;
+            if (debug) {
+                fprintf(stderr, "Seed %lu: restarting with %zd designs per generation\n",
+                        random_seed, nmemb);
+            }
+            if (stopping->max_evaluations > 0
+                && num_evaluations + init_population_size + nmemb > stopping->max_evaluations) {
+                reason = GA_STOP_BUDGET;
+                break;
+            }
+        }
+    }
+    *num_generations = generations_run;
+    *stop_reason = reason;
+
+    // Close convergence file
+    start = bt_profile_now(profile);
+    if (output_convergence) {
+        bt_convergence_close(conv_log);
+    }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+
+    if (debug && reason != GA_STOP_MAX_GENERATIONS) {
+        fprintf(stderr, "Seed %lu: stopped after %zd generations and %zd restarts (%s)\n",
+                random_seed, generations_run, num_restarts, ga_stop_reason_names[reason]);
+    }
+
+    // Report the best design in double precision.
+    start = bt_profile_now(profile);
+    plan->precision = BT_PLAN_DOUBLE;
+    *best_mean_abs_residual = bt_model_calculate_error(best_design, plan) / bt_trials->size;
+    bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+
+    // Write the last generation and integration of best design.
+    start = bt_profile_now(profile);
+    int status = 0;
+    if (output_population)
+        status |= write_population(output_population, random_seed, output_format,
+                                   es->nmemb, designs, plan);
+    if (output_integration)
+        status |= write_integration(output_integration, random_seed, output_format,
+                                    best_design, bt_data, integrator);
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+
+    // Finish the profile.
+    if (profile_summary || perf_counters)
+        bt_profile_fprint_summary(stderr, profile, num_evaluations * plan->num_records);
+    if (bt_profile_close(profile) != 0)
+        fprintf(stderr, "Unable to write trace file for seed %lu.\n", random_seed);
+
+    // Free objects
+    cmaes_free(es);
+    bt_plan_free(plan);
+    free(init_fitnesses);
+    free(init_designs);
+    free(fitnesses);
+    free(designs);
+    return status;
+}
+
+
+/*
+ * Loads the trials file for each iteration, where trials_path may be a
+ * pattern. Returns 0 on success, or 1 (after writing an error message) on
+ * failure.
+ */
+static int load_trials(bt_trials_t *bt_trials[], const size_t num_iterations,
+                       const char *trials_path)
+{
+    if (strchr(trials_path, '%')) {
         // Treat the path as a pattern.
-        for (size_t i = 0; i < args.num_iterations; i++) {
+        for (size_t i = 0; i < num_iterations; i++) {
             char formatted_path[MAX_PATH_LENGTH];
-            snprintf(formatted_path, MAX_PATH_LENGTH, args.trials_path, i+1);
-            if ((bt_trials[i] = bt_trials_load(formatted_path)) == NULL)
-                fail("Unable to parse trials file: %s.\n", formatted_path);
+            snprintf(formatted_path, MAX_PATH_LENGTH, trials_path, i+1);
+            if ((bt_trials[i] = bt_trials_load(formatted_path)) == NULL) {
+                fprintf(stderr, "Unable to parse trials file: %s.\n", formatted_path);
+                for (size_t j = 0; j < i; j++)
+                    bt_trials_free(bt_trials[j]);
+                return 1;
+            }
         }
     } else {
         // It's just a path, so we only need to load it once.
-        if ((bt_trials[0] = bt_trials_load(args.trials_path)) == NULL)
-            fail("Unable to parse trials file.\n");
-        for (size_t i = 1; i < args.num_iterations; i++)
+        if ((bt_trials[0] = bt_trials_load(trials_path)) == NULL) {
+            fprintf(stderr, "Unable to parse trials file: %s.\n", trials_path);
+            return 1;
+        }
+        for (size_t i = 1; i < num_iterations; i++)
             bt_trials[i] = bt_trials[0];
     }
-    bt_design_bounds_t *bt_design_bounds;
-    if ((bt_design_bounds = bt_bounds_load(args.bounds_path)) == NULL)
-        fail("Unable to parse bounds file.\n");
-    if (args.debug) {
+    return 0;
+}
+
+
+static void free_trials(bt_trials_t *bt_trials[], const size_t num_iterations,
+                        const char *trials_path)
+{
+    if (strchr(trials_path, '%'))
+        for (size_t i = 0; i < num_iterations; i++)
+            bt_trials_free(bt_trials[i]);
+    else
+        bt_trials_free(bt_trials[0]);
+}
+
+
+/*
+ * Writes the best designs like bt_model_fprint_designs(), with the number of
+ * generations run and the reason for stopping added to each row.
+ */
+static void fprint_results(FILE *stream, const size_t nmemb,
+                           design_var_t (*const designs)[DESIGN_VAR_COUNT],
+                           const fitness_t mean_abs_residuals[],
+                           const size_t num_generations[],
+                           const enum ga_stop_reason stop_reasons[])
+{
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++)
+        fprintf(stream, "%s\t", bt_design_var_names[j]);
+    fprintf(stream, "mean_abs_residual\tgenerations\tstop_reason\n");
+    for (size_t i = 0; i < nmemb; i++) {
+        for (size_t j = 0; j < DESIGN_VAR_COUNT; j++)
+            fprintf(stream, "%lf\t", designs[i][j]);
+        fprintf(stream, "%lf\t%zd\t%s\n", mean_abs_residuals[i], num_generations[i],
+                ga_stop_reason_names[stop_reasons[i]]);
+    }
+}
+
+
+/*
+ * Runs the GA for each iteration and writes the best designs to output_path.
+ * Returns 0 on success, or 1 if any iteration failed (in which case nothing
+ * is written to output_path) or the output file couldn't be opened.
+ */
+static int fit_iterations(const struct arguments *args,
+                          const bt_design_bounds_t *bt_design_bounds,
+                          const bt_data_t *bt_data, bt_trials_t *bt_trials[],
+                          const char *output_path, const char *output_integration,
+                          const char *output_population, const char *output_convergence,
+                          const char *checkpoint, const char *output_trace,
+                          const bool show_progress)
+{
+    if (args->debug) {
         fprintf(stderr, "Using bounds:\n");
         bt_bounds_write(stderr, bt_design_bounds);
         fprintf(stderr, "\n");
     }
 
     // Create the output arrays.
-    design_var_t best_designs[args.num_iterations][DESIGN_VAR_COUNT];
-    fitness_t best_mean_abs_residuals[args.num_iterations];
-
-    // Run the GA.
-    for (size_t i = 0; i < args.num_iterations; i++) {
-        fprintf(stderr, "Iteration %zd\n", i+1);
-        fflush(stderr);
-        run_ga(best_designs[i],
-               &best_mean_abs_residuals[i],
-               args.max_generations,
-               args.population_size,
-               args.cull_keep,
-               args.mutate_probability,
-               args.blx_alpha,
-               bt_design_bounds,
-               bt_data,
-               bt_trials[i],
-               i + 1,
-               args.output_integration,
-               args.output_population,
-               args.output_convergence,
-               args.debug);
+    design_var_t best_designs[args->num_iterations][DESIGN_VAR_COUNT];
+    fitness_t best_mean_abs_residuals[args->num_iterations];
+    size_t num_generations[args->num_iterations];
+    enum ga_stop_reason stop_reasons[args->num_iterations];
+
+    // Run the GA. The iterations are independent, so they can run concurrently.
+    const size_t population_size = args->optimizer == OPTIMIZER_CMAES
+                                   ? args->cmaes.nmemb : args->population_size;
+    bt_threads_split_t split = bt_threads_split(args->num_iterations, population_size,
+                                                bt_data->size, args->seed_threads);
+    bt_threads_enable_nesting(&split);
+    if (args->debug) {
+        fprintf(stderr, "Using %d concurrent iterations with %d evaluation threads each\n\n",
+                split.seed_threads, split.eval_threads);
+    }
+    size_t num_failures = 0;
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(split.seed_threads) reduction(+:num_failures)
+    for (size_t i = 0; i < args->num_iterations; i++) {
+        bt_threads_limit_eval(&split);
+        if (show_progress) {
+            fprintf(stderr, "Iteration %zd\n", i+1);
+            fflush(stderr);
+        }
+        int status;
+        if (args->optimizer == OPTIMIZER_CMAES) {
+            status = run_cmaes(best_designs[i],
+                               &best_mean_abs_residuals[i],
+                               &num_generations[i],
+                               &stop_reasons[i],
+                               args->max_generations,
+                               args->population_size,
+                               &args->cmaes,
+                               args->integrator,
+                               args->precision,
+                               &args->stopping,
+                               bt_design_bounds,
+                               bt_data,
+                               bt_trials[i],
+                               i + 1,
+                               output_integration,
+                               output_population,
+                               output_convergence,
+                               args->output_format,
+                               args->profile,
+                               args->perf_counters,
+                               output_trace,
+                               args->debug);
+        } else {
+            status = run_ga(best_designs[i],
+                            &best_mean_abs_residuals[i],
+                            &num_generations[i],
+                            &stop_reasons[i],
+                            args->max_generations,
+                            args->population_size,
+                            args->cull_keep,
+                            args->mutate_probability,
+                            args->blx_alpha,
+                            args->integrator,
+                            args->precision,
+                            &args->islands,
+                            &args->stopping,
+                            &args->refine,
+                            bt_design_bounds,
+                            bt_data,
+                            bt_trials[i],
+                            i + 1,
+                            output_integration,
+                            output_population,
+                            output_convergence,
+                            args->output_format,
+                            checkpoint,
+                            args->checkpoint_interval,
+                            args->resume,
+                            args->bounded_evaluation,
+                            args->profile,
+                            args->perf_counters,
+                            output_trace,
+                            args->debug);
+        }
+        if (status != 0)
+            num_failures++;
     }
+    if (num_failures > 0)
+        return 1;
 
     // Write the output file.
-    FILE *output_file = fopen(args.output_path, "w");
-    bt_model_fprint_designs(output_file, args.num_iterations,
-                            best_designs, best_mean_abs_residuals);
+    FILE *output_file = fopen(output_path, "w");
+    if (output_file == NULL) {
+        fprintf(stderr, "Unable to open output file: %s.\n", output_path);
+        return 1;
+    }
+    const ga_stopping_t *stopping = &args->stopping;
+    // CMA-ES can stop on its own when it converges.
+    if (stopping->stall_generations > 0 || stopping->min_spread > 0
+        || stopping->max_evaluations > 0 || args->optimizer == OPTIMIZER_CMAES) {
+        fprint_results(output_file, args->num_iterations, best_designs,
+                       best_mean_abs_residuals, num_generations, stop_reasons);
+    } else {
+        bt_model_fprint_designs(output_file, BT_TABLE_TSV, args->num_iterations,
+                                best_designs, best_mean_abs_residuals);
+    }
     fclose(output_file);
+    return 0;
+}
+
+
+/*
+ * Loads the input files for one athlete and fits the model. Returns 0 on
+ * success, or 1 (after writing an error message) on failure.
+ */
+static int fit_athlete(const struct arguments *args,
+                       const char *bounds_path, const char *data_path,
+                       const char *trials_path, const char *output_path,
+                       const char *output_integration, const char *output_population,
+                       const char *output_convergence, const char *checkpoint,
+                       const char *output_trace, const bool show_progress)
+{
+    int status = 1;
+    bt_trials_t *bt_trials[args->num_iterations];
+    bt_data_t *bt_data = bt_data_load(data_path);
+    bt_design_bounds_t *bt_design_bounds = bt_bounds_load(bounds_path);
+    if (bt_data == NULL) {
+        fprintf(stderr, "Unable to parse data file: %s.\n", data_path);
+    } else if (bt_design_bounds == NULL) {
+        fprintf(stderr, "Unable to parse bounds file: %s.\n", bounds_path);
+    } else if (load_trials(bt_trials, args->num_iterations, trials_path) == 0) {
+        status = fit_iterations(args, bt_design_bounds, bt_data, bt_trials, output_path,
+                                output_integration, output_population, output_convergence,
+                                checkpoint, output_trace, show_progress);
+        free_trials(bt_trials, args->num_iterations, trials_path);
+    }
 
     // Cleanup the input data.
     bt_data_free(bt_data);
-    if (trials_is_pattern)
-        for (size_t i = 0; i < args.num_iterations; i++)
-            bt_trials_free(bt_trials[i]);
-    else
-        bt_trials_free(bt_trials[0]);
     bt_bounds_free(bt_design_bounds);
+    return status;
+}
+
+
+/*
+ * Writes the pattern to resolved, prefixed with the directory of output_path
+ * if the pattern is relative. Returns resolved, or NULL if pattern is NULL.
+ */
+static char *resolve_output_pattern(char resolved[MAX_PATH_LENGTH], const char *pattern,
+                                    const char *output_path)
+{
+    if (pattern == NULL)
+        return NULL;
+    const char *last_slash = strrchr(output_path, '/');
+    if (pattern[0] == '/' || last_slash == NULL) {
+        snprintf(resolved, MAX_PATH_LENGTH, "%s", pattern);
+    } else {
+        snprintf(resolved, MAX_PATH_LENGTH, "%.*s%s",
+                 (int)(last_slash - output_path + 1), output_path, pattern);
+    }
+    return resolved;
+}
+
+
+/*
+ * Fits every athlete in the manifest. Each athlete is a task, so loading
+ * inputs and writing results overlap with the other athletes' GA runs on a
+ * single team of threads. Returns the number of athletes that failed.
+ */
+static size_t fit_manifest(const struct arguments *args, const bt_manifest_t *manifest)
+{
+    size_t num_failures = 0;
+    #pragma omp parallel
+    #pragma omp single
+    for (size_t i = 0; i < manifest->size; i++) {
+        #pragma omp task firstprivate(i) shared(num_failures)
+        {
+            const bt_manifest_entry_t *entry = &manifest->entries[i];
+            char integ_pattern[MAX_PATH_LENGTH];
+            char pop_pattern[MAX_PATH_LENGTH];
+            char conv_pattern[MAX_PATH_LENGTH];
+            char checkpoint_pattern[MAX_PATH_LENGTH];
+            char trace_pattern[MAX_PATH_LENGTH];
+            int status = fit_athlete(
+                args, entry->bounds_path, entry->data_path, entry->trials_path,
+                entry->output_path,
+                resolve_output_pattern(integ_pattern, args->output_integration, entry->output_path),
+                resolve_output_pattern(pop_pattern, args->output_population, entry->output_path),
+                resolve_output_pattern(conv_pattern, args->output_convergence, entry->output_path),
+                resolve_output_pattern(checkpoint_pattern, args->checkpoint, entry->output_path),
+                resolve_output_pattern(trace_pattern, args->output_trace, entry->output_path),
+                false);
+            if (status == 0) {
+                fprintf(stderr, "Finished %s\n", entry->output_path);
+            } else {
+                fprintf(stderr, "Failed %s\n", entry->output_path);
+                #pragma omp atomic
+                num_failures++;
+            }
+        }
+    }
+    return num_failures;
+}
+
+
+int main(int argc, char *argv[])
+{
+    // Parse the arguments.
+    struct arguments args;
+    parse_arguments(argc, argv, &args);
+    if (args.debug) {
+        fprintf(stderr, "Using arguments:\n");
+        fprintf_arguments(stderr, &args);
+        fprintf(stderr, "\n");
+    }
+    if (args.islands.num_islands == 0 ||
+        args.population_size < 2 * args.islands.num_islands)
+        fail("Each island needs at least two designs.\n");
+    if (args.checkpoint && args.num_iterations > 1 && strchr(args.checkpoint, '%') == NULL)
+        fail("The checkpoint PATTERN needs a %%zd for the iteration number.\n");
+    if (args.refine.interval > 0 && args.integrator != BT_ODE_EULER)
+        fail("Refinement requires the euler integrator.\n");
+    if (args.optimizer == OPTIMIZER_CMAES) {
+        if (args.cmaes.nmemb < 2 || args.max_generations == 0)
+            fail("CMA-ES needs at least two designs and one generation.\n");
+        if (args.islands.num_islands > 1 || args.refine.interval > 0 || args.checkpoint
+            || args.bounded_evaluation)
+            fail("CMA-ES doesn't support islands, refinement, checkpoints, or bounded evaluation.\n");
+    }
+
+    // Batch mode.
+    if (args.manifest_path) {
+        bt_manifest_t *manifest;
+        if ((manifest = bt_manifest_load(args.manifest_path)) == NULL)
+            fail("Unable to parse manifest file.\n");
+        size_t num_failures = fit_manifest(&args, manifest);
+        if (num_failures > 0)
+            fprintf(stderr, "%zd of %zd athletes failed.\n", num_failures, manifest->size);
+        bt_manifest_free(manifest);
+        return num_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    if (fit_athlete(&args, args.bounds_path, args.data_path, args.trials_path,
+                    args.output_path, args.output_integration, args.output_population,
+                    args.output_convergence, args.checkpoint, args.output_trace,
+                    true) != 0)
+        exit(EXIT_FAILURE);
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "rng_stream.h"
+#include <math.h>
+
+
+uint64_t rng_stream_interval(const uint64_t max, rng_stream_t *stream)
+{
+    if (max == 0)
+        return 0;
+
+    // Smallest bit mask >= max, then reject values above max.
+    uint64_t mask = max;
+    mask |= mask >> 1;
+    mask |= mask >> 2;
+    mask |= mask >> 4;
+    mask |= mask >> 8;
+    mask |= mask >> 16;
+    mask |= mask >> 32;
+    uint64_t value;
+    while ((value = (rng_stream_next(stream) & mask)) > max)
+        ;
+    return value;
+}
+
+
+double rng_stream_gauss(rng_stream_t *stream)
+{
+    if (stream->has_gauss) {
+        stream->has_gauss = 0;
+        return stream->gauss;
+    }
+
+    // Polar Box-Muller method, as in rk_gauss().
+    double x1, x2, r2;
+    do {
+        x1 = 2.0 * rng_stream_double(stream) - 1.0;
+        x2 = 2.0 * rng_stream_double(stream) - 1.0;
+        r2 = x1 * x1 + x2 * x2;
+    } while (r2 >= 1.0 || r2 == 0.0);
+    const double f = sqrt(-2.0 * log(r2) / r2);
+    stream->gauss = f * x1;
+    stream->has_gauss = 1;
+    return f * x2;
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file rng_stream.h
+ *
+ * Counter-based pseudorandom number streams.
+ *
+ * Each stream is identified by a 64-bit key, and its `n`th value is a hash of
+ * the key and `n`, so any number of independent streams can be created
+ * cheaply and used in any order. Keys are derived hierarchically with
+ * rng_stream_key(), e.g. from the seed, then the generation, then the
+ * member, so the values drawn for a member don't depend on which thread
+ * draws them.
+ *
+ * The hash is the output function of SplitMix64.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * State of a stream.
+ */
+typedef struct rng_stream_t {
+    /**
+     * Key identifying the stream.
+     */
+    uint64_t key;
+    /**
+     * Number of values drawn so far.
+     */
+    uint64_t counter;
+    /**
+     * Whether @p gauss holds the second value of the last pair of normal
+     * deviates.
+     */
+    int has_gauss;
+    double gauss;
+} rng_stream_t;
+
+/**
+ * Mixes the bits of a 64-bit value.
+ */
+static inline uint64_t rng_stream_mix(uint64_t z)
+{
+    z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+/**
+ * Derives the key of the child stream @p index of @p parent_key.
+ *
+ * @param[in] parent_key Key of the parent stream (e.g. 0 for the root).
+ * @param[in] index Index of the child.
+ * @returns The key of the child.
+ */
+static inline uint64_t rng_stream_key(const uint64_t parent_key, const uint64_t index)
+{
+    return rng_stream_mix(rng_stream_mix(parent_key ^ UINT64_C(0x5851f42d4c957f2d)) +
+                          (index + 1) * UINT64_C(0x9e3779b97f4a7c15));
+}
+
+/**
+ * Starts the stream with the given key at its first value.
+ *
+ * @param[out] stream The stream to initialize.
+ * @param[in] key Key of the stream.
+ */
+static inline void rng_stream_init(rng_stream_t *stream, const uint64_t key)
+{
+    stream->key = key;
+    stream->counter = 0;
+    stream->has_gauss = 0;
+    stream->gauss = 0.;
+}
+
+/**
+ * Returns the next 64 random bits of the stream.
+ */
+static inline uint64_t rng_stream_next(rng_stream_t *stream)
+{
+    return rng_stream_mix(stream->key + ++stream->counter * UINT64_C(0x9e3779b97f4a7c15));
+}
+
+/**
+ * Returns the next value of the stream as a uniformly distributed double in
+ * [0, 1).
+ */
+static inline double rng_stream_double(rng_stream_t *stream)
+{
+    return (rng_stream_next(stream) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * Returns a uniformly distributed integer in [0, @p max].
+ *
+ * @param[in] max The largest possible value.
+ * @param[in,out] stream The stream.
+ */
+uint64_t rng_stream_interval(const uint64_t max, rng_stream_t *stream);
+
+/**
+ * Returns a standard normal deviate.
+ *
+ * @param[in,out] stream The stream.
+ */
+double rng_stream_gauss(rng_stream_t *stream);
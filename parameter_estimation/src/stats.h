@@ -42,7 +42,7 @@ void stats_sort(double data[], const size_t n);
  * For example, `indices[0]` will be the index of the minimum value in @p data.
  * @p indices does not need to be initialized ahead-of-time.
  *
- * The ordering of NAN values is undefined. The sort is not stable.
+ * `NAN` values are ordered before all other values. The sort is not stable.
  *
  * @param[out] indices Indices that would sort the data in increasing order.
  * @param[in] data Data array.
@@ -50,6 +50,48 @@ void stats_sort(double data[], const size_t n);
  */
 void stats_sort_index(size_t indices[], const double data[], const size_t n);
 
+/**
+ * Writes the indices to @p indices that would partition the data around its
+ * @p k th smallest value, in linear time on average and `O(n log n)` time in
+ * the worst case.
+ *
+ * Afterwards, `data[indices[k]]` is the value that would be at position @p k
+ * if the data were sorted in increasing order, `data[indices[i]] <=
+ * data[indices[k]]` for `i < k`, and `data[indices[j]] >= data[indices[k]]`
+ * for `j > k`. For example, the last `n - k` indices are those of the `n - k`
+ * largest values, in no particular order. If @p k is @p n, the indices are
+ * `0, 1, ..., n - 1`. @p indices does not need to be initialized
+ * ahead-of-time.
+ *
+ * `NAN` values are ordered before all other values.
+ *
+ * @param[out] indices Indices that partition the data.
+ * @param[in] data Data array.
+ * @param[in] n Number of elements in @p data.
+ * @param[in] k Position to partition around, from 0 to @p n, inclusive.
+ */
+void stats_select_index(size_t indices[], const double data[], const size_t n,
+                        const size_t k);
+
+/**
+ * Computes quantiles of unsorted data in linear time.
+ *
+ * The results are the same as those of stats_quantile_from_sorted() for the
+ * sorted data, but the data doesn't need to be sorted (or copied), because the
+ * necessary order statistics are found by selection. `NAN` values are
+ * ordered before all other values (see stats_select_index()), so for example
+ * the minimum is `NAN` if any value is `NAN`.
+ *
+ * @param[out] results The quantiles, one for each element of @p qs.
+ * @param[in] qs Quantiles to compute, in increasing order; each must be
+ *   between 0 and 1, inclusive.
+ * @param[in] num_quantiles Number of elements in @p qs.
+ * @param[in] data Data array.
+ * @param[in] n Number of elements in @p data.
+ */
+void stats_quantiles(double results[], const double qs[], const size_t num_quantiles,
+                     const double data[], const size_t n);
+
 /**
  * Returns the median of the @p data containing @p n elements.
  *
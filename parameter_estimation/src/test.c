@@ -15,11 +15,26 @@
  * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
  */
 
+#include "bt_checkpoint.h"
+#include "bt_data.h"
+#include "bt_input.h"
+#include "bt_model.h"
+#include "bt_ode.h"
+#include "bt_plan.h"
+#include "bt_refine.h"
+#include "bt_table.h"
+#include "cmaes.h"
+#include "ga.h"
+#include "rng_stream.h"
 #include "stats.h"
+#include "vpow.h"
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 bool approx_eq(const double a, const double b, const double eps)
 {
@@ -57,6 +72,41 @@ void test_stats_sort_index()
     }
 }
 
+void test_stats_select_index()
+{
+    const double a[] = {0.262, -0.188, 0.648, -0.241, 0.213, 0.262, 0.604, 0.721, -0.145};
+    const size_t len = 9;
+    assert(sizeof(a) / sizeof(double) == len);
+
+    const double sorted[] = {-0.241, -0.188, -0.145, 0.213, 0.262, 0.262, 0.604, 0.648, 0.721};
+    assert(sizeof(sorted) / sizeof(double) == len);
+
+    for (size_t k = 0; k < len; k++) {
+        size_t indices[len];
+        stats_select_index(indices, a, len, k);
+        assert(a[indices[k]] == sorted[k]);
+        bool seen[len];
+        for (size_t i = 0; i < len; i++)
+            seen[i] = false;
+        for (size_t i = 0; i < len; i++) {
+            assert(indices[i] < len && !seen[indices[i]]);
+            seen[indices[i]] = true;
+            assert(i < k ? a[indices[i]] <= sorted[k] : a[indices[i]] >= sorted[k]);
+        }
+    }
+
+    size_t indices[len];
+    stats_select_index(indices, a, len, len);
+    for (size_t i = 0; i < len; i++)
+        assert(indices[i] == i);
+
+    // NAN is ordered first.
+    const double b[] = {0.5, NAN, -1., NAN, 2.};
+    stats_select_index(indices, b, 5, 2);
+    assert(b[indices[2]] == -1.);
+    assert(isnan(b[indices[0]]) && isnan(b[indices[1]]));
+}
+
 void test_stats_median_from_sorted()
 {
     const double a[] = {-0.595, -0.505, -0.464, -0.332, 0.248, 0.353, 0.802, 0.876};
@@ -90,6 +140,30 @@ void test_stats_quantile_from_sorted()
     assert(isnan(stats_quantile_from_sorted(empty, 0, 0.5)));
 }
 
+void test_stats_quantiles()
+{
+    const double a[] = {0.262, -0.188, 0.648, -0.241, 0.213, 0.262, 0.604, 0.721, -0.145, 0.1};
+    const size_t len = 10;
+    assert(sizeof(a) / sizeof(double) == len);
+
+    const double qs[] = {0., 0.1, 0.25, 0.5, 0.5, 0.75, 0.99, 1.};
+    const size_t num_quantiles = sizeof(qs) / sizeof(double);
+    for (size_t n = 1; n <= len; n++) {
+        double sorted_n[n];
+        for (size_t i = 0; i < n; i++)
+            sorted_n[i] = a[i];
+        stats_sort(sorted_n, n);
+        double results[num_quantiles];
+        stats_quantiles(results, qs, num_quantiles, a, n);
+        for (size_t j = 0; j < num_quantiles; j++)
+            assert(results[j] == stats_quantile_from_sorted(sorted_n, n, qs[j]));
+    }
+
+    double results[2];
+    stats_quantiles(results, qs, 2, a, 0);
+    assert(isnan(results[0]) && isnan(results[1]));
+}
+
 void test_stats_min_index()
 {
     double a[] = {-0.188, 0.262, 0.648, -0.241, 0.213, -0.145, 0.604, 0.721};
@@ -151,15 +225,596 @@ void test_stats_min_max()
     assert(isnan(max2));
 }
 
+void test_vpow_array()
+{
+    const size_t len = 400;
+    double bases[len], exponents[len], correct[len], results[len];
+    for (size_t i = 0; i < len; i++) {
+        bases[i] = 1e-3 * pow(1e7, i / (double)(len - 1));
+        exponents[i] = 0.5 + (i % 7) / 6.;
+        correct[i] = pow(bases[i], exponents[i]);
+    }
+
+    vpow_array(len, bases, exponents, results, VPOW_EXACT);
+    for (size_t i = 0; i < len; i++)
+        assert(results[i] == correct[i]);
+
+    vpow_array(len, bases, exponents, results, VPOW_PRECISE);
+    for (size_t i = 0; i < len; i++)
+        assert(fabs(results[i] - correct[i]) <= 1e-12 * correct[i]);
+
+    vpow_array(len, bases, exponents, results, VPOW_FAST);
+    for (size_t i = 0; i < len; i++)
+        assert(fabs(results[i] - correct[i]) <= 1e-7 * correct[i]);
+
+    // Exponents of 1 are exact, and special cases match pow().
+    const double special_bases[] = {3.7, -2.0, 0.0, NAN, INFINITY, 1e-310, 1e300};
+    const double special_exponents[] = {1.0, 1.5, 1.2, 1.1, 0.9, 1.1, 3.0};
+    const size_t special_len = 7;
+    double special_results[special_len];
+    for (int accuracy = VPOW_EXACT; accuracy <= VPOW_FAST; accuracy++) {
+        vpow_array(special_len, special_bases, special_exponents, special_results, accuracy);
+        for (size_t i = 0; i < special_len; i++) {
+            const double expected = pow(special_bases[i], special_exponents[i]);
+            assert(special_results[i] == expected || (isnan(special_results[i]) && isnan(expected)));
+            const double single = vpow(special_bases[i], special_exponents[i], accuracy);
+            assert(single == expected || (isnan(single) && isnan(expected)));
+        }
+    }
+}
+
+void test_vpowf_array()
+{
+    const size_t len = 400;
+    float bases[len], exponents[len], results[len];
+    for (size_t i = 0; i < len; i++) {
+        bases[i] = 1e-3 * pow(1e7, i / (double)(len - 1));
+        exponents[i] = 0.5 + (i % 7) / 6.;
+    }
+
+    for (int accuracy = VPOW_EXACT; accuracy <= VPOW_FAST; accuracy++) {
+        vpowf_array(len, bases, exponents, results, accuracy);
+        for (size_t i = 0; i < len; i++) {
+            const double correct = pow(bases[i], exponents[i]);
+            assert(fabs(results[i] - correct) <= 2e-6 * correct);
+        }
+    }
+
+    // Exponents of 1 are exact, and special cases match powf().
+    const float special_bases[] = {3.7f, -2.0f, 0.0f, NAN, INFINITY, 1e-40f, 1e30f};
+    const float special_exponents[] = {1.0f, 1.5f, 1.2f, 1.1f, 0.9f, 1.1f, 3.0f};
+    const size_t special_len = 7;
+    float special_results[special_len];
+    for (int accuracy = VPOW_EXACT; accuracy <= VPOW_FAST; accuracy++) {
+        vpowf_array(special_len, special_bases, special_exponents, special_results, accuracy);
+        for (size_t i = 0; i < special_len; i++) {
+            const float expected = powf(special_bases[i], special_exponents[i]);
+            assert(special_results[i] == expected || (isnan(special_results[i]) && isnan(expected)));
+        }
+    }
+}
+
+void test_bt_plan_compile()
+{
+    double time[] = {0, 1, 3, 4, 7, 8};
+    double performance[] = {10, 11, 12, 13, 14, 15};
+    double training_stress[] = {5, 0, 6, 0, 7, 0};
+    const bt_data_t data = {6, time, performance, training_stress};
+    size_t trial_indices[] = {2, 4};
+    const bt_trials_t trials = {2, trial_indices};
+
+    bt_plan_t *plan = bt_plan_compile(&data, &trials, BT_ODE_EULER, BT_PLAN_DOUBLE);
+    assert(plan->num_trials == 2);
+    assert(plan->targets[0] == 12 && plan->targets[1] == 14);
+    assert(plan->segment_lengths[0] == 2 && plan->segment_lengths[1] == 2);
+
+    // The records stop at the last trial.
+    assert(plan->num_records == 4);
+    const double dts[] = {1, 2, 1, 3};
+    const double stresses[] = {5, 0, 6, 0};
+    for (size_t i = 0; i < plan->num_records; i++) {
+        assert(plan->records[i].dt == dts[i]);
+        assert(plan->records[i].training_stress == stresses[i]);
+    }
+    bt_plan_free(plan);
+
+    // Runs of rest intervals are merged within (but not across) segments.
+    double rest_time[] = {0, 1, 2, 3, 4, 5, 6, 7};
+    double rest_performance[] = {0, 0, 0, 0, 0, 0, 0, 0};
+    double rest_training_stress[] = {5, 0, 0, 6, 0, 0, 0, 0};
+    const bt_data_t rest_data = {8, rest_time, rest_performance, rest_training_stress};
+    size_t rest_trial_indices[] = {5, 7};
+    const bt_trials_t rest_trials = {2, rest_trial_indices};
+    plan = bt_plan_compile(&rest_data, &rest_trials, BT_ODE_RK4, BT_PLAN_DOUBLE);
+    assert(plan->segment_lengths[0] == 4 && plan->segment_lengths[1] == 1);
+    assert(plan->num_records == 5);
+    const double rest_dts[] = {1, 2, 1, 1, 2};
+    const double rest_stresses[] = {5, 0, 6, 0, 0};
+    for (size_t i = 0; i < plan->num_records; i++) {
+        assert(plan->records[i].dt == rest_dts[i]);
+        assert(plan->records[i].training_stress == rest_stresses[i]);
+    }
+    bt_plan_free(plan);
+
+    assert(bt_plan_precision_from_name("double") == BT_PLAN_DOUBLE);
+    assert(bt_plan_precision_from_name("mixed") == BT_PLAN_MIXED);
+    assert(bt_plan_precision_from_name("single") < 0);
+}
+
+void test_bt_model_calculate_errors_mixed()
+{
+    const size_t num_days = 120;
+    double time[num_days], performance[num_days], training_stress[num_days];
+    for (size_t i = 0; i < num_days; i++) {
+        time[i] = i;
+        training_stress[i] = i % 7 == 6 ? 0 : 50 + 40 * sin(0.3 * i);
+        performance[i] = 250 + 20 * sin(0.05 * i);
+    }
+    const bt_data_t data = {num_days, time, performance, training_stress};
+    size_t trial_indices[] = {10, 25, 40, 41, 70, 100, 119};
+    const bt_trials_t trials = {7, trial_indices};
+
+    // More designs than lanes, so that the last block is partial, and one
+    // infeasible design.
+    const size_t nmemb = 2 * BT_MODEL_MIXED_LANES + 1;
+    design_var_t designs[nmemb][DESIGN_VAR_COUNT];
+    for (size_t i = 0; i < nmemb; i++) {
+        const double u = i / (double)nmemb;
+        const design_var_t design[DESIGN_VAR_COUNT] = {
+            30 + 40 * u, 2 + 8 * u, 1 + 0.5 * u, 0.5 + 0.5 * u,
+            0.01 + 0.3 * u, 0.02 + 0.4 * u, 200 + 50 * u, 40 * u, 30 * u
+        };
+        memcpy(designs[i], design, sizeof(design));
+    }
+    designs[1][VAR_TAU1] = -1;
+
+    bt_plan_t *plan = bt_plan_compile(&data, &trials, BT_ODE_EULER, BT_PLAN_DOUBLE);
+    fitness_t double_errors[nmemb], mixed_errors[nmemb];
+    bt_model_calculate_errors(nmemb, designs, double_errors, plan);
+    plan->precision = BT_PLAN_MIXED;
+    bt_model_calculate_errors(nmemb, designs, mixed_errors, plan);
+
+    // Single precision integration is close to double precision, and the
+    // scalar objective function stays in double precision.
+    for (size_t i = 0; i < nmemb; i++) {
+        if (i == 1) {
+            assert(isnan(double_errors[i]) && isnan(mixed_errors[i]));
+            continue;
+        }
+        assert(fabs(mixed_errors[i] - double_errors[i]) <= 1e-4 * double_errors[i]);
+        assert(bt_model_calculate_error(designs[i], plan) == double_errors[i]);
+    }
+
+    // Re-scoring gives the double precision fitnesses.
+    fitness_t fitnesses[nmemb];
+    bt_model_rescore_fitnesses(nmemb, designs, fitnesses, plan);
+    for (size_t i = 0; i < nmemb; i++)
+        assert(i == 1 ? fitnesses[i] == -INFINITY : fitnesses[i] == -double_errors[i]);
+    bt_plan_free(plan);
+}
+
+void test_bt_model_calculate_residual_jacobian()
+{
+    const size_t num_days = 90;
+    double time[num_days], performance[num_days], training_stress[num_days];
+    for (size_t i = 0; i < num_days; i++) {
+        time[i] = i;
+        training_stress[i] = i % 5 == 4 ? 0 : 60 + 30 * cos(0.2 * i);
+        performance[i] = 240 + 15 * sin(0.07 * i);
+    }
+    const bt_data_t data = {num_days, time, performance, training_stress};
+    size_t trial_indices[] = {5, 20, 21, 50, 89};
+    const size_t num_trials = 5;
+    const bt_trials_t trials = {num_trials, trial_indices};
+    bt_plan_t *plan = bt_plan_compile(&data, &trials, BT_ODE_EULER, BT_PLAN_DOUBLE);
+    const design_var_t design[DESIGN_VAR_COUNT] = {45, 6, 1.1, 0.9, 0.1, 0.2, 230, 20, 15};
+
+    // The residuals sum to the total absolute residual.
+    design_var_t residuals[num_trials], jacobian[num_trials][DESIGN_VAR_COUNT];
+    bt_model_calculate_residual_jacobian(design, plan, residuals, jacobian);
+    double total = 0;
+    for (size_t trial = 0; trial < num_trials; trial++)
+        total += fabs(residuals[trial]);
+    assert(total == bt_model_calculate_error(design, plan));
+
+    // The derivatives match central differences.
+    for (size_t j = 0; j < DESIGN_VAR_COUNT; j++) {
+        const double h = 1e-6 * fmax(fabs(design[j]), 1);
+        design_var_t above[DESIGN_VAR_COUNT], below[DESIGN_VAR_COUNT];
+        memcpy(above, design, sizeof(above));
+        memcpy(below, design, sizeof(below));
+        above[j] += h;
+        below[j] -= h;
+        design_var_t residuals_above[num_trials], residuals_below[num_trials];
+        design_var_t unused[num_trials][DESIGN_VAR_COUNT];
+        bt_model_calculate_residual_jacobian(above, plan, residuals_above, unused);
+        bt_model_calculate_residual_jacobian(below, plan, residuals_below, unused);
+        for (size_t trial = 0; trial < num_trials; trial++) {
+            const double difference = (residuals_above[trial] - residuals_below[trial]) / (2 * h);
+            assert(fabs(jacobian[trial][j] - difference) <= 1e-5 * fmax(fabs(difference), 1));
+        }
+    }
+
+    // Refinement never makes a design worse, and improves this one.
+    design_var_t refined[DESIGN_VAR_COUNT];
+    memcpy(refined, design, sizeof(refined));
+    size_t num_evaluations = 0;
+    const fitness_t error = bt_refine_design(refined, plan, 20, &num_evaluations);
+    assert(error == bt_model_calculate_error(refined, plan));
+    assert(num_evaluations > 1 && num_evaluations <= 2 * 20 + 1);
+    assert(error < 0.5 * bt_model_calculate_error(design, plan));
+    assert(refined[VAR_ALPHA] >= 1 && refined[VAR_BETA] <= 1);
+    bt_plan_free(plan);
+}
+
+void test_bt_ode_advance()
+{
+    // Exact solutions of y' = -y^a/tau.
+    const bt_ode_t quadratic = {1, 2, 0};
+    assert(fabs(bt_ode_decay(&quadratic, 1, 3, VPOW_EXACT) - 0.25) < 1e-15);
+    const bt_ode_t square_root = {1, 0.5, 0};
+    assert(fabs(bt_ode_decay(&square_root, 1, 1, VPOW_EXACT) - 0.25) < 1e-15);
+    assert(bt_ode_decay(&square_root, 1, 3, VPOW_EXACT) == 0);
+    assert(isnan(bt_ode_decay(&square_root, -1, 1, VPOW_EXACT)));
+
+    // Exact solution of y' = -y/tau + k*s.
+    const bt_ode_t linear = {2, 1, 0.5};
+    const double y0 = 3, stress = 4, duration = 0.5;
+    const double steady_state = linear.gain * stress * linear.tau;
+    const double expected = steady_state + (y0 - steady_state) * exp(-duration / linear.tau);
+    assert(fabs(bt_ode_advance(BT_ODE_RK4, &linear, y0, stress, duration, VPOW_EXACT) - expected) < 1e-4);
+    assert(fabs(bt_ode_advance(BT_ODE_ADAPTIVE, &linear, y0, stress, duration, VPOW_EXACT) - expected) < 1e-7);
+    assert(fabs(bt_ode_advance(BT_ODE_RK4, &linear, y0, 0, duration, VPOW_EXACT) - y0 * exp(-duration / linear.tau)) < 1e-15);
+
+    // The Euler method is a single step.
+    const bt_ode_t nonlinear = {3, 1.5, 0.2};
+    assert(bt_ode_advance(BT_ODE_EULER, &nonlinear, 2, 0, 1, VPOW_EXACT) == 2 + -1/3. * pow(2, 1.5));
+
+    // The adaptive method agrees with the exact solution for rest intervals.
+    const double exact = bt_ode_decay(&nonlinear, 2, 5, VPOW_EXACT);
+    double y = 2;
+    for (size_t i = 0; i < 100; i++)
+        y = bt_ode_advance(BT_ODE_ADAPTIVE, &nonlinear, y, 1e-300, 0.05, VPOW_EXACT);
+    assert(fabs(y - exact) < 1e-6);
+
+    assert(bt_ode_method_from_name("RK4") == BT_ODE_RK4);
+    assert(bt_ode_method_from_name("bogus") == -1);
+}
+
+void test_rng_stream()
+{
+    // The same key gives the same values, and different keys different ones.
+    const uint64_t key = rng_stream_key(rng_stream_key(0, 1), 2);
+    assert(key == rng_stream_key(rng_stream_key(0, 1), 2));
+    assert(key != rng_stream_key(rng_stream_key(0, 2), 1));
+    rng_stream_t a, b;
+    rng_stream_init(&a, key);
+    rng_stream_init(&b, key);
+    for (size_t i = 0; i < 10; i++)
+        assert(rng_stream_next(&a) == rng_stream_next(&b));
+    rng_stream_init(&b, rng_stream_key(key, 0));
+    assert(rng_stream_next(&a) != rng_stream_next(&b));
+
+    // Uniform deviates are in range with about the right mean.
+    const size_t n = 100000;
+    double sum = 0, sum_gauss = 0, sum_gauss_sq = 0;
+    for (size_t i = 0; i < n; i++) {
+        const double u = rng_stream_double(&a);
+        assert(0 <= u && u < 1);
+        sum += u;
+        assert(rng_stream_interval(6, &a) <= 6);
+        const double g = rng_stream_gauss(&a);
+        sum_gauss += g;
+        sum_gauss_sq += g * g;
+    }
+    assert(approx_eq(sum / n, 0.5, 0.01));
+    assert(approx_eq(sum_gauss / n, 0, 0.02));
+    assert(approx_eq(sum_gauss_sq / n, 1, 0.02));
+    assert(rng_stream_interval(0, &a) == 0);
+}
+
+void test_bt_table()
+{
+    const char *const names[] = {"a", "long_column_name"};
+    const enum bt_table_column_type types[] = {BT_TABLE_INTEGER, BT_TABLE_DOUBLE};
+    const double values[] = {1, 20, 300, -2.5, -0., 1e-300};
+    FILE *stream = tmpfile();
+    assert(bt_table_write(stream, 2, 3, names, types, values) == 0);
+
+    // The values start at an aligned offset after the header.
+    const long size = ftell(stream);
+    assert((size - 6 * 8) % 8 == 0);
+    rewind(stream);
+    unsigned char magic[8];
+    assert(fread(magic, 1, 8, stream) == 8);
+    assert(memcmp(magic, BT_TABLE_MAGIC, 8) == 0);
+
+    rewind(stream);
+    bt_table_t *table = bt_table_read(stream);
+    assert(table != NULL);
+    assert(table->num_columns == 2);
+    assert(table->num_rows == 3);
+    assert(strcmp(table->names[0], "a") == 0);
+    assert(strcmp(table->names[1], "long_column_name") == 0);
+    assert(table->types[0] == BT_TABLE_INTEGER && table->types[1] == BT_TABLE_DOUBLE);
+    assert(memcmp(table->values, values, sizeof(values)) == 0);
+
+    // Integer columns are written as the text outputs write them.
+    FILE *tsv = tmpfile();
+    bt_table_write_tsv(tsv, table);
+    rewind(tsv);
+    char text[128] = {0};
+    assert(fread(text, 1, sizeof(text) - 1, tsv) > 0);
+    assert(strcmp(text, "a\tlong_column_name\n1\t-2.500000\n20\t-0.000000\n300\t0.000000\n") == 0);
+    fclose(tsv);
+    bt_table_free(table);
+
+    // Without types, all the columns hold doubles.
+    FILE *untyped = tmpfile();
+    assert(bt_table_write(untyped, 2, 3, names, NULL, values) == 0);
+    rewind(untyped);
+    table = bt_table_read(untyped);
+    assert(table != NULL);
+    assert(table->types[0] == BT_TABLE_DOUBLE && table->types[1] == BT_TABLE_DOUBLE);
+    bt_table_free(table);
+    fclose(untyped);
+
+    // A file with the wrong magic number is rejected.
+    rewind(stream);
+    assert(fwrite("BTTABLE0", 1, 8, stream) == 8);
+    rewind(stream);
+    assert(bt_table_read(stream) == NULL);
+    fclose(stream);
+
+    enum bt_table_format format;
+    assert(bt_table_parse_format("Binary", &format) == 0 && format == BT_TABLE_BINARY);
+    assert(bt_table_parse_format("tsv", &format) == 0 && format == BT_TABLE_TSV);
+    assert(bt_table_parse_format("csv", &format) != 0);
+}
+
+void test_bt_input_parse_double()
+{
+    // The fast path and the fallback agree with strtod().
+    const char *const numbers[] = {
+        "0", "-0", "1", "149", "0.000000", "123.456000", "-7.25", ".5", "5.",
+        "1e22", "1e23", "9007199254740993", "0.1", "2.2250738585072014e-308",
+        "1.7976931348623157e308", "12345678901234567890123", "1E-5", "nan", "-inf",
+        "0x1p-3", "0e-50", "-0e-50", "0.000000000000000000000000000000", "0e-99999",
+        "0e99999"
+    };
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        const char *cursor = numbers[i];
+        const char *end = cursor + strlen(cursor);
+        double value;
+        assert(bt_input_parse_double(&cursor, end, &value) == 0);
+        assert(cursor == end);
+        const double expected = strtod(numbers[i], NULL);
+        assert(memcmp(&value, &expected, sizeof(value)) == 0 || (isnan(value) && isnan(expected)));
+    }
+    rng_stream_t stream;
+    rng_stream_init(&stream, 1);
+    for (size_t i = 0; i < 10000; i++) {
+        char text[64];
+        snprintf(text, sizeof(text), i % 2 ? "%.17g" : "%lf", (rng_stream_double(&stream) - 0.5) * 1e6);
+        const char *cursor = text;
+        double value;
+        assert(bt_input_parse_double(&cursor, text + strlen(text), &value) == 0);
+        assert(value == strtod(text, NULL));
+    }
+
+    // Numbers are separated by blanks, and the end isn't passed.
+    const char *line = " 1\t2.5 \r\n3";
+    const char *end = line + 9;
+    double a, b, c;
+    assert(bt_input_parse_double(&line, end, &a) == 0 && a == 1);
+    assert(bt_input_parse_double(&line, end, &b) == 0 && b == 2.5);
+    assert(bt_input_parse_double(&line, end, &c) != 0);
+    const char *bad = "abc";
+    assert(bt_input_parse_double(&bad, bad + 3, &a) != 0);
+
+    size_t n;
+    const char *size = "  42\n";
+    assert(bt_input_parse_size(&size, size + 5, &n) == 0 && n == 42);
+    const char *huge = "99999999999999999999999";
+    assert(bt_input_parse_size(&huge, huge + strlen(huge), &n) != 0);
+}
+
+void test_bt_data_load()
+{
+    // Text and binary files give the same data.
+    char text_path[] = "/tmp/bt_data_XXXXXX";
+    char binary_path[] = "/tmp/bt_data_XXXXXX";
+    FILE *text = fdopen(mkstemp(text_path), "w");
+    fprintf(text, "day\tperformance\ttraining_stress\n1\t0\t149\n2\t0.5\t71\r\n4\t262\t0");
+    fclose(text);
+    bt_data_t *data = bt_data_load(text_path);
+    assert(data != NULL && data->input == NULL);
+    assert(data->size == 3);
+    assert(data->time[2] == 4 && data->performance[1] == 0.5 && data->training_stress[0] == 149);
+    FILE *binary = fdopen(mkstemp(binary_path), "wb");
+    bt_data_write(binary, BT_TABLE_BINARY, data);
+    fclose(binary);
+    bt_data_t *mapped = bt_data_load(binary_path);
+    assert(mapped != NULL && mapped->size == data->size);
+    assert(mapped->input != NULL || !bt_table_native());
+    assert(memcmp(mapped->time, data->time, data->size * sizeof(double)) == 0);
+    assert(memcmp(mapped->performance, data->performance, data->size * sizeof(double)) == 0);
+    assert(memcmp(mapped->training_stress, data->training_stress, data->size * sizeof(double)) == 0);
+
+    // A copy owns its arrays.
+    bt_data_t *copy = bt_data_copy(mapped);
+    bt_data_free(mapped);
+    assert(copy->input == NULL && copy->training_stress[1] == 71);
+    bt_data_free(copy);
+    bt_data_free(data);
+
+    // Malformed lines are rejected.
+    text = fopen(text_path, "w");
+    fprintf(text, "day\tperformance\ttraining_stress\n1\t0\n");
+    fclose(text);
+    assert(bt_data_load(text_path) == NULL);
+    unlink(text_path);
+    unlink(binary_path);
+}
+
+void test_bt_checkpoint()
+{
+    char path[] = "/tmp/bt_checkpoint_XXXXXX";
+    close(mkstemp(path));
+    const double values[] = {1.5, -0., NAN, 1e-310};
+
+    // A committed checkpoint reads back exactly.
+    bt_checkpoint_t *checkpoint = bt_checkpoint_create(path);
+    assert(checkpoint != NULL);
+    bt_checkpoint_put_size(checkpoint, 42);
+    bt_checkpoint_put_doubles(checkpoint, 4, values);
+    assert(bt_checkpoint_commit(checkpoint) == 0);
+    checkpoint = bt_checkpoint_open(path);
+    assert(checkpoint != NULL);
+    assert(bt_checkpoint_get_size(checkpoint) == 42);
+    double read[6];
+    bt_checkpoint_get_doubles(checkpoint, 4, read);
+    assert(memcmp(read, values, sizeof(values)) == 0);
+    assert(bt_checkpoint_close(checkpoint) == 0);
+
+    // Reading past the end, or not reading to the end, fails.
+    checkpoint = bt_checkpoint_open(path);
+    bt_checkpoint_get_size(checkpoint);
+    assert(bt_checkpoint_close(checkpoint) != 0);
+    checkpoint = bt_checkpoint_open(path);
+    bt_checkpoint_get_doubles(checkpoint, 6, read);
+    assert(checkpoint->failed);
+    assert(bt_checkpoint_close(checkpoint) != 0);
+    unlink(path);
+
+    // A missing file isn't a checkpoint.
+    assert(bt_checkpoint_open(path) == NULL);
+}
+
+void test_ga_check_stop()
+{
+    const fitness_t fitnesses[] = {-4, -3, -2, -1};
+    const fitness_t improved[] = {-4, -3, -2, -0.5};
+    ga_progress_t progress;
+
+    // With no criteria, the run never stops.
+    const ga_stopping_t none = {0};
+    ga_progress_init(&progress);
+    assert(ga_check_stop(&none, &progress, 0, 4, 4, fitnesses) == GA_STOP_MAX_GENERATIONS);
+
+    // Stalls after stall_generations without an improvement > stall_epsilon.
+    const ga_stopping_t stall = {.stall_generations = 2, .stall_epsilon = 0.1};
+    ga_progress_init(&progress);
+    assert(ga_check_stop(&stall, &progress, 0, 4, 4, fitnesses) == GA_STOP_MAX_GENERATIONS);
+    assert(ga_check_stop(&stall, &progress, 1, 8, 4, fitnesses) == GA_STOP_MAX_GENERATIONS);
+    assert(ga_check_stop(&stall, &progress, 2, 12, 4, improved) == GA_STOP_MAX_GENERATIONS);
+    assert(progress.best_generation == 2);
+    assert(ga_check_stop(&stall, &progress, 3, 16, 4, improved) == GA_STOP_MAX_GENERATIONS);
+    assert(ga_check_stop(&stall, &progress, 4, 20, 4, improved) == GA_STOP_STALL);
+
+    // The interquartile range of the fitnesses is 1.5.
+    const ga_stopping_t spread = {.min_spread = 1.5};
+    assert(ga_check_stop(&spread, &progress, 0, 4, 4, fitnesses) == GA_STOP_MAX_GENERATIONS);
+    const ga_stopping_t collapse = {.min_spread = 1.6};
+    assert(ga_check_stop(&collapse, &progress, 0, 4, 4, fitnesses) == GA_STOP_SPREAD);
+
+    // Stops when the next generation wouldn't fit in the budget.
+    const ga_stopping_t budget = {.max_evaluations = 10};
+    assert(ga_check_stop(&budget, &progress, 0, 4, 4, fitnesses) == GA_STOP_MAX_GENERATIONS);
+    assert(ga_check_stop(&budget, &progress, 1, 8, 4, fitnesses) == GA_STOP_BUDGET);
+}
+
+void test_ga_blx_alpha()
+{
+    // With an odd number of designs, the last child is crossed too, and each
+    // child is within the BLX-alpha interval of its parents.
+    design_var_t population[3][2] = {{0, 10}, {1, 20}, {2, 30}};
+    const size_t winners[] = {0, 1, 2};
+    design_var_t children[3][2];
+    for (size_t i = 0; i < 3; i++)
+        children[i][0] = children[i][1] = NAN;
+    ga_blx_alpha(3, 2, population, winners, children, 0.5, rng_stream_key(0, 1));
+    assert(children[0][0] >= -0.5 && children[0][0] <= 1.5);
+    assert(children[1][1] >= 5 && children[1][1] <= 25);
+    assert(children[2][0] >= -1 && children[2][0] <= 3);
+    assert(children[2][1] >= 0 && children[2][1] <= 40);
+}
+
+void test_cmaes()
+{
+    // Maximizes a rotated, badly scaled ellipsoid centered at (1, 2, 3, 4).
+    const size_t n = 4;
+    const size_t nmemb = cmaes_default_nmemb(n);
+    assert(nmemb == 8);
+    cmaes_t *es = cmaes_alloc(n, nmemb);
+    const design_var_t mean[] = {0, 0, 0, 0};
+    const design_var_t stdevs[] = {1, 1, 1, 1};
+    const double expected[] = {1, 2, 3, 4};
+    cmaes_init(es, mean, stdevs);
+    design_var_t designs[nmemb][n];
+    fitness_t fitnesses[nmemb];
+    size_t generation = 0;
+    while (!cmaes_converged(es)) {
+        assert(generation < 2000);
+        cmaes_sample(es, designs, rng_stream_key(1, generation++));
+        for (size_t i = 0; i < nmemb; i++) {
+            fitnesses[i] = 0;
+            for (size_t j = 0; j < n; j++) {
+                const size_t k = (j+1) % n;
+                const double x = designs[i][j] - expected[j] + (designs[i][k] - expected[k]) / 2;
+                fitnesses[i] -= pow(100, j / 3.) * x * x;
+            }
+        }
+        // Infeasible designs rank last.
+        fitnesses[generation % nmemb] = NAN;
+        cmaes_update(es, designs, fitnesses);
+    }
+    for (size_t j = 0; j < n; j++)
+        assert(approx_eq(es->mean[j], expected[j], 1e-6));
+
+    // A plateau whose edge cuts through the distribution converges, and
+    // so would restart, even though most generations have infeasible
+    // designs.
+    cmaes_init(es, mean, stdevs);
+    size_t num_infeasible = 0;
+    for (generation = 0; !cmaes_converged(es); generation++) {
+        assert(generation < 200);
+        cmaes_sample(es, designs, rng_stream_key(2, generation));
+        for (size_t i = 0; i < nmemb; i++) {
+            fitnesses[i] = designs[i][0] > 0 ? -INFINITY : designs[i][1] > 0 ? NAN : 1;
+            num_infeasible += !isfinite(fitnesses[i]);
+        }
+        cmaes_update(es, designs, fitnesses);
+    }
+    assert(es->flat_generations > 0 && num_infeasible > generation);
+    cmaes_free(es);
+}
+
 int main(int argc, char *argv[])
 {
     test_stats_sort();
     test_stats_sort_index();
+    test_stats_select_index();
     test_stats_median_from_sorted();
     test_stats_quantile_from_sorted();
+    test_stats_quantiles();
     test_stats_min_index();
     test_stats_max_index();
     test_stats_min_max();
+    test_vpow_array();
+    test_vpowf_array();
+    test_bt_plan_compile();
+    test_bt_model_calculate_errors_mixed();
+    test_bt_model_calculate_residual_jacobian();
+    test_bt_ode_advance();
+    test_rng_stream();
+    test_bt_table();
+    test_bt_input_parse_double();
+    test_bt_data_load();
+    test_bt_checkpoint();
+    test_ga_check_stop();
+    test_ga_blx_alpha();
+    test_cmaes();
 
     printf("Success!\n");
 }
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_table_tsv.c
+ *
+ * Converts a binary table (see bt_table.h) to TSV.
+ */
+
+#include "../bt_table.h"
+#include <stdlib.h>
+
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr,
+                "Usage:\n"
+                "  %s INPUT_PATH [OUTPUT_PATH]\n"
+                "\n"
+                "Writes the binary table at INPUT_PATH as TSV to OUTPUT_PATH, or to\n"
+                "standard output if OUTPUT_PATH is omitted.\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *input = fopen(argv[1], "rb");
+    if (input == NULL) {
+        fprintf(stderr, "Unable to open input file: %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    bt_table_t *table = bt_table_read(input);
+    fclose(input);
+    if (table == NULL) {
+        fprintf(stderr, "Unable to parse table file: %s.\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *output = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (output == NULL) {
+        fprintf(stderr, "Unable to open output file: %s.\n", argv[2]);
+        bt_table_free(table);
+        return EXIT_FAILURE;
+    }
+    bt_table_write_tsv(output, table);
+    if (output != stdout)
+        fclose(output);
+    bt_table_free(table);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_tsv_table.c
+ *
+ * Converts a TSV file of numbers with a header line to a binary table (see
+ * bt_table.h), such as a native binary training data or trials file.
+ */
+
+#include "../bt_input.h"
+#include "../bt_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        fprintf(stderr,
+                "Usage:\n"
+                "  %s INPUT_PATH OUTPUT_PATH\n"
+                "\n"
+                "Writes the TSV file at INPUT_PATH as a binary table to OUTPUT_PATH.\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bt_input_t *input = bt_input_open(argv[1]);
+    if (input == NULL || input->size == 0) {
+        fprintf(stderr, "Unable to open input file: %s.\n", argv[1]);
+        bt_input_close(input);
+        return EXIT_FAILURE;
+    }
+    const char *end = input->data + input->size;
+
+    // Header
+    const char *line = bt_input_next_line(input->data, end);
+    size_t header_length = line - input->data;
+    while (header_length > 0 && (input->data[header_length-1] == '\n' || input->data[header_length-1] == '\r'))
+        header_length--;
+    char *header = malloc(header_length + 1);
+    memcpy(header, input->data, header_length);
+    header[header_length] = '\0';
+    size_t num_columns = 1;
+    for (size_t i = 0; i < header_length; i++)
+        if (header[i] == '\t')
+            num_columns++;
+    const char *names[num_columns];
+    names[0] = strtok(header, "\t");
+    for (size_t j = 1; j < num_columns; j++)
+        names[j] = strtok(NULL, "\t");
+
+    // Values
+    const size_t num_rows = bt_input_count_lines(line, end);
+    double *values = malloc((num_columns * num_rows > 0 ? num_columns * num_rows : 1) * sizeof(double));
+    for (size_t i = 0; i < num_rows; i++) {
+        const char *next_line = bt_input_next_line(line, end);
+        const char *cursor = line;
+        for (size_t j = 0; j < num_columns; j++) {
+            if (bt_input_parse_double(&cursor, next_line, &values[j * num_rows + i]) != 0) {
+                fprintf(stderr, "Unable to parse line '%.*s'.\n", (int)(next_line - line), line);
+                free(values);
+                free(header);
+                bt_input_close(input);
+                return EXIT_FAILURE;
+            }
+        }
+        line = next_line;
+    }
+    bt_input_close(input);
+
+    FILE *output = fopen(argv[2], "wb");
+    int status = output != NULL
+        && bt_table_write(output, num_columns, num_rows, names, NULL, values) == 0
+        && fclose(output) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (status != EXIT_SUCCESS)
+        fprintf(stderr, "Unable to write output file: %s.\n", argv[2]);
+    free(values);
+    free(header);
+    return status;
+}
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "vpow.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Split of ln(2) such that k * LN2_HI is exact for |k| < 2^11. */
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+#define INV_LN2 1.44269504088896338700e+00
+
+/* Adding and then subtracting this rounds a double to the nearest integer. */
+#define ROUND_SHIFT 0x1.8p52
+
+/* Bit pattern of sqrt(1/2). */
+#define SQRT_HALF_BITS UINT64_C(0x3fe6a09e667f3bcd)
+
+/* Largest |y*log(x)| for which 2^round(y*log(x)/ln(2)) is a normal number. */
+#define MAX_EXP_ARG 708.0
+
+/* Number of elements vpow_array() handles per block. */
+#define BLOCK_SIZE 64
+
+/* Single precision versions of the constants above. k * LN2F_HI is exact for
+ * |k| < 2^8. */
+#define LN2F_HI 6.93145751953125e-01f
+#define LN2F_LO 1.42860676533018704e-06f
+#define INV_LN2F 1.44269504088896338700e+00f
+#define ROUND_SHIFTF 0x1.8p23f
+#define SQRT_HALF_BITSF UINT32_C(0x3f3504f3)
+#define MAX_EXP_ARGF 87.0f
+
+
+typedef union {
+    double value;
+    uint64_t bits;
+} vpow_bits_t;
+
+
+typedef union {
+    float value;
+    uint32_t bits;
+} vpowf_bits_t;
+
+
+static inline uint64_t double_to_bits(const double x)
+{
+    vpow_bits_t u = { .value = x };
+    return u.bits;
+}
+
+
+static inline double bits_to_double(const uint64_t bits)
+{
+    vpow_bits_t u = { .bits = bits };
+    return u.value;
+}
+
+
+static inline uint32_t float_to_bits(const float x)
+{
+    vpowf_bits_t u = { .value = x };
+    return u.bits;
+}
+
+
+static inline float bits_to_float(const uint32_t bits)
+{
+    vpowf_bits_t u = { .bits = bits };
+    return u.value;
+}
+
+
+/*
+ * Natural logarithm of a positive normal number.
+ *
+ * Writes x = 2^k * m with m in [sqrt(1/2), sqrt(2)), and then uses
+ * log(m) = 2*atanh(s) with s = (m-1)/(m+1), |s| < 0.172.
+ */
+static inline double vpow_log(const double x, const int precise)
+{
+    const uint64_t bits = double_to_bits(x);
+    const uint64_t tmp = bits - SQRT_HALF_BITS;
+    // k is the signed top 12 bits of tmp. Biasing it to be unsigned and
+    // placing it in the mantissa of 2^52 avoids 64-bit integer conversions,
+    // which most vector units don't have.
+    const uint64_t biased_k = (tmp + (UINT64_C(2048) << 52)) >> 52;
+    const double k = bits_to_double(UINT64_C(0x4330000000000000) | biased_k) - (0x1p52 + 2048);
+    const double m = bits_to_double(bits - (tmp & UINT64_C(0xfff0000000000000)));
+
+    const double s = (m - 1) / (m + 1);
+    const double s2 = s * s;
+    const double s4 = s2 * s2;
+    const double s8 = s4 * s4;
+    // Estrin's scheme, which has shorter dependency chains than Horner's.
+    double p;
+    if (precise) {
+        p = (1./3 + s2 * (1./5)) + s4 * (1./7 + s2 * (1./9)) +
+            s8 * ((1./11 + s2 * (1./13)) + s4 * (1./15 + s2 * (1./17)) +
+                  s8 * ((1./19 + s2 * (1./21)) + s4 * (1./23)));
+    } else {
+        p = (1./3 + s2 * (1./5)) + s4 * (1./7 + s2 * (1./9));
+    }
+    const double log_m = 2 * s + 2 * s * s2 * p;
+    return k * LN2_HI + (log_m + k * LN2_LO);
+}
+
+
+/*
+ * Exponential of t for |t| <= MAX_EXP_ARG. (The result is meaningless, but
+ * harmless, outside of that range.)
+ *
+ * Writes t = k*ln(2) + r with |r| <= ln(2)/2 and uses a Taylor polynomial for
+ * exp(r).
+ */
+static inline double vpow_exp(const double t, const int precise)
+{
+    const double shifted = t * INV_LN2 + ROUND_SHIFT;
+    const double k = shifted - ROUND_SHIFT;
+    // The low bits of `shifted` hold k, so this builds the bits of 2^k.
+    const double scale = bits_to_double((double_to_bits(shifted) + 1023) << 52);
+    const double r = (t - k * LN2_HI) - k * LN2_LO;
+    const double r2 = r * r;
+    const double r4 = r2 * r2;
+    const double r8 = r4 * r4;
+    // Estrin's scheme, which has shorter dependency chains than Horner's.
+    double p;
+    if (precise) {
+        p = ((1 + r) + r2 * (1./2 + r * (1./6))) +
+            r4 * ((1./24 + r * (1./120)) + r2 * (1./720 + r * (1./5040))) +
+            r8 * (((1./40320 + r * (1./362880)) + r2 * (1./3628800 + r * (1./39916800))) +
+                  r4 * (1./479001600 + r * (1./6227020800.)));
+    } else {
+        p = ((1 + r) + r2 * (1./2 + r * (1./6))) +
+            r4 * ((1./24 + r * (1./120)) + r2 * (1./720 + r * (1./5040)));
+    }
+    return p * scale;
+}
+
+
+/*
+ * Single precision vpow_log() with the short polynomial. Vector units convert
+ * 32-bit integers, so k is simply the shifted exponent.
+ */
+static inline float vpowf_log(const float x)
+{
+    const uint32_t bits = float_to_bits(x);
+    const uint32_t tmp = bits - SQRT_HALF_BITSF;
+    const float k = (float)((int32_t)tmp >> 23);
+    const float m = bits_to_float(bits - (tmp & UINT32_C(0xff800000)));
+
+    const float s = (m - 1) / (m + 1);
+    const float s2 = s * s;
+    const float s4 = s2 * s2;
+    const float p = (1.f/3 + s2 * (1.f/5)) + s4 * (1.f/7 + s2 * (1.f/9));
+    const float log_m = 2 * s + 2 * s * s2 * p;
+    return k * LN2F_HI + (log_m + k * LN2F_LO);
+}
+
+
+/*
+ * Single precision vpow_exp() with the short polynomial, for |t| <=
+ * MAX_EXP_ARGF.
+ */
+static inline float vpowf_exp(const float t)
+{
+    const float shifted = t * INV_LN2F + ROUND_SHIFTF;
+    const float k = shifted - ROUND_SHIFTF;
+    const float scale = bits_to_float((float_to_bits(shifted) + 127) << 23);
+    const float r = (t - k * LN2F_HI) - k * LN2F_LO;
+    const float r2 = r * r;
+    const float r4 = r2 * r2;
+    const float p = ((1 + r) + r2 * (1.f/2 + r * (1.f/6))) +
+        r4 * ((1.f/24 + r * (1.f/120)) + r2 * (1.f/720 + r * (1.f/5040)));
+    return p * scale;
+}
+
+
+/* Returns whether the polynomial tiers can't be used for these arguments. */
+static inline int vpow_is_special(const double x, const double y, const double t)
+{
+    // Bitwise rather than logical operators so that this vectorizes.
+    return !(x >= DBL_MIN) | !(x <= DBL_MAX) | !(fabs(y) <= DBL_MAX) |
+        !(fabs(t) <= MAX_EXP_ARG);
+}
+
+
+/* Single precision vpow_is_special(). */
+static inline int vpowf_is_special(const float x, const float y, const float t)
+{
+    return !(x >= FLT_MIN) | !(x <= FLT_MAX) | !(fabsf(y) <= FLT_MAX) |
+        !(fabsf(t) <= MAX_EXP_ARGF);
+}
+
+
+void vpow_array(const size_t n, const double bases[], const double exponents[],
+                double results[], const enum vpow_accuracy accuracy)
+{
+    if (accuracy == VPOW_EXACT) {
+        for (size_t i = 0; i < n; i++)
+            results[i] = exponents[i] == 1 ? bases[i] : pow(bases[i], exponents[i]);
+        return;
+    }
+
+    // Work in blocks so that the polynomial loops have no branches or calls
+    // (and thus vectorize), with the rare special cases fixed up afterwards.
+    // Results for special cases are garbage until they're fixed up.
+    double ts[BLOCK_SIZE];
+    double powers[BLOCK_SIZE];
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+        const size_t count = n - start < BLOCK_SIZE ? n - start : BLOCK_SIZE;
+        const double *x = bases + start;
+        const double *y = exponents + start;
+        if (accuracy == VPOW_PRECISE) {
+            for (size_t i = 0; i < count; i++)
+                ts[i] = y[i] * vpow_log(x[i], 1);
+            for (size_t i = 0; i < count; i++)
+                powers[i] = vpow_exp(ts[i], 1);
+        } else {
+            for (size_t i = 0; i < count; i++)
+                ts[i] = y[i] * vpow_log(x[i], 0);
+            for (size_t i = 0; i < count; i++)
+                powers[i] = vpow_exp(ts[i], 0);
+        }
+        int any_special = 0;
+        for (size_t i = 0; i < count; i++)
+            any_special |= vpow_is_special(x[i], y[i], ts[i]);
+        if (any_special) {
+            for (size_t i = 0; i < count; i++)
+                if (vpow_is_special(x[i], y[i], ts[i]))
+                    powers[i] = pow(x[i], y[i]);
+        }
+        for (size_t i = 0; i < count; i++)
+            powers[i] = y[i] == 1 ? x[i] : powers[i];
+        memcpy(results + start, powers, count * sizeof(double));
+    }
+}
+
+
+double vpow(const double base, const double exponent,
+            const enum vpow_accuracy accuracy)
+{
+    if (exponent == 1)
+        return base;
+    if (accuracy == VPOW_EXACT)
+        return pow(base, exponent);
+    const int precise = accuracy == VPOW_PRECISE;
+    const double t = exponent * vpow_log(base, precise);
+    if (vpow_is_special(base, exponent, t))
+        return pow(base, exponent);
+    return vpow_exp(t, precise);
+}
+
+
+void vpowf_array(const size_t n, const float bases[], const float exponents[],
+                 float results[], const enum vpow_accuracy accuracy)
+{
+    if (accuracy == VPOW_EXACT) {
+        for (size_t i = 0; i < n; i++)
+            results[i] = exponents[i] == 1 ? bases[i] : powf(bases[i], exponents[i]);
+        return;
+    }
+
+    // Blocks as in vpow_array().
+    float ts[BLOCK_SIZE];
+    float powers[BLOCK_SIZE];
+    for (size_t start = 0; start < n; start += BLOCK_SIZE) {
+        const size_t count = n - start < BLOCK_SIZE ? n - start : BLOCK_SIZE;
+        const float *x = bases + start;
+        const float *y = exponents + start;
+        for (size_t i = 0; i < count; i++)
+            ts[i] = y[i] * vpowf_log(x[i]);
+        for (size_t i = 0; i < count; i++)
+            powers[i] = vpowf_exp(ts[i]);
+        int any_special = 0;
+        for (size_t i = 0; i < count; i++)
+            any_special |= vpowf_is_special(x[i], y[i], ts[i]);
+        if (any_special) {
+            for (size_t i = 0; i < count; i++)
+                if (vpowf_is_special(x[i], y[i], ts[i]))
+                    powers[i] = powf(x[i], y[i]);
+        }
+        for (size_t i = 0; i < count; i++)
+            powers[i] = y[i] == 1 ? x[i] : powers[i];
+        memcpy(results + start, powers, count * sizeof(float));
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file vpow.h
+ *
+ * Power function kernels for arrays of bases and exponents.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Accuracy tier of the power function kernels.
+ */
+enum vpow_accuracy {
+    /**
+     * Use the C library's `pow()` (correctly rounded in practice with glibc).
+     */
+    VPOW_EXACT = 0,
+    /**
+     * Use `exp(y*log(x))` with polynomial kernels, to a relative error of
+     * about 1e-12 or better for the range of values in the model.
+     */
+    VPOW_PRECISE = 1,
+    /**
+     * Like #VPOW_PRECISE but with shorter polynomials, to a relative error of
+     * about 1e-7.
+     */
+    VPOW_FAST = 2
+};
+
+/**
+ * Computes `results[i] = pow(bases[i], exponents[i])` for each `i`.
+ *
+ * Exponents equal to 1 are handled exactly (the result is the base) in every
+ * tier. For the polynomial tiers, bases that are not positive normal numbers,
+ * non-finite exponents, and results that would overflow or underflow are
+ * computed with `pow()` instead, so the special cases behave as in the C
+ * library.
+ *
+ * @p results may alias @p bases or @p exponents.
+ *
+ * @param[in] n Number of elements in each array.
+ * @param[in] bases The bases.
+ * @param[in] exponents The exponents.
+ * @param[out] results The array to write the powers.
+ * @param[in] accuracy Accuracy tier to use.
+ */
+void vpow_array(const size_t n, const double bases[], const double exponents[],
+                double results[], const enum vpow_accuracy accuracy);
+
+/**
+ * Returns `pow(base, exponent)` computed with the given accuracy tier.
+ *
+ * This is the single-element version of vpow_array().
+ *
+ * @param[in] base The base.
+ * @param[in] exponent The exponent.
+ * @param[in] accuracy Accuracy tier to use.
+ * @returns The power.
+ */
+double vpow(const double base, const double exponent,
+            const enum vpow_accuracy accuracy);
+
+/**
+ * Computes `results[i] = powf(bases[i], exponents[i])` for each `i` in single
+ * precision.
+ *
+ * This is vpow_array() for floats. #VPOW_EXACT uses the C library's `powf()`,
+ * and both polynomial tiers use the same single precision kernels, to a
+ * relative error of about 1e-6 for the range of values in the model.
+ *
+ * @param[in] n Number of elements in each array.
+ * @param[in] bases The bases.
+ * @param[in] exponents The exponents.
+ * @param[out] results The array to write the powers.
+ * @param[in] accuracy Accuracy tier to use.
+ */
+void vpowf_array(const size_t n, const float bases[], const float exponents[],
+                 float results[], const enum vpow_accuracy accuracy);
@@ -19,6 +19,7 @@
 #include "bt_model.h"
 #include <getopt.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 void usage(const char *program_name)
@@ -39,10 +40,16 @@ void usage(const char *program_name)
         "  -tFLOAT, --penalty-factor-rate=FLOAT    Rate of exponential increase in\n"
         "                                            penalty factor for each generation.\n"
         "  -oFLOAT, --max-roughness-factor=FLOAT   Maximum roughness penalty factor.\n"
+        "  -eMETHOD, --integrator=METHOD           Method used to integrate the model:\n"
+        "                                            euler (default), rk4, or adaptive.\n"
         "\n"
         "Genetic algorithm:\n"
         "  -nCOUNT, --num-iterations=COUNT     Number of iterations of the genetic\n"
         "                                         algorithm.\n"
+        "  -jCOUNT, --seed-threads=COUNT       Number of iterations to run concurrently.\n"
+        "                                        The default (0) divides the threads\n"
+        "                                        between iterations and evaluation\n"
+        "                                        automatically.\n"
         "  -gCOUNT, --max-generations=COUNT    Maximum number of generations.\n"
         "  -zCOUNT, --population-size=COUNT    Number of individuals in each generation.\n"
         "  -kCOUNT, --cull-keep=COUNT          Number of individuals from the previous\n"
@@ -59,6 +66,43 @@ void usage(const char *program_name)
         "                                        particular stress value.\n"
         "  -wFLOAT, --mutate-change-rate=FLOAT Rate of exponential change in\n"
         "                                        mutation parameters for each generation.\n"
+        "  -x, --segment-crossover             Use two-point crossover instead of\n"
+        "                                        BLX-alpha crossover.\n"
+        "  -vCOUNT, --mutate-window=COUNT      Mutate windows of COUNT consecutive days\n"
+        "                                        by the same amount instead of mutating\n"
+        "                                        days independently (0, the default).\n"
+        "  -ICOUNT, --islands=COUNT            Number of islands to split the population\n"
+        "                                        into (default 1). The islands evolve\n"
+        "                                        concurrently.\n"
+        "  -MCOUNT, --migration-interval=COUNT Number of generations between migrations\n"
+        "                                        (default 10).\n"
+        "  -ECOUNT, --migrants=COUNT           Number of the best designs each island\n"
+        "                                        sends to its neighbors (default 2).\n"
+        "  -TNAME, --topology=NAME             Migration topology: ring (default) or\n"
+        "                                        full.\n"
+        "\n"
+        "Differential evolution:\n"
+        "  -DSTRATEGY, --differential-evolution=STRATEGY\n"
+        "                                      Replace the crossover, mutation, and\n"
+        "                                        culling of the genetic algorithm with\n"
+        "                                        differential evolution with adaptive\n"
+        "                                        parameters, using the given mutation\n"
+        "                                        strategy: rand1bin or pbest\n"
+        "                                        (current-to-pbest/1 with an archive).\n"
+        "                                        The penalty and roughness schedules\n"
+        "                                        and the number of evaluations per\n"
+        "                                        generation stay the same.\n"
+        "  -BFLOAT, --pbest-fraction=FLOAT     Fraction of the best designs that\n"
+        "                                        pbest draws from (default 0.11).\n"
+        "\n"
+        "Polishing:\n"
+        "  -NCOUNT, --polish-designs=COUNT     Number of the best designs of the final\n"
+        "                                        population to polish with projected\n"
+        "                                        L-BFGS steps along the adjoint gradient\n"
+        "                                        (default 0). Requires the euler\n"
+        "                                        integrator.\n"
+        "  -SCOUNT, --polish-iterations=COUNT  Maximum number of iterations per\n"
+        "                                        polished design (default 100).\n"
         "\n"
         "Extra output:\n"
         "  -i[PATTERN], --output-integration[=PATTERN]\n"
@@ -77,6 +121,38 @@ void usage(const char *program_name)
         "                                        specifies the names of the files, where\n"
         "                                        %%zd is replaced by the iteration\n"
         "                                        number.\n"
+        "  -FFORMAT, --output-format=FORMAT    Format of the files written by -i, -p,\n"
+        "                                        and -c: tsv (default) or binary. Use\n"
+        "                                        bt_table_tsv to convert binary files\n"
+        "                                        to TSV.\n"
+        "\n"
+        "Checkpoints:\n"
+        "  -C[PATTERN], --checkpoint[=PATTERN] Save the state of each iteration to a\n"
+        "                                        checkpoint file. PATTERN specifies the\n"
+        "                                        names of the files, where %%zd is\n"
+        "                                        replaced by the iteration number.\n"
+        "  -KCOUNT, --checkpoint-interval=COUNT\n"
+        "                                      Number of generations between\n"
+        "                                        checkpoints (default 100). The last\n"
+        "                                        generation is always saved.\n"
+        "  -R, --resume                        Continue each iteration from its\n"
+        "                                        checkpoint, if there is one.\n"
+        "\n"
+        "Profiling:\n"
+        "  -P, --profile                       Write the time spent in each phase of the\n"
+        "                                        GA, and by each thread, after each\n"
+        "                                        iteration.\n"
+        "  -H, --perf-counters                 Also count the cycles, instructions, L1\n"
+        "                                        data and last level cache misses, and\n"
+        "                                        branch misses of each phase with\n"
+        "                                        perf_event_open, and write them with\n"
+        "                                        the profile.\n"
+        "  -J[PATTERN], --output-trace[=PATTERN]\n"
+        "                                      Output a Chrome trace (JSON) of the\n"
+        "                                        phases from each iteration. PATTERN\n"
+        "                                        specifies the names of the files, where\n"
+        "                                        %%zd is replaced by the iteration\n"
+        "                                        number.\n"
         "\n"
         "Help:\n"
         "  -d, --debug                         Show debug output.\n"
@@ -106,7 +182,9 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
     args->init_penalty_factor = 6e-7;
     args->penalty_factor_rate = 1.02;
     args->max_roughness_factor = 0;
+    args->integrator = BT_ODE_EULER;
     args->num_iterations = 1;
+    args->seed_threads = 0;
     args->max_generations = 2000;
     args->population_size = 500;
     args->cull_keep = args->population_size / 10;
@@ -115,9 +193,27 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
     args->init_mutate_stdev = 10;
     args->init_mutate_probability = 0.1;
     args->mutate_change_rate = 0.999;
+    args->segment_crossover = false;
+    args->mutate_window = 0;
+    args->islands.num_islands = 1;
+    args->islands.migration_interval = 10;
+    args->islands.num_migrants = 2;
+    args->islands.topology = GA_TOPOLOGY_RING;
+    args->differential_evolution = false;
+    args->de.strategy = DE_STRATEGY_CURRENT_TO_PBEST_1;
+    args->de.pbest_fraction = 0.11;
+    args->polish.num_designs = 0;
+    args->polish.max_iterations = 100;
     args->output_integration = NULL;
     args->output_population = NULL;
     args->output_convergence = NULL;
+    args->output_format = BT_TABLE_TSV;
+    args->checkpoint = NULL;
+    args->checkpoint_interval = 100;
+    args->resume = false;
+    args->profile = false;
+    args->perf_counters = false;
+    args->output_trace = NULL;
     args->debug = false;
 
     // Options
@@ -127,7 +223,9 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
         {"init-penalty-factor", 1, NULL, 'r'},
         {"penalty-factor-rate", 1, NULL, 't'},
         {"max-roughness-factor", 1, NULL, 'o'},
+        {"integrator", 1, NULL, 'e'},
         {"num-iterations", 1, NULL, 'n'},
+        {"seed-threads", 1, NULL, 'j'},
         {"max-generations", 1, NULL, 'g'},
         {"population-size", 1, NULL, 'z'},
         {"cull-keep", 1, NULL, 'k'},
@@ -136,9 +234,26 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
         {"init-mutate-stdev", 1, NULL, 'm'},
         {"init-mutate-probability", 1, NULL, 'l'},
         {"mutate-change-rate", 1, NULL, 'w'},
+        {"segment-crossover", 0, NULL, 'x'},
+        {"mutate-window", 1, NULL, 'v'},
+        {"islands", 1, NULL, 'I'},
+        {"migration-interval", 1, NULL, 'M'},
+        {"migrants", 1, NULL, 'E'},
+        {"topology", 1, NULL, 'T'},
+        {"differential-evolution", 1, NULL, 'D'},
+        {"pbest-fraction", 1, NULL, 'B'},
+        {"polish-designs", 1, NULL, 'N'},
+        {"polish-iterations", 1, NULL, 'S'},
         {"output-integration", 2, NULL, 'i'},
         {"output-population", 2, NULL, 'p'},
         {"output-convergence", 2, NULL, 'c'},
+        {"output-format", 1, NULL, 'F'},
+        {"checkpoint", 2, NULL, 'C'},
+        {"checkpoint-interval", 1, NULL, 'K'},
+        {"resume", 0, NULL, 'R'},
+        {"profile", 0, NULL, 'P'},
+        {"perf-counters", 0, NULL, 'H'},
+        {"output-trace", 2, NULL, 'J'},
         {"debug", 0, NULL, 'd'},
         {"help", 0, NULL, 'h'},
         {NULL}
@@ -146,7 +261,7 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
 
     // Parse options
     int c;
-    while ((c = getopt_long(argc, argv, "f:y:r:t:o:n:g:z:k:a:m:l:w:i::p::c::dh", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "f:y:r:t:o:e:n:j:g:z:k:a:m:l:w:xv:I:M:E:T:D:B:N:S:i::p::c::F:C::K:RPHJ::dh", long_options, NULL)) != -1) {
         switch (c) {
         case 'f':
             if (sscanf(optarg, "%zd", &args->num_days) != 1)
@@ -168,10 +283,21 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
             if (sscanf(optarg, "%lf", &args->max_roughness_factor) != 1)
                 usage(argv[0]);
             break;
+        case 'e': {
+            int method = bt_ode_method_from_name(optarg);
+            if (method < 0)
+                usage(argv[0]);
+            args->integrator = method;
+            break;
+        }
         case 'n':
             if (sscanf(optarg, "%zd", &args->num_iterations) != 1)
                 usage(argv[0]);
             break;
+        case 'j':
+            if (sscanf(optarg, "%d", &args->seed_threads) != 1)
+                usage(argv[0]);
+            break;
         case 'g':
             if (sscanf(optarg, "%zd", &args->max_generations) != 1)
                 usage(argv[0]);
@@ -204,6 +330,53 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
             if (sscanf(optarg, "%lf", &args->mutate_change_rate) != 1)
                 usage(argv[0]);
             break;
+        case 'x':
+            args->segment_crossover = true;
+            break;
+        case 'v':
+            if (sscanf(optarg, "%zd", &args->mutate_window) != 1)
+                usage(argv[0]);
+            break;
+        case 'I':
+            if (sscanf(optarg, "%zd", &args->islands.num_islands) != 1)
+                usage(argv[0]);
+            break;
+        case 'M':
+            if (sscanf(optarg, "%zd", &args->islands.migration_interval) != 1)
+                usage(argv[0]);
+            break;
+        case 'E':
+            if (sscanf(optarg, "%zd", &args->islands.num_migrants) != 1)
+                usage(argv[0]);
+            break;
+        case 'T':
+            if (strcmp(optarg, "ring") == 0)
+                args->islands.topology = GA_TOPOLOGY_RING;
+            else if (strcmp(optarg, "full") == 0)
+                args->islands.topology = GA_TOPOLOGY_FULL;
+            else
+                usage(argv[0]);
+            break;
+        case 'D': {
+            int strategy = de_strategy_from_name(optarg);
+            if (strategy < 0)
+                usage(argv[0]);
+            args->differential_evolution = true;
+            args->de.strategy = strategy;
+            break;
+        }
+        case 'B':
+            if (sscanf(optarg, "%lf", &args->de.pbest_fraction) != 1)
+                usage(argv[0]);
+            break;
+        case 'N':
+            if (sscanf(optarg, "%zd", &args->polish.num_designs) != 1)
+                usage(argv[0]);
+            break;
+        case 'S':
+            if (sscanf(optarg, "%zd", &args->polish.max_iterations) != 1)
+                usage(argv[0]);
+            break;
         case 'i':
             if (optarg)
                 args->output_integration = optarg;
@@ -222,6 +395,35 @@ void parse_arguments(const int argc, char * const argv[], arguments_t *args)
             else
                 args->output_convergence = "convergence%04zd.tsv";
             break;
+        case 'F':
+            if (bt_table_parse_format(optarg, &args->output_format) != 0)
+                usage(argv[0]);
+            break;
+        case 'C':
+            if (optarg)
+                args->checkpoint = optarg;
+            else
+                args->checkpoint = "checkpoint%04zd.bin";
+            break;
+        case 'K':
+            if (sscanf(optarg, "%zd", &args->checkpoint_interval) != 1)
+                usage(argv[0]);
+            break;
+        case 'R':
+            args->resume = true;
+            break;
+        case 'P':
+            args->profile = true;
+            break;
+        case 'H':
+            args->perf_counters = true;
+            break;
+        case 'J':
+            if (optarg)
+                args->output_trace = optarg;
+            else
+                args->output_trace = "trace%04zd.json";
+            break;
         case 'd':
             args->debug = true;
             break;
@@ -259,7 +461,9 @@ void fprintf_arguments(FILE *stream, const arguments_t *args)
     fprintf(stream, "init-penalty-factor = %lf\n", args->init_penalty_factor);
     fprintf(stream, "penalty-factor-rate = %lf\n", args->penalty_factor_rate);
     fprintf(stream, "max-roughness-factor = %lf\n", args->max_roughness_factor);
+    fprintf(stream, "integrator = %s\n", bt_ode_method_names[args->integrator]);
     fprintf(stream, "num-iterations = %zd\n", args->num_iterations);
+    fprintf(stream, "seed-threads = %d\n", args->seed_threads);
     fprintf(stream, "max-generations = %zd\n", args->max_generations);
     fprintf(stream, "population-size = %zd\n", args->population_size);
     fprintf(stream, "cull-keep = %zd\n", args->cull_keep);
@@ -268,8 +472,28 @@ void fprintf_arguments(FILE *stream, const arguments_t *args)
     fprintf(stream, "init-mutate-stdev = %lf\n", args->init_mutate_stdev);
     fprintf(stream, "init-mutate-probability = %lf\n", args->init_mutate_probability);
     fprintf(stream, "mutate-change-rate = %lf\n", args->mutate_change_rate);
+    fprintf(stream, "segment-crossover = %d\n", args->segment_crossover);
+    fprintf(stream, "mutate-window = %zd\n", args->mutate_window);
+    fprintf(stream, "islands = %zd\n", args->islands.num_islands);
+    fprintf(stream, "migration-interval = %zd\n", args->islands.migration_interval);
+    fprintf(stream, "migrants = %zd\n", args->islands.num_migrants);
+    fprintf(stream, "topology = %s\n",
+            args->islands.topology == GA_TOPOLOGY_RING ? "ring" : "full");
+    fprintf(stream, "differential-evolution = %s\n",
+            args->differential_evolution ? de_strategy_names[args->de.strategy] : "(null)");
+    fprintf(stream, "pbest-fraction = %lf\n", args->de.pbest_fraction);
+    fprintf(stream, "polish-designs = %zd\n", args->polish.num_designs);
+    fprintf(stream, "polish-iterations = %zd\n", args->polish.max_iterations);
     fprintf(stream, "output-integration = %s\n", args->output_integration);
     fprintf(stream, "output-population = %s\n", args->output_population);
     fprintf(stream, "output-convergence = %s\n", args->output_convergence);
+    fprintf(stream, "output-format = %s\n",
+            args->output_format == BT_TABLE_TSV ? "tsv" : "binary");
+    fprintf(stream, "checkpoint = %s\n", args->checkpoint);
+    fprintf(stream, "checkpoint-interval = %zd\n", args->checkpoint_interval);
+    fprintf(stream, "resume = %d\n", args->resume);
+    fprintf(stream, "profile = %d\n", args->profile);
+    fprintf(stream, "perf-counters = %d\n", args->perf_counters);
+    fprintf(stream, "output-trace = %s\n", args->output_trace);
     fprintf(stream, "debug = %d\n", args->debug);
 }
@@ -23,6 +23,11 @@
 
 #pragma once
 
+#include "bt_de.h"
+#include "bt_ga.h"
+#include "bt_ode.h"
+#include "bt_polish.h"
+#include "bt_table.h"
 #include <stdbool.h>
 #include <stdio.h>
 
@@ -40,9 +45,11 @@ typedef struct arguments_t {
     double init_penalty_factor;
     double penalty_factor_rate;
     double max_roughness_factor;
+    enum bt_ode_method integrator;
 
     // Genetic algorithm
     size_t num_iterations;
+    int seed_threads;
     size_t max_generations;
     size_t population_size;
     size_t cull_keep;
@@ -51,11 +58,32 @@ typedef struct arguments_t {
     double init_mutate_stdev;
     double init_mutate_probability;
     double mutate_change_rate;
+    bool segment_crossover;
+    size_t mutate_window;
+    ga_islands_t islands;
+
+    // Differential evolution
+    bool differential_evolution;
+    de_options_t de;
+
+    // Polishing
+    bt_polish_options_t polish;
 
     // Extra output
     char *output_integration;
     char *output_population;
     char *output_convergence;
+    enum bt_table_format output_format;
+
+    // Checkpoints
+    char *checkpoint;
+    size_t checkpoint_interval;
+    bool resume;
+
+    // Profiling
+    bool profile;
+    bool perf_counters;
+    char *output_trace;
 
     // Debug
     bool debug;
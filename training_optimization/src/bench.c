@@ -0,0 +1,235 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bench.c
+ *
+ * Benchmarks of the objective function and the GA operators.
+ *
+ * Writes a TSV table to stdout with one row per measurement: the kernel, the
+ * number of OpenMP threads, the population size, the number of days, the
+ * number of repetitions, the total time in seconds, and the number of designs
+ * processed per second. The thread counts are the powers of 2 up to
+ * `omp_get_max_threads()` (set with `OMP_NUM_THREADS`), and that maximum.
+ *
+ * The `update_obj_func` kernel integrates every design from the first day,
+ * while `generation` is a whole generation of ga_generation(), which reuses
+ * the cached states of the parents.
+ *
+ * Usage: bench [PARAMS_PATH]
+ */
+
+#include "bt_ga.h"
+#include "bt_model.h"
+#include "bt_params.h"
+#include "bt_population.h"
+#include "rng_stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Minimum total time of each measurement, in seconds. The number of
+ * repetitions is doubled until the kernel runs for at least this long.
+ */
+#ifndef BENCH_MIN_SECONDS
+#define BENCH_MIN_SECONDS 0.5
+#endif
+
+#define MAX_DAILY_STRESS 300
+#define PENALTY_FACTOR 6e-7
+#define ROUGHNESS_DAYS 14
+
+static const size_t population_sizes[] = {100, 1000, 10000};
+static const size_t num_days_list[] = {28, 84, 365};
+
+/**
+ * Buffers shared by the kernels.
+ */
+typedef struct bench_t {
+    const bt_params_t *parameters;
+    bt_population_t *designs;
+    bt_population_t *children;
+    size_t *winners;
+    ga_variation_t variation;
+    uint64_t key;
+} bench_t;
+
+
+static double wall_time()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+
+static void run_update_obj_func(bench_t *bench)
+{
+    bt_population_t *children = bench->children;
+    memset(children->num_valid_states, 0, children->nmemb * sizeof(size_t));
+    bt_model_update_obj_func(bench->parameters, ROUGHNESS_DAYS, PENALTY_FACTOR, 0,
+                             MAX_DAILY_STRESS, children);
+}
+
+
+static void run_tournament_select(bench_t *bench)
+{
+    ga_tournament_select(bench->designs->nmemb, bench->designs->fitnesses,
+                         bench->designs->nmemb, bench->winners, bench->key++);
+}
+
+
+static void run_blx_alpha(bench_t *bench)
+{
+    ga_blx_alpha(bench->designs->nmemb, bench->designs->num_days, bench->designs->stresses,
+                 bench->winners, bench->children->stresses, bench->variation.blx_alpha,
+                 0, MAX_DAILY_STRESS, bench->key++);
+}
+
+
+static void run_mutate(bench_t *bench)
+{
+    ga_mutate(bench->children->nmemb, bench->children->num_days, bench->children->stresses,
+              bench->variation.mutate_stdev, 0, MAX_DAILY_STRESS,
+              bench->variation.mutate_probability, bench->key++);
+}
+
+
+static void run_cull(bench_t *bench)
+{
+    ga_cull(bench->designs, bench->children, bench->designs->nmemb / 10);
+}
+
+
+static void run_generation(bench_t *bench)
+{
+    ga_generation(bench->designs, bench->children, bench->designs->nmemb / 10,
+                  &bench->variation, bench->parameters, ROUGHNESS_DAYS, PENALTY_FACTOR, 0,
+                  MAX_DAILY_STRESS, bench->key++, NULL);
+}
+
+
+/*
+ * Runs the kernel, doubling the number of repetitions until they take long
+ * enough, and writes a row of results. The first run is also the warm-up.
+ */
+static void measure(const char *name, void (*kernel)(bench_t *), bench_t *bench,
+                    const int threads)
+{
+    double start = wall_time();
+    kernel(bench);
+    double seconds = wall_time() - start;
+    size_t repetitions = 1;
+    while (seconds < BENCH_MIN_SECONDS) {
+        repetitions *= 2;
+        start = wall_time();
+        for (size_t i = 0; i < repetitions; i++)
+            kernel(bench);
+        seconds = wall_time() - start;
+    }
+    printf("%s\t%d\t%zd\t%zd\t%zd\t%lf\t%lf\n", name, threads, bench->designs->nmemb,
+           bench->designs->num_days, repetitions, seconds,
+           repetitions * bench->designs->nmemb / seconds);
+    fflush(stdout);
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *params_path = "params.tsv";
+    if (argc == 2) {
+        params_path = argv[1];
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [PARAMS_PATH]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    bt_params_t *parameters = bt_params_load(params_path);
+    if (parameters == NULL) {
+        fprintf(stderr, "Unable to parse parameters file: %s.\n", params_path);
+        return EXIT_FAILURE;
+    }
+
+    // Thread counts to measure.
+    int max_threads = 1;
+#ifdef _OPENMP
+    max_threads = omp_get_max_threads();
+#endif
+    int thread_counts[8 * sizeof(int)];
+    size_t num_thread_counts = 0;
+    for (int threads = 1; threads < max_threads; threads *= 2)
+        thread_counts[num_thread_counts++] = threads;
+    thread_counts[num_thread_counts++] = max_threads;
+
+    bench_t bench = {
+        .parameters = parameters,
+        .variation = {
+            .segment_crossover = false,
+            .blx_alpha = 0.5,
+            .mutate_window = 0,
+            .mutate_stdev = 10,
+            .mutate_probability = 0.1,
+            .min = 0,
+            .max = MAX_DAILY_STRESS
+        },
+        .key = rng_stream_key(0, 1)
+    };
+
+    printf("kernel\tthreads\tpopulation_size\tnum_days\trepetitions\tseconds\tdesigns_per_second\n");
+    for (size_t t = 0; t < num_thread_counts; t++) {
+#ifdef _OPENMP
+        omp_set_num_threads(thread_counts[t]);
+#endif
+        for (size_t p = 0; p < sizeof(population_sizes) / sizeof(size_t); p++) {
+            for (size_t d = 0; d < sizeof(num_days_list) / sizeof(size_t); d++) {
+                const size_t nmemb = population_sizes[p];
+                const size_t num_days = num_days_list[d];
+                bench.designs = bt_population_alloc(nmemb, num_days);
+                bench.children = bt_population_alloc(nmemb, num_days);
+                bench.winners = malloc(nmemb * sizeof(size_t));
+                ga_init_stresses(nmemb, num_days, MAX_DAILY_STRESS, bench.designs->stresses,
+                                 bench.key++);
+                bt_model_update_obj_func(parameters, ROUGHNESS_DAYS, PENALTY_FACTOR, 0,
+                                         MAX_DAILY_STRESS, bench.designs);
+
+                // The operators in the order of a generation, so each one has
+                // valid inputs.
+                measure("tournament_select", run_tournament_select, &bench, thread_counts[t]);
+                measure("blx_alpha", run_blx_alpha, &bench, thread_counts[t]);
+                measure("mutate", run_mutate, &bench, thread_counts[t]);
+                measure("update_obj_func", run_update_obj_func, &bench, thread_counts[t]);
+                measure("cull", run_cull, &bench, thread_counts[t]);
+                measure("generation", run_generation, &bench, thread_counts[t]);
+
+                free(bench.winners);
+                bt_population_free(bench.children);
+                bt_population_free(bench.designs);
+            }
+        }
+    }
+
+    bt_params_free(parameters);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_checkpoint.h
+ *
+ * Checkpoint files holding the state of a GA run.
+ *
+ * A checkpoint is #BT_CHECKPOINT_MAGIC followed by a sequence of
+ * little-endian unsigned 64-bit integers and IEEE 754 doubles, in an order
+ * defined by the caller. A checkpoint is written to a temporary file that
+ * replaces the checkpoint only once it's complete and on disk, so a run that
+ * is killed while writing one leaves the previous checkpoint intact.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * The first eight bytes of a checkpoint file.
+ */
+#define BT_CHECKPOINT_MAGIC "BTCKPT01"
+
+/**
+ * A checkpoint file being written or read.
+ *
+ * Errors are sticky: once a read or write fails, the following ones are
+ * ignored, and bt_checkpoint_commit() or bt_checkpoint_close() reports the
+ * failure.
+ */
+typedef struct bt_checkpoint_t {
+    /**
+     * The file being written or read.
+     */
+    FILE *stream;
+    /**
+     * Path of the checkpoint.
+     */
+    char *path;
+    /**
+     * Path of the temporary file being written, or `NULL` when reading.
+     */
+    char *temp_path;
+    /**
+     * Whether a read or write has failed.
+     */
+    bool failed;
+} bt_checkpoint_t;
+
+/**
+ * Starts writing a checkpoint, which replaces the one at @p path when it's
+ * committed.
+ *
+ * The returned pointer must be freed with bt_checkpoint_commit().
+ *
+ * @param[in] path Path of the checkpoint.
+ * @returns A pointer to the checkpoint, or `NULL` if the temporary file
+ *   couldn't be created.
+ */
+bt_checkpoint_t *bt_checkpoint_create(const char *path);
+
+/**
+ * Flushes a checkpoint to disk and atomically replaces the previous one.
+ *
+ * @param[in] checkpoint The checkpoint, which is freed.
+ * @returns 0 on success, or -1 on failure, in which case the previous
+ *   checkpoint is left in place.
+ */
+int bt_checkpoint_commit(bt_checkpoint_t *checkpoint);
+
+/**
+ * Opens a checkpoint for reading.
+ *
+ * The returned pointer must be freed with bt_checkpoint_close().
+ *
+ * @param[in] path Path of the checkpoint.
+ * @returns A pointer to the checkpoint, or `NULL` if the file doesn't exist
+ *   or isn't a checkpoint.
+ */
+bt_checkpoint_t *bt_checkpoint_open(const char *path);
+
+/**
+ * Closes a checkpoint opened with bt_checkpoint_open().
+ *
+ * @param[in] checkpoint The checkpoint, which is freed.
+ * @returns 0 if every read succeeded and the whole file was read, or -1
+ *   otherwise.
+ */
+int bt_checkpoint_close(bt_checkpoint_t *checkpoint);
+
+/**
+ * Writes an integer to a checkpoint.
+ *
+ * @param[in,out] checkpoint The checkpoint.
+ * @param[in] value The value.
+ */
+void bt_checkpoint_put_size(bt_checkpoint_t *checkpoint, const size_t value);
+
+/**
+ * Writes an array of doubles to a checkpoint.
+ *
+ * @param[in,out] checkpoint The checkpoint.
+ * @param[in] n Number of values.
+ * @param[in] values Array of values.
+ */
+void bt_checkpoint_put_doubles(bt_checkpoint_t *checkpoint, const size_t n,
+                               const double values[]);
+
+/**
+ * Reads an integer from a checkpoint.
+ *
+ * @param[in,out] checkpoint The checkpoint.
+ * @returns The value, or 0 if the read failed.
+ */
+size_t bt_checkpoint_get_size(bt_checkpoint_t *checkpoint);
+
+/**
+ * Reads an array of doubles from a checkpoint.
+ *
+ * @param[in,out] checkpoint The checkpoint.
+ * @param[in] n Number of values.
+ * @param[out] values Array of values, which are set to 0 if the read fails.
+ */
+void bt_checkpoint_get_doubles(bt_checkpoint_t *checkpoint, const size_t n,
+                               double values[]);
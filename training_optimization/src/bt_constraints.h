@@ -29,7 +29,7 @@
 #pragma once
 
 #include "bt_population.h"
-#include <stdio.h>
+#include <stddef.h>
 
 /**
  * Updates the penalty value.
@@ -48,21 +48,55 @@ penalty_t bt_constraints_penalty_step(
     const stress_t training_stress, const stress_t max_daily_stress);
 
 /**
- * Writes the portion of a TSV file header corresponding to this constraint function.
+ * Partial derivatives of the penalty that one call to
+ * bt_constraints_penalty_step() adds.
+ */
+typedef struct bt_constraints_gradient_t {
+    double performance;
+    double fitness;
+    double fatigue;
+    double training_stress;
+} bt_constraints_gradient_t;
+
+/**
+ * Computes the partial derivatives of the penalty that
+ * bt_constraints_penalty_step() adds, for the adjoint of the model.
+ *
+ * The penalties aren't differentiable where a constraint becomes active; the
+ * derivatives of the inactive side (i.e. 0) are used there.
  *
- * @param[in,out] stream The stream to write to.
+ * @param[in] performance The performance prediction from the nonlinear model.
+ * @param[in] fitness The fitness prediction from the nonlinear model.
+ * @param[in] fatigue The fatigue prediction from the nonlinear model.
+ * @param[in] training_stress The training stress for the whole day.
+ * @param[in] max_daily_stress The maximum daily training stress.
+ * @returns The partial derivatives of the added penalty.
+ */
+bt_constraints_gradient_t bt_constraints_penalty_gradient(
+    const performance_t performance, const performance_t fitness,
+    const performance_t fatigue, const stress_t training_stress,
+    const stress_t max_daily_stress);
+
+/**
+ * Number of values that this constraint function reports for each day.
+ */
+extern const size_t bt_constraints_num_columns;
+
+/**
+ * Names of the values that this constraint function reports, used as column
+ * names in the output files.
  */
-void bt_constraints_print_header(FILE *stream);
+extern const char *const bt_constraints_column_names[];
 
 /**
- * Writes the portion of a TSV file body corresponding to this constraint function.
+ * Computes the values that this constraint function reports for a day.
  *
- * @param[in,out] stream The stream to write to.
+ * @param[out] values Array of #bt_constraints_num_columns values.
  * @param[in] performance The performance prediction from the nonlinear model.
  * @param[in] fitness The fitness prediction from the nonlinear model.
  * @param[in] fatigue The fatigue prediction from the nonlinear model.
  * @param[in] max_daily_stress The maximum daily training stress.
  */
-void bt_constraints_print_value(
-    FILE *stream, const performance_t performance, const performance_t fitness,
+void bt_constraints_values(
+    double values[], const performance_t performance, const performance_t fitness,
     const performance_t fatigue, const stress_t max_daily_stress);
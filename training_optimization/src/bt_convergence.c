@@ -0,0 +1,108 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_convergence.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define NUM_COLUMNS BT_CONVERGENCE_NUM_COLUMNS
+
+
+static const char *const column_names[NUM_COLUMNS] = {
+    "generation", "min", "q1", "median", "q3", "max"
+};
+
+static const enum bt_table_column_type column_types[NUM_COLUMNS] = {
+    BT_TABLE_INTEGER, BT_TABLE_DOUBLE, BT_TABLE_DOUBLE, BT_TABLE_DOUBLE,
+    BT_TABLE_DOUBLE, BT_TABLE_DOUBLE
+};
+
+
+bt_convergence_t *bt_convergence_open(const char *path, const enum bt_table_format format)
+{
+    FILE *stream = fopen(path, "w");
+    if (stream == NULL)
+        return NULL;
+    bt_convergence_t *log = calloc(1, sizeof(bt_convergence_t));
+    log->stream = stream;
+    log->format = format;
+    log->buffer = malloc(BT_CONVERGENCE_BUFFER_SIZE);
+    setvbuf(log->stream, log->buffer, _IOFBF, BT_CONVERGENCE_BUFFER_SIZE);
+    if (format == BT_TABLE_TSV) {
+        for (size_t j = 0; j < NUM_COLUMNS; j++)
+            fprintf(log->stream, j > 0 ? "\t%s" : "%s", column_names[j]);
+        fprintf(log->stream, "\n");
+    }
+    return log;
+}
+
+
+static void bt_convergence_append(bt_convergence_t *log, const double row[NUM_COLUMNS])
+{
+    if (log->num_rows == log->capacity) {
+        log->capacity = log->capacity > 0 ? 2 * log->capacity : 256;
+        log->rows = realloc(log->rows, log->capacity * NUM_COLUMNS * sizeof(double));
+    }
+    memcpy(log->rows + log->num_rows * NUM_COLUMNS, row, NUM_COLUMNS * sizeof(double));
+    log->num_rows++;
+    if (log->format == BT_TABLE_TSV) {
+        fprintf(log->stream, "%zd\t%lf\t%lf\t%lf\t%lf\t%lf\n", (size_t)row[0],
+                row[1], row[2], row[3], row[4], row[5]);
+    }
+}
+
+
+void bt_convergence_write(bt_convergence_t *log, const size_t generation,
+                          const size_t nmemb, const double fitnesses[])
+{
+    static const double qs[] = {0., 0.25, 0.5, 0.75, 1.};
+    double row[NUM_COLUMNS];
+    row[0] = generation;
+    stats_quantiles(row + 1, qs, 5, fitnesses, nmemb);
+    bt_convergence_append(log, row);
+}
+
+
+void bt_convergence_restore(bt_convergence_t *log, const size_t num_rows,
+                            const double rows[])
+{
+    for (size_t i = 0; i < num_rows; i++)
+        bt_convergence_append(log, rows + i * NUM_COLUMNS);
+}
+
+
+void bt_convergence_close(bt_convergence_t *log)
+{
+    if (log == NULL)
+        return;
+
+    if (log->format == BT_TABLE_BINARY) {
+        // The table is column-major, so transpose the rows.
+        double *values = malloc((log->num_rows > 0 ? log->num_rows : 1) * NUM_COLUMNS * sizeof(double));
+        for (size_t i = 0; i < log->num_rows; i++)
+            for (size_t j = 0; j < NUM_COLUMNS; j++)
+                values[j * log->num_rows + i] = log->rows[i * NUM_COLUMNS + j];
+        bt_table_write(log->stream, NUM_COLUMNS, log->num_rows, column_names, column_types, values);
+        free(values);
+    }
+    free(log->rows);
+    fclose(log->stream);
+    free(log->buffer);
+    free(log);
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_de.h"
+#include "bt_ga.h"
+#include "bt_model.h"
+#include "stats.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+const char *de_strategy_names[DE_STRATEGY_COUNT] = {
+    "rand1bin",
+    "pbest"
+};
+
+
+int de_strategy_from_name(const char *name)
+{
+    for (int i = 0; i < DE_STRATEGY_COUNT; i++)
+        if (strcasecmp(de_strategy_names[i], name) == 0)
+            return i;
+    return -1;
+}
+
+
+de_t *de_alloc(const de_options_t *options, const size_t nmemb, const size_t num_days)
+{
+    de_t *de = malloc(sizeof(de_t));
+    de->options = *options;
+    de->nmemb = nmemb;
+    de->num_days = num_days;
+    for (size_t k = 0; k < DE_MEMORY_SIZE; k++) {
+        de->memory_f[k] = 0.5;
+        de->memory_cr[k] = 0.5;
+    }
+    de->memory_index = 0;
+    de->archive = malloc(nmemb * sizeof(stress_t *));
+    de->archive[0] = malloc(nmemb * num_days * sizeof(stress_t));
+    for (size_t i = 1; i < nmemb; i++)
+        de->archive[i] = de->archive[0] + i * num_days;
+    de->archive_size = 0;
+    de->f = malloc(nmemb * sizeof(double));
+    de->cr = malloc(nmemb * sizeof(double));
+    return de;
+}
+
+
+void de_free(de_t *de)
+{
+    if (de == NULL)
+        return;
+
+    free(de->archive[0]);
+    free(de->archive);
+    free(de->f);
+    free(de->cr);
+    free(de);
+}
+
+
+/*
+ * Returns a random index in [0, n) other than the given ones.
+ */
+static inline size_t draw_other(const size_t n, const size_t not1, const size_t not2,
+                                rng_stream_t *rng)
+{
+    size_t r;
+    do {
+        r = rng_stream_interval(n - 1, rng);
+    } while (r == not1 || r == not2);
+    return r;
+}
+
+
+/*
+ * Generates trial design i into children, drawing from the child i of key.
+ * sorted_indices sorts the parents by fitness, for current-to-pbest/1.
+ */
+static void de_trial(de_t *de, const bt_population_t *parents, bt_population_t *children,
+                     const size_t sorted_indices[], const size_t num_pbest,
+                     const stress_t max, const uint64_t key, const size_t i)
+{
+    const size_t nmemb = de->nmemb;
+    const size_t num_days = de->num_days;
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, i));
+
+    // Draw the parameters around a random entry of the memories.
+    const size_t slot = rng_stream_interval(DE_MEMORY_SIZE - 1, &rng);
+    const double cr = fmin(fmax(de->memory_cr[slot] + 0.1 * rng_stream_gauss(&rng), 0.), 1.);
+    double f;
+    do {
+        f = de->memory_f[slot] + 0.1 * tan(M_PI * (rng_stream_double(&rng) - 0.5));
+    } while (f <= 0);
+    f = fmin(f, 1.);
+    de->f[i] = f;
+    de->cr[i] = cr;
+
+    // Pick the donors. The mutant is base + f * (to - from), plus f * (pbest
+    // - base) for current-to-pbest/1.
+    const stress_t *target = parents->stresses[i];
+    const stress_t *base, *pbest = NULL, *to, *from;
+    if (de->options.strategy == DE_STRATEGY_CURRENT_TO_PBEST_1) {
+        base = target;
+        pbest = parents->stresses[sorted_indices[nmemb - 1 - rng_stream_interval(num_pbest - 1, &rng)]];
+        const size_t r1 = draw_other(nmemb, i, i, &rng);
+        const size_t r2 = draw_other(nmemb + de->archive_size, i, r1, &rng);
+        to = parents->stresses[r1];
+        from = r2 < nmemb ? parents->stresses[r2] : de->archive[r2 - nmemb];
+    } else {
+        const size_t r1 = draw_other(nmemb, i, i, &rng);
+        const size_t r2 = draw_other(nmemb, i, r1, &rng);
+        size_t r3;
+        do {
+            r3 = rng_stream_interval(nmemb - 1, &rng);
+        } while (r3 == i || r3 == r1 || r3 == r2);
+        base = parents->stresses[r1];
+        to = parents->stresses[r2];
+        from = parents->stresses[r3];
+    }
+
+    // Binomial crossover, taking at least the day j_rand from the mutant.
+    stress_t *trial = children->stresses[i];
+    const size_t j_rand = rng_stream_interval(num_days - 1, &rng);
+    for (size_t j = 0; j < num_days; j++) {
+        if (rng_stream_double(&rng) < cr || j == j_rand) {
+            double mutant = base[j] + f * (to[j] - from[j]);
+            if (pbest)
+                mutant += f * (pbest[j] - base[j]);
+            if (mutant < 0)
+                mutant = target[j] / 2;
+            else if (mutant > max)
+                mutant = (target[j] + max) / 2;
+            trial[j] = mutant;
+        } else {
+            trial[j] = target[j];
+        }
+    }
+    bt_population_inherit_member_states(children, i, parents, i);
+}
+
+
+size_t de_generation(de_t *de, bt_population_t *parents, bt_population_t *children,
+                     const bt_params_t *parameters, const size_t roughness_days,
+                     const fitness_t penalty_factor, const fitness_t roughness_factor,
+                     const stress_t max_daily_stress, const uint64_t key,
+                     bt_profile_t *profile)
+{
+    const size_t nmemb = de->nmemb;
+    const size_t num_days = de->num_days;
+    const bool pbest = de->options.strategy == DE_STRATEGY_CURRENT_TO_PBEST_1;
+
+    // Rank the parents for current-to-pbest/1.
+    bt_profile_mark_t start = bt_profile_now(profile);
+    size_t *sorted_indices = NULL;
+    size_t num_pbest = 0;
+    if (pbest) {
+        sorted_indices = malloc(nmemb * sizeof(size_t));
+        stats_sort_index(sorted_indices, parents->fitnesses, nmemb);
+        num_pbest = de->options.pbest_fraction * nmemb + 0.5;
+        num_pbest = num_pbest < 1 ? 1 : num_pbest < nmemb ? num_pbest : nmemb;
+    }
+    bt_profile_record(profile, BT_PROFILE_SELECT, start);
+
+    // Generate and evaluate the trial designs.
+    start = bt_profile_now(profile);
+    const uint64_t trial_key = rng_stream_key(key, DE_STREAM_TRIAL);
+    #pragma omp parallel for if(nmemb * num_days >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < nmemb; i++)
+        de_trial(de, parents, children, sorted_indices, num_pbest, max_daily_stress, trial_key, i);
+    free(sorted_indices);
+    bt_profile_record(profile, BT_PROFILE_MUTATE, start);
+    start = bt_profile_now(profile);
+    const size_t num_integrated_days = bt_model_update_obj_func(
+        parameters, roughness_days, penalty_factor, roughness_factor, max_daily_stress, children);
+    bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+
+    // Keep each trial design that is at least as fit as its parent, archiving
+    // the parents that it beats, and update the memories with the Lehmer mean
+    // of the successful scale factors and the mean of the successful
+    // crossover rates.
+    start = bt_profile_now(profile);
+    rng_stream_t archive_rng;
+    rng_stream_init(&archive_rng, rng_stream_key(key, DE_STREAM_ARCHIVE));
+    double sum_weights = 0, sum_cr = 0, sum_f = 0, sum_f2 = 0;
+    for (size_t i = 0; i < nmemb; i++) {
+        if (!(children->fitnesses[i] >= parents->fitnesses[i]))
+            continue;
+        const double improvement = children->fitnesses[i] - parents->fitnesses[i];
+        if (improvement > 0 && isfinite(improvement)) {
+            if (pbest) {
+                const size_t slot = de->archive_size < nmemb ? de->archive_size++
+                    : rng_stream_interval(nmemb - 1, &archive_rng);
+                memcpy(de->archive[slot], parents->stresses[i], num_days * sizeof(stress_t));
+            }
+            sum_weights += improvement;
+            sum_cr += improvement * de->cr[i];
+            sum_f += improvement * de->f[i];
+            sum_f2 += improvement * de->f[i] * de->f[i];
+        }
+        bt_population_copy_member(parents, i, children, i);
+    }
+    if (sum_weights > 0) {
+        de->memory_cr[de->memory_index] = sum_cr / sum_weights;
+        de->memory_f[de->memory_index] = sum_f2 / sum_f;
+        de->memory_index = (de->memory_index + 1) % DE_MEMORY_SIZE;
+    }
+    bt_profile_record(profile, BT_PROFILE_CULL, start);
+    return num_integrated_days;
+}
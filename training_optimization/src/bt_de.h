@@ -0,0 +1,185 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_de.h
+ *
+ * Differential evolution with success-history based adaptation of its
+ * parameters (SHADE), as an alternative to the genetic algorithm.
+ */
+
+#pragma once
+
+#include "bt_params.h"
+#include "bt_population.h"
+#include "bt_profile.h"
+#include "rng_stream.h"
+
+/**
+ * Number of entries in the memories of successful scale factors and
+ * crossover rates.
+ */
+#ifndef DE_MEMORY_SIZE
+#define DE_MEMORY_SIZE 6
+#endif
+
+/**
+ * Purposes of the random streams of one generation (see ::ga_stream).
+ */
+enum de_stream {
+    /**
+     * Each trial design draws its scale factor, crossover rate, donors, and
+     * crossover from its own child of this stream.
+     */
+    DE_STREAM_TRIAL = 1,
+    /**
+     * Replacements of random members of the full archive.
+     */
+    DE_STREAM_ARCHIVE = 2
+};
+
+/**
+ * Mutation strategies.
+ */
+enum de_strategy {
+    /**
+     * DE/rand/1/bin: `v = x_r1 + F (x_r2 - x_r3)`.
+     */
+    DE_STRATEGY_RAND_1 = 0,
+    /**
+     * DE/current-to-pbest/1/bin with an external archive: `v = x_i + F
+     * (x_pbest - x_i) + F (x_r1 - x_r2)`, where `x_pbest` is one of the best
+     * designs and `x_r2` may come from the archive of replaced parents.
+     */
+    DE_STRATEGY_CURRENT_TO_PBEST_1 = 1,
+    DE_STRATEGY_COUNT
+};
+
+/**
+ * Names of the strategies, indexed by ::de_strategy.
+ */
+extern const char *de_strategy_names[DE_STRATEGY_COUNT];
+
+/**
+ * Options for differential evolution.
+ */
+typedef struct de_options_t {
+    /**
+     * Mutation strategy.
+     */
+    enum de_strategy strategy;
+    /**
+     * Fraction of the population from which current-to-pbest/1 draws
+     * `x_pbest`.
+     */
+    double pbest_fraction;
+} de_options_t;
+
+/**
+ * State of differential evolution for one population, other than the
+ * population itself.
+ */
+typedef struct de_t {
+    de_options_t options;
+    size_t nmemb;
+    size_t num_days;
+    /**
+     * Memories of the means of the successful scale factors and crossover
+     * rates, updated in turn.
+     */
+    double memory_f[DE_MEMORY_SIZE];
+    double memory_cr[DE_MEMORY_SIZE];
+    size_t memory_index;
+    /**
+     * Parents that were replaced by better trial designs, at most nmemb.
+     */
+    stress_t **archive;
+    size_t archive_size;
+    /**
+     * Scale factor and crossover rate of each trial design.
+     */
+    double *f;
+    double *cr;
+} de_t;
+
+/**
+ * Returns the strategy with the given name (case insensitive).
+ *
+ * @param[in] name Name of the strategy.
+ * @returns The strategy, or -1 if there is no strategy with that name.
+ */
+int de_strategy_from_name(const char *name);
+
+/**
+ * Allocates the state of differential evolution, with all entries of the
+ * memories set to 0.5 and an empty archive.
+ *
+ * @param[in] options Options for differential evolution.
+ * @param[in] nmemb Number of designs in the population, at least 4.
+ * @param[in] num_days Number of training stresses in each design.
+ * @returns The state, to be freed with de_free().
+ */
+de_t *de_alloc(const de_options_t *options, const size_t nmemb, const size_t num_days);
+
+/**
+ * Frees the state of differential evolution.
+ *
+ * @param[in] de The state to free, or `NULL`.
+ */
+void de_free(de_t *de);
+
+/**
+ * Runs one generation of differential evolution: mutation, binomial
+ * crossover, evaluation, and one-to-one selection.
+ *
+ * Each trial design draws its scale factor F from a Cauchy distribution and
+ * its crossover rate CR from a normal distribution around a random entry of
+ * the memories. Mutant values outside `[0, max_daily_stress]` are moved
+ * halfway between the parent value and the bound they crossed. The trial
+ * designs inherit the cached states of their parents and are evaluated
+ * together by bt_model_update_obj_func(). Each trial design replaces its
+ * parent if it is at least as fit, and the parameters of the strictly
+ * better ones update the next entry of the memories (weighted by the
+ * improvement in fitness).
+ *
+ * Like ga_generation(), this evaluates one design per member of the
+ * population, so the two use the same number of evaluations per generation.
+ *
+ * @param[in,out] de The state of differential evolution.
+ * @param[in,out] parents The population of parents, which is replaced by the
+ *   next generation. Its fitnesses must be up to date with @p
+ *   penalty_factor, @p roughness_factor, and @p roughness_days.
+ * @param[out] children The population in which to generate the trial
+ *   designs.
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress, which is
+ *   also the upper bound for any design variable value.
+ * @param[in] key The key of the generation's random streams.
+ * @param[in,out] profile (Optional) Profile in which to record the time of
+ *   each step, or `NULL`.
+ * @returns The total number of days that were integrated.
+ */
+size_t de_generation(de_t *de, bt_population_t *parents, bt_population_t *children,
+                     const bt_params_t *parameters, const size_t roughness_days,
+                     const fitness_t penalty_factor, const fitness_t roughness_factor,
+                     const stress_t max_daily_stress, const uint64_t key,
+                     bt_profile_t *profile);
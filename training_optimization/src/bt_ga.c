@@ -20,28 +20,70 @@
 #include "stats.h"
 #include <assert.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
-#include <string.h>
 
 
 void ga_init_stresses(const size_t nmemb, const size_t num_days,
                       const stress_t max_daily_stress, stress_t **stresses,
-                      rk_state *rng)
+                      const uint64_t key)
 {
-    for (size_t i = 0; i < nmemb; i++)
+    #pragma omp parallel for if(nmemb * num_days >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < nmemb; i++) {
+        rng_stream_t rng;
+        rng_stream_init(&rng, rng_stream_key(key, i));
         for (size_t j = 0; j < num_days; j++)
-            stresses[i][j] = rk_double(rng) * max_daily_stress;
+            stresses[i][j] = rng_stream_double(&rng) * max_daily_stress;
+    }
+}
+
+
+/*
+ * Selects winner i of a tournament selection, drawing from the child i of
+ * key.
+ */
+static inline size_t tournament_select_one(const size_t nmemb, const fitness_t fitnesses[],
+                                           const uint64_t key, const size_t i)
+{
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, i));
+    size_t comp1 = rng_stream_interval(nmemb - 1, &rng);
+    size_t comp2 = rng_stream_interval(nmemb - 1, &rng);
+    return fitnesses[comp1] >= fitnesses[comp2] ? comp1 : comp2;
 }
 
 
 void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
                           const size_t num_winners, size_t winner_indices[],
-                          rk_state *rng)
+                          const uint64_t key)
 {
-    for (size_t i = 0; i < num_winners; i++) {
-        size_t comp1 = rk_interval(nmemb - 1, rng);
-        size_t comp2 = rk_interval(nmemb - 1, rng);
-        winner_indices[i] = fitnesses[comp1] >= fitnesses[comp2] ? comp1 : comp2;
+    #pragma omp parallel for if(2 * num_winners >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < num_winners; i++)
+        winner_indices[i] = tournament_select_one(nmemb, fitnesses, key, i);
+}
+
+
+/*
+ * Crosses one pair of parents by BLX-alpha, drawing from the child pair of
+ * key. c2 may be NULL to make only the first child.
+ */
+static inline void blx_alpha_pair(const size_t design_var_count,
+                                  const stress_t *p1, const stress_t *p2,
+                                  stress_t *c1, stress_t *c2,
+                                  const double alpha, const double min, const double max,
+                                  const uint64_t key, const size_t pair)
+{
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, pair));
+    for (size_t j = 0; j < design_var_count; j++) {
+        double cmin = p1[j] <= p2[j] ? p1[j] : p2[j];  // Select min value
+        double cmax = p1[j] > p2[j] ? p1[j] : p2[j];  // Select max value
+        double range = cmax - cmin;  // Select range
+        double a = cmin - range * alpha;  // Select lower bound
+        double b = cmax + range * alpha;  // Select upper bound
+        c1[j] = fmin(fmax(a + (b - a) * rng_stream_double(&rng), min), max); // Set child design
+        if (c2)
+            c2[j] = fmin(fmax(a + (b - a) * rng_stream_double(&rng), min), max); // Set child design
     }
 }
 
@@ -49,46 +91,135 @@ void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
 void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
                   stress_t *const *const population,
                   const size_t parent_indices[],
-                  double **children,
+                  stress_t **children,
                   const double alpha,
                   const double min, const double max,
-                  rk_state *rng)
+                  const uint64_t key)
+{
+    // With an odd number of designs, the last child has the first winner as
+    // its second parent, and the pair only makes that one child.
+    const size_t num_pairs = (nmemb + 1) / 2;
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t pair = 0; pair < num_pairs; pair++) {
+        const size_t i = 2 * pair;
+        const bool has_second_child = i + 1 < nmemb;
+        blx_alpha_pair(design_var_count, population[parent_indices[i]],
+                       population[parent_indices[has_second_child ? i+1 : 0]], children[i],
+                       has_second_child ? children[i+1] : NULL, alpha, min, max, key, pair);
+    }
+}
+
+
+/*
+ * Crosses one pair of parents by two-point crossover, drawing from the child
+ * pair of key. c2 may be NULL to make only the first child.
+ */
+static inline void segment_crossover_pair(const size_t design_var_count,
+                                          const stress_t *p1, const stress_t *p2,
+                                          stress_t *c1, stress_t *c2,
+                                          const uint64_t key, const size_t pair)
+{
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, pair));
+    size_t start = rng_stream_interval(design_var_count, &rng);  // Select segment
+    size_t end = rng_stream_interval(design_var_count, &rng);
+    if (start > end) {
+        size_t tmp = start;
+        start = end;
+        end = tmp;
+    }
+    for (size_t j = 0; j < design_var_count; j++) {
+        const int swap = start <= j && j < end;
+        c1[j] = swap ? p2[j] : p1[j];
+        if (c2)
+            c2[j] = swap ? p1[j] : p2[j];
+    }
+}
+
+
+void ga_segment_crossover(const size_t nmemb, const size_t design_var_count,
+                          stress_t *const *const population,
+                          const size_t parent_indices[],
+                          stress_t **children,
+                          const uint64_t key)
+{
+    // As in ga_blx_alpha(), an odd last child is crossed with the first winner.
+    const size_t num_pairs = (nmemb + 1) / 2;
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t pair = 0; pair < num_pairs; pair++) {
+        const size_t i = 2 * pair;
+        const bool has_second_child = i + 1 < nmemb;
+        segment_crossover_pair(design_var_count, population[parent_indices[i]],
+                               population[parent_indices[has_second_child ? i+1 : 0]],
+                               children[i], has_second_child ? children[i+1] : NULL,
+                               key, pair);
+    }
+}
+
+
+/*
+ * Mutates design i by Gaussian mutation, drawing from the child i of key.
+ */
+static inline void mutate_one(const size_t design_var_count, stress_t *design,
+                              const double stdev, const double min, const double max,
+                              const double mutate_probability, const uint64_t key,
+                              const size_t i)
 {
-    for (size_t i = 0; i < nmemb-1; i += 2) {
-        const double *p1 = population[parent_indices[i]];  // Select first parent
-        const double *p2 = population[parent_indices[i+1]];  // Select second parent
-        for (size_t j = 0; j < design_var_count; j++) {
-            double cmin = p1[j] <= p2[j] ? p1[j] : p2[j];  // Select min value
-            double cmax = p1[j] > p2[j] ? p1[j] : p2[j];  // Select max value
-            double range = cmax - cmin;  // Select range
-            double a = cmin - range * alpha;  // Select lower bound
-            double b = cmax + range * alpha;  // Select upper bound
-            children[i][j] = fmin(fmax(a + (b - a) * rk_double(rng), min), max); // Set child design
-            children[i+1][j] = fmin(fmax(a + (b - a) * rk_double(rng), min), max); // Set child design
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, i));
+    for (size_t j = 0; j < design_var_count; j++) {
+        if (rng_stream_double(&rng) < mutate_probability) {
+            design[j] += stdev * rng_stream_gauss(&rng);
+            design[j] = fmin(fmax(design[j], min), max);
         }
     }
 }
 
 
 void ga_mutate(const size_t nmemb, const size_t design_var_count,
-               double **population,
+               stress_t **population,
                const double stdev, const double min, const double max,
-               const double mutate_probability, rk_state *rng)
+               const double mutate_probability, const uint64_t key)
 {
-    for (size_t i = 0; i < nmemb; i++) {
-        for (size_t j = 0; j < design_var_count; j++) {
-            if (rk_double(rng) < mutate_probability) {
-                population[i][j] += stdev * rk_gauss(rng);
-                population[i][j] = fmin(fmax(population[i][j], min), max);
-            }
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < nmemb; i++)
+        mutate_one(design_var_count, population[i], stdev, min, max, mutate_probability, key, i);
+}
+
+
+/*
+ * Mutates design i by Gaussian mutation of windows, drawing from the child i
+ * of key.
+ */
+static inline void mutate_window_one(const size_t design_var_count, stress_t *design,
+                                     const double stdev, const double min, const double max,
+                                     const double mutate_probability, const size_t window_length,
+                                     const uint64_t key, const size_t i)
+{
+    const double start_probability = mutate_probability / window_length;
+    rng_stream_t rng;
+    rng_stream_init(&rng, rng_stream_key(key, i));
+    for (size_t j = 0; j < design_var_count; j++) {
+        if (rng_stream_double(&rng) < start_probability) {
+            const double change = stdev * rng_stream_gauss(&rng);
+            for (size_t k = j; k < j + window_length && k < design_var_count; k++)
+                design[k] = fmin(fmax(design[k] + change, min), max);
         }
     }
 }
 
 
-static int compare_size_t(const void *first, const void *second)
+void ga_mutate_window(const size_t nmemb, const size_t design_var_count,
+                      stress_t **population,
+                      const double stdev, const double min, const double max,
+                      const double mutate_probability, const size_t window_length,
+                      const uint64_t key)
 {
-    return (int)((long long)(*((size_t *) first)) - (long long)(*((size_t *) second)));
+    #pragma omp parallel for if(nmemb * design_var_count >= GA_PARALLEL_MIN_DRAWS)
+    for (size_t i = 0; i < nmemb; i++) {
+        mutate_window_one(design_var_count, population[i], stdev, min, max,
+                          mutate_probability, window_length, key, i);
+    }
 }
 
 
@@ -97,27 +228,164 @@ void ga_cull(bt_population_t *parents, const bt_population_t *children, const si
     const size_t nmemb = parents->nmemb;
     assert(children->nmemb == nmemb);
     assert(num_keep <= nmemb);
+    const bool parallel = nmemb * parents->num_days >= GA_CULL_PARALLEL_MIN_VALUES;
 
-    // Copy best parents to the start of the arrays
-    size_t sorted_parent_indices[nmemb];
-    stats_sort_index(sorted_parent_indices, parents->fitnesses, nmemb);
-    qsort(sorted_parent_indices + (nmemb - num_keep), num_keep, sizeof(size_t), compare_size_t);
-    for (size_t i = 0; i < num_keep; i++) {
-        const size_t s = sorted_parent_indices[i + nmemb - num_keep];
-        memmove(parents->stresses[i], parents->stresses[s], parents->num_days * sizeof(stress_t));
-        parents->final_performances[i] = parents->final_performances[s];
-        parents->penalties[i] = parents->penalties[s];
-        parents->fitnesses[i] = parents->fitnesses[s];
-    }
+    // Move the best parents to the start of the arrays. Those that are
+    // already there stay, and the rest fill the places of the discarded
+    // parents.
+    size_t *parent_indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(parent_indices, parents->fitnesses, nmemb, nmemb - num_keep);
+    size_t num_moves = 0;
+    for (size_t i = 0; i < nmemb - num_keep; i++)
+        if (parent_indices[i] < num_keep)
+            parent_indices[num_moves++] = parent_indices[i];
+    size_t *sources = parent_indices + (nmemb - num_keep);
+    size_t num_sources = 0;
+    for (size_t i = 0; i < num_keep; i++)
+        if (sources[i] >= num_keep)
+            sources[num_sources++] = sources[i];
+    assert(num_sources == num_moves);
+    #pragma omp parallel for if(parallel)
+    for (size_t i = 0; i < num_moves; i++)
+        bt_population_copy_member(parents, parent_indices[i], parents, sources[i]);
+    free(parent_indices);
 
     // Copy best children to the rest of the arrays
-    size_t sorted_child_indices[nmemb];
-    stats_sort_index(sorted_child_indices, children->fitnesses, nmemb);
-    for (size_t i = num_keep; i < nmemb; i++) {
-        const size_t s = sorted_child_indices[i];
-        memcpy(parents->stresses[i], children->stresses[s], children->num_days * sizeof(stress_t));
-        parents->final_performances[i] = children->final_performances[s];
-        parents->penalties[i] = children->penalties[s];
-        parents->fitnesses[i] = children->fitnesses[s];
+    size_t *child_indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(child_indices, children->fitnesses, nmemb, num_keep);
+    #pragma omp parallel for if(parallel)
+    for (size_t i = num_keep; i < nmemb; i++)
+        bt_population_copy_member(parents, i, children, child_indices[i]);
+    free(child_indices);
+}
+
+
+
+size_t ga_generation(bt_population_t *parents, bt_population_t *children, const size_t num_keep,
+                     const ga_variation_t *variation, const bt_params_t *parameters,
+                     const size_t roughness_days, const fitness_t penalty_factor,
+                     const fitness_t roughness_factor, const stress_t max_daily_stress,
+                     const uint64_t key, bt_profile_t *profile)
+{
+    const size_t nmemb = parents->nmemb;
+    const size_t num_days = parents->num_days;
+    assert(children->nmemb == nmemb);
+    const uint64_t select_key = rng_stream_key(key, GA_STREAM_SELECT);
+    const uint64_t crossover_key = rng_stream_key(key, GA_STREAM_CROSSOVER);
+    const uint64_t mutate_key = rng_stream_key(key, GA_STREAM_MUTATE);
+
+    // With an odd number of designs, the last child is crossed with the first
+    // winner, as in ga_blx_alpha(), which is drawn again since it belongs to
+    // another pair.
+    const size_t num_pairs = (nmemb + 1) / 2;
+    size_t num_integrated_days = 0;
+    // If profiling, each thread times its share of each step.
+    const bt_profile_mark_t start = bt_profile_now(profile);
+    #pragma omp parallel reduction(+:num_integrated_days)
+    {
+        bt_profile_laps_t laps = {0};
+        const bt_profile_mark_t thread_start = bt_profile_now(profile);
+        #pragma omp for schedule(dynamic, 4) nowait
+        for (size_t pair = 0; pair < num_pairs; pair++) {
+            const size_t first = 2 * pair;
+            const size_t num_children = first + 1 < nmemb ? 2 : 1;
+            size_t parent_indices[2];
+            bt_profile_mark_t lap = bt_profile_now(profile);
+            for (size_t c = 0; c < 2; c++) {
+                const size_t winner = c < num_children ? first + c : 0;
+                parent_indices[c] = tournament_select_one(nmemb, parents->fitnesses, select_key, winner);
+            }
+            lap = bt_profile_lap(profile, &laps, BT_PROFILE_SELECT, lap);
+            stress_t *second_child = num_children == 2 ? children->stresses[first+1] : NULL;
+            if (variation->segment_crossover) {
+                segment_crossover_pair(num_days, parents->stresses[parent_indices[0]],
+                                       parents->stresses[parent_indices[1]],
+                                       children->stresses[first], second_child,
+                                       crossover_key, pair);
+            } else {
+                blx_alpha_pair(num_days, parents->stresses[parent_indices[0]],
+                               parents->stresses[parent_indices[1]],
+                               children->stresses[first], second_child,
+                               variation->blx_alpha, variation->min, variation->max,
+                               crossover_key, pair);
+            }
+            lap = bt_profile_lap(profile, &laps, BT_PROFILE_CROSSOVER, lap);
+            for (size_t c = 0; c < num_children; c++) {
+                const size_t i = first + c;
+                if (variation->mutate_window > 0) {
+                    mutate_window_one(num_days, children->stresses[i], variation->mutate_stdev,
+                                      variation->min, variation->max, variation->mutate_probability,
+                                      variation->mutate_window, mutate_key, i);
+                } else {
+                    mutate_one(num_days, children->stresses[i], variation->mutate_stdev,
+                               variation->min, variation->max, variation->mutate_probability,
+                               mutate_key, i);
+                }
+                lap = bt_profile_lap(profile, &laps, BT_PROFILE_MUTATE, lap);
+                bt_population_inherit_member_states(children, i, parents, parent_indices[c]);
+                num_integrated_days += bt_model_update_member_obj_func(
+                    parameters, roughness_days, penalty_factor, roughness_factor,
+                    max_daily_stress, children, i);
+                lap = bt_profile_lap(profile, &laps, BT_PROFILE_EVALUATE, lap);
+            }
+        }
+        bt_profile_record_thread(profile, thread_start, &laps);
     }
+    bt_profile_record_fused(profile, start);
+
+    const bt_profile_mark_t cull_start = bt_profile_now(profile);
+    ga_cull(parents, children, num_keep);
+    bt_profile_record(profile, BT_PROFILE_CULL, cull_start);
+    return num_integrated_days;
+}
+
+
+void ga_migrate(const ga_islands_t *islands, bt_population_t populations[])
+{
+    const size_t num_islands = islands->num_islands;
+    const size_t num_migrants = islands->num_migrants;
+    if (num_islands < 2 || num_migrants == 0)
+        return;
+
+    // Copy the best designs of each island to its mailbox.
+    bt_population_t *mail = bt_population_alloc(num_islands * num_migrants,
+                                                populations[0].num_days);
+    size_t mail_counts[num_islands];
+    size_t max_size = 0;
+    for (size_t k = 0; k < num_islands; k++)
+        if (populations[k].nmemb > max_size)
+            max_size = populations[k].nmemb;
+    size_t *indices = malloc(max_size * sizeof(size_t));
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t size = populations[k].nmemb;
+        mail_counts[k] = num_migrants < size ? num_migrants : size;
+        stats_select_index(indices, populations[k].fitnesses, size, size - mail_counts[k]);
+        for (size_t j = 0; j < mail_counts[k]; j++)
+            bt_population_copy_member(mail, k * num_migrants + j, &populations[k],
+                                      indices[size - 1 - j]);
+    }
+
+    // Replace the worst designs of each island with the mail from its
+    // neighbors.
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t size = populations[k].nmemb;
+        const size_t num_sources = islands->topology == GA_TOPOLOGY_RING ? 1 : num_islands - 1;
+        size_t num_mail = 0;
+        for (size_t step = 1; step <= num_sources; step++)
+            num_mail += mail_counts[(k + num_islands - step) % num_islands];
+        stats_select_index(indices, populations[k].fitnesses, size,
+                           num_mail < size / 2 ? num_mail : size / 2);
+        size_t num_replaced = 0;
+        for (size_t step = 1; step < num_islands; step++) {
+            const size_t source = (k + num_islands - step) % num_islands;
+            for (size_t j = 0; j < mail_counts[source] && num_replaced < size / 2; j++)
+                bt_population_copy_member(&populations[k], indices[num_replaced++],
+                                          mail, source * num_migrants + j);
+            if (islands->topology == GA_TOPOLOGY_RING)
+                break;
+        }
+    }
+
+    free(indices);
+    bt_population_free(mail);
 }
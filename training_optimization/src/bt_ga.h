@@ -23,8 +23,106 @@
 
 #pragma once
 
+#include "bt_params.h"
 #include "bt_population.h"
-#include "randomkit.h"
+#include "bt_profile.h"
+#include "rng_stream.h"
+#include <stdbool.h>
+
+/**
+ * Minimum number of random draws in one call of a variation operator that
+ * makes it worthwhile to run the operator on multiple threads.
+ */
+#ifndef GA_PARALLEL_MIN_DRAWS
+#define GA_PARALLEL_MIN_DRAWS 20000
+#endif
+
+/**
+ * Minimum number of values copied by ga_cull() that makes it worthwhile to
+ * copy the designs on multiple threads.
+ */
+#ifndef GA_CULL_PARALLEL_MIN_VALUES
+#define GA_CULL_PARALLEL_MIN_VALUES 200000
+#endif
+
+/**
+ * Purposes of the random streams of one generation.
+ *
+ * Each operator draws from its own child of the generation's key (see
+ * rng_stream_key()), and each design (or pair of designs, for crossover) from
+ * its own child of that, so the operators can process the designs in
+ * parallel and in any order.
+ */
+enum ga_stream {
+    GA_STREAM_INIT = 0,
+    GA_STREAM_SELECT = 1,
+    GA_STREAM_CROSSOVER = 2,
+    GA_STREAM_MUTATE = 3
+};
+
+/**
+ * Settings of the variation operators (crossover and mutation) for one
+ * generation.
+ */
+typedef struct ga_variation_t {
+    /**
+     * Whether to use two-point crossover instead of BLX-alpha crossover.
+     */
+    bool segment_crossover;
+    /**
+     * The alpha parameter of BLX-alpha crossover.
+     */
+    double blx_alpha;
+    /**
+     * Number of consecutive days mutated together, or 0 to mutate days
+     * independently.
+     */
+    size_t mutate_window;
+    /**
+     * Standard deviation for Gaussian mutation.
+     */
+    double mutate_stdev;
+    /**
+     * Probability that any individual design variable value will be mutated.
+     */
+    double mutate_probability;
+    /**
+     * The lower bound for any design variable value.
+     */
+    double min;
+    /**
+     * The upper bound for any design variable value.
+     */
+    double max;
+} ga_variation_t;
+
+/**
+ * Topology of the migration between islands.
+ */
+enum ga_topology {
+    /**
+     * Each island sends its emigrants to the next island, wrapping around.
+     */
+    GA_TOPOLOGY_RING = 0,
+    /**
+     * Each island sends its emigrants to every other island.
+     */
+    GA_TOPOLOGY_FULL = 1
+};
+
+/**
+ * Configuration of the island model.
+ *
+ * The population is split into @p num_islands contiguous sub-populations that
+ * evolve independently and exchange designs every @p migration_interval
+ * generations.
+ */
+typedef struct ga_islands_t {
+    size_t num_islands;
+    size_t migration_interval;
+    size_t num_migrants;
+    enum ga_topology topology;
+} ga_islands_t;
 
 /**
  * Randomly generates initial training stress values.
@@ -33,11 +131,11 @@
  * @param[in] num_days The number of training stresses in each design.
  * @param[in] max_daily_stress The maximum possible training stress.
  * @param[out] stresses The population of training stresses to write.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void ga_init_stresses(const size_t nmemb, const size_t num_days,
                       const stress_t max_daily_stress, stress_t **stresses,
-                      rk_state *rng);
+                      const uint64_t key);
 
 /**
  * Selects indices of suitable parents for generating children via
@@ -48,15 +146,18 @@ void ga_init_stresses(const size_t nmemb, const size_t num_days,
  *   designs.
  * @param[in] num_winners The number of designs to select.
  * @param[out] winner_indices The indices of the selected designs.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
                           const size_t num_winners, size_t winner_indices[],
-                          rk_state *rng);
+                          const uint64_t key);
 
 /**
  * Generates new children by crossing the parents.
  *
+ * Each pair of parents makes a pair of children. If @p nmemb is odd, the last
+ * child is made from the last parent and the first, so every child is set.
+ *
  * You may want to update the objective function and penalty values of @p
  * children after this.
  *
@@ -70,7 +171,7 @@ void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
  *   clipped to this).
  * @param[in] max The upper bound for any design variable value (values are
  *   clipped to this).
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  *
  * @note Ideally, @p population would be defined as `const stress_t *const
  * *const population`, but due to limitations in the C standard, that would
@@ -80,10 +181,33 @@ void ga_tournament_select(const size_t nmemb, const fitness_t fitnesses[],
 void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
                   stress_t *const *const population,
                   const size_t parent_indices[],
-                  double **children,
+                  stress_t **children,
                   const double alpha,
                   const double min, const double max,
-                  rk_state *rng);
+                  const uint64_t key);
+
+/**
+ * Generates new children by two-point (segment) crossover of the parents.
+ *
+ * Each pair of parents produces two children, where the first child is a copy
+ * of the first parent except for a random contiguous segment of days, which
+ * comes from the second parent, and vice versa. Since the start of each
+ * child matches one of its parents, the children can reuse most of their
+ * parents' cached states (see bt_population_inherit_states()). If @p nmemb is
+ * odd, the last child is made as in ga_blx_alpha().
+ *
+ * @param[in] nmemb The number of designs in each population.
+ * @param[in] design_var_count The number of elements in each design.
+ * @param[in] population The population of parent designs.
+ * @param[in] parent_indices Indices within @p population to use as parents.
+ * @param[out] children The population of children to generate.
+ * @param[in] key The key of the operator's random stream.
+ */
+void ga_segment_crossover(const size_t nmemb, const size_t design_var_count,
+                          stress_t *const *const population,
+                          const size_t parent_indices[],
+                          stress_t **children,
+                          const uint64_t key);
 
 /**
  * Mutates the given population using Gaussian mutation.
@@ -101,19 +225,106 @@ void ga_blx_alpha(const size_t nmemb, const size_t design_var_count,
  *   clipped to this).
  * @param[in] mutate_probability Probability that any individual design
  *   variable value will be mutated.
- * @param[in,out] rng The state of the PRNG.
+ * @param[in] key The key of the operator's random stream.
  */
 void ga_mutate(const size_t nmemb, const size_t design_var_count,
-               double **population,
+               stress_t **population,
                const double stdev, const double min, const double max,
-               const double mutate_probability, rk_state *rng);
+               const double mutate_probability, const uint64_t key);
+
+/**
+ * Mutates the given population using Gaussian mutation of contiguous windows
+ * of design variables.
+ *
+ * Each design variable starts a window with probability `mutate_probability /
+ * window_length`, so that about the same number of values are mutated as with
+ * ga_mutate(), but in runs of consecutive days. All of the values in a window
+ * are shifted by the same normally distributed amount.
+ *
+ * @param[in] nmemb The number of designs in each population.
+ * @param[in] design_var_count The number of elements in each design.
+ * @param[in,out] population The population of designs to mutate.
+ * @param[in] stdev Standard deviation for Gaussian mutation.
+ * @param[in] min The lower bound for any design variable value (values are
+ *   clipped to this).
+ * @param[in] max The upper bound for any design variable value (values are
+ *   clipped to this).
+ * @param[in] mutate_probability Probability that any individual design
+ *   variable value will be mutated.
+ * @param[in] window_length Number of consecutive values in each window.
+ * @param[in] key The key of the operator's random stream.
+ */
+void ga_mutate_window(const size_t nmemb, const size_t design_var_count,
+                      stress_t **population,
+                      const double stdev, const double min, const double max,
+                      const double mutate_probability, const size_t window_length,
+                      const uint64_t key);
 
 /**
  * Combines the two populations, keeping the best designs.
  *
+ * The best designs are found by selection rather than sorting, so this takes
+ * linear time on average. Kept parents that are already among the first @p
+ * num_keep designs stay where they are, and the order of the output
+ * population is otherwise unspecified.
+ *
  * @param[in,out] parents The population of parents.
  * @param[in] children The population of children.
  * @param[in] num_keep Number of the best parents to keep. The rest of the
  *   parents are replaced with the best children.
  */
 void ga_cull(bt_population_t *parents, const bt_population_t *children, const size_t num_keep);
+
+/**
+ * Runs one generation of the GA: selection, crossover, mutation, evaluation,
+ * and culling.
+ *
+ * Instead of making a pass over the population for each step, each pair of
+ * children is selected, crossed, mutated, and evaluated in one go, while its
+ * data is still in the cache, and the pairs are processed in parallel. The
+ * random streams are the same as for the separate operators (with the keys
+ * `rng_stream_key(key, GA_STREAM_SELECT)` etc.), so the result is the same as
+ * that of ga_tournament_select(), ga_blx_alpha() or ga_segment_crossover(),
+ * ga_mutate() or ga_mutate_window(), bt_population_inherit_states(),
+ * bt_model_update_obj_func(), and ga_cull() in turn.
+ *
+ * @param[in,out] parents The population of parents, which is replaced by the
+ *   next generation.
+ * @param[out] children The population in which to generate the children.
+ * @param[in] num_keep Number of the best parents to keep.
+ * @param[in] variation Settings of the variation operators.
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress (for
+ *   calculating penalties).
+ * @param[in] key The key of the generation's random streams.
+ * @param[in,out] profile (Optional) Profile in which to record the time of
+ *   each step, or `NULL`.
+ * @returns The total number of days that were integrated.
+ */
+size_t ga_generation(bt_population_t *parents, bt_population_t *children, const size_t num_keep,
+                     const ga_variation_t *variation, const bt_params_t *parameters,
+                     const size_t roughness_days, const fitness_t penalty_factor,
+                     const fitness_t roughness_factor, const stress_t max_daily_stress,
+                     const uint64_t key, bt_profile_t *profile);
+
+/**
+ * Migrates the best designs of each island to its neighbors.
+ *
+ * The @p num_migrants best designs of every island are copied out first, and
+ * then each island replaces its worst designs with the copies from its
+ * neighbors (as given by the topology), so the result doesn't depend on the
+ * order in which the islands are visited. At most half of each island is
+ * replaced. The migrants keep their cached states. The best and worst
+ * designs are found by selection rather than sorting, so they are taken in no
+ * particular order.
+ *
+ * @param[in] islands The island model configuration.
+ * @param[in,out] populations Array of `islands->num_islands` populations (see
+ *   bt_population_slice()).
+ */
+void ga_migrate(const ga_islands_t *islands, bt_population_t populations[]);
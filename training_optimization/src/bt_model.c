@@ -18,92 +18,125 @@
 #include "bt_model.h"
 #include "bt_constraints.h"
 #include <math.h>
+#include <stdlib.h>
 
 
 #define DAY_LENGTH 1
 
 
-static inline performance_t bt_model_calc_fitness_d(const performance_t fitness,
-                                                    const stress_t training_stress,
-                                                    const bt_params_t *parameters)
-{
-    return -1/parameters->tau1 * pow(fitness, parameters->alpha) + parameters->k1 * training_stress;
-}
-
-
-static inline performance_t bt_model_calc_fatigue_d(const performance_t fatigue,
-                                                    const stress_t training_stress,
-                                                    const bt_params_t *parameters)
-{
-    return -1/parameters->tau2 * pow(fatigue, parameters->beta) + parameters->k2 * training_stress;
-}
-
-
-static inline performance_t bt_model_euler_step(
-    performance_t (*y_d)(const performance_t y, const stress_t training_stress, const bt_params_t *parameters),
-    const performance_t y, const double dt, const stress_t training_stress, const bt_params_t *parameters)
-{
-    return y + dt * y_d(y, training_stress, parameters);
-}
-
-
 static void bt_model_integrate_interval(
     performance_t *performance, performance_t *fitness, performance_t *fatigue, penalty_t *penalty,
     const stress_t training_stress, const param_t interval_duration, const stress_t max_daily_stress,
     const bt_params_t *parameters)
 {
+    const bt_ode_t fitness_ode = {parameters->tau1, parameters->alpha, parameters->k1};
+    const bt_ode_t fatigue_ode = {parameters->tau2, parameters->beta, parameters->k2};
     *penalty = bt_constraints_penalty_step(*penalty, *performance, *fitness, *fatigue, training_stress, max_daily_stress);
-    *fitness = bt_model_euler_step(bt_model_calc_fitness_d, *fitness, interval_duration, training_stress, parameters);
-    *fatigue = bt_model_euler_step(bt_model_calc_fatigue_d, *fatigue, interval_duration, training_stress, parameters);
+    *fitness = bt_ode_advance(parameters->integrator, &fitness_ode, *fitness, training_stress, interval_duration, BT_MODEL_POW_ACCURACY);
+    *fatigue = bt_ode_advance(parameters->integrator, &fatigue_ode, *fatigue, training_stress, interval_duration, BT_MODEL_POW_ACCURACY);
     *performance = parameters->p0 + *fitness - *fatigue;
     *penalty = bt_constraints_penalty_step(*penalty, *performance, *fitness, *fatigue, training_stress, max_daily_stress);
 }
 
 
 void bt_model_fprint_integrate(
-    FILE *stream,
+    FILE *stream, const enum bt_table_format format,
     const size_t num_days, const stress_t *stresses,
     const stress_t max_daily_stress, const bt_params_t *parameters)
 {
-    fprintf(stream, "day\tstress\tfitness\tfatigue\tperformance");
-    bt_constraints_print_header(stream);
-    fprintf(stream, "\n");
+    static const char *const model_names[] = {"day", "stress", "fitness", "fatigue", "performance"};
+    const size_t num_model_columns = sizeof(model_names) / sizeof(model_names[0]);
+    const size_t num_columns = num_model_columns + bt_constraints_num_columns;
+    const size_t num_rows = num_days + 1;
+
+    // The binary table is column-major, so it's collected before writing.
+    double *values = NULL;
+    if (format == BT_TABLE_BINARY) {
+        values = malloc(num_columns * num_rows * sizeof(double));
+    } else {
+        fprintf(stream, "day\tstress\tfitness\tfatigue\tperformance");
+        for (size_t j = 0; j < bt_constraints_num_columns; j++)
+            fprintf(stream, "\t%s", bt_constraints_column_names[j]);
+        fprintf(stream, "\n");
+    }
+
     performance_t fitness = parameters->f0;
     performance_t fatigue = parameters->u0;
     performance_t performance = parameters->p0 + parameters->f0 - parameters->u0;
     penalty_t penalty = 0;
-    size_t day;
-    for (day = 0; day < num_days; day++) {
-        fprintf(stream, "%zd\t%lf\t%lf\t%lf\t%lf", day, stresses[day], fitness, fatigue, performance);
-        bt_constraints_print_value(stream, performance, fitness, fatigue, max_daily_stress);
-        fprintf(stream, "\n");
-        bt_model_integrate_interval(
-            &performance, &fitness, &fatigue, &penalty, stresses[day],
-            DAY_LENGTH, max_daily_stress, parameters);
+    double constraint_values[bt_constraints_num_columns];
+    for (size_t day = 0; day < num_rows; day++) {
+        const stress_t stress = day < num_days ? stresses[day] : 0.;
+        bt_constraints_values(constraint_values, performance, fitness, fatigue, max_daily_stress);
+        if (values) {
+            const double row[] = {day, stress, fitness, fatigue, performance};
+            for (size_t j = 0; j < num_model_columns; j++)
+                values[j * num_rows + day] = row[j];
+            for (size_t j = 0; j < bt_constraints_num_columns; j++)
+                values[(num_model_columns + j) * num_rows + day] = constraint_values[j];
+        } else {
+            fprintf(stream, "%zd\t%lf\t%lf\t%lf\t%lf", day, stress, fitness, fatigue, performance);
+            for (size_t j = 0; j < bt_constraints_num_columns; j++)
+                fprintf(stream, "\t%lf", constraint_values[j]);
+            fprintf(stream, "\n");
+        }
+        if (day < num_days) {
+            bt_model_integrate_interval(
+                &performance, &fitness, &fatigue, &penalty, stresses[day],
+                DAY_LENGTH, max_daily_stress, parameters);
+        }
+    }
+
+    if (values) {
+        const char *names[num_columns];
+        enum bt_table_column_type types[num_columns];
+        for (size_t j = 0; j < num_model_columns; j++)
+            names[j] = model_names[j];
+        for (size_t j = 0; j < bt_constraints_num_columns; j++)
+            names[num_model_columns + j] = bt_constraints_column_names[j];
+        for (size_t j = 0; j < num_columns; j++)
+            types[j] = j == 0 ? BT_TABLE_INTEGER : BT_TABLE_DOUBLE;
+        bt_table_write(stream, num_columns, num_rows, names, types, values);
+        free(values);
     }
-    fprintf(stream, "%zd\t%lf\t%lf\t%lf\t%lf", day, 0., fitness, fatigue, performance);
-    bt_constraints_print_value(stream, performance, fitness, fatigue, max_daily_stress);
-    fprintf(stream, "\n");
 }
 
 
-/* this calculates the performance at the start of the last day */
-static void bt_model_calculate_final_performance_and_penalty(
+/*
+ * this calculates the performance at the start of the last day, resuming from
+ * the last valid cached state and updating the cache; returns the number of
+ * days integrated
+ */
+static size_t bt_model_calculate_final_performance_and_penalty(
     const size_t num_days, const stress_t *stresses, const stress_t max_daily_stress,
-    const bt_params_t *parameters,
+    const bt_params_t *parameters, bt_population_state_t *states, size_t *num_valid_states,
     performance_t *final_performance, penalty_t *penalty)
 {
+    // Find the starting state
+    if (*num_valid_states == 0) {
+        states[0].fitness = parameters->f0;
+        states[0].fatigue = parameters->u0;
+        states[0].penalty = 0;
+        *num_valid_states = 1;
+    }
+    const size_t start_day = *num_valid_states - 1;
+
     // Perform integration
-    performance_t fitness = parameters->f0;
-    performance_t fatigue = parameters->u0;
-    performance_t performance = parameters->p0 + parameters->f0 - parameters->u0;
-    *penalty = 0;
-    for (size_t day = 0; day < num_days; day++) {
+    performance_t fitness = states[start_day].fitness;
+    performance_t fatigue = states[start_day].fatigue;
+    performance_t performance = parameters->p0 + fitness - fatigue;
+    *penalty = states[start_day].penalty;
+    for (size_t day = start_day; day < num_days; day++) {
         bt_model_integrate_interval(
             &performance, &fitness, &fatigue, penalty, stresses[day],
             DAY_LENGTH, max_daily_stress, parameters);
+        states[day+1].fitness = fitness;
+        states[day+1].fatigue = fatigue;
+        states[day+1].penalty = *penalty;
     }
+    *num_valid_states = num_days + 1;
     *final_performance = performance;
+    return num_days - start_day;
 }
 
 
@@ -130,6 +163,117 @@ static inline fitness_t bt_model_calculate_objective_function(
 }
 
 
+/*
+ * Returns the derivative of the state after an Euler step with respect to the
+ * state y before it. The derivative of y^exponent is taken to be 0 at y = 0.
+ */
+static inline double bt_model_euler_slope(const bt_ode_t *ode, const performance_t y,
+                                          const param_t interval_duration)
+{
+    const double dpow_dy = y > 0 ? ode->exponent * vpow(y, ode->exponent, BT_MODEL_POW_ACCURACY) / y : 0;
+    return 1 - interval_duration / ode->tau * dpow_dy;
+}
+
+
+/*
+ * Adds the adjoint of a penalty step at the given state to the derivatives of
+ * the objective function with respect to the state and the day's stress.
+ */
+static inline void bt_model_penalty_adjoint(
+    double *adj_fitness, double *adj_fatigue, fitness_t *adj_stress,
+    const performance_t fitness, const performance_t fatigue, const stress_t training_stress,
+    const stress_t max_daily_stress, const fitness_t penalty_factor,
+    const bt_params_t *parameters)
+{
+    const performance_t performance = parameters->p0 + fitness - fatigue;
+    const bt_constraints_gradient_t penalty = bt_constraints_penalty_gradient(
+        performance, fitness, fatigue, training_stress, max_daily_stress);
+    *adj_fitness -= penalty_factor * (penalty.fitness + penalty.performance);
+    *adj_fatigue -= penalty_factor * (penalty.fatigue - penalty.performance);
+    *adj_stress -= penalty_factor * penalty.training_stress;
+}
+
+
+/*
+ * Adds scale times the derivatives of bt_model_calculate_roughness() to
+ * gradient, taking the derivative of |x| to be 0 at x = 0.
+ */
+static void bt_model_add_roughness_gradient(
+    const size_t num_days, const stress_t *stresses, const size_t roughness_days,
+    const fitness_t scale, fitness_t gradient[])
+{
+    for (size_t day = roughness_days; day < num_days; day++) {
+        for (size_t old_day = day - roughness_days; old_day < day; old_day++) {
+            const double difference = stresses[old_day] - stresses[old_day+1];
+            const double sign = (difference > 0) - (difference < 0);
+            gradient[old_day] += scale * sign;
+            gradient[old_day+1] -= scale * sign;
+        }
+        const double difference = stresses[day-roughness_days] - stresses[day];
+        const double sign = (difference > 0) - (difference < 0);
+        gradient[day-roughness_days] -= scale * sign;
+        gradient[day] += scale * sign;
+    }
+}
+
+
+fitness_t bt_model_calculate_obj_func_gradient(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const size_t num_days, const stress_t *stresses,
+    fitness_t gradient[])
+{
+    // Forward sweep, keeping the state at the start of each day.
+    performance_t *fitnesses = malloc((num_days + 1) * sizeof(performance_t));
+    performance_t *fatigues = malloc((num_days + 1) * sizeof(performance_t));
+    performance_t fitness = parameters->f0;
+    performance_t fatigue = parameters->u0;
+    performance_t performance = parameters->p0 + fitness - fatigue;
+    penalty_t penalty = 0;
+    fitnesses[0] = fitness;
+    fatigues[0] = fatigue;
+    for (size_t day = 0; day < num_days; day++) {
+        bt_model_integrate_interval(
+            &performance, &fitness, &fatigue, &penalty, stresses[day],
+            DAY_LENGTH, max_daily_stress, parameters);
+        fitnesses[day+1] = fitness;
+        fatigues[day+1] = fatigue;
+    }
+    penalty_t roughness = 0;
+    if (roughness_factor > 0)
+        roughness = bt_model_calculate_roughness(num_days, stresses, roughness_days);
+    const fitness_t objective = bt_model_calculate_objective_function(
+        performance, penalty, penalty_factor, roughness, roughness_factor);
+
+    // Reverse sweep. At the start of each iteration, adj_fitness and
+    // adj_fatigue are the derivatives of the objective function with respect
+    // to the state at the end of the day, apart from the day's own penalty.
+    const bt_ode_t fitness_ode = {parameters->tau1, parameters->alpha, parameters->k1};
+    const bt_ode_t fatigue_ode = {parameters->tau2, parameters->beta, parameters->k2};
+    double adj_fitness = 1;
+    double adj_fatigue = -1;
+    for (size_t day = num_days; day-- > 0;) {
+        const stress_t stress = stresses[day];
+        gradient[day] = 0;
+        bt_model_penalty_adjoint(&adj_fitness, &adj_fatigue, &gradient[day],
+                                 fitnesses[day+1], fatigues[day+1], stress,
+                                 max_daily_stress, penalty_factor, parameters);
+        gradient[day] += DAY_LENGTH * (adj_fitness * parameters->k1 + adj_fatigue * parameters->k2);
+        adj_fitness *= bt_model_euler_slope(&fitness_ode, fitnesses[day], DAY_LENGTH);
+        adj_fatigue *= bt_model_euler_slope(&fatigue_ode, fatigues[day], DAY_LENGTH);
+        bt_model_penalty_adjoint(&adj_fitness, &adj_fatigue, &gradient[day],
+                                 fitnesses[day], fatigues[day], stress,
+                                 max_daily_stress, penalty_factor, parameters);
+    }
+    if (roughness_factor > 0)
+        bt_model_add_roughness_gradient(num_days, stresses, roughness_days, -roughness_factor, gradient);
+
+    free(fatigues);
+    free(fitnesses);
+    return objective;
+}
+
+
 void bt_model_update_penalty_factors(const fitness_t penalty_factor, const fitness_t roughness_factor,
                                      const size_t roughness_days, bt_population_t *population)
 {
@@ -146,43 +290,57 @@ void bt_model_update_penalty_factors(const fitness_t penalty_factor, const fitne
 }
 
 
-void bt_model_update_obj_func(
+size_t bt_model_update_member_obj_func(
     const bt_params_t *parameters, const size_t roughness_days,
     const fitness_t penalty_factor, const fitness_t roughness_factor,
-    const stress_t max_daily_stress, bt_population_t *population)
+    const stress_t max_daily_stress, bt_population_t *population, const size_t i)
 {
-    #pragma omp parallel for
-    for (size_t i = 0; i < population->nmemb; i++) {
+    // Calculate roughness.
+    penalty_t roughness  = 0;
+    if (roughness_factor > 0) {
+        roughness = bt_model_calculate_roughness(
+            population->num_days, population->stresses[i], roughness_days);
+    }
 
-        // Calculate roughness.
-        penalty_t roughness  = 0;
-        if (roughness_factor > 0) {
-            roughness = bt_model_calculate_roughness(
-                population->num_days, population->stresses[i], roughness_days);
-        }
+    // Calculate final performance and penalty.
+    performance_t final_performance;
+    penalty_t penalty;
+    const size_t num_integrated_days = bt_model_calculate_final_performance_and_penalty(
+        population->num_days, population->stresses[i], max_daily_stress,
+        parameters, population->states[i], &population->num_valid_states[i],
+        &final_performance, &penalty);
 
-        // Calculate final performance and penalty.
-        performance_t final_performance;
-        penalty_t penalty;
-        bt_model_calculate_final_performance_and_penalty(
-            population->num_days, population->stresses[i], max_daily_stress,
-            parameters, &final_performance, &penalty);
-
-        // Calculate overall fitness.
-        fitness_t fitness = bt_model_calculate_objective_function(
-            final_performance, penalty, penalty_factor, roughness, roughness_factor);
-
-        // Handle any numerical problems.
-        if (!isnan(fitness)) {
-            population->final_performances[i] = final_performance;
-            population->penalties[i] = penalty;
-            population->roughnesses[i] = roughness;
-            population->fitnesses[i] = fitness;
-        } else {
-            population->final_performances[i] = -INFINITY;
-            population->penalties[i] = INFINITY;
-            population->roughnesses[i] = INFINITY;
-            population->fitnesses[i] = -INFINITY;
-        }
+    // Calculate overall fitness.
+    fitness_t fitness = bt_model_calculate_objective_function(
+        final_performance, penalty, penalty_factor, roughness, roughness_factor);
+
+    // Handle any numerical problems.
+    if (!isnan(fitness)) {
+        population->final_performances[i] = final_performance;
+        population->penalties[i] = penalty;
+        population->roughnesses[i] = roughness;
+        population->fitnesses[i] = fitness;
+    } else {
+        population->final_performances[i] = -INFINITY;
+        population->penalties[i] = INFINITY;
+        population->roughnesses[i] = INFINITY;
+        population->fitnesses[i] = -INFINITY;
+    }
+    return num_integrated_days;
+}
+
+
+size_t bt_model_update_obj_func(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, bt_population_t *population)
+{
+    size_t num_integrated_days = 0;
+    #pragma omp parallel for reduction(+:num_integrated_days)
+    for (size_t i = 0; i < population->nmemb; i++) {
+        num_integrated_days += bt_model_update_member_obj_func(
+            parameters, roughness_days, penalty_factor, roughness_factor,
+            max_daily_stress, population, i);
     }
+    return num_integrated_days;
 }
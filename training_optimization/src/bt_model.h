@@ -25,8 +25,22 @@
 
 #include "bt_params.h"
 #include "bt_population.h"
+#include "bt_table.h"
+#include "vpow.h"
 #include <stdio.h>
 
+/**
+ * Accuracy tier of the power function in the nonlinear model; see
+ * ::vpow_accuracy.
+ *
+ * The default reproduces the C library's `pow()`. Set it with e.g.
+ * `-DBT_MODEL_POW_ACCURACY=VPOW_PRECISE` in `CFLAGS` to use the polynomial
+ * kernels.
+ */
+#ifndef BT_MODEL_POW_ACCURACY
+#define BT_MODEL_POW_ACCURACY VPOW_EXACT
+#endif
+
 /**
  * Writes the result of integrating the nonlinear model.
  *
@@ -36,6 +50,7 @@
  * of days.
  *
  * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
  * @param[in] num_days The number of days of training stresses.
  * @param[in] stresses The array of training stresses.
  * @param[in] max_daily_stress The maximum allowable daily stress (for
@@ -44,10 +59,40 @@
  *   model.
  */
 void bt_model_fprint_integrate(
-    FILE *stream,
+    FILE *stream, const enum bt_table_format format,
     const size_t num_days, const stress_t *stresses,
     const stress_t max_daily_stress, const bt_params_t *parameters);
 
+/**
+ * Calculates the penalized objective function value of a training plan and its
+ * gradient with respect to the daily stresses.
+ *
+ * The gradient is found by an adjoint (reverse) sweep over the days, which
+ * costs about as much as two integrations of the model regardless of the
+ * number of days. The penalties and roughness aren't differentiable everywhere;
+ * see bt_constraints_penalty_gradient().
+ *
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model. The integrator must be #BT_ODE_EULER.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress (for
+ *   calculating penalties).
+ * @param[in] num_days Number of days in the training plan.
+ * @param[in] stresses The daily stresses of the training plan.
+ * @param[out] gradient The array to write the @p num_days partial derivatives
+ *   of the objective function value.
+ * @returns The penalized objective function value, as calculated by
+ *   bt_model_update_member_obj_func().
+ */
+fitness_t bt_model_calculate_obj_func_gradient(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const size_t num_days, const stress_t *stresses,
+    fitness_t gradient[]);
+
 /**
  * Updates the penalized objective function values according to new
  * penalty and roughness factors.
@@ -77,6 +122,10 @@ void bt_model_update_penalty_factors(const fitness_t penalty_factor, const fitne
  * bt_model_update_penalty_factors() instead to avoid the expense of
  * re-integrating the nonlinear model.
  *
+ * Integration of each design resumes from the last of its cached states that
+ * is still valid (see bt_population_inherit_states()), and the caches are
+ * updated.
+ *
  * @param[in] parameters Parameters and initial conditions for the nonlinear
  *   model.
  * @param[in] roughness_days Number of days used for calculating roughness
@@ -86,8 +135,32 @@ void bt_model_update_penalty_factors(const fitness_t penalty_factor, const fitne
  * @param[in] max_daily_stress The maximum allowable daily stress (for
  *   calculating penalties).
  * @param[in,out] population Population to update.
+ * @returns The total number of days that were integrated.
  */
-void bt_model_update_obj_func(
+size_t bt_model_update_obj_func(
     const bt_params_t *parameters, const size_t roughness_days,
     const fitness_t penalty_factor, const fitness_t roughness_factor,
     const stress_t max_daily_stress, bt_population_t *population);
+
+/**
+ * Updates the objective function value, penalty, and penalized objective
+ * function value of one design.
+ *
+ * This is bt_model_update_obj_func() for a single member of the population.
+ *
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress (for
+ *   calculating penalties).
+ * @param[in,out] population Population containing the design.
+ * @param[in] i Index of the design within @p population.
+ * @returns The number of days that were integrated.
+ */
+size_t bt_model_update_member_obj_func(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, bt_population_t *population, const size_t i);
@@ -24,6 +24,8 @@
 
 #pragma once
 
+#include "bt_ode.h"
+
 /**
  * Type of a parameter or initial condition.
  *
@@ -45,6 +47,11 @@ typedef struct bt_params_t {
     param_t p0;
     param_t f0;
     param_t u0;
+    /**
+     * Method used to integrate the model. This isn't read from the parameters
+     * file; bt_params_load() sets it to #BT_ODE_EULER.
+     */
+    enum bt_ode_method integrator;
 } bt_params_t;
 
 /**
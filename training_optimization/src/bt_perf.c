@@ -0,0 +1,111 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+#include "bt_perf.h"
+#include <string.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+const char *const bt_perf_counter_names[] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses"
+};
+
+
+#ifdef __linux__
+
+/*
+ * type and config of the event of each counter
+ */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[BT_PERF_NUM_COUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8
+                         | PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}
+};
+
+/*
+ * The counters of each thread are one group, so they are scheduled together
+ * and read with a single system call. group_fd is the leader of the calling
+ * thread's group, -1 if none of the counters could be opened, or -2 if they
+ * haven't been opened yet. The file descriptors stay open for the lifetime of
+ * the thread.
+ */
+static int group_fd = -2;
+static unsigned available = 0;
+static int num_available = 0;
+#ifdef _OPENMP
+#pragma omp threadprivate(group_fd, available, num_available)
+#endif
+
+
+static void open_counters()
+{
+    group_fd = -1;
+    for (int i = 0; i < BT_PERF_NUM_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+        if (fd < 0)
+            continue;
+        if (group_fd < 0)
+            group_fd = fd;
+        available |= 1u << i;
+        num_available++;
+    }
+}
+
+#endif
+
+
+unsigned bt_perf_read(uint64_t values[])
+{
+    memset(values, 0, BT_PERF_NUM_COUNTERS * sizeof(uint64_t));
+#ifdef __linux__
+    if (group_fd == -2)
+        open_counters();
+    if (group_fd < 0)
+        return 0;
+
+    // The group is read as the number of counters followed by their values,
+    // in the order that they were opened.
+    uint64_t buffer[1 + BT_PERF_NUM_COUNTERS];
+    const ssize_t size = (1 + num_available) * sizeof(uint64_t);
+    if (read(group_fd, buffer, size) != size)
+        return 0;
+    for (int i = 0, j = 1; i < BT_PERF_NUM_COUNTERS; i++) {
+        if (available & 1u << i)
+            values[i] = buffer[j++];
+    }
+    return available;
+#else
+    return 0;
+#endif
+}
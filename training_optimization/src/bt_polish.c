@@ -0,0 +1,239 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_polish.h"
+#include "bt_model.h"
+#include "stats.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Sufficient increase of the objective function in the line search, relative
+ * to the increase predicted by the gradient, and the maximum number of times
+ * the step is halved.
+ */
+#define BT_POLISH_ARMIJO 1e-4
+#define BT_POLISH_MAX_BACKTRACKS 30
+
+/*
+ * Length of the first steepest ascent step, relative to the maximum daily
+ * stress, for the largest component of the gradient.
+ */
+#define BT_POLISH_INITIAL_STEP 0.1
+
+
+/*
+ * Evaluates the negated objective function and its gradient, since the
+ * iterations are written as a minimization.
+ */
+static double bt_polish_evaluate(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const size_t num_days, const stress_t x[],
+    double gradient[])
+{
+    const fitness_t objective = bt_model_calculate_obj_func_gradient(
+        parameters, roughness_days, penalty_factor, roughness_factor,
+        max_daily_stress, num_days, x, gradient);
+    for (size_t i = 0; i < num_days; i++)
+        gradient[i] = -gradient[i];
+    return -objective;
+}
+
+
+static double bt_polish_dot(const size_t n, const double a[], const double b[])
+{
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+
+/*
+ * Computes the L-BFGS direction in the free variables with the two-loop
+ * recursion. Returns false if there is no descent direction.
+ */
+static bool bt_polish_direction(
+    const size_t n, const double gradient[], const bool fixed[],
+    double (*const s)[n], double (*const y)[n], const double rho[],
+    const size_t num_pairs, const size_t newest, const double initial_scale,
+    double direction[])
+{
+    double alpha[BT_POLISH_MEMORY];
+    for (size_t i = 0; i < n; i++)
+        direction[i] = fixed[i] ? 0 : gradient[i];
+    for (size_t j = 0; j < num_pairs; j++) {
+        const size_t k = (newest + BT_POLISH_MEMORY - j) % BT_POLISH_MEMORY;
+        alpha[k] = rho[k] * bt_polish_dot(n, s[k], direction);
+        for (size_t i = 0; i < n; i++)
+            direction[i] -= alpha[k] * y[k][i];
+    }
+    double scale = initial_scale;
+    if (num_pairs > 0)
+        scale = bt_polish_dot(n, s[newest], y[newest]) / bt_polish_dot(n, y[newest], y[newest]);
+    for (size_t i = 0; i < n; i++)
+        direction[i] *= scale;
+    for (size_t j = num_pairs; j-- > 0;) {
+        const size_t k = (newest + BT_POLISH_MEMORY - j) % BT_POLISH_MEMORY;
+        const double beta = rho[k] * bt_polish_dot(n, y[k], direction);
+        for (size_t i = 0; i < n; i++)
+            direction[i] += (alpha[k] - beta) * s[k][i];
+    }
+    double slope = 0;
+    for (size_t i = 0; i < n; i++) {
+        direction[i] = fixed[i] ? 0 : -direction[i];
+        slope += gradient[i] * direction[i];
+    }
+    return slope < 0;
+}
+
+
+size_t bt_polish_stresses(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const size_t num_days, stress_t stresses[],
+    const size_t max_iterations)
+{
+    const size_t n = num_days;
+    stress_t *x = malloc(n * sizeof(stress_t));
+    double *gradient = malloc(n * sizeof(double));
+    stress_t *x_new = malloc(n * sizeof(stress_t));
+    double *gradient_new = malloc(n * sizeof(double));
+    double *direction = malloc(n * sizeof(double));
+    double (*s)[n] = malloc(BT_POLISH_MEMORY * sizeof(*s));
+    double (*y)[n] = malloc(BT_POLISH_MEMORY * sizeof(*y));
+    bool *fixed = malloc(n * sizeof(bool));
+    double rho[BT_POLISH_MEMORY];
+    size_t num_pairs = 0;
+    size_t newest = BT_POLISH_MEMORY - 1;
+    size_t num_evaluations = 1;
+
+    memcpy(x, stresses, n * sizeof(stress_t));
+    for (size_t i = 0; i < n; i++)
+        x[i] = fmin(fmax(x[i], 0), max_daily_stress);
+    double value = bt_polish_evaluate(parameters, roughness_days, penalty_factor, roughness_factor,
+                                      max_daily_stress, n, x, gradient);
+
+    for (size_t iteration = 0; iteration < max_iterations && isfinite(value); iteration++) {
+        // Stresses at a bound that the gradient pushes outward stay there.
+        double max_free_gradient = 0;
+        for (size_t i = 0; i < n; i++) {
+            fixed[i] = (x[i] <= 0 && gradient[i] > 0) || (x[i] >= max_daily_stress && gradient[i] < 0);
+            if (!fixed[i])
+                max_free_gradient = fmax(max_free_gradient, fabs(gradient[i]));
+        }
+        if (max_free_gradient == 0)
+            break;
+        const double initial_scale = BT_POLISH_INITIAL_STEP * max_daily_stress / max_free_gradient;
+        if (!bt_polish_direction(n, gradient, fixed, s, y, rho, num_pairs, newest,
+                                 initial_scale, direction)) {
+            num_pairs = 0;
+            bt_polish_direction(n, gradient, fixed, s, y, rho, 0, newest, initial_scale, direction);
+        }
+
+        // Backtrack along the projected path.
+        double step = 1;
+        double value_new = NAN;
+        bool accepted = false;
+        for (size_t j = 0; j < BT_POLISH_MAX_BACKTRACKS && !accepted; j++, step /= 2) {
+            double predicted = 0;
+            for (size_t i = 0; i < n; i++) {
+                x_new[i] = fmin(fmax(x[i] + step * direction[i], 0), max_daily_stress);
+                predicted += gradient[i] * (x_new[i] - x[i]);
+            }
+            if (predicted >= 0)
+                break;
+            value_new = bt_polish_evaluate(parameters, roughness_days, penalty_factor, roughness_factor,
+                                           max_daily_stress, n, x_new, gradient_new);
+            num_evaluations++;
+            accepted = value_new <= value + BT_POLISH_ARMIJO * predicted;
+        }
+        if (!accepted)
+            break;
+
+        // Keep the curvature pair only if it is positive, so that the inverse
+        // Hessian approximation stays positive definite.
+        const size_t next = (newest + 1) % BT_POLISH_MEMORY;
+        for (size_t i = 0; i < n; i++) {
+            s[next][i] = x_new[i] - x[i];
+            y[next][i] = gradient_new[i] - gradient[i];
+        }
+        const double curvature = bt_polish_dot(n, s[next], y[next]);
+        if (curvature > 0) {
+            rho[next] = 1 / curvature;
+            newest = next;
+            if (num_pairs < BT_POLISH_MEMORY)
+                num_pairs++;
+        }
+
+        const bool converged = value - value_new <= 1e-12 * fabs(value);
+        stress_t *swap_x = x;
+        x = x_new;
+        x_new = swap_x;
+        double *swap_gradient = gradient;
+        gradient = gradient_new;
+        gradient_new = swap_gradient;
+        value = value_new;
+        if (converged)
+            break;
+    }
+
+    for (size_t i = 0; i < n; i++)
+        stresses[i] = x[i];
+
+    free(fixed);
+    free(y);
+    free(s);
+    free(direction);
+    free(gradient_new);
+    free(x_new);
+    free(gradient);
+    free(x);
+    return 2 * num_evaluations * num_days;
+}
+
+
+size_t bt_polish_best_designs(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const bt_polish_options_t *options,
+    bt_population_t *population)
+{
+    const size_t nmemb = population->nmemb;
+    const size_t num_polished = options->num_designs < nmemb ? options->num_designs : nmemb;
+    size_t *indices = malloc(nmemb * sizeof(size_t));
+    stats_select_index(indices, population->fitnesses, nmemb, nmemb - num_polished);
+    size_t num_integrated_days = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+:num_integrated_days)
+    for (size_t i = nmemb - num_polished; i < nmemb; i++) {
+        const size_t index = indices[i];
+        if (!isfinite(population->fitnesses[index]))
+            continue;
+        num_integrated_days += bt_polish_stresses(
+            parameters, roughness_days, penalty_factor, roughness_factor, max_daily_stress,
+            population->num_days, population->stresses[index], options->max_iterations);
+        population->num_valid_states[index] = 0;
+        num_integrated_days += bt_model_update_member_obj_func(
+            parameters, roughness_days, penalty_factor, roughness_factor, max_daily_stress,
+            population, index);
+    }
+    free(indices);
+    return num_integrated_days;
+}
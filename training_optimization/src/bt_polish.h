@@ -0,0 +1,102 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_polish.h
+ *
+ * Gradient-based polishing of training plans, as an alternative to or a final
+ * stage after the genetic algorithm.
+ */
+
+#pragma once
+
+#include "bt_params.h"
+#include "bt_population.h"
+#include <stddef.h>
+
+/**
+ * Number of the most recent steps whose curvature pairs approximate the
+ * inverse Hessian in the L-BFGS directions.
+ */
+#ifndef BT_POLISH_MEMORY
+#define BT_POLISH_MEMORY 7
+#endif
+
+/**
+ * Options for polishing the best designs of the final population.
+ */
+typedef struct {
+    /**
+     * Number of the best designs to polish, or 0 to not polish.
+     */
+    size_t num_designs;
+    /**
+     * Maximum number of iterations per design.
+     */
+    size_t max_iterations;
+} bt_polish_options_t;
+
+/**
+ * Maximizes the penalized objective function of a training plan with a
+ * projected L-BFGS method within the bounds `[0, max_daily_stress]`.
+ *
+ * Each iteration fixes the stresses that are at a bound and that the gradient
+ * (from bt_model_calculate_obj_func_gradient()) pushes outward, takes an
+ * L-BFGS direction in the other stresses, and backtracks along the path
+ * projected onto the bounds until the objective function value increases
+ * sufficiently. The polished plan is therefore never worse than the original.
+ * Polishing stops early when no step makes progress.
+ *
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model. The integrator must be #BT_ODE_EULER.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress.
+ * @param[in] num_days Number of days in the training plan.
+ * @param[in,out] stresses The daily stresses of the training plan.
+ * @param[in] max_iterations Maximum number of iterations.
+ * @returns Number of days that the nonlinear model was integrated for.
+ */
+size_t bt_polish_stresses(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const size_t num_days, stress_t stresses[],
+    const size_t max_iterations);
+
+/**
+ * Polishes the best designs of a population with bt_polish_stresses(), in
+ * parallel, and updates their objective function values. Designs with
+ * infinite or `NAN` objective function values aren't polished.
+ *
+ * @param[in] parameters Parameters and initial conditions for the nonlinear
+ *   model. The integrator must be #BT_ODE_EULER.
+ * @param[in] roughness_days Number of days used for calculating roughness
+ *   value.
+ * @param[in] penalty_factor Coefficient of penalty function.
+ * @param[in] roughness_factor Coefficient of roughness value.
+ * @param[in] max_daily_stress The maximum allowable daily stress.
+ * @param[in] options Numbers of designs and iterations to polish.
+ * @param[in,out] population The population whose best designs to polish.
+ * @returns Number of days that the nonlinear model was integrated for.
+ */
+size_t bt_polish_best_designs(
+    const bt_params_t *parameters, const size_t roughness_days,
+    const fitness_t penalty_factor, const fitness_t roughness_factor,
+    const stress_t max_daily_stress, const bt_polish_options_t *options,
+    bt_population_t *population);
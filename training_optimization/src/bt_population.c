@@ -34,12 +34,115 @@ bt_population_t *bt_population_alloc(const size_t nmemb, const size_t num_days)
     population->penalties = malloc(nmemb * sizeof(penalty_t));
     population->roughnesses = malloc(nmemb * sizeof(penalty_t));
     population->fitnesses = malloc(nmemb * sizeof(fitness_t));
+    population->states = malloc(nmemb * sizeof(bt_population_state_t *));
+    population->states[0] = malloc(nmemb * (num_days + 1) * sizeof(bt_population_state_t));
+    for (size_t i = 1; i < nmemb; i++)
+        population->states[i] = population->states[0] + i * (num_days + 1);
+    population->num_valid_states = calloc(nmemb, sizeof(size_t));
     return population;
 }
 
 
-void bt_population_write(FILE *stream, const bt_population_t *population)
+bt_population_t bt_population_slice(const bt_population_t *population,
+                                    const size_t offset, const size_t nmemb)
+{
+    bt_population_t slice = *population;
+    slice.nmemb = nmemb;
+    slice.stresses += offset;
+    slice.final_performances += offset;
+    slice.penalties += offset;
+    slice.roughnesses += offset;
+    slice.fitnesses += offset;
+    slice.states += offset;
+    slice.num_valid_states += offset;
+    return slice;
+}
+
+
+void bt_population_inherit_member_states(bt_population_t *children, const size_t child_index,
+                                         const bt_population_t *parents, const size_t parent_index)
+{
+    const size_t num_days = children->num_days;
+    const stress_t *child = children->stresses[child_index];
+    const stress_t *parent = parents->stresses[parent_index];
+    size_t first_diff = 0;
+    while (first_diff < num_days && child[first_diff] == parent[first_diff])
+        first_diff++;
+    size_t num_valid = first_diff + 1;
+    if (num_valid > parents->num_valid_states[parent_index])
+        num_valid = parents->num_valid_states[parent_index];
+    memcpy(children->states[child_index], parents->states[parent_index],
+           num_valid * sizeof(bt_population_state_t));
+    children->num_valid_states[child_index] = num_valid;
+}
+
+
+void bt_population_copy_member(bt_population_t *dst, const size_t dst_index,
+                               const bt_population_t *src, const size_t src_index)
+{
+    memcpy(dst->stresses[dst_index], src->stresses[src_index], src->num_days * sizeof(stress_t));
+    dst->final_performances[dst_index] = src->final_performances[src_index];
+    dst->penalties[dst_index] = src->penalties[src_index];
+    dst->roughnesses[dst_index] = src->roughnesses[src_index];
+    dst->fitnesses[dst_index] = src->fitnesses[src_index];
+    memcpy(dst->states[dst_index], src->states[src_index],
+           src->num_valid_states[src_index] * sizeof(bt_population_state_t));
+    dst->num_valid_states[dst_index] = src->num_valid_states[src_index];
+}
+
+
+void bt_population_inherit_states(bt_population_t *children, const bt_population_t *parents,
+                                  const size_t parent_indices[])
+{
+    for (size_t i = 0; i < children->nmemb; i++)
+        bt_population_inherit_member_states(children, i, parents, parent_indices[i]);
+}
+
+
+/*
+ * writes the population as a binary table, with the same columns as the TSV
+ * format
+ */
+static void bt_population_write_binary(FILE *stream, const bt_population_t *population)
+{
+    const size_t nmemb = population->nmemb;
+    const double *const extra_columns[] = {
+        population->final_performances, population->penalties,
+        population->roughnesses, population->fitnesses
+    };
+    static const char *const extra_names[] = {"final_performance", "penalty", "roughness", "fitness"};
+    const size_t max_columns = population->num_days + 4;
+    const char *names[max_columns];
+    char (*day_names)[24] = malloc((population->num_days > 0 ? population->num_days : 1) * sizeof(char[24]));
+    double *values = malloc(max_columns * (nmemb > 0 ? nmemb : 1) * sizeof(double));
+    size_t num_columns = 0;
+    for (size_t day = 0; day < population->num_days; day++, num_columns++) {
+        snprintf(day_names[day], sizeof(day_names[day]), "day%03zd", day);
+        names[num_columns] = day_names[day];
+        for (size_t i = 0; i < nmemb; i++)
+            values[num_columns * nmemb + i] = population->stresses[i][day];
+    }
+    for (size_t k = 0; k < 4; k++) {
+        if (extra_columns[k] == NULL)
+            continue;
+        names[num_columns] = extra_names[k];
+        memcpy(values + num_columns * nmemb, extra_columns[k], nmemb * sizeof(double));
+        num_columns++;
+    }
+    bt_table_write(stream, num_columns, nmemb, names, NULL, values);
+    free(values);
+    free(day_names);
+}
+
+
+void bt_population_write(FILE *stream, const enum bt_table_format format,
+                         const bt_population_t *population)
 {
+    if (format == BT_TABLE_BINARY) {
+        bt_population_write_binary(stream, population);
+        return;
+    }
+
     // Header
     for (size_t i = 0; i < population->num_days; i++) {
         if (i != 0)
@@ -87,35 +190,18 @@ void bt_population_free(bt_population_t *population)
     free(population->penalties);
     free(population->roughnesses);
     free(population->fitnesses);
+    free(population->states[0]);
+    free(population->states);
+    free(population->num_valid_states);
     free(population);
 }
 
 
 void fprintf_fitness_summary(FILE *stream, const size_t nmemb, const fitness_t fitnesses[])
 {
-    fitness_t min_fitness, max_fitness, median_fitness;
-    fitness_t fitnesses_copy[nmemb];
-    memcpy(fitnesses_copy, fitnesses, nmemb * sizeof(fitness_t));
-    stats_sort(fitnesses_copy, nmemb);
-    min_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.0);
-    max_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 1.0);
-    median_fitness = stats_median_from_sorted(fitnesses_copy, nmemb);
+    static const double qs[] = {0., 0.5, 1.};
+    fitness_t summary[3];
+    stats_quantiles(summary, qs, 3, fitnesses, nmemb);
     fprintf(stream, "Min: %lf\tMedian: %lf\t Max: %lf",
-            min_fitness, median_fitness, max_fitness);
-}
-
-
-void fprintf_fitness_quartiles(FILE *stream, const size_t nmemb, const fitness_t fitnesses[])
-{
-    fitness_t min_fitness, q1_fitness, median_fitness, q3_fitness, max_fitness;
-    fitness_t fitnesses_copy[nmemb];
-    memcpy(fitnesses_copy, fitnesses, nmemb * sizeof(fitness_t));
-    stats_sort(fitnesses_copy, nmemb);
-    min_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.0);
-    max_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 1.0);
-    median_fitness = stats_median_from_sorted(fitnesses_copy, nmemb);
-    q1_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.25);
-    q3_fitness = stats_quantile_from_sorted(fitnesses_copy, nmemb, 0.75);
-    fprintf(stream, "%lf\t%lf\t%lf\t%lf\t%lf",
-            min_fitness, q1_fitness, median_fitness, q3_fitness, max_fitness);
+            summary[0], summary[1], summary[2]);
 }
@@ -23,15 +23,21 @@
 
 #pragma once
 
+#include "bt_table.h"
 #include <stdio.h>
 
 /**
  * Type of training stress values.
  *
  * This is primarily useful from a documentation perspective for clarifying the
- * desired inputs/outputs of functions.
+ * desired inputs/outputs of functions. Add `-DBT_STRESS_T=float` to `CFLAGS`
+ * to store the populations' stresses in single precision, which halves the
+ * memory they take; the model still integrates in double precision.
  */
-typedef double stress_t;
+#ifndef BT_STRESS_T
+#define BT_STRESS_T double
+#endif
+typedef BT_STRESS_T stress_t;
 
 /**
  * Type of training performance values.
@@ -61,6 +67,16 @@ typedef double penalty_t;
  */
 typedef double fitness_t;
 
+/**
+ * State of the nonlinear model and the accumulated penalty at the beginning of
+ * a day.
+ */
+typedef struct bt_population_state_t {
+    performance_t fitness;
+    performance_t fatigue;
+    penalty_t penalty;
+} bt_population_state_t;
+
 /**
  * A population of designs and associated objective function and penalty
  * values.
@@ -100,6 +116,19 @@ typedef struct bt_population_t {
      * Penalized objective function values.
      */
     fitness_t *fitnesses;
+    /**
+     * 2-D array of cached states from integrating the nonlinear model.
+     *
+     * The first index is the member, and the second index is the day, from 0
+     * to `num_days` (inclusive). Each element is the state at the beginning of
+     * that day, so the last element is the final state.
+     */
+    bt_population_state_t **states;
+    /**
+     * Number of leading elements of each member's row of @p states that are
+     * up to date with its training stresses.
+     */
+    size_t *num_valid_states;
 } bt_population_t;
 
 /**
@@ -114,12 +143,71 @@ typedef struct bt_population_t {
 bt_population_t *bt_population_alloc(const size_t nmemb, const size_t num_days);
 
 /**
- * Writes the population data to the given stream.
+ * Returns a view of a contiguous range of members of a population.
+ *
+ * The view shares its arrays with @p population, so changes to the members of
+ * the view are changes to @p population. It must not be freed with
+ * bt_population_free().
+ *
+ * @param[in] population The population to view.
+ * @param[in] offset Index of the first member of the view.
+ * @param[in] nmemb Number of members in the view.
+ * @returns The view.
+ */
+bt_population_t bt_population_slice(const bt_population_t *population,
+                                    const size_t offset, const size_t nmemb);
+
+/**
+ * Copies the cached states that each child shares with its parent.
+ *
+ * The state at the beginning of a day depends only on the training stresses
+ * of earlier days, so the states of a child are the same as those of its
+ * parent up to and including the first day on which their training stresses
+ * differ.
+ *
+ * @param[in,out] children The population of children, whose training
+ *   stresses have already been generated.
+ * @param[in] parents The population of parents.
+ * @param[in] parent_indices For each child, the index within @p parents of
+ *   the parent it was derived from.
+ */
+void bt_population_inherit_states(bt_population_t *children, const bt_population_t *parents,
+                                  const size_t parent_indices[]);
+
+/**
+ * Copies the cached states that one child shares with its parent.
+ *
+ * This is bt_population_inherit_states() for a single child.
+ *
+ * @param[in,out] children The population of children.
+ * @param[in] child_index Index of the child within @p children.
+ * @param[in] parents The population of parents.
+ * @param[in] parent_index Index of the child's parent within @p parents.
+ */
+void bt_population_inherit_member_states(bt_population_t *children, const size_t child_index,
+                                         const bt_population_t *parents, const size_t parent_index);
+
+/**
+ * Copies one member of a population, including its cached states, over a
+ * member of another (or the same) population.
+ *
+ * @param[in,out] dst The destination population.
+ * @param[in] dst_index Index of the member to overwrite within @p dst.
+ * @param[in] src The source population.
+ * @param[in] src_index Index of the member to copy within @p src.
+ */
+void bt_population_copy_member(bt_population_t *dst, const size_t dst_index,
+                               const bt_population_t *src, const size_t src_index);
+
+/**
+ * Writes the population data to the given stream as a table.
  *
  * @param[in,out] stream The stream to write to.
+ * @param[in] format The format of the table.
  * @param[in] population The population to write.
  */
-void bt_population_write(FILE *stream, const bt_population_t *population);
+void bt_population_write(FILE *stream, const enum bt_table_format format,
+                         const bt_population_t *population);
 
 /**
  * Frees a population allocated with bt_population_alloc().
@@ -138,14 +226,3 @@ void bt_population_free(bt_population_t *population);
  */
 void fprintf_fitness_summary(FILE *stream,
                              const size_t nmemb, const fitness_t fitnesses[]);
-
-/**
- * Writes a summary (min/q1/median/q3/max) of the penalized objective function
- * values to the given stream.
- *
- * @param[in,out] stream The stream to write to.
- * @param[in] nmemb Number of penalized objective function values.
- * @param[in] fitnesses Array of penalized objective function values.
- */
-void fprintf_fitness_quartiles(FILE *stream,
-                               const size_t nmemb, const fitness_t fitnesses[]);
@@ -0,0 +1,334 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_profile.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+const char *const bt_profile_phase_names[] = {
+    "select", "crossover", "mutate", "evaluate", "cull", "migrate", "stats", "io"
+};
+
+
+/*
+ * trace thread ID of the calling thread, assigned on first use
+ */
+static int trace_tid = -1;
+#ifdef _OPENMP
+#pragma omp threadprivate(trace_tid)
+#endif
+static int next_trace_tid = 0;
+
+
+static double wall_time()
+{
+#ifdef _OPENMP
+    return omp_get_wtime();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+
+/*
+ * Returns the number of the calling thread in the innermost team of more than
+ * one thread that was started after the profile was created, or 0 if there's
+ * none.
+ */
+static size_t thread_index(const bt_profile_t *profile)
+{
+#ifdef _OPENMP
+    for (int level = omp_get_level(); level > profile->level; level--) {
+        if (omp_get_team_size(level) > 1)
+            return omp_get_ancestor_thread_num(level) % profile->num_threads;
+    }
+#endif
+    return 0;
+}
+
+
+/*
+ * Adds the counts of events from start until end to counters.
+ */
+static void add_counters(uint64_t counters[], const bt_profile_mark_t *start,
+                         const bt_profile_mark_t *end)
+{
+    for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+        counters[i] += end->counters[i] - start->counters[i];
+}
+
+
+/*
+ * Writes a complete event to the trace. Must be called in the bt_profile
+ * critical section.
+ */
+static void write_event(bt_profile_t *profile, const char *name, const double start,
+                        const double end, const char *args)
+{
+    if (trace_tid < 0)
+        trace_tid = next_trace_tid++;
+    fprintf(profile->trace,
+            "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %lu, \"tid\": %d, "
+            "\"ts\": %.3lf, \"dur\": %.3lf, \"args\": {%s}}",
+            profile->trace_empty ? "" : ",", name, profile->id, trace_tid,
+            (start - profile->origin) * 1e6, (end - start) * 1e6, args);
+    profile->trace_empty = false;
+}
+
+
+bt_profile_t *bt_profile_create(const unsigned long id, const char *trace_path,
+                                const bool perf_counters)
+{
+    bt_profile_t *profile = calloc(1, sizeof(bt_profile_t));
+    profile->id = id;
+    if (perf_counters) {
+        uint64_t counters[BT_PERF_NUM_COUNTERS];
+        profile->available_counters = bt_perf_read(counters);
+        profile->perf_counters = profile->available_counters != 0;
+    }
+    profile->num_threads = 1;
+#ifdef _OPENMP
+    profile->level = omp_get_level();
+    profile->num_threads = omp_get_max_threads();
+#endif
+    profile->thread_seconds = calloc(profile->num_threads,
+                                     sizeof(double[BT_PROFILE_NUM_THREAD_PHASES]));
+    if (trace_path) {
+        if ((profile->trace = fopen(trace_path, "w")) == NULL) {
+            free(profile->thread_seconds);
+            free(profile);
+            return NULL;
+        }
+        fprintf(profile->trace, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+        profile->trace_empty = true;
+    }
+    profile->origin = wall_time();
+    return profile;
+}
+
+
+bt_profile_mark_t bt_profile_now(const bt_profile_t *profile)
+{
+    bt_profile_mark_t mark = {0};
+    if (profile == NULL)
+        return mark;
+    if (profile->perf_counters)
+        bt_perf_read(mark.counters);
+    mark.seconds = wall_time();
+    return mark;
+}
+
+
+void bt_profile_record(bt_profile_t *profile, const enum bt_profile_phase phase,
+                       const bt_profile_mark_t start)
+{
+    if (profile == NULL)
+        return;
+    const bt_profile_mark_t end = bt_profile_now(profile);
+    #pragma omp critical (bt_profile)
+    {
+        profile->seconds[phase] += end.seconds - start.seconds;
+        add_counters(profile->counters[phase], &start, &end);
+        if (profile->trace)
+            write_event(profile, bt_profile_phase_names[phase], start.seconds, end.seconds, "");
+    }
+}
+
+
+void bt_profile_record_generation(bt_profile_t *profile, const size_t generation,
+                                  const bt_profile_mark_t start)
+{
+    if (profile == NULL)
+        return;
+    const double end = wall_time();
+    #pragma omp critical (bt_profile)
+    {
+        profile->num_generations++;
+        if (profile->trace) {
+            char args[32];
+            snprintf(args, sizeof(args), "\"generation\": %zd", generation);
+            write_event(profile, "generation", start.seconds, end, args);
+        }
+    }
+}
+
+
+bt_profile_mark_t bt_profile_lap(const bt_profile_t *profile, bt_profile_laps_t *laps,
+                                 const enum bt_profile_phase phase,
+                                 const bt_profile_mark_t start)
+{
+    const bt_profile_mark_t now = bt_profile_now(profile);
+    if (profile == NULL)
+        return now;
+    laps->seconds[phase] += now.seconds - start.seconds;
+    add_counters(laps->counters[phase], &start, &now);
+    return now;
+}
+
+
+void bt_profile_record_thread(bt_profile_t *profile, const bt_profile_mark_t start,
+                              const bt_profile_laps_t *laps)
+{
+    if (profile == NULL)
+        return;
+    const double end = wall_time();
+    const size_t thread = thread_index(profile);
+    #pragma omp critical (bt_profile)
+    {
+        char args[256];
+        int length = snprintf(args, sizeof(args), "\"thread\": %zd", thread);
+        for (size_t phase = 0; phase < BT_PROFILE_NUM_THREAD_PHASES; phase++) {
+            const double seconds = laps->seconds[phase];
+            profile->thread_seconds[thread][phase] += seconds;
+            profile->pending_seconds[phase] += seconds;
+            for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+                profile->thread_counters[phase][i] += laps->counters[phase][i];
+            if (seconds > 0 && length < (int)sizeof(args)) {
+                length += snprintf(args + length, sizeof(args) - length, ", \"%s_us\": %.3lf",
+                                   bt_profile_phase_names[phase], seconds * 1e6);
+            }
+        }
+        if (profile->trace)
+            write_event(profile, "worker", start.seconds, end, args);
+    }
+}
+
+
+void bt_profile_record_fused(bt_profile_t *profile, const bt_profile_mark_t start)
+{
+    if (profile == NULL)
+        return;
+    const double end = wall_time();
+    #pragma omp critical (bt_profile)
+    {
+        double total = 0;
+        for (size_t phase = 0; phase < BT_PROFILE_NUM_THREAD_PHASES; phase++)
+            total += profile->pending_seconds[phase];
+        for (size_t phase = 0; phase < BT_PROFILE_NUM_THREAD_PHASES; phase++) {
+            if (total > 0)
+                profile->seconds[phase] += (end - start.seconds) * profile->pending_seconds[phase] / total;
+            profile->pending_seconds[phase] = 0;
+        }
+        if (total == 0)
+            profile->seconds[BT_PROFILE_EVALUATE] += end - start.seconds;
+        if (profile->trace)
+            write_event(profile, "select+crossover+mutate+evaluate", start.seconds, end, "");
+    }
+}
+
+
+/*
+ * Writes the counters of each phase, their instructions per cycle, and the
+ * counters per evaluated day.
+ */
+static void fprint_counters(FILE *stream, const bt_profile_t *profile,
+                            const size_t num_evaluated_days)
+{
+    fprintf(stream, "phase");
+    for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+        fprintf(stream, "\t%s", bt_perf_counter_names[i]);
+    fprintf(stream, "\tipc");
+    for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+        fprintf(stream, "\t%s_per_day", bt_perf_counter_names[i]);
+    fprintf(stream, "\n");
+
+    // The phases that worker threads report are counted on all of them, so
+    // the counts of the GA's thread are only used for the other phases.
+    uint64_t totals[BT_PERF_NUM_COUNTERS] = {0};
+    for (size_t phase = 0; phase <= BT_PROFILE_NUM_PHASES; phase++) {
+        const uint64_t *counters = totals;
+        if (phase < BT_PROFILE_NUM_THREAD_PHASES && profile->thread_counters[phase][BT_PERF_CYCLES] > 0)
+            counters = profile->thread_counters[phase];
+        else if (phase < BT_PROFILE_NUM_PHASES)
+            counters = profile->counters[phase];
+        if (phase < BT_PROFILE_NUM_PHASES) {
+            for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+                totals[i] += counters[i];
+        }
+
+        double values[BT_PERF_NUM_COUNTERS];
+        for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+            values[i] = profile->available_counters & 1u << i ? counters[i] : NAN;
+        fprintf(stream, "%s", phase < BT_PROFILE_NUM_PHASES ? bt_profile_phase_names[phase] : "total");
+        for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+            fprintf(stream, "\t%.0lf", values[i]);
+        fprintf(stream, "\t%.3lf", values[BT_PERF_INSTRUCTIONS] / values[BT_PERF_CYCLES]);
+        for (size_t i = 0; i < BT_PERF_NUM_COUNTERS; i++)
+            fprintf(stream, "\t%.3lf", values[i] / num_evaluated_days);
+        fprintf(stream, "\n");
+    }
+}
+
+
+void bt_profile_fprint_summary(FILE *stream, const bt_profile_t *profile,
+                               const size_t num_evaluated_days)
+{
+    if (profile == NULL)
+        return;
+    const double total = wall_time() - profile->origin;
+    const size_t num_generations = profile->num_generations > 0 ? profile->num_generations : 1;
+    #pragma omp critical (bt_profile_summary)
+    {
+        fprintf(stream, "Profile of seed %lu: %zd generations in %lf s\n",
+                profile->id, profile->num_generations, total);
+        fprintf(stream, "phase\tseconds\tpercent\tms_per_generation\n");
+        for (size_t phase = 0; phase < BT_PROFILE_NUM_PHASES; phase++) {
+            fprintf(stream, "%s\t%lf\t%.2lf\t%lf\n", bt_profile_phase_names[phase],
+                    profile->seconds[phase], 100 * profile->seconds[phase] / total,
+                    1e3 * profile->seconds[phase] / num_generations);
+        }
+        fprintf(stream, "total\t%lf\t100.00\t%lf\n", total, 1e3 * total / num_generations);
+        fprintf(stream, "thread");
+        for (size_t phase = 0; phase < BT_PROFILE_NUM_THREAD_PHASES; phase++)
+            fprintf(stream, "\t%s", bt_profile_phase_names[phase]);
+        fprintf(stream, "\n");
+        for (size_t thread = 0; thread < profile->num_threads; thread++) {
+            fprintf(stream, "%zd", thread);
+            for (size_t phase = 0; phase < BT_PROFILE_NUM_THREAD_PHASES; phase++)
+                fprintf(stream, "\t%lf", profile->thread_seconds[thread][phase]);
+            fprintf(stream, "\n");
+        }
+        if (profile->perf_counters)
+            fprint_counters(stream, profile, num_evaluated_days);
+        fflush(stream);
+    }
+}
+
+
+int bt_profile_close(bt_profile_t *profile)
+{
+    if (profile == NULL)
+        return 0;
+    int status = 0;
+    if (profile->trace) {
+        fprintf(profile->trace, "\n]}\n");
+        if (ferror(profile->trace))
+            status = -1;
+        if (fclose(profile->trace) != 0)
+            status = -1;
+    }
+    free(profile->thread_seconds);
+    free(profile);
+    return status;
+}
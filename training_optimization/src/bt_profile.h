@@ -0,0 +1,275 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_profile.h
+ *
+ * Timing of the phases of a GA run.
+ *
+ * A profile accumulates the wall time of each phase as measured by the thread
+ * that runs the GA, and the time that each worker thread spends in the
+ * parallel steps, which shows how evenly the work is spread. It can also
+ * write each measurement as an event of a Chrome trace, a JSON file that can
+ * be viewed in `chrome://tracing` or Perfetto. Optionally, it also counts
+ * hardware events (see bt_perf.h) over the same intervals. All of the
+ * functions do nothing when given a `NULL` profile, so disabled profiling
+ * doesn't even read the clock.
+ */
+
+#pragma once
+
+#include "bt_perf.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Phases of a generation.
+ */
+enum bt_profile_phase {
+    BT_PROFILE_SELECT = 0,
+    BT_PROFILE_CROSSOVER = 1,
+    BT_PROFILE_MUTATE = 2,
+    BT_PROFILE_EVALUATE = 3,
+    BT_PROFILE_CULL = 4,
+    BT_PROFILE_MIGRATE = 5,
+    BT_PROFILE_STATS = 6,
+    BT_PROFILE_IO = 7,
+    BT_PROFILE_NUM_PHASES = 8
+};
+
+/**
+ * Number of phases (starting from #BT_PROFILE_SELECT) that worker threads
+ * report with bt_profile_record_thread().
+ */
+#define BT_PROFILE_NUM_THREAD_PHASES (BT_PROFILE_EVALUATE + 1)
+
+/**
+ * Names of the phases, indexed by #bt_profile_phase.
+ */
+extern const char *const bt_profile_phase_names[];
+
+/**
+ * A point in time on one thread, which starts an interval to record.
+ */
+typedef struct bt_profile_mark_t {
+    /**
+     * Time, in seconds.
+     */
+    double seconds;
+    /**
+     * Values of the calling thread's counters, or zeros if the profile
+     * doesn't count hardware events.
+     */
+    uint64_t counters[BT_PERF_NUM_COUNTERS];
+} bt_profile_mark_t;
+
+/**
+ * Time and hardware events of one worker thread in each of the first
+ * #BT_PROFILE_NUM_THREAD_PHASES phases of a parallel step. Initialize it to
+ * zeros.
+ */
+typedef struct bt_profile_laps_t {
+    /**
+     * Time in each phase, in seconds.
+     */
+    double seconds[BT_PROFILE_NUM_THREAD_PHASES];
+    /**
+     * Number of each hardware event in each phase.
+     */
+    uint64_t counters[BT_PROFILE_NUM_THREAD_PHASES][BT_PERF_NUM_COUNTERS];
+} bt_profile_laps_t;
+
+/**
+ * Timing measurements of one GA run.
+ */
+typedef struct bt_profile_t {
+    /**
+     * Identifier of the run (the random seed), used as the process ID in
+     * the trace.
+     */
+    unsigned long id;
+    /**
+     * Time at which the profile was created, in seconds.
+     */
+    double origin;
+    /**
+     * OpenMP nesting level of the thread that created the profile.
+     */
+    int level;
+    /**
+     * Number of generations recorded by bt_profile_record_generation().
+     */
+    size_t num_generations;
+    /**
+     * Total wall time of each phase, in seconds.
+     */
+    double seconds[BT_PROFILE_NUM_PHASES];
+    /**
+     * Number of rows of @p thread_seconds.
+     */
+    size_t num_threads;
+    /**
+     * Total time of each worker thread (by its number in the innermost team
+     * started by the GA) in each of the first #BT_PROFILE_NUM_THREAD_PHASES
+     * phases, in seconds.
+     */
+    double (*thread_seconds)[BT_PROFILE_NUM_THREAD_PHASES];
+    /**
+     * Time of all of the worker threads in each phase since the last call of
+     * bt_profile_record_fused().
+     */
+    double pending_seconds[BT_PROFILE_NUM_THREAD_PHASES];
+    /**
+     * Whether hardware events are counted.
+     */
+    bool perf_counters;
+    /**
+     * Bit mask of the available counters (see bt_perf_read()).
+     */
+    unsigned available_counters;
+    /**
+     * Number of each hardware event in each phase, counted on the threads
+     * that called bt_profile_record().
+     */
+    uint64_t counters[BT_PROFILE_NUM_PHASES][BT_PERF_NUM_COUNTERS];
+    /**
+     * Number of each hardware event in each of the first
+     * #BT_PROFILE_NUM_THREAD_PHASES phases, summed over the worker threads.
+     */
+    uint64_t thread_counters[BT_PROFILE_NUM_THREAD_PHASES][BT_PERF_NUM_COUNTERS];
+    /**
+     * The trace being written, or `NULL`.
+     */
+    FILE *trace;
+    /**
+     * Whether no events have been written to @p trace yet.
+     */
+    bool trace_empty;
+} bt_profile_t;
+
+/**
+ * Creates a profile for a GA run.
+ *
+ * Call this on the thread that runs the GA, after limiting its number of
+ * threads. The returned pointer must be freed with bt_profile_close().
+ *
+ * @param[in] id Identifier of the run (the random seed).
+ * @param[in] trace_path Path of the Chrome trace to write, or `NULL` for no
+ *   trace.
+ * @param[in] perf_counters Whether to count hardware events. Check
+ *   `available_counters` to find out which of them can be counted.
+ * @returns A pointer to the profile, or `NULL` if the trace couldn't be
+ *   created.
+ */
+bt_profile_t *bt_profile_create(const unsigned long id, const char *trace_path,
+                                const bool perf_counters);
+
+/**
+ * Returns the current time and counter values of the calling thread, or
+ * zeros if @p profile is `NULL`.
+ *
+ * @param[in] profile The profile.
+ * @returns The current mark.
+ */
+bt_profile_mark_t bt_profile_now(const bt_profile_t *profile);
+
+/**
+ * Records that a phase ran from @p start until now on the calling thread,
+ * which runs the GA.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] phase The phase.
+ * @param[in] start The mark returned by bt_profile_now() on the same thread
+ *   at the start.
+ */
+void bt_profile_record(bt_profile_t *profile, const enum bt_profile_phase phase,
+                       const bt_profile_mark_t start);
+
+/**
+ * Records that a generation ran from @p start until now. This only adds a
+ * trace event enclosing the events of the generation's phases.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] generation The generation number.
+ * @param[in] start The mark returned by bt_profile_now() at the start.
+ */
+void bt_profile_record_generation(bt_profile_t *profile, const size_t generation,
+                                  const bt_profile_mark_t start);
+
+/**
+ * Adds the time and hardware events from @p start until now to @p phase of
+ * @p laps, for measuring the phases of a worker thread.
+ *
+ * @param[in] profile The profile.
+ * @param[in,out] laps The measurements of the calling thread.
+ * @param[in] phase The phase that ended.
+ * @param[in] start The mark returned by bt_profile_now() on the same thread
+ *   at the start.
+ * @returns The current mark, which is the start of the next phase.
+ */
+bt_profile_mark_t bt_profile_lap(const bt_profile_t *profile, bt_profile_laps_t *laps,
+                                 const enum bt_profile_phase phase,
+                                 const bt_profile_mark_t start);
+
+/**
+ * Records the work of the calling worker thread in a parallel step, which ran
+ * from @p start until now.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] start The mark returned by bt_profile_now() when the thread
+ *   started.
+ * @param[in] laps The measurements of the thread's phases.
+ */
+void bt_profile_record_thread(bt_profile_t *profile, const bt_profile_mark_t start,
+                              const bt_profile_laps_t *laps);
+
+/**
+ * Records a parallel step that fused several phases, which ran from @p start
+ * until now on the GA's thread. Its wall time is divided among the phases in
+ * proportion to the time that the worker threads reported for them since the
+ * last call.
+ *
+ * @param[in,out] profile The profile.
+ * @param[in] start The mark returned by bt_profile_now() at the start.
+ */
+void bt_profile_record_fused(bt_profile_t *profile, const bt_profile_mark_t start);
+
+/**
+ * Writes a summary of the profile as tab-separated tables: the total time of
+ * each phase, the time of each worker thread, and, if hardware events are
+ * counted, the events of each phase with the instructions per cycle and the
+ * events per evaluated day. The events of the phases that worker threads
+ * report are summed over the worker threads, and the others are counted on
+ * the GA's thread. Unavailable counters are written as `nan`.
+ *
+ * @param[in,out] stream The stream to write to.
+ * @param[in] profile The profile.
+ * @param[in] num_evaluated_days Number of days integrated by the evaluations
+ *   that the worker threads reported.
+ */
+void bt_profile_fprint_summary(FILE *stream, const bt_profile_t *profile,
+                               const size_t num_evaluated_days);
+
+/**
+ * Finishes the trace and frees a profile created with bt_profile_create().
+ *
+ * @param[in] profile The profile to close.
+ * @returns 0 on success, or nonzero if the trace couldn't be written.
+ */
+int bt_profile_close(bt_profile_t *profile);
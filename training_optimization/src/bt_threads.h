@@ -0,0 +1,93 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+/**
+ * @file bt_threads.h
+ *
+ * Division of OpenMP threads between concurrent GA runs (seeds) and the
+ * evaluation of each run's population.
+ *
+ * Without OpenMP, everything runs on one thread.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Minimum amount of work (in integration steps per generation) that makes it
+ * worthwhile to give another thread to the evaluation of one population.
+ */
+#ifndef BT_THREADS_MIN_WORK
+#define BT_THREADS_MIN_WORK 5000
+#endif
+
+/**
+ * Numbers of threads to use at each level of parallelism.
+ */
+typedef struct bt_threads_split_t {
+    /**
+     * Number of seeds to run concurrently.
+     */
+    int seed_threads;
+    /**
+     * Number of threads for evaluating the population of each seed.
+     */
+    int eval_threads;
+} bt_threads_split_t;
+
+/**
+ * Decides how to divide the available threads.
+ *
+ * Independent seeds need no synchronization, so they get threads first. Each
+ * seed's evaluation gets a share of the remaining threads, limited so that
+ * each thread has at least #BT_THREADS_MIN_WORK steps per generation.
+ *
+ * If this is called from within a parallel region (e.g. from an OpenMP task),
+ * the result is one thread at each level.
+ *
+ * @param[in] num_seeds Number of independent GA runs.
+ * @param[in] population_size Number of designs evaluated per generation.
+ * @param[in] work_per_member Number of integration steps per design.
+ * @param[in] requested_seed_threads Number of seeds to run concurrently, or 0
+ *   to decide automatically.
+ * @returns The numbers of threads.
+ */
+bt_threads_split_t bt_threads_split(const size_t num_seeds, const size_t population_size,
+                                    const size_t work_per_member,
+                                    const int requested_seed_threads);
+
+/**
+ * Allows the parallel regions within each seed to be active when the seeds
+ * themselves run in parallel.
+ *
+ * Call this before the parallel loop over the seeds.
+ *
+ * @param[in] split The numbers of threads.
+ */
+void bt_threads_enable_nesting(const bt_threads_split_t *split);
+
+/**
+ * Limits the parallel regions subsequently encountered by the calling thread
+ * to the number of evaluation threads.
+ *
+ * Call this at the start of each seed, inside the parallel loop over the
+ * seeds.
+ *
+ * @param[in] split The numbers of threads.
+ */
+void bt_threads_limit_eval(const bt_threads_split_t *split);
@@ -41,14 +41,29 @@ penalty_t bt_constraints_penalty_step(
     return new_penalty;
 }
 
-void bt_constraints_print_header(FILE *stream)
+bt_constraints_gradient_t bt_constraints_penalty_gradient(
+    const performance_t performance, const performance_t fitness,
+    const performance_t fatigue, const stress_t training_stress,
+    const stress_t max_daily_stress)
 {
-    fprintf(stream, "\tmax_fatigue_fitness_ratio");
+    bt_constraints_gradient_t gradient = {0, 0, 0, 0};
+
+    const performance_t fatigue_fitness_ratio = fatigue / fitness;
+    if (fatigue_fitness_ratio > MAX_FATIGUE_FITNESS_RATIO) {
+        gradient.fatigue += 1 / fitness;
+        gradient.fitness -= fatigue_fitness_ratio / fitness;
+    }
+
+    return gradient;
 }
 
-void bt_constraints_print_value(
-    FILE *stream, const performance_t performance, const performance_t fitness,
+const size_t bt_constraints_num_columns = 1;
+
+const char *const bt_constraints_column_names[] = {"max_fatigue_fitness_ratio"};
+
+void bt_constraints_values(
+    double values[], const performance_t performance, const performance_t fitness,
     const performance_t fatigue, const stress_t max_daily_stress)
 {
-    fprintf(stream, "\t%lf", MAX_FATIGUE_FITNESS_RATIO);
+    values[0] = MAX_FATIGUE_FITNESS_RATIO;
 }
@@ -48,16 +48,31 @@ penalty_t bt_constraints_penalty_step(
     return new_penalty;
 }
 
-void bt_constraints_print_header(FILE *stream)
+bt_constraints_gradient_t bt_constraints_penalty_gradient(
+    const performance_t performance, const performance_t fitness,
+    const performance_t fatigue, const stress_t training_stress,
+    const stress_t max_daily_stress)
 {
-    fprintf(stream, "\tfitness_max_stress");
+    bt_constraints_gradient_t gradient = {0, 0, 0, 0};
+
+    const stress_t max_stress_fitness = bt_constraints_calc_max_stress_fitness(max_daily_stress, fitness);
+    if (training_stress > max_stress_fitness) {
+        gradient.training_stress += 1;
+        gradient.fitness -= max_daily_stress * 0.9 / 150 * exp(-fitness / 150);
+    }
+
+    return gradient;
 }
 
-void bt_constraints_print_value(
-    FILE *stream, const performance_t performance, const performance_t fitness,
+const size_t bt_constraints_num_columns = 1;
+
+const char *const bt_constraints_column_names[] = {"fitness_max_stress"};
+
+void bt_constraints_values(
+    double values[], const performance_t performance, const performance_t fitness,
     const performance_t fatigue, const stress_t max_daily_stress)
 {
     const stress_t max_stress_fitness = bt_constraints_calc_max_stress_fitness(max_daily_stress, fitness);
 
-    fprintf(stream, "\t%lf", max_stress_fitness);
+    values[0] = max_stress_fitness;
 }
@@ -40,14 +40,26 @@ penalty_t bt_constraints_penalty_step(
     return new_penalty;
 }
 
-void bt_constraints_print_header(FILE *stream)
+bt_constraints_gradient_t bt_constraints_penalty_gradient(
+    const performance_t performance, const performance_t fitness,
+    const performance_t fatigue, const stress_t training_stress,
+    const stress_t max_daily_stress)
 {
-    fprintf(stream, "\tmax_stress");
+    bt_constraints_gradient_t gradient = {0, 0, 0, 0};
+
+    if (training_stress > MAX_STRESS)
+        gradient.training_stress += 1;
+
+    return gradient;
 }
 
-void bt_constraints_print_value(
-    FILE *stream, const performance_t performance, const performance_t fitness,
+const size_t bt_constraints_num_columns = 1;
+
+const char *const bt_constraints_column_names[] = {"max_stress"};
+
+void bt_constraints_values(
+    double values[], const performance_t performance, const performance_t fitness,
     const performance_t fatigue, const stress_t max_daily_stress)
 {
-    fprintf(stream, "\t%lf", MAX_STRESS);
+    values[0] = MAX_STRESS;
 }
@@ -16,10 +16,16 @@
  */
 
 #include "args.h"
+#include "bt_checkpoint.h"
+#include "bt_convergence.h"
+#include "bt_de.h"
 #include "bt_model.h"
 #include "bt_params.h"
+#include "bt_polish.h"
 #include "bt_population.h"
+#include "bt_profile.h"
 #include "bt_ga.h"
+#include "bt_threads.h"
 #include "stats.h"
 #include <stdbool.h>
 #include <stdio.h>
@@ -31,22 +37,197 @@
 #define MAX_ROUGHNESS_DAYS 14
 
 
+/*
+ * State of a run that changes from one generation to the next, other than the
+ * population itself.
+ */
+typedef struct ga_schedule_t {
+    double penalty_factor;
+    double roughness_factor;
+    size_t roughness_days;
+    double blx_alpha;
+    double mutate_stdev;
+    double mutate_probability;
+} ga_schedule_t;
+
+
+/*
+ * Writes the stresses of a population to a checkpoint as doubles, one design
+ * at a time, so that the checkpoint doesn't depend on the type of stress_t.
+ */
+static void put_stresses(bt_checkpoint_t *checkpoint, const bt_population_t *designs)
+{
+    double *row = malloc(designs->num_days * sizeof(double));
+    for (size_t i = 0; i < designs->nmemb; i++) {
+        for (size_t day = 0; day < designs->num_days; day++)
+            row[day] = designs->stresses[i][day];
+        bt_checkpoint_put_doubles(checkpoint, designs->num_days, row);
+    }
+    free(row);
+}
+
+
+/*
+ * Reads the stresses written by put_stresses().
+ */
+static void get_stresses(bt_checkpoint_t *checkpoint, bt_population_t *designs)
+{
+    double *row = malloc(designs->num_days * sizeof(double));
+    for (size_t i = 0; i < designs->nmemb; i++) {
+        bt_checkpoint_get_doubles(checkpoint, designs->num_days, row);
+        for (size_t day = 0; day < designs->num_days; day++)
+            designs->stresses[i][day] = row[day];
+    }
+    free(row);
+}
+
+
+/*
+ * Saves the state of a run after the given number of generations. A failure
+ * is reported but doesn't stop the run.
+ */
+static void save_checkpoint(const char *path, const unsigned long random_seed,
+                            const size_t max_generations, const size_t num_islands,
+                            const size_t generation, const size_t num_integrated_days,
+                            const ga_schedule_t *schedule, const bt_population_t *designs,
+                            const bt_convergence_t *conv_log)
+{
+    bt_checkpoint_t *checkpoint = bt_checkpoint_create(path);
+    if (checkpoint == NULL) {
+        fprintf(stderr, "Unable to create checkpoint file: %s.\n", path);
+        return;
+    }
+    bt_checkpoint_put_size(checkpoint, random_seed);
+    bt_checkpoint_put_size(checkpoint, designs->nmemb);
+    bt_checkpoint_put_size(checkpoint, designs->num_days);
+    bt_checkpoint_put_size(checkpoint, max_generations);
+    bt_checkpoint_put_size(checkpoint, num_islands);
+    bt_checkpoint_put_size(checkpoint, generation);
+    bt_checkpoint_put_size(checkpoint, num_integrated_days);
+    const double factors[] = {
+        schedule->penalty_factor, schedule->roughness_factor, schedule->blx_alpha,
+        schedule->mutate_stdev, schedule->mutate_probability
+    };
+    bt_checkpoint_put_doubles(checkpoint, 5, factors);
+    bt_checkpoint_put_size(checkpoint, schedule->roughness_days);
+
+    // Population, including the cached states so that the children of the
+    // restored designs integrate the same days as they would have.
+    const size_t nmemb = designs->nmemb;
+    put_stresses(checkpoint, designs);
+    bt_checkpoint_put_doubles(checkpoint, nmemb, designs->final_performances);
+    bt_checkpoint_put_doubles(checkpoint, nmemb, designs->penalties);
+    bt_checkpoint_put_doubles(checkpoint, nmemb, designs->roughnesses);
+    bt_checkpoint_put_doubles(checkpoint, nmemb, designs->fitnesses);
+    for (size_t i = 0; i < nmemb; i++) {
+        bt_checkpoint_put_size(checkpoint, designs->num_valid_states[i]);
+        for (size_t day = 0; day < designs->num_valid_states[i]; day++) {
+            const bt_population_state_t *state = &designs->states[i][day];
+            const double values[] = {state->fitness, state->fatigue, state->penalty};
+            bt_checkpoint_put_doubles(checkpoint, 3, values);
+        }
+    }
+
+    const size_t num_rows = conv_log ? conv_log->num_rows : 0;
+    bt_checkpoint_put_size(checkpoint, num_rows);
+    bt_checkpoint_put_doubles(checkpoint, num_rows * BT_CONVERGENCE_NUM_COLUMNS,
+                              conv_log ? conv_log->rows : NULL);
+    if (bt_checkpoint_commit(checkpoint) != 0)
+        fprintf(stderr, "Unable to write checkpoint file: %s.\n", path);
+}
+
+
+/*
+ * Restores the state of a run from a checkpoint, appending its convergence
+ * rows to conv_log (if it isn't NULL). Returns the number of generations
+ * that were run, or 0 if there's no checkpoint; exits if the checkpoint
+ * doesn't match the run.
+ */
+static size_t load_checkpoint(const char *path, const unsigned long random_seed,
+                              const size_t max_generations, const size_t num_islands,
+                              size_t *num_integrated_days, ga_schedule_t *schedule,
+                              bt_population_t *designs, bt_convergence_t *conv_log)
+{
+    bt_checkpoint_t *checkpoint = bt_checkpoint_open(path);
+    if (checkpoint == NULL)
+        return 0;
+    const size_t nmemb = designs->nmemb;
+    const size_t num_days = designs->num_days;
+    const bool matches = bt_checkpoint_get_size(checkpoint) == random_seed
+        && bt_checkpoint_get_size(checkpoint) == nmemb
+        && bt_checkpoint_get_size(checkpoint) == num_days
+        && bt_checkpoint_get_size(checkpoint) == max_generations
+        && bt_checkpoint_get_size(checkpoint) == num_islands;
+    const size_t generation = bt_checkpoint_get_size(checkpoint);
+    if (!matches || generation > max_generations) {
+        fprintf(stderr, "Checkpoint file %s doesn't match the arguments.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    *num_integrated_days = bt_checkpoint_get_size(checkpoint);
+    double factors[5];
+    bt_checkpoint_get_doubles(checkpoint, 5, factors);
+    schedule->penalty_factor = factors[0];
+    schedule->roughness_factor = factors[1];
+    schedule->blx_alpha = factors[2];
+    schedule->mutate_stdev = factors[3];
+    schedule->mutate_probability = factors[4];
+    schedule->roughness_days = bt_checkpoint_get_size(checkpoint);
+
+    get_stresses(checkpoint, designs);
+    bt_checkpoint_get_doubles(checkpoint, nmemb, designs->final_performances);
+    bt_checkpoint_get_doubles(checkpoint, nmemb, designs->penalties);
+    bt_checkpoint_get_doubles(checkpoint, nmemb, designs->roughnesses);
+    bt_checkpoint_get_doubles(checkpoint, nmemb, designs->fitnesses);
+    for (size_t i = 0; i < nmemb && !checkpoint->failed; i++) {
+        designs->num_valid_states[i] = bt_checkpoint_get_size(checkpoint);
+        if (designs->num_valid_states[i] > num_days + 1) {
+            designs->num_valid_states[i] = 0;
+            checkpoint->failed = true;
+        }
+        for (size_t day = 0; day < designs->num_valid_states[i]; day++) {
+            double values[3];
+            bt_checkpoint_get_doubles(checkpoint, 3, values);
+            designs->states[i][day] = (bt_population_state_t){values[0], values[1], values[2]};
+        }
+    }
+
+    const size_t num_rows = bt_checkpoint_get_size(checkpoint);
+    double *rows = NULL;
+    if (num_rows <= generation) {
+        rows = malloc((num_rows > 0 ? num_rows : 1) * BT_CONVERGENCE_NUM_COLUMNS * sizeof(double));
+        bt_checkpoint_get_doubles(checkpoint, num_rows * BT_CONVERGENCE_NUM_COLUMNS, rows);
+    }
+    if (bt_checkpoint_close(checkpoint) != 0 || rows == NULL) {
+        fprintf(stderr, "Unable to parse checkpoint file: %s.\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if (conv_log)
+        bt_convergence_restore(conv_log, num_rows, rows);
+    free(rows);
+    return generation;
+}
+
+
 void run_ga(const size_t num_days,
             const size_t max_generations, const size_t population_size,
             const stress_t max_daily_stress, const double init_penalty_factor,
             const double penalty_factor_rate, const double max_roughness_factor,
             const size_t cull_keep, const double init_blx_alpha, const double blx_alpha_change_rate,
             const double init_mutate_stdev, const double init_mutate_probability,
-            const double mutate_change_rate,
-            const bt_params_t *parameters, const unsigned long random_seed,
+            const double mutate_change_rate, const bool segment_crossover,
+            const size_t mutate_window, const ga_islands_t *islands,
+            const de_options_t *de_options, const bt_polish_options_t *polish, const bt_params_t *parameters, const unsigned long random_seed,
             const char *output_integration, const char *output_population,
-            const char *output_convergence, const bool debug,
-            stress_t best_stresses[],
+            const char *output_convergence, const enum bt_table_format output_format,
+            const char *checkpoint, const size_t checkpoint_interval, const bool resume,
+            const bool profile_summary, const bool perf_counters, const char *output_trace,
+            const bool debug, stress_t best_stresses[],
             performance_t *best_final_performance, penalty_t *best_penalty, fitness_t *best_fitness)
 {
+    const size_t num_islands = islands->num_islands;
+
     // Allocate objects
     bt_population_t *designs = bt_population_alloc(population_size, num_days);
-    rk_state *rng = malloc(sizeof(rk_state));
 
     // Temporary variables for the GA
     double penalty_factor = init_penalty_factor;
@@ -55,29 +236,100 @@ void run_ga(const size_t num_days,
     double blx_alpha = init_blx_alpha;
     double mutate_stdev = init_mutate_stdev;
     double mutate_probability = init_mutate_probability;
-    size_t *winners = malloc(population_size * sizeof(size_t));
     bt_population_t *children = bt_population_alloc(population_size, num_days);
 
-    // Initialize objects
-    rk_seed(random_seed, rng);
-    ga_init_stresses(population_size, num_days, max_daily_stress, designs->stresses, rng);
-    bt_model_update_obj_func(parameters, roughness_days, penalty_factor, roughness_factor,
-                             max_daily_stress, designs);
+    // Split the population into islands of (nearly) equal size, each with its
+    // own share of the kept parents. With one island, this is the whole
+    // population.
+    bt_population_t island_designs[num_islands];
+    bt_population_t island_children[num_islands];
+    size_t island_cull_keeps[num_islands];
+    for (size_t k = 0; k < num_islands; k++) {
+        const size_t offset = k * population_size / num_islands;
+        const size_t size = (k + 1) * population_size / num_islands - offset;
+        island_designs[k] = bt_population_slice(designs, offset, size);
+        island_children[k] = bt_population_slice(children, offset, size);
+        island_cull_keeps[k] = cull_keep * size / population_size;
+    }
+
+    // With differential evolution, each island adapts its own parameters.
+    de_t *island_des[num_islands];
+    for (size_t k = 0; k < num_islands; k++)
+        island_des[k] = de_options ? de_alloc(de_options, island_designs[k].nmemb, num_days) : NULL;
+
+    // Initialize objects. The random streams are keyed by the seed, then the
+    // generation (0 for the initial population), then the island, so the
+    // results don't depend on the number of threads.
+    const uint64_t seed_key = rng_stream_key(0, random_seed);
+    const uint64_t init_key = rng_stream_key(seed_key, 0);
+
+    // Start profiling, if requested. The profile is NULL otherwise, so the
+    // timing calls do nothing.
+    bt_profile_t *profile = NULL;
+    if (profile_summary || perf_counters || output_trace) {
+        char trace_path[MAX_PATH_LENGTH];
+        if (output_trace)
+            snprintf(trace_path, MAX_PATH_LENGTH, output_trace, random_seed);
+        profile = bt_profile_create(random_seed, output_trace ? trace_path : NULL, perf_counters);
+        if (profile == NULL) {
+            fprintf(stderr, "Unable to open trace file: %s.\n", trace_path);
+            exit(EXIT_FAILURE);
+        }
+        if (perf_counters && !profile->perf_counters)
+            fprintf(stderr, "Unable to open performance counters for seed %lu.\n", random_seed);
+    }
 
     // Open convergence file
-    FILE *conv_file = NULL;
+    bt_profile_mark_t start = bt_profile_now(profile);
+    bt_convergence_t *conv_log = NULL;
     if (output_convergence) {
         char conv_path[MAX_PATH_LENGTH];
         snprintf(conv_path, MAX_PATH_LENGTH, output_convergence, random_seed);
-        if ((conv_file = fopen(conv_path, "w")) == NULL) {
+        if ((conv_log = bt_convergence_open(conv_path, output_format)) == NULL) {
             fprintf(stderr, "Unable to open convergence file: %s.\n", conv_path);
             exit(EXIT_FAILURE);
         }
-        fprintf(conv_file, "generation\tmin\tq1\tmedian\tq3\tmax\n");
     }
 
+    // Restore the state from the checkpoint, if there is one. The random
+    // streams only depend on the generation, so the run continues exactly as
+    // if it hadn't been interrupted.
+    char checkpoint_path[MAX_PATH_LENGTH];
+    if (checkpoint)
+        snprintf(checkpoint_path, MAX_PATH_LENGTH, checkpoint, random_seed);
+    size_t num_integrated_days = 0;
+    size_t first_generation = 0;
+    if (checkpoint && resume) {
+        ga_schedule_t schedule;
+        first_generation = load_checkpoint(checkpoint_path, random_seed, max_generations,
+                                           num_islands, &num_integrated_days, &schedule,
+                                           designs, conv_log);
+        if (first_generation > 0) {
+            penalty_factor = schedule.penalty_factor;
+            roughness_factor = schedule.roughness_factor;
+            roughness_days = schedule.roughness_days;
+            blx_alpha = schedule.blx_alpha;
+            mutate_stdev = schedule.mutate_stdev;
+            mutate_probability = schedule.mutate_probability;
+        }
+    }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+    if (first_generation == 0) {
+        for (size_t k = 0; k < num_islands; k++) {
+            ga_init_stresses(island_designs[k].nmemb, num_days, max_daily_stress,
+                             island_designs[k].stresses,
+                             rng_stream_key(rng_stream_key(init_key, k), GA_STREAM_INIT));
+        }
+        start = bt_profile_now(profile);
+        num_integrated_days = bt_model_update_obj_func(parameters, roughness_days, penalty_factor,
+                                                       roughness_factor, max_daily_stress, designs);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
+    }
+    const size_t first_integrated_days = num_integrated_days;
+
     // Run the GA.
-    for (ssize_t i = 0; i < max_generations; i++) {
+    for (ssize_t i = first_generation; i < max_generations; i++) {
+        const bt_profile_mark_t generation_start = bt_profile_now(profile);
 
         // Update roughness_factor and roughness_days.
         ssize_t min_roughness_generation = max_generations / 5.;
@@ -92,9 +344,12 @@ void run_ga(const size_t num_days,
         }
 
         // Update calculated fitnesses with the new penalty and roughness values.
+        start = bt_profile_now(profile);
         bt_model_update_penalty_factors(penalty_factor, roughness_factor, roughness_days, designs);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
 
         // Debug output.
+        start = bt_profile_now(profile);
         if (debug) {
             fprintf(stderr, "Seed %lu, Generation %zd:\t", random_seed, i+1);
             fprintf_fitness_summary(stderr, population_size, designs->fitnesses);
@@ -103,32 +358,77 @@ void run_ga(const size_t num_days,
 
         // Convergence file output.
         if (output_convergence) {
-            fprintf(conv_file, "%zd\t", i+1);
-            fprintf_fitness_quartiles(conv_file, population_size, designs->fitnesses);
-            fprintf(conv_file, "\n");
-        }
-
-        // Run steps of the GA.
-        ga_tournament_select(population_size, designs->fitnesses,
-                             population_size, winners, rng);
-        ga_blx_alpha(population_size, num_days, designs->stresses, winners,
-                     children->stresses, blx_alpha, 0., max_daily_stress, rng);
-        ga_mutate(population_size, num_days, children->stresses,
-                  mutate_stdev, 0., max_daily_stress, mutate_probability, rng);
-        bt_model_update_obj_func(parameters, roughness_days, penalty_factor, roughness_factor,
-                                 max_daily_stress, children);
-        ga_cull(designs, children, cull_keep);
+            bt_convergence_write(conv_log, i+1, population_size, designs->fitnesses);
+        }
+        bt_profile_record(profile, BT_PROFILE_STATS, start);
+
+        // Run a generation of the GA (or of differential evolution). The
+        // islands evolve independently between migrations, so they can run
+        // concurrently.
+        const ga_variation_t variation = {
+            segment_crossover, blx_alpha, mutate_window, mutate_stdev, mutate_probability,
+            0., max_daily_stress
+        };
+        const uint64_t generation_key = rng_stream_key(seed_key, i+1);
+        #pragma omp parallel for schedule(dynamic, 1) if(num_islands > 1) reduction(+:num_integrated_days)
+        for (size_t k = 0; k < num_islands; k++) {
+            if (island_des[k]) {
+                num_integrated_days += de_generation(
+                    island_des[k], &island_designs[k], &island_children[k], parameters,
+                    roughness_days, penalty_factor, roughness_factor, max_daily_stress,
+                    rng_stream_key(generation_key, k), profile);
+            } else {
+                num_integrated_days += ga_generation(
+                    &island_designs[k], &island_children[k], island_cull_keeps[k], &variation,
+                    parameters, roughness_days, penalty_factor, roughness_factor,
+                    max_daily_stress, rng_stream_key(generation_key, k), profile);
+            }
+        }
+        if (islands->migration_interval > 0 && (i+1) % islands->migration_interval == 0) {
+            start = bt_profile_now(profile);
+            ga_migrate(islands, island_designs);
+            bt_profile_record(profile, BT_PROFILE_MIGRATE, start);
+        }
 
         // Update penalty factor and GA parameters.
         penalty_factor *= penalty_factor_rate;
         blx_alpha *= blx_alpha_change_rate;
         mutate_stdev *= mutate_change_rate;
         mutate_probability *= mutate_change_rate;
+
+        if (checkpoint && ((checkpoint_interval > 0 && (i+1) % checkpoint_interval == 0)
+                           || i+1 == max_generations)) {
+            const ga_schedule_t schedule = {
+                penalty_factor, roughness_factor, roughness_days,
+                blx_alpha, mutate_stdev, mutate_probability
+            };
+            start = bt_profile_now(profile);
+            save_checkpoint(checkpoint_path, random_seed, max_generations, num_islands,
+                            i+1, num_integrated_days, &schedule, designs, conv_log);
+            bt_profile_record(profile, BT_PROFILE_IO, start);
+        }
+        bt_profile_record_generation(profile, i+1, generation_start);
+    }
+
+    // Polish the best designs with the final penalty factor.
+    if (polish->num_designs > 0) {
+        start = bt_profile_now(profile);
+        bt_model_update_penalty_factors(penalty_factor, roughness_factor, roughness_days, designs);
+        num_integrated_days += bt_polish_best_designs(parameters, roughness_days, penalty_factor,
+                                                      roughness_factor, max_daily_stress, polish,
+                                                      designs);
+        bt_profile_record(profile, BT_PROFILE_EVALUATE, start);
     }
 
     // Close convergence file
+    start = bt_profile_now(profile);
     if (output_convergence) {
-        fclose(conv_file);
+        bt_convergence_close(conv_log);
+    }
+
+    if (debug) {
+        fprintf(stderr, "Seed %lu: integrated %zd of %zd days\n", random_seed,
+                num_integrated_days, (max_generations + 1) * population_size * num_days);
     }
 
     // Copy the best design to the output variables
@@ -143,7 +443,7 @@ void run_ga(const size_t num_days,
         char pop_path[MAX_PATH_LENGTH];
         snprintf(pop_path, MAX_PATH_LENGTH, output_population, random_seed);
         FILE *pop_file = fopen(pop_path, "w");
-        bt_population_write(pop_file, designs);
+        bt_population_write(pop_file, output_format, designs);
         fclose(pop_file);
     }
 
@@ -152,15 +452,22 @@ void run_ga(const size_t num_days,
         char integ_path[MAX_PATH_LENGTH];
         snprintf(integ_path, MAX_PATH_LENGTH, output_integration, random_seed);
         FILE *integ_file = fopen(integ_path, "w");
-        bt_model_fprint_integrate(integ_file, num_days, best_stresses, max_daily_stress, parameters);
+        bt_model_fprint_integrate(integ_file, output_format, num_days, best_stresses, max_daily_stress, parameters);
         fclose(integ_file);
     }
+    bt_profile_record(profile, BT_PROFILE_IO, start);
+
+    // Finish the profile.
+    if (profile_summary || perf_counters)
+        bt_profile_fprint_summary(stderr, profile, num_integrated_days - first_integrated_days);
+    if (bt_profile_close(profile) != 0)
+        fprintf(stderr, "Unable to write trace file for seed %lu.\n", random_seed);
 
     // Free objects
+    for (size_t k = 0; k < num_islands; k++)
+        de_free(island_des[k]);
     bt_population_free(children);
     bt_population_free(designs);
-    free(winners);
-    free(rng);
 }
 
 
@@ -175,19 +482,57 @@ int main(int argc, char *argv[])
         fprintf(stderr, "\n");
     }
 
+    if (args.islands.num_islands == 0 ||
+        args.population_size < 2 * args.islands.num_islands) {
+        fprintf(stderr, "Each island needs at least two designs.\n");
+        exit(EXIT_FAILURE);
+    }
+    if (args.differential_evolution) {
+        if (args.population_size < 4 * args.islands.num_islands) {
+            fprintf(stderr, "Differential evolution needs at least four designs per island.\n");
+            exit(EXIT_FAILURE);
+        }
+        if (!(args.de.pbest_fraction > 0 && args.de.pbest_fraction <= 1)) {
+            fprintf(stderr, "The pbest fraction must be in (0, 1].\n");
+            exit(EXIT_FAILURE);
+        }
+        if (args.checkpoint) {
+            fprintf(stderr, "Checkpoints aren't supported with differential evolution.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (args.checkpoint && args.num_iterations > 1 && strchr(args.checkpoint, '%') == NULL) {
+        fprintf(stderr, "The checkpoint PATTERN needs a %%zd for the iteration number.\n");
+        exit(EXIT_FAILURE);
+    }
+
     // Load the input files.
     bt_params_t *parameters;
     if ((parameters = bt_params_load(args.params_path)) == NULL) {
         fprintf(stderr, "Unable to parse paramaters file.\n");
         exit(EXIT_FAILURE);
     }
+    parameters->integrator = args.integrator;
+    if (args.polish.num_designs > 0 && args.integrator != BT_ODE_EULER) {
+        fprintf(stderr, "Polishing requires the euler integrator.\n");
+        exit(EXIT_FAILURE);
+    }
 
     // Create the output population.
     bt_population_t *best_designs = bt_population_alloc(
         args.num_iterations, args.num_days);
 
-    // Run the GA.
+    // Run the GA. The iterations are independent, so they can run concurrently.
+    bt_threads_split_t split = bt_threads_split(args.num_iterations, args.population_size,
+                                                args.num_days, args.seed_threads);
+    bt_threads_enable_nesting(&split);
+    if (args.debug) {
+        fprintf(stderr, "Using %d concurrent iterations with %d evaluation threads each\n\n",
+                split.seed_threads, split.eval_threads);
+    }
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(split.seed_threads)
     for (size_t i = 0; i < args.num_iterations; i++) {
+        bt_threads_limit_eval(&split);
         fprintf(stderr, "Iteration %zd\n", i+1);
         fflush(stderr);
         run_ga(args.num_days,
@@ -203,11 +548,23 @@ int main(int argc, char *argv[])
                args.init_mutate_stdev,
                args.init_mutate_probability,
                args.mutate_change_rate,
+               args.segment_crossover,
+               args.mutate_window,
+               &args.islands,
+               args.differential_evolution ? &args.de : NULL,
+               &args.polish,
                parameters,
                i + 1,
                args.output_integration,
                args.output_population,
                args.output_convergence,
+               args.output_format,
+               args.checkpoint,
+               args.checkpoint_interval,
+               args.resume,
+               args.profile,
+               args.perf_counters,
+               args.output_trace,
                args.debug,
                best_designs->stresses[i],
                &best_designs->final_performances[i],
@@ -217,7 +574,7 @@ int main(int argc, char *argv[])
 
     // Write the output file.
     FILE *output_file = fopen(args.output_path, "w");
-    bt_population_write(output_file, best_designs);
+    bt_population_write(output_file, BT_TABLE_TSV, best_designs);
     fclose(output_file);
 
     // Cleanup the input data.
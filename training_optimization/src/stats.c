@@ -37,6 +37,15 @@ void stats_sort(double data[], const size_t n)
     qsort(data, n, sizeof(double), compare_doubles);
 }
 
+/*
+ * Total order used for sorting indices and selection, where NAN is less than
+ * any other value.
+ */
+static inline int less_than(const double x, const double y)
+{
+    return x < y || (isnan(x) && !isnan(y));
+}
+
 static int compare_indices_by_data(
 #ifdef MAC_OSX
     void *data, const void *first, const void *second
@@ -53,20 +62,20 @@ static int compare_indices_by_data(
     // Perform comparison.
     const double x1 = xs[i1];
     const double x2 = xs[i2];
-    if (x1 < x2) {
+    if (less_than(x1, x2)) {
         return -1;
-    } else if (x1 > x2) {
+    } else if (less_than(x2, x1)) {
         return 1;
     } else {
         return 0;
     }
 }
 
-void stats_sort_index(size_t indices[], const double data[], const size_t n)
+/*
+ * Sorts the n indices (in any initial order) by the values they refer to.
+ */
+static void sort_indices_by_data(size_t indices[], const double data[], const size_t n)
 {
-    for (size_t i = 0; i < n; i++) {
-        indices[i] = i;
-    }
     // Strip const qualifier because `qsort_r` doesn't take the pointer as
     // const. This is safe because `qsort_r` doesn't modify the data in this
     // case (since `compare_indices_by_data` doesn't modify the data).
@@ -80,6 +89,124 @@ void stats_sort_index(size_t indices[], const double data[], const size_t n)
     );
 }
 
+void stats_sort_index(size_t indices[], const double data[], const size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    sort_indices_by_data(indices, data, n);
+}
+
+static inline void swap_indices(size_t indices[], const size_t a, const size_t b)
+{
+    const size_t tmp = indices[a];
+    indices[a] = indices[b];
+    indices[b] = tmp;
+}
+
+static inline double median_of_three(const double a, const double b, const double c)
+{
+    if (less_than(a, b)) {
+        return less_than(b, c) ? b : (less_than(a, c) ? c : a);
+    } else {
+        return less_than(a, c) ? a : (less_than(b, c) ? c : b);
+    }
+}
+
+/*
+ * Partitions indices[lo..hi) around its k th smallest value (counting from
+ * 0), as stats_select_index() does for the whole array.
+ */
+static void select_indices_range(size_t indices[], const double data[],
+                                 size_t lo, size_t hi, const size_t k)
+{
+    // Introselect: quickselect with median-of-three pivots, falling back to
+    // sorting the remaining range if the partitions are repeatedly bad.
+    size_t depth_limit = 2;
+    for (size_t m = hi - lo; m > 1; m /= 2) {
+        depth_limit += 2;
+    }
+    while (k < hi && hi - lo > 1) {
+        if (depth_limit-- == 0) {
+            sort_indices_by_data(indices + lo, data, hi - lo);
+            return;
+        }
+        const double pivot = median_of_three(data[indices[lo]],
+                                             data[indices[lo + (hi - lo) / 2]],
+                                             data[indices[hi - 1]]);
+
+        // Three-way partition, so that [lo, lt) is less than the pivot,
+        // [lt, gt) is equal, and [gt, hi) is greater.
+        // The pivot itself is in the middle range, so each pass makes
+        // progress.
+        size_t lt = lo;
+        size_t gt = hi;
+        size_t i = lo;
+        while (i < gt) {
+            const double x = data[indices[i]];
+            if (less_than(x, pivot)) {
+                swap_indices(indices, lt++, i++);
+            } else if (less_than(pivot, x)) {
+                swap_indices(indices, i, --gt);
+            } else {
+                i++;
+            }
+        }
+        if (k < lt) {
+            hi = lt;
+        } else if (k >= gt) {
+            lo = gt;
+        } else {
+            return;
+        }
+    }
+}
+
+void stats_select_index(size_t indices[], const double data[], const size_t n,
+                        const size_t k)
+{
+    for (size_t i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    select_indices_range(indices, data, 0, n, k);
+}
+
+void stats_quantiles(double results[], const double qs[], const size_t num_quantiles,
+                     const double data[], const size_t n)
+{
+    if (n == 0) {
+        for (size_t j = 0; j < num_quantiles; j++) {
+            results[j] = NAN;
+        }
+        return;
+    }
+
+    // Select the order statistics on either side of each quantile, from the
+    // smallest up. Everything after a selected position is at least as large
+    // as it, so each selection only needs to look at the rest of the array.
+    size_t *indices = malloc(n * sizeof(size_t));
+    for (size_t i = 0; i < n; i++) {
+        indices[i] = i;
+    }
+    size_t selected = 0;  // indices[0..selected) are in sorted order
+    for (size_t j = 0; j < num_quantiles; j++) {
+        const double prod = qs[j] * (n - 1);
+        const size_t lower = prod;
+        const size_t upper = lower == n - 1 ? lower : lower + 1;
+        for (size_t rank = lower; rank <= upper; rank++) {
+            if (rank >= selected) {
+                select_indices_range(indices, data, selected, n, rank);
+                selected = rank + 1;
+            }
+        }
+        const double delta = prod - lower;
+        const double low_value = data[indices[lower]];
+        results[j] = upper == lower ? low_value :
+            fma(data[indices[upper]] - low_value, delta, low_value);
+    }
+    free(indices);
+}
+
 double stats_median_from_sorted(const double data[], const size_t n)
 {
     if (n == 0) {
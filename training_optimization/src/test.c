@@ -0,0 +1,320 @@
+/*
+ * Copyright 2015-2019 Duke University
+ *
+ * This program is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License Version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program. If not, see
+ * <https://www.gnu.org/licenses/old-licenses/gpl-2.0.txt>.
+ */
+
+#include "bt_de.h"
+#include "bt_ga.h"
+#include "bt_model.h"
+#include "bt_ode.h"
+#include "bt_params.h"
+#include "bt_polish.h"
+#include "bt_population.h"
+#include "rng_stream.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The parameters in params.tsv.
+ */
+static const bt_params_t test_params = {
+    .tau1 = 61, .tau2 = 5.5, .alpha = 1.16, .beta = 0.85, .k1 = 0.10, .k2 = 0.12,
+    .p0 = 155, .f0 = 70.9, .u0 = 24.5, .integrator = BT_ODE_EULER};
+
+bool approx_eq(const double a, const double b, const double eps)
+{
+    return fabs(a - b) < eps;
+}
+
+void test_bt_model_calculate_obj_func_gradient()
+{
+    const size_t num_days = 40;
+    const size_t roughness_days = 3;
+    const fitness_t penalty_factor = 0.5;
+    const fitness_t roughness_factor = 0.2;
+    const stress_t max_daily_stress = 400;
+
+    bt_population_t *population = bt_population_alloc(1, num_days);
+    ga_init_stresses(1, num_days, max_daily_stress, population->stresses, 11);
+    stress_t *stresses = population->stresses[0];
+
+    fitness_t gradient[num_days];
+    fitness_t scratch[num_days];
+    const fitness_t objective = bt_model_calculate_obj_func_gradient(
+        &test_params, roughness_days, penalty_factor, roughness_factor,
+        max_daily_stress, num_days, stresses, gradient);
+
+    // The objective function value must be the one the GA uses, and the
+    // plan must violate the constraints so that the penalty gradient is
+    // checked too.
+    bt_model_update_member_obj_func(
+        &test_params, roughness_days, penalty_factor, roughness_factor,
+        max_daily_stress, population, 0);
+    assert(approx_eq(objective, population->fitnesses[0], 1e-9 * fabs(objective)));
+    assert(population->penalties[0] > 0);
+    assert(population->roughnesses[0] > 0);
+
+    // Central differences. The step is measured between the stresses that
+    // were actually evaluated, in case stress_t is float, which also leaves
+    // the model less accurate.
+    const double tolerance = sizeof(stress_t) < sizeof(double) ? 1e-2 : 1e-8;
+    for (size_t day = 0; day < num_days; day++) {
+        const stress_t stress = stresses[day];
+        stresses[day] = stress + (stress_t)0.05;
+        const stress_t above = stresses[day];
+        const fitness_t objective_above = bt_model_calculate_obj_func_gradient(
+            &test_params, roughness_days, penalty_factor, roughness_factor,
+            max_daily_stress, num_days, stresses, scratch);
+        stresses[day] = stress - (stress_t)0.05;
+        const stress_t below = stresses[day];
+        const fitness_t objective_below = bt_model_calculate_obj_func_gradient(
+            &test_params, roughness_days, penalty_factor, roughness_factor,
+            max_daily_stress, num_days, stresses, scratch);
+        stresses[day] = stress;
+
+        const double difference = (objective_above - objective_below) / (above - below);
+        assert(approx_eq(gradient[day], difference, tolerance * fmax(1, fabs(difference))));
+    }
+
+    bt_population_free(population);
+}
+
+void test_bt_polish_stresses()
+{
+    const size_t num_days = 40;
+    const size_t roughness_days = 3;
+    const fitness_t penalty_factor = 0.5;
+    const fitness_t roughness_factor = 0.2;
+    const stress_t max_daily_stress = 400;
+
+    bt_population_t *population = bt_population_alloc(2, num_days);
+    ga_init_stresses(1, num_days, max_daily_stress, population->stresses, 11);
+    memcpy(population->stresses[1], population->stresses[0], num_days * sizeof(stress_t));
+
+    bt_polish_stresses(&test_params, roughness_days, penalty_factor, roughness_factor,
+                       max_daily_stress, num_days, population->stresses[1], 20);
+    bt_model_update_obj_func(&test_params, roughness_days, penalty_factor, roughness_factor,
+                             max_daily_stress, population);
+
+    assert(population->fitnesses[1] >= population->fitnesses[0]);
+    for (size_t day = 0; day < num_days; day++) {
+        assert(population->stresses[1][day] >= 0);
+        assert(population->stresses[1][day] <= max_daily_stress);
+    }
+
+    bt_population_free(population);
+}
+
+/*
+ * Asserts that two populations have bitwise identical designs, objective
+ * function values, and valid cached states.
+ */
+void assert_populations_identical(const bt_population_t *a, const bt_population_t *b)
+{
+    assert(a->nmemb == b->nmemb);
+    assert(a->num_days == b->num_days);
+    const size_t nmemb = a->nmemb;
+    assert(memcmp(a->final_performances, b->final_performances,
+                  nmemb * sizeof(performance_t)) == 0);
+    assert(memcmp(a->penalties, b->penalties, nmemb * sizeof(penalty_t)) == 0);
+    assert(memcmp(a->roughnesses, b->roughnesses, nmemb * sizeof(penalty_t)) == 0);
+    assert(memcmp(a->fitnesses, b->fitnesses, nmemb * sizeof(fitness_t)) == 0);
+    assert(memcmp(a->num_valid_states, b->num_valid_states, nmemb * sizeof(size_t)) == 0);
+    for (size_t i = 0; i < nmemb; i++) {
+        assert(memcmp(a->stresses[i], b->stresses[i], a->num_days * sizeof(stress_t)) == 0);
+        assert(memcmp(a->states[i], b->states[i],
+                      a->num_valid_states[i] * sizeof(bt_population_state_t)) == 0);
+    }
+}
+
+void test_ga_generation()
+{
+    // An odd number of designs, so that the last child is made alone.
+    const size_t nmemb = 11;
+    const size_t num_days = 30;
+    const size_t num_keep = 3;
+    const size_t roughness_days = 3;
+    const fitness_t penalty_factor = 0.5;
+    const fitness_t roughness_factor = 0.2;
+    const stress_t max_daily_stress = 400;
+
+    for (size_t v = 0; v < 4; v++) {
+        const ga_variation_t variation = {
+            .segment_crossover = v & 1, .blx_alpha = 0.5, .mutate_window = v & 2 ? 4 : 0,
+            .mutate_stdev = 40, .mutate_probability = 0.2, .min = 0, .max = max_daily_stress};
+
+        bt_population_t *fused_parents = bt_population_alloc(nmemb, num_days);
+        bt_population_t *fused_children = bt_population_alloc(nmemb, num_days);
+        bt_population_t *parents = bt_population_alloc(nmemb, num_days);
+        bt_population_t *children = bt_population_alloc(nmemb, num_days);
+        ga_init_stresses(nmemb, num_days, max_daily_stress, fused_parents->stresses, 17);
+        ga_init_stresses(nmemb, num_days, max_daily_stress, parents->stresses, 17);
+        bt_model_update_obj_func(&test_params, roughness_days, penalty_factor, roughness_factor,
+                                 max_daily_stress, fused_parents);
+        bt_model_update_obj_func(&test_params, roughness_days, penalty_factor, roughness_factor,
+                                 max_daily_stress, parents);
+
+        for (uint64_t generation = 0; generation < 3; generation++) {
+            const uint64_t key = rng_stream_key(23, generation);
+            const size_t fused_num_days = ga_generation(
+                fused_parents, fused_children, num_keep, &variation, &test_params,
+                roughness_days, penalty_factor, roughness_factor, max_daily_stress, key, NULL);
+
+            // The same generation as separate passes over the population
+            size_t parent_indices[nmemb];
+            ga_tournament_select(nmemb, parents->fitnesses, nmemb, parent_indices,
+                                 rng_stream_key(key, GA_STREAM_SELECT));
+            if (variation.segment_crossover) {
+                ga_segment_crossover(nmemb, num_days, parents->stresses, parent_indices,
+                                     children->stresses, rng_stream_key(key, GA_STREAM_CROSSOVER));
+            } else {
+                ga_blx_alpha(nmemb, num_days, parents->stresses, parent_indices,
+                             children->stresses, variation.blx_alpha, variation.min,
+                             variation.max, rng_stream_key(key, GA_STREAM_CROSSOVER));
+            }
+            if (variation.mutate_window > 0) {
+                ga_mutate_window(nmemb, num_days, children->stresses, variation.mutate_stdev,
+                                 variation.min, variation.max, variation.mutate_probability,
+                                 variation.mutate_window, rng_stream_key(key, GA_STREAM_MUTATE));
+            } else {
+                ga_mutate(nmemb, num_days, children->stresses, variation.mutate_stdev,
+                          variation.min, variation.max, variation.mutate_probability,
+                          rng_stream_key(key, GA_STREAM_MUTATE));
+            }
+            bt_population_inherit_states(children, parents, parent_indices);
+            const size_t separate_num_days = bt_model_update_obj_func(
+                &test_params, roughness_days, penalty_factor, roughness_factor,
+                max_daily_stress, children);
+            ga_cull(parents, children, num_keep);
+
+            assert(fused_num_days == separate_num_days);
+            assert_populations_identical(fused_children, children);
+            assert_populations_identical(fused_parents, parents);
+        }
+
+        bt_population_free(fused_parents);
+        bt_population_free(fused_children);
+        bt_population_free(parents);
+        bt_population_free(children);
+    }
+}
+
+/*
+ * Asserts that every training stress of a design is within [0, max].
+ */
+void assert_stresses_within(const size_t num_days, const stress_t *stresses, const stress_t max)
+{
+    for (size_t day = 0; day < num_days; day++) {
+        assert(stresses[day] >= 0);
+        assert(stresses[day] <= max);
+    }
+}
+
+/*
+ * Runs differential evolution on a random population, checking after each
+ * generation that the trial designs, the parents, and the archive stay within
+ * the bounds and that no parent gets worse. The caller frees the population
+ * and the returned state.
+ */
+de_t *run_de(const de_options_t *options, bt_population_t *parents, const uint64_t key)
+{
+    const size_t nmemb = parents->nmemb;
+    const size_t num_days = parents->num_days;
+    const size_t roughness_days = 3;
+    const fitness_t penalty_factor = 0.5;
+    const fitness_t roughness_factor = 0.2;
+    const stress_t max_daily_stress = 400;
+
+    de_t *de = de_alloc(options, nmemb, num_days);
+    bt_population_t *children = bt_population_alloc(nmemb, num_days);
+    fitness_t previous_fitnesses[nmemb];
+    ga_init_stresses(nmemb, num_days, max_daily_stress, parents->stresses,
+                     rng_stream_key(key, GA_STREAM_INIT));
+    bt_model_update_obj_func(&test_params, roughness_days, penalty_factor, roughness_factor,
+                             max_daily_stress, parents);
+
+    for (uint64_t generation = 0; generation < 20; generation++) {
+        memcpy(previous_fitnesses, parents->fitnesses, nmemb * sizeof(fitness_t));
+        de_generation(de, parents, children, &test_params, roughness_days, penalty_factor,
+                      roughness_factor, max_daily_stress, rng_stream_key(key, generation + 1),
+                      NULL);
+
+        assert(de->archive_size <= nmemb);
+        for (size_t i = 0; i < nmemb; i++) {
+            assert_stresses_within(num_days, children->stresses[i], max_daily_stress);
+            assert_stresses_within(num_days, parents->stresses[i], max_daily_stress);
+            assert(parents->fitnesses[i] >= previous_fitnesses[i]);
+        }
+        for (size_t i = 0; i < de->archive_size; i++)
+            assert_stresses_within(num_days, de->archive[i], max_daily_stress);
+        for (size_t k = 0; k < DE_MEMORY_SIZE; k++) {
+            assert(de->memory_f[k] > 0 && de->memory_f[k] <= 1);
+            assert(de->memory_cr[k] >= 0 && de->memory_cr[k] <= 1);
+        }
+    }
+
+    bt_population_free(children);
+    return de;
+}
+
+void test_de_generation()
+{
+    // Large enough for the trial designs to be generated in parallel
+    const size_t nmemb = 200;
+    const size_t num_days = 100;
+
+    for (int strategy = 0; strategy < DE_STRATEGY_COUNT; strategy++) {
+        const de_options_t options = {.strategy = strategy, .pbest_fraction = 0.1};
+        bt_population_t *parents = bt_population_alloc(nmemb, num_days);
+        bt_population_t *rerun_parents = bt_population_alloc(nmemb, num_days);
+        de_t *de = run_de(&options, parents, 29);
+        de_t *rerun_de = run_de(&options, rerun_parents, 29);
+
+        // The parameters adapted, and only current-to-pbest/1 archives.
+        assert(de->memory_index != 0 || de->memory_f[0] != 0.5);
+        if (strategy == DE_STRATEGY_CURRENT_TO_PBEST_1)
+            assert(de->archive_size > 0);
+        else
+            assert(de->archive_size == 0);
+
+        // A seeded run is reproducible.
+        assert_populations_identical(parents, rerun_parents);
+        assert(memcmp(de->memory_f, rerun_de->memory_f, sizeof(de->memory_f)) == 0);
+        assert(memcmp(de->memory_cr, rerun_de->memory_cr, sizeof(de->memory_cr)) == 0);
+        assert(de->memory_index == rerun_de->memory_index);
+        assert(de->archive_size == rerun_de->archive_size);
+        for (size_t i = 0; i < de->archive_size; i++)
+            assert(memcmp(de->archive[i], rerun_de->archive[i], num_days * sizeof(stress_t)) == 0);
+
+        de_free(de);
+        de_free(rerun_de);
+        bt_population_free(parents);
+        bt_population_free(rerun_parents);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    test_bt_model_calculate_obj_func_gradient();
+    test_bt_polish_stresses();
+    test_ga_generation();
+    test_de_generation();
+
+    printf("Success!\n");
+}